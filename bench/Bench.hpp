@@ -0,0 +1,86 @@
+/**
+ * @file Bench.hpp
+ * @brief Minimal benchmark harness shared by the host and on-device runners.
+ *
+ * A benchmark is a function that runs an operation state.iterations times
+ * between state.start() and state.stop(). Benchmarks register themselves with
+ * BENCHMARK() and are timed with the HAL cycle counter, which counts CPU
+ * cycles on the ESP32 and nanoseconds on the host. A benchmark that also
+ * checks results calls state.fail(), which fails the run.
+ */
+
+#ifndef Bench_hpp
+#define Bench_hpp
+
+#include "HAL.hpp"
+
+namespace bench {
+
+/**
+ * @brief Timing state handed to a benchmark function.
+ */
+class State {
+public:
+    explicit State(uint32_t iterations)
+        : iterations(iterations), startCycles(0), elapsedCycles(0), failure(nullptr) {}
+
+    /** Starts (or resumes) timing. */
+    void start() { startCycles = hal::cycleCount(); }
+
+    /** Pauses timing and accumulates the elapsed cycles. */
+    void stop() { elapsedCycles += hal::cycleCount() - startCycles; }
+
+    const uint32_t iterations; // Number of operations to run between start() and stop()
+    uint64_t getElapsedCycles() const { return elapsedCycles; }
+
+    /** Marks the run failed; the timing is still reported. */
+    void fail(const char* reason) { failure = reason; }
+
+    /** Reason passed to fail(), or nullptr if the benchmark passed. */
+    const char* getFailure() const { return failure; }
+
+private:
+    uint32_t startCycles;
+    uint64_t elapsedCycles;
+    const char* failure;
+};
+
+typedef void (*Function)(State& state);
+
+/**
+ * @brief One registered benchmark.
+ */
+struct Case {
+    const char* name; // Unique name, printed in the results
+    Function function; // Benchmark body
+    uint32_t iterations; // Operations per run
+    Case* next; // Next registered benchmark
+};
+
+/**
+ * @brief Adds a benchmark to the global list. Used through BENCHMARK().
+ */
+class Registrar {
+public:
+    Registrar(Case& benchmark);
+};
+
+/**
+ * @brief Runs every registered benchmark and prints one line per benchmark.
+ * @return Number of benchmarks that failed.
+ */
+uint32_t runAll();
+
+} // namespace bench
+
+#define BENCH_CONCAT_INNER(a, b) a##b
+#define BENCH_CONCAT(a, b) BENCH_CONCAT_INNER(a, b)
+
+/**
+ * Registers a benchmark function under a name with a fixed iteration count.
+ */
+#define BENCHMARK(name, function, iterations) \
+    static bench::Case BENCH_CONCAT(benchCase, __LINE__) = {name, function, iterations, nullptr}; \
+    static bench::Registrar BENCH_CONCAT(benchRegistrar, __LINE__)(BENCH_CONCAT(benchCase, __LINE__))
+
+#endif /* Bench_hpp */
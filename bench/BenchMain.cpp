@@ -0,0 +1,120 @@
+/**
+ * @file BenchMain.cpp
+ * @brief Benchmark runner: main() on the host, setup() on the ESP32.
+ *
+ * Each result is printed twice: as a table row, and as a JSON object on a
+ * line of its own starting with "BENCH ", which tools/bench_compare.py picks
+ * out of a host run's output or a serial capture to compare two runs.
+ * A benchmark that failed a check gets a "FAIL" line after its result, and
+ * the host runner exits with status 1.
+ */
+
+#include <stdio.h>
+#include "Bench.hpp"
+#include "JsonWriter.hpp"
+
+namespace bench {
+
+namespace {
+
+Case* head = nullptr;
+Case* tail = nullptr;
+
+#ifdef ARDUINO
+const char* const platform = "esp32";
+#else
+const char* const platform = "native";
+#endif
+
+/**
+ * @brief Prints one result as a "BENCH " line for tools/bench_compare.py.
+ */
+void printRecord(const Case& benchmark, double cyclesPerOp, uint32_t perUs) {
+    char line[192] = "BENCH ";
+    JsonWriter json(line + 6, sizeof(line) - 7);
+    json.beginObject()
+        .key("name").string(benchmark.name)
+        .key("platform").string(platform)
+        .key("ops").number(benchmark.iterations)
+        .key("cycles_per_us").number(perUs)
+        .key("cycles_per_op").fixed(static_cast<int32_t>(cyclesPerOp * 100 + 0.5), 2)
+        .key("us_per_op").fixed(static_cast<int32_t>(cyclesPerOp * 1000 / perUs + 0.5), 3)
+        .endObject();
+    if (json.overflowed()) {
+        return;
+    }
+    line[6 + json.length()] = '\0';
+    hal::serialPrintln(line);
+}
+
+} // namespace
+
+/**
+ * @brief Appends the benchmark so they run in definition order.
+ */
+Registrar::Registrar(Case& benchmark) {
+    if (tail == nullptr) {
+        head = &benchmark;
+    } else {
+        tail->next = &benchmark;
+    }
+    tail = &benchmark;
+}
+
+/**
+ * @brief Runs each benchmark once and prints cycles and microseconds per
+ * operation, as a table row and as a "BENCH " JSON line.
+ * @return Number of benchmarks that failed.
+ */
+uint32_t runAll() {
+    uint32_t failures = 0;
+    char line[128];
+    uint32_t perUs = hal::cyclesPerMicrosecond();
+    snprintf(line, sizeof(line), "%-40s %10s %14s %12s", "benchmark", "ops", "cycles/op", "us/op");
+    hal::serialPrintln(line);
+    for (Case* benchmark = head; benchmark != nullptr; benchmark = benchmark->next) {
+        State state(benchmark->iterations);
+        benchmark->function(state);
+        double cyclesPerOp = static_cast<double>(state.getElapsedCycles()) / benchmark->iterations;
+        snprintf(line, sizeof(line), "%-40s %10lu %14.1f %12.3f", benchmark->name,
+            static_cast<unsigned long>(benchmark->iterations), cyclesPerOp, cyclesPerOp / perUs);
+        hal::serialPrintln(line);
+        printRecord(*benchmark, cyclesPerOp, perUs);
+        if (state.getFailure() != nullptr) {
+            snprintf(line, sizeof(line), "FAIL %s: %s", benchmark->name, state.getFailure());
+            hal::serialPrintln(line);
+            failures++;
+        }
+    }
+    if (failures > 0) {
+        snprintf(line, sizeof(line), "%lu benchmarks failed", static_cast<unsigned long>(failures));
+        hal::serialPrintln(line);
+    }
+    return failures;
+}
+
+} // namespace bench
+
+#ifdef ARDUINO
+
+void setup() {
+    hal::serialBegin(115200);
+    hal::delay(1000);
+    bench::runAll();
+}
+
+void loop() {
+    hal::delay(1000);
+}
+
+#else
+
+#include "HALSim.hpp"
+
+int main() {
+    hal::sim::setSerialEcho(true);
+    hal::serialBegin(115200);
+    return bench::runAll() == 0 ? 0 : 1;
+}
+
+#endif
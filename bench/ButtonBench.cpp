@@ -0,0 +1,119 @@
+/**
+ * @file ButtonBench.cpp
+ * @brief Cost of a button click, from the pin edge to the LEDs.
+ *
+ * "ButtonManager press and release" is one press and one release through
+ * the edge interrupt, the scheduler event and the debounce logic to the
+ * click handler. It needs simulated pin edges, so it only runs on the host.
+ * A click that does not reach the handler fails the run.
+ *
+ * "Button click to LEDs" is what the firmware's click handlers do after
+ * that: the control machine dispatch, the observer pass and the diode
+ * updates in one shift register transaction, as dispatchControlEvent() and
+ * applyStateToOutputs() in src/main.cpp. Clicks cycle through the grow
+ * modes and the pump so every operation changes the outputs.
+ */
+
+#include <stdio.h>
+#include "Bench.hpp"
+#include "AppState.hpp"
+#include "ButtonManager.hpp"
+#include "ControlMachine.hpp"
+#include "LEDController.hpp"
+#include "PinMap.hpp"
+#include "Scheduler.hpp"
+#include "ShiftRegister.hpp"
+#ifndef ARDUINO
+#include "HALSim.hpp"
+#endif
+
+namespace {
+
+constexpr uint8_t dataPin = 14;
+constexpr uint8_t clockPin = 27;
+constexpr uint8_t latchPin = 12;
+constexpr uint8_t buttonPin = 32;
+constexpr uint64_t settleUs = 100000; // Longer than the debounce delay
+
+typedef PinMap<0, 1, 2, 3, 4, 22, 23, 21> BenchPins;
+
+uint32_t clicks = 0;
+
+void countClick() {
+    clicks++;
+}
+
+#ifndef ARDUINO
+
+Scheduler scheduler;
+ButtonManager button(buttonPin);
+
+void pressAndRelease(bench::State& state) {
+    button.setup(scheduler);
+    button.setClickHandler(countClick);
+    hal::sim::advanceMicros(settleUs);
+    clicks = 0;
+    for (uint32_t i = 0; i < state.iterations; i++) {
+        state.start();
+        hal::sim::setInput(buttonPin, LOW);
+        scheduler.runPending();
+        state.stop();
+        hal::sim::advanceMicros(settleUs);
+        state.start();
+        hal::sim::setInput(buttonPin, HIGH);
+        scheduler.runPending();
+        state.stop();
+        hal::sim::advanceMicros(settleUs);
+    }
+    if (clicks != state.iterations) {
+        char line[64];
+        snprintf(line, sizeof(line), "  %lu of %lu clicks lost", static_cast<unsigned long>(state.iterations - clicks),
+            static_cast<unsigned long>(state.iterations));
+        hal::serialPrintln(line);
+        state.fail("clicks lost");
+    }
+}
+
+#endif
+
+AppState appState;
+ShiftRegister shiftRegister(dataPin, clockPin, latchPin);
+LEDController<BenchPins>* ledController = nullptr;
+
+void applyStateToOutputs(uint32_t changedMask, uint32_t current, void* context) {
+    (void)context;
+    static const DiodeType diodes[] = {DiodeType::Power, DiodeType::Pump, DiodeType::Vegetable, DiodeType::Flower};
+    shiftRegister.beginTransaction();
+    for (DiodeType diode : diodes) {
+        if (changedMask & AppState::bit(diode)) {
+            ledController->setLedDiodeState(diode, (current & AppState::bit(diode)) != 0);
+        }
+    }
+    shiftRegister.commit();
+}
+
+void clickToLeds(bench::State& state) {
+    static const control::Event clicks[] = {
+        control::Event::Vegetable, control::Event::Flower, control::Event::Flower, control::Event::Pump};
+    LEDController<BenchPins> controller(&shiftRegister);
+    ledController = &controller;
+    appState.subscribe(applyStateToOutputs, nullptr);
+    control::dispatch(appState, control::Event::Power);
+    appState.notifyObservers();
+    state.start();
+    for (uint32_t i = 0; i < state.iterations; i++) {
+        if (control::dispatch(appState, clicks[i % 4]) & control::TogglePump) {
+            appState.setPumpLedDiodeState(!appState.isPumpLedDiodeOn());
+        }
+        appState.notifyObservers();
+    }
+    state.stop();
+    ledController = nullptr;
+}
+
+} // namespace
+
+#ifndef ARDUINO
+BENCHMARK("ButtonManager press and release", pressAndRelease, 20000);
+#endif
+BENCHMARK("Button click to LEDs", clickToLeds, 20000);
@@ -0,0 +1,75 @@
+/**
+ * @file ControlMachineBench.cpp
+ * @brief Random button sequences through the control machine, checked against its invariants.
+ *
+ * One operation is one event: a dispatch on a real AppState, the pump LED
+ * switched if the machine asks for the pump, and the observers notified, as
+ * in a control cycle. Sequences of sequenceLength random events start from
+ * Off. Every state word an observer sees is checked with
+ * control::invariantsHold() and against the mode the machine's table says it
+ * should be in; a violation fails the run, with the count and the last bad
+ * state word printed above the result. 1 / (us/op) is millions of events
+ * checked per second.
+ */
+
+#include <stdio.h>
+#include "Bench.hpp"
+#include "ControlMachine.hpp"
+
+namespace {
+
+constexpr uint32_t eventsPerRun = 4000000;
+constexpr uint32_t sequenceLength = 32;
+
+AppState state;
+uint32_t violations = 0;
+uint32_t lastViolation = 0;
+control::Mode expectedMode = control::Mode::Off;
+
+void checkState(uint32_t changedMask, uint32_t current, void* context) {
+    (void)changedMask;
+    (void)context;
+    if (!control::invariantsHold(current) || control::modeOf(current) != expectedMode) {
+        violations++;
+        lastViolation = current;
+    }
+}
+
+void fuzzEvents(bench::State& benchState) {
+    state.subscribe(checkState, nullptr);
+    uint32_t x = 0x9E3779B9;
+    uint32_t sequences = 0;
+    benchState.start();
+    for (uint32_t i = 0; i < benchState.iterations; i++) {
+        if (i % sequenceLength == 0) {
+            expectedMode = control::Mode::Off;
+            state.replace(0);
+            state.notifyObservers();
+            sequences++;
+        }
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        control::Event event = static_cast<control::Event>(x % control::eventCount);
+        expectedMode = control::table.at(control::modeOf(state.snapshot()), event).next;
+        if (control::dispatch(state, event) & control::TogglePump) {
+            state.setPumpLedDiodeState(!state.isPumpLedDiodeOn());
+        }
+        state.notifyObservers();
+    }
+    benchState.stop();
+    char line[96];
+    snprintf(line, sizeof(line), "  %lu sequences of %lu events", static_cast<unsigned long>(sequences),
+        static_cast<unsigned long>(sequenceLength));
+    hal::serialPrintln(line);
+    if (violations > 0) {
+        snprintf(line, sizeof(line), "  %lu invariant violations, last state %08lx",
+            static_cast<unsigned long>(violations), static_cast<unsigned long>(lastViolation));
+        hal::serialPrintln(line);
+        benchState.fail("a state word broke the invariants or left the table's mode");
+    }
+}
+
+} // namespace
+
+BENCHMARK("ControlMachine random events", fuzzEvents, eventsPerRun);
@@ -0,0 +1,47 @@
+/**
+ * @file DebugLoggerBench.cpp
+ * @brief Cost of LOG_INFO to the calling task.
+ *
+ * One operation is one LOG_INFO with an integer argument, formatted as text
+ * or, built with LOG_BINARY, encoded as a binary record. Messages are logged
+ * in bursts shorter than the queue, and the drain task is given time to
+ * write each burst out untimed, so the figure is the cost of a message that
+ * finds room in the queue rather than of a dropped one. On the host there is
+ * no drain task: the queue is written inline with the serial echo off, which
+ * adds little.
+ */
+
+#include "Bench.hpp"
+#include "DebugLogger.hpp"
+#ifndef ARDUINO
+#include "HALSim.hpp"
+#endif
+
+namespace {
+
+constexpr uint32_t burstLength = DebugLogger::queueLength / 2;
+constexpr uint32_t drainDelayMs = 50; // Long enough for a burst at 115200 baud
+
+void logInfo(bench::State& state) {
+    DebugLogger::setDebug(true);
+#ifndef ARDUINO
+    hal::sim::setSerialEcho(false);
+#endif
+    for (uint32_t i = 0; i < state.iterations; i += burstLength) {
+        state.start();
+        for (uint32_t j = i; j < i + burstLength && j < state.iterations; j++) {
+            LOG_INFO("bench %lu", static_cast<unsigned long>(j));
+        }
+        state.stop();
+        hal::delay(drainDelayMs);
+    }
+#ifndef ARDUINO
+    hal::sim::setSerialEcho(true);
+#endif
+    DebugLogger::setDebug(false);
+    hal::serialBegin(115200); // setDebug(false) closed the port the results go to
+}
+
+} // namespace
+
+BENCHMARK("DebugLogger LOG_INFO", logInfo, 1024);
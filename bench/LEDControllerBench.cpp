@@ -0,0 +1,48 @@
+/**
+ * @file LEDControllerBench.cpp
+ * @brief Time to switch diodes through LEDController onto the shift register.
+ *
+ * Every operation changes the outputs, so each one clocks out the register:
+ * one diode per operation with setLedDiodeState(), three diodes in one
+ * transaction with tuneMultipleLedAttributes(). The difference between the
+ * two is what batching saves.
+ */
+
+#include "Bench.hpp"
+#include "LEDController.hpp"
+#include "PinMap.hpp"
+#include "ShiftRegister.hpp"
+
+namespace {
+
+constexpr uint8_t dataPin = 14;
+constexpr uint8_t clockPin = 27;
+constexpr uint8_t latchPin = 12;
+
+typedef PinMap<0, 1, 2, 3, 4, 22, 23, 21> BenchPins;
+
+void setDiodeState(bench::State& state) {
+    ShiftRegister shiftRegister(dataPin, clockPin, latchPin);
+    LEDController<BenchPins> ledController(&shiftRegister);
+    state.start();
+    for (uint32_t i = 0; i < state.iterations; i++) {
+        ledController.setLedDiodeState(DiodeType::Pump, (i & 1) != 0);
+    }
+    state.stop();
+}
+
+void tuneThreeDiodes(bench::State& state) {
+    ShiftRegister shiftRegister(dataPin, clockPin, latchPin);
+    LEDController<BenchPins> ledController(&shiftRegister);
+    state.start();
+    for (uint32_t i = 0; i < state.iterations; i++) {
+        bool on = (i & 1) != 0;
+        ledController.tuneMultipleLedAttributes(DiodeType::Power, on, DiodeType::Vegetable, !on, DiodeType::Flower, on);
+    }
+    state.stop();
+}
+
+} // namespace
+
+BENCHMARK("LEDController setLedDiodeState", setDiodeState, 20000);
+BENCHMARK("LEDController tuneMultipleLedAttributes x3", tuneThreeDiodes, 20000);
@@ -0,0 +1,71 @@
+/**
+ * @file PixelStripBench.cpp
+ * @brief Time to render an addressable strip frame, and a fade frame end to end.
+ *
+ * Gradient rendering is the work done for every frame of a fade; at 60
+ * frames per second a frame has 16.7 ms, most of which the control loop
+ * needs for itself. The fade benchmark renders into the back buffer and
+ * presents it while the previous frame is on the wire, so it also counts
+ * the buffer swap and the output call. On the host the simulated clock moves
+ * one frame interval per operation, so every frame goes out; on the ESP32
+ * frames presented while the output was busy replace the waiting one. The
+ * count of both is printed above the result.
+ */
+
+#include <stdio.h>
+#include "Bench.hpp"
+#include "PixelStrip.hpp"
+#include "Scheduler.hpp"
+#ifndef ARDUINO
+#include "HALSim.hpp"
+#endif
+
+namespace {
+
+constexpr uint8_t dataPin = 5;
+constexpr LedStripFader::Color dawn = {255, 64, 0};
+constexpr LedStripFader::Color noon = {32, 96, 255};
+
+template<uint16_t Pixels, PixelOrder Order>
+void renderGradient(bench::State& state) {
+    static uint8_t frame[Pixels * bytesPerPixel(Order)];
+    state.start();
+    for (uint32_t i = 0; i < state.iterations; i++) {
+        LedStripFader::Color end = {static_cast<uint8_t>(i), 128, 255};
+        PixelRenderer::renderGradient(frame, Pixels, Order, dawn, end);
+    }
+    state.stop();
+}
+
+void fadeFrame(bench::State& state) {
+    static PixelStrip<144> strip(dataPin);
+    Scheduler scheduler;
+    if (!strip.begin(scheduler)) {
+        return;
+    }
+    strip.fadeTo(dawn, noon, 0xFFFFFFFF);
+    uint32_t sentBefore = strip.getSentFrameCount();
+    uint32_t replacedBefore = strip.getReplacedFrameCount();
+    state.start();
+    for (uint32_t i = 0; i < state.iterations; i++) {
+        strip.renderFadeFrame();
+#ifndef ARDUINO
+        hal::sim::advanceMicros(PixelStripBase::frameIntervalMs * 1000); // Frame pacing the ESP32 gets from real time
+#endif
+    }
+    state.stop();
+    char line[96];
+    snprintf(line, sizeof(line), "  %lu frames sent, %lu replaced while the output was busy",
+        static_cast<unsigned long>(strip.getSentFrameCount() - sentBefore),
+        static_cast<unsigned long>(strip.getReplacedFrameCount() - replacedBefore));
+    hal::serialPrintln(line);
+}
+
+} // namespace
+
+BENCHMARK("PixelRenderer gradient, 60 RGB pixels", (renderGradient<60, PixelOrder::Grb>), 20000);
+BENCHMARK("PixelRenderer gradient, 144 RGB pixels", (renderGradient<144, PixelOrder::Grb>), 10000);
+BENCHMARK("PixelRenderer gradient, 300 RGB pixels", (renderGradient<300, PixelOrder::Grb>), 5000);
+BENCHMARK("PixelRenderer gradient, 600 RGB pixels", (renderGradient<600, PixelOrder::Grb>), 2000);
+BENCHMARK("PixelRenderer gradient, 144 RGBW pixels", (renderGradient<144, PixelOrder::Grbw>), 10000);
+BENCHMARK("PixelStrip fade frame, 144 RGB pixels", fadeFrame, 10000);
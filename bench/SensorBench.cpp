@@ -0,0 +1,56 @@
+/**
+ * @file SensorBench.cpp
+ * @brief Time per ADC sample through the SensorPipeline filters.
+ *
+ * One operation is one sample: the batches are split by channel, median
+ * filtered and averaged exactly as when they are drained from the DMA ring.
+ * 1 / (us/op) is the sustained sample rate in MHz the CPU could keep up with.
+ */
+
+#include "Bench.hpp"
+#include "SensorPipeline.hpp"
+
+namespace {
+
+constexpr uint32_t samplesPerRun = SensorPipeline::batchSamples * 400;
+
+uint16_t samples[SensorPipeline::batchSamples];
+SensorPipeline pipelines[3]; // Too large for the loop task's stack
+
+/**
+ * Fills a batch with channels 0..channelCount-1 interleaved, with noise and spikes.
+ */
+void fillBatch(uint8_t channelCount) {
+    uint32_t x = 0x2545F491;
+    for (size_t i = 0; i < SensorPipeline::batchSamples; i++) {
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        uint16_t value = static_cast<uint16_t>(2048 + (x & 63) + ((x >> 6) % 37 == 0 ? 1500 : 0));
+        uint8_t channel = static_cast<uint8_t>(i % channelCount);
+        samples[i] = static_cast<uint16_t>((channel << hal::adcSampleChannelShift) | value);
+    }
+}
+
+template<uint8_t ChannelCount, uint8_t Pipeline>
+void filterSamples(bench::State& state) {
+    SensorPipeline& pipeline = pipelines[Pipeline];
+    for (uint8_t i = 0; i < ChannelCount; i++) {
+        pipeline.addChannel(i, SensorPipeline::twoPoint(0, 0, 4095, 14000), 8);
+    }
+    fillBatch(ChannelCount);
+    state.start();
+    for (uint32_t i = 0; i < state.iterations; i += SensorPipeline::batchSamples) {
+        pipeline.process(samples, SensorPipeline::batchSamples);
+    }
+    state.stop();
+    if (pipeline.getReading(0) == 0) {
+        hal::serialPrintln("  (no reading, the filter did not run)");
+    }
+}
+
+} // namespace
+
+BENCHMARK("SensorPipeline 1 channel", (filterSamples<1, 0>), samplesPerRun);
+BENCHMARK("SensorPipeline 2 channels", (filterSamples<2, 1>), samplesPerRun);
+BENCHMARK("SensorPipeline 4 channels", (filterSamples<4, 2>), samplesPerRun);
@@ -0,0 +1,43 @@
+/**
+ * @file ShiftRegisterBench.cpp
+ * @brief Time per full-chain update of ShiftRegisterChain for both backends.
+ *
+ * Every operation flips one output and flushes, so each iteration clocks out
+ * the whole chain. With the SPI backend a write waits for the previous
+ * transfer, so the figure is the sustained update period, not just CPU time.
+ */
+
+#include "Bench.hpp"
+#include "ShiftRegisterChain.hpp"
+
+namespace {
+
+constexpr uint8_t dataPin = 14;
+constexpr uint8_t clockPin = 27;
+constexpr uint8_t latchPin = 12;
+
+template<uint8_t N, ShiftRegisterBackend Backend>
+void fullChainUpdate(bench::State& state) {
+    ShiftRegisterChain<N> chain(dataPin, clockPin, latchPin, Backend);
+    chain.flush();
+    if (chain.getBackend() != Backend) {
+        hal::serialPrintln("  (SPI unavailable, measured the bit-bang fallback)");
+    }
+    state.start();
+    for (uint32_t i = 0; i < state.iterations; i++) {
+        chain.setPinState(0, i & 1);
+        chain.flush();
+    }
+    state.stop();
+}
+
+} // namespace
+
+BENCHMARK("ShiftRegisterChain<1> bit-bang", (fullChainUpdate<1, ShiftRegisterBackend::BitBang>), 2000);
+BENCHMARK("ShiftRegisterChain<4> bit-bang", (fullChainUpdate<4, ShiftRegisterBackend::BitBang>), 1000);
+BENCHMARK("ShiftRegisterChain<16> bit-bang", (fullChainUpdate<16, ShiftRegisterBackend::BitBang>), 500);
+BENCHMARK("ShiftRegisterChain<64> bit-bang", (fullChainUpdate<64, ShiftRegisterBackend::BitBang>), 200);
+BENCHMARK("ShiftRegisterChain<1> spi", (fullChainUpdate<1, ShiftRegisterBackend::Spi>), 2000);
+BENCHMARK("ShiftRegisterChain<4> spi", (fullChainUpdate<4, ShiftRegisterBackend::Spi>), 1000);
+BENCHMARK("ShiftRegisterChain<16> spi", (fullChainUpdate<16, ShiftRegisterBackend::Spi>), 500);
+BENCHMARK("ShiftRegisterChain<64> spi", (fullChainUpdate<64, ShiftRegisterBackend::Spi>), 200);
@@ -0,0 +1,129 @@
+/**
+ * @file TelemetryBench.cpp
+ * @brief Ingest rate, compression and query cost of TelemetryStore.
+ *
+ * Appending is timed including the flash writes of full blocks and the
+ * erases of new segments, so the figure is the sustained ingest cost. Each
+ * append benchmark prints the space its records took: encoded, and on flash
+ * with block and segment headers, against 13 bytes for a plain record of
+ * time, channel and value. On the board this formats the storage partition.
+ */
+
+#include <stdio.h>
+#include "Bench.hpp"
+#include "TelemetryStore.hpp"
+
+namespace {
+
+constexpr uint32_t sensorIntervalMs = 60000;
+constexpr uint32_t queryWindowMs = 3600000;
+
+Scheduler scheduler; // Holds the flush timers, never run
+TelemetryStore stores[3];
+
+/**
+ * Mounts a store with a state channel and four sensor channels, and empties it.
+ */
+TelemetryStore& freshStore(uint8_t index) {
+    TelemetryStore& store = stores[index];
+    store.addChannel("state", TelemetryStore::Encoding::Xor);
+    store.addChannel("ph", TelemetryStore::Encoding::Delta);
+    store.addChannel("ec", TelemetryStore::Encoding::Delta);
+    store.addChannel("water", TelemetryStore::Encoding::Delta);
+    store.addChannel("level", TelemetryStore::Encoding::Delta);
+    if (!store.begin(scheduler, 0xFFFFFFFF) || !store.format()) {
+        hal::serialPrintln("  (no storage partition)");
+    }
+    return store;
+}
+
+/**
+ * Appends one round of the four sensor readings, drifting slowly with noise.
+ */
+void appendSensors(TelemetryStore& store, uint32_t round, uint32_t& noise) {
+    noise ^= noise << 13;
+    noise ^= noise >> 17;
+    noise ^= noise << 5;
+    uint32_t timeMs = round * sensorIntervalMs;
+    store.append(1, static_cast<int32_t>(6000 + round / 64 % 200 + (noise & 7)), timeMs);
+    store.append(2, static_cast<int32_t>(1200 + round / 128 % 100 + (noise >> 3 & 3)), timeMs);
+    store.append(3, static_cast<int32_t>(210 + round / 256 % 30), timeMs);
+    store.append(4, static_cast<int32_t>(750 - round / 512 % 100), timeMs);
+}
+
+void printSpace(const TelemetryStore& store) {
+    char line[128];
+    double records = store.getRecordCount();
+    snprintf(line, sizeof(line), "  %.2f bytes/record encoded, %.2f on flash, %.1f:1",
+        store.getEncodedBytes() / records, store.getConsumedBytes() / records,
+        13.0 * records / store.getConsumedBytes());
+    hal::serialPrintln(line);
+}
+
+void appendSensorReadings(bench::State& state) {
+    TelemetryStore& store = freshStore(0);
+    uint32_t noise = 0x2545F491;
+    state.start();
+    for (uint32_t round = 0; round < state.iterations / 4; round++) {
+        appendSensors(store, round, noise);
+    }
+    store.flush();
+    state.stop();
+    printSpace(store);
+}
+
+void appendStateChanges(bench::State& state) {
+    TelemetryStore& store = freshStore(1);
+    uint32_t noise = 0x9E3779B9;
+    uint32_t word = 0x2F;
+    uint32_t timeMs = 0;
+    state.start();
+    for (uint32_t i = 0; i < state.iterations; i++) {
+        noise ^= noise << 13;
+        noise ^= noise >> 17;
+        noise ^= noise << 5;
+        timeMs += 100 + noise % 900000;
+        word ^= 1u << (noise >> 24 & 7);
+        store.append(0, static_cast<int32_t>(word), timeMs);
+    }
+    store.flush();
+    state.stop();
+    printSpace(store);
+}
+
+void countRecord(uint8_t channel, uint64_t timeMs, int32_t value, void* context) {
+    (void)channel;
+    (void)timeMs;
+    (void)value;
+    (*static_cast<uint32_t*>(context))++;
+}
+
+/**
+ * Queries one-hour windows spread over two weeks of sensor readings.
+ */
+void queryHour(bench::State& state) {
+    TelemetryStore& store = freshStore(2);
+    constexpr uint32_t rounds = 14 * 24 * 60;
+    uint32_t noise = 0x2545F491;
+    for (uint32_t round = 0; round < rounds; round++) {
+        appendSensors(store, round, noise);
+    }
+    store.flush();
+    uint64_t startMs = store.now() - hal::millis();
+    uint32_t delivered = 0;
+    state.start();
+    for (uint32_t i = 0; i < state.iterations; i++) {
+        uint64_t fromMs = startMs + static_cast<uint64_t>(i * 7919 % (rounds - 60)) * sensorIntervalMs;
+        store.query(fromMs, fromMs + queryWindowMs - 1, countRecord, &delivered);
+    }
+    state.stop();
+    char line[96];
+    snprintf(line, sizeof(line), "  %.1f records per query", static_cast<double>(delivered) / state.iterations);
+    hal::serialPrintln(line);
+}
+
+} // namespace
+
+BENCHMARK("TelemetryStore append, sensor readings", appendSensorReadings, 40000);
+BENCHMARK("TelemetryStore append, state changes", appendStateChanges, 10000);
+BENCHMARK("TelemetryStore query, 1 h of 2 weeks", queryHour, 200);
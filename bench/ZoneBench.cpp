@@ -0,0 +1,70 @@
+/**
+ * @file ZoneBench.cpp
+ * @brief Cost of one ZoneController update pass as the zone count grows.
+ *
+ * One operation is one update() over all zones, 7 simulated seconds after
+ * the last, so a run crosses nights, ramps and days and every pump schedule.
+ * Half the zones grow vegetative and half flowering, the first 16 are dimmed
+ * through LEDC and the others switched only, and the pumps are staggered.
+ * The chain is only clocked out when an output changed, as in the firmware,
+ * so the figure is mostly the pass itself; the per-zone line above each
+ * result shows how it scales.
+ */
+
+#include <stdio.h>
+#include "Bench.hpp"
+#include "ShiftRegisterChain.hpp"
+#include "ZoneController.hpp"
+
+namespace {
+
+constexpr uint8_t maxZones = 64;
+constexpr uint8_t registers = 16; // A light and a pump output per zone
+constexpr uint8_t dataPin = 14;
+constexpr uint8_t clockPin = 27;
+constexpr uint8_t latchPin = 12;
+constexpr uint32_t secondsPerUpdate = 7;
+const uint8_t pwmPins[ZoneController<maxZones, registers>::ledcChannelCount] = {
+    2, 4, 5, 13, 15, 16, 17, 18, 19, 21, 22, 23, 25, 26, 32, 33};
+
+const PhotoperiodProgram vegetative = {6 * 3600, 18 * 3600, 30 * 60, {0, 0, 0}, {0, 0, 0}};
+const PhotoperiodProgram flowering = {6 * 3600, 12 * 3600, 45 * 60, {0, 0, 0}, {0, 0, 0}};
+
+ShiftRegisterChain<registers> chain(dataPin, clockPin, latchPin);
+ZoneController<maxZones, registers> zones(chain); // Too large for the loop task's stack
+
+template<uint8_t ZoneCount>
+void updateZones(bench::State& state) {
+    static_assert(ZoneCount <= maxZones, "more zones than the table holds");
+    while (zones.getZoneCount() < ZoneCount) {
+        uint8_t index = zones.getZoneCount();
+        bool pwm = index < zones.ledcChannelCount;
+        ZoneWiring wiring = {index, static_cast<uint16_t>(maxZones + index),
+            pwm ? index : ZoneWiring::noPwm, pwm ? pwmPins[index] : static_cast<uint8_t>(0)};
+        uint8_t zone = zones.addZone(wiring);
+        zones.setMode(zone, zone % 2 == 0 ? ZoneMode::Vegetative : ZoneMode::Flowering,
+            zone % 2 == 0 ? &vegetative : &flowering);
+        zones.setPumpInterval(zone, 3600, 900, zone * 225u);
+    }
+    uint32_t nowSeconds = 0;
+    state.start();
+    for (uint32_t i = 0; i < state.iterations; i++) {
+        zones.update(nowSeconds);
+        nowSeconds += secondsPerUpdate;
+    }
+    state.stop();
+    char line[64];
+    snprintf(line, sizeof(line), "  %.1f cycles per zone",
+        static_cast<double>(state.getElapsedCycles()) / state.iterations / ZoneCount);
+    hal::serialPrintln(line);
+}
+
+} // namespace
+
+BENCHMARK("ZoneController update, 1 zone", updateZones<1>, 20000);
+BENCHMARK("ZoneController update, 2 zones", updateZones<2>, 20000);
+BENCHMARK("ZoneController update, 4 zones", updateZones<4>, 20000);
+BENCHMARK("ZoneController update, 8 zones", updateZones<8>, 20000);
+BENCHMARK("ZoneController update, 16 zones", updateZones<16>, 20000);
+BENCHMARK("ZoneController update, 32 zones", updateZones<32>, 20000);
+BENCHMARK("ZoneController update, 64 zones", updateZones<64>, 20000);
@@ -6,16 +6,88 @@
 #include "AppState.hpp"
 
 /**
- * @brief Initializes state variables to false.
+ * @brief Initializes all states to false.
  */
-AppState::AppState() : powerOn(false), wifiLedDiodeState(false), pumpLedDiodeState(false), flowerLedDiodeState(false), ledStripState(false) {}
+AppState::AppState() : bits(0), changedMask(0), subscribers(), subscriberCount(0) {}
+
+/**
+ * @brief Reads all states at once.
+ * @return State word, decode with test().
+ */
+uint32_t AppState::snapshot() const {
+    return bits.load(std::memory_order_acquire);
+}
+
+/**
+ * @brief Replaces the whole state if it still equals an expected value.
+ * @param expected Value read earlier; updated to the current state on failure.
+ * @param desired New state word.
+ * @return True if the state was replaced.
+ */
+bool AppState::compareAndSwap(uint32_t& expected, uint32_t desired) {
+    uint32_t previous = expected;
+    if (!bits.compare_exchange_strong(expected, desired, std::memory_order_acq_rel)) {
+        return false;
+    }
+    changedMask.fetch_or(previous ^ desired, std::memory_order_release);
+    return true;
+}
+
+/**
+ * @brief Replaces the whole state unconditionally.
+ * @param desired New state word.
+ */
+void AppState::replace(uint32_t desired) {
+    uint32_t previous = bits.exchange(desired, std::memory_order_acq_rel);
+    if (previous != desired) {
+        changedMask.fetch_or(previous ^ desired, std::memory_order_release);
+    }
+}
+
+/**
+ * @brief Registers a function called by notifyObservers().
+ * @return False if the subscriber table is full.
+ */
+bool AppState::subscribe(Observer observer, void* context) {
+    if (subscriberCount >= maxObservers) {
+        return false;
+    }
+    subscribers[subscriberCount++] = {observer, context};
+    return true;
+}
+
+/**
+ * @brief Passes the changes since the last call to all subscribers.
+ */
+void AppState::notifyObservers() {
+    uint32_t changed = changedMask.exchange(0, std::memory_order_acq_rel);
+    if (changed == 0) {
+        return;
+    }
+    uint32_t current = snapshot();
+    for (uint8_t i = 0; i < subscriberCount; i++) {
+        subscribers[i].observer(changed, current, subscribers[i].context);
+    }
+}
+
+/**
+ * @brief Sets or clears bits and records which of them changed.
+ */
+void AppState::setBits(uint32_t mask, bool on) {
+    uint32_t previous = on ? bits.fetch_or(mask, std::memory_order_acq_rel)
+                           : bits.fetch_and(~mask, std::memory_order_acq_rel);
+    uint32_t changed = (on ? ~previous : previous) & mask;
+    if (changed != 0) {
+        changedMask.fetch_or(changed, std::memory_order_release);
+    }
+}
 
 /**
  * @brief Sets the power state.
  * @param state The new state to set.
  */
 void AppState::setPowerState(bool state) {
-    powerOn = state;
+    setBits(bit(Field::Power), state);
 }
 
 /**
@@ -23,7 +95,7 @@ void AppState::setPowerState(bool state) {
  * @return True if powered on, otherwise false.
  */
 bool AppState::isPowerOn() const {
-    return powerOn;
+    return test(snapshot(), Field::Power);
 }
 
 /**
@@ -31,7 +103,7 @@ bool AppState::isPowerOn() const {
  * @param state The new state to set.
  */
 void AppState::setWiFiLedDiodeState(bool state) {
-    wifiLedDiodeState = state;
+    setBits(bit(Field::WiFiLedDiode), state);
 }
 
 /**
@@ -39,7 +111,7 @@ void AppState::setWiFiLedDiodeState(bool state) {
  * @return True if on, otherwise false.
  */
 bool AppState::isWiFiLedDiodeOn() const {
-    return wifiLedDiodeState;
+    return test(snapshot(), Field::WiFiLedDiode);
 }
 
 /**
@@ -47,7 +119,7 @@ bool AppState::isWiFiLedDiodeOn() const {
  * @param state The new state to set.
  */
 void AppState::setPumpLedDiodeState(bool state) {
-    pumpLedDiodeState = state;
+    setBits(bit(Field::PumpLedDiode), state);
 }
 
 /**
@@ -55,7 +127,7 @@ void AppState::setPumpLedDiodeState(bool state) {
  * @return True if on, otherwise false.
  */
 bool AppState::isPumpLedDiodeOn() const {
-    return pumpLedDiodeState;
+    return test(snapshot(), Field::PumpLedDiode);
 }
 
 /**
@@ -63,7 +135,7 @@ bool AppState::isPumpLedDiodeOn() const {
  * @param state The new state to set.
  */
 void AppState::setVegetableLedDiodeState(bool state) {
-    vegetableLedDiodeState = state;
+    setBits(bit(Field::VegetableLedDiode), state);
 }
 
 /**
@@ -71,7 +143,7 @@ void AppState::setVegetableLedDiodeState(bool state) {
  * @return True if on, otherwise false.
  */
 bool AppState::isVegetableLedDiodeOn() const {
-    return vegetableLedDiodeState;
+    return test(snapshot(), Field::VegetableLedDiode);
 }
 
 /**
@@ -79,7 +151,7 @@ bool AppState::isVegetableLedDiodeOn() const {
  * @param state The new state to set.
  */
 void AppState::setFlowerLedDiodeState(bool state) {
-    flowerLedDiodeState = state;
+    setBits(bit(Field::FlowerLedDiode), state);
 }
 
 /**
@@ -87,7 +159,7 @@ void AppState::setFlowerLedDiodeState(bool state) {
  * @return True if on, otherwise false.
  */
 bool AppState::isFlowerLedDiodeOn() const {
-    return flowerLedDiodeState;
+    return test(snapshot(), Field::FlowerLedDiode);
 }
 
 /**
@@ -96,23 +168,7 @@ bool AppState::isFlowerLedDiodeOn() const {
  * @param state The new state to set.
  */
 void AppState::setLedDiodeState(DiodeType ledDiode, bool state) {
-    switch (ledDiode) {
-        case DiodeType::Power:
-            powerOn = state;
-            break;
-        case DiodeType::WiFi:
-            wifiLedDiodeState = state;
-            break;
-        case DiodeType::Pump:
-            pumpLedDiodeState = state;
-            break;
-        case DiodeType::Vegetable:
-            vegetableLedDiodeState = state;
-            break;
-        case DiodeType::Flower:
-            flowerLedDiodeState = state;
-            break;
-    }
+    setBits(bit(ledDiode), state);
 }
 
 /**
@@ -121,14 +177,7 @@ void AppState::setLedDiodeState(DiodeType ledDiode, bool state) {
  * @return The current state of the specified diode.
  */
 bool AppState::getStateForLedDiode(DiodeType ledDiode) const {
-    switch (ledDiode) {
-        case DiodeType::Power: return powerOn;
-        case DiodeType::WiFi: return wifiLedDiodeState;
-        case DiodeType::Pump: return pumpLedDiodeState;
-        case DiodeType::Vegetable: return vegetableLedDiodeState;
-        case DiodeType::Flower: return flowerLedDiodeState;
-        default: return false;
-    }
+    return (snapshot() & bit(ledDiode)) != 0;
 }
 
 /**
@@ -136,7 +185,7 @@ bool AppState::getStateForLedDiode(DiodeType ledDiode) const {
  * @param state The new state to set.
  */
 void AppState::setLedStripState(bool state) {
-    ledStripState = state;
+    setBits(bit(Field::LedStrip), state);
 }
 
 /**
@@ -144,5 +193,5 @@ void AppState::setLedStripState(bool state) {
  * @return True if on, otherwise false.
  */
 bool AppState::isLedStripOn() const {
-    return ledStripState;
+    return test(snapshot(), Field::LedStrip);
 }
@@ -6,19 +6,105 @@
 #ifndef AppState_hpp
 #define AppState_hpp
 
-#include "LEDController.hpp"
+#include <atomic>
+#include <stdint.h>
+#include "DiodeTypes.hpp"
 
 /**
  * @class AppState
  * @brief Holds and manages states for various system components.
+ *
+ * All states are bits of one atomic word, so the whole state can be read as a
+ * consistent snapshot from any core or task and updated with compare-and-swap.
+ * Diode states sit at the bit index of their DiodeType; the power state is the
+ * power diode. Every change is also recorded in a change mask, and
+ * notifyObservers() hands the accumulated changes to subscribers once per
+ * tick, so they only recompute what actually changed.
  */
 class AppState {
 public:
+    /**
+     * @brief Individual states, as bit indices into the state word.
+     */
+    enum class Field : uint8_t {
+        Power = static_cast<uint8_t>(DiodeType::Power),
+        WiFiLedDiode = static_cast<uint8_t>(DiodeType::WiFi),
+        PumpLedDiode = static_cast<uint8_t>(DiodeType::Pump),
+        VegetableLedDiode = static_cast<uint8_t>(DiodeType::Vegetable),
+        FlowerLedDiode = static_cast<uint8_t>(DiodeType::Flower),
+        LedStrip
+    };
+
+    /**
+     * @brief Called with the changed bits and the state after the change.
+     */
+    typedef void (*Observer)(uint32_t changedMask, uint32_t state, void* context);
+
+    static constexpr uint8_t maxObservers = 4; // Capacity of the subscriber table.
+    static_assert(static_cast<uint8_t>(Field::LedStrip) < 32, "every field needs a bit of the state word");
+
+    /**
+     * @brief Bit of a field in a state word or change mask.
+     */
+    static constexpr uint32_t bit(Field field) {
+        return 1u << static_cast<uint8_t>(field);
+    }
+
+    /**
+     * @brief Bit of a diode in a state word or change mask.
+     */
+    static constexpr uint32_t bit(DiodeType diode) {
+        return 1u << static_cast<uint8_t>(diode);
+    }
+
+    /**
+     * @brief Tests a field in a state word returned by snapshot().
+     */
+    static constexpr bool test(uint32_t state, Field field) {
+        return (state & bit(field)) != 0;
+    }
+
     /**
      * @brief Constructor for AppState. Initializes all states to false.
      */
     AppState();
     
+    // Whole-state access
+
+    /**
+     * @brief Reads all states at once.
+     * @return State word, decode with test().
+     */
+    uint32_t snapshot() const;
+
+    /**
+     * @brief Replaces the whole state if it still equals an expected value.
+     * @param expected Value read earlier; updated to the current state on failure.
+     * @param desired New state word.
+     * @return True if the state was replaced.
+     */
+    bool compareAndSwap(uint32_t& expected, uint32_t desired);
+
+    /**
+     * @brief Replaces the whole state unconditionally.
+     * @param desired New state word.
+     */
+    void replace(uint32_t desired);
+
+    /**
+     * @brief Registers a function called by notifyObservers().
+     * @return False if the subscriber table is full.
+     */
+    bool subscribe(Observer observer, void* context);
+
+    /**
+     * @brief Passes the changes since the last call to all subscribers.
+     *
+     * Call once per tick from the task that owns the outputs. Does nothing if
+     * no state changed.
+     */
+    void notifyObservers();
+
     // State checkers
 
     /**
@@ -110,12 +196,17 @@ public:
     bool getStateForLedDiode(DiodeType diode) const;
 
 private:
-    bool powerOn;
-    bool wifiLedDiodeState;
-    bool pumpLedDiodeState;
-    bool vegetableLedDiodeState;
-    bool flowerLedDiodeState;
-    bool ledStripState;
+    void setBits(uint32_t mask, bool on); // Sets or clears bits and records the change
+
+    struct Subscriber {
+        Observer observer; // Function to call
+        void* context; // Argument passed to the observer
+    };
+
+    std::atomic<uint32_t> bits; // One bit per Field
+    std::atomic<uint32_t> changedMask; // Bits changed since the last notifyObservers()
+    Subscriber subscribers[maxObservers]; // Registered observers
+    uint8_t subscriberCount; // Number of registered observers
 };
 
 #endif /* AppState_hpp */
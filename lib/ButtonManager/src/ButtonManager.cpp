@@ -7,42 +7,198 @@
  * @param pin The GPIO pin number for the button.
  */
 ButtonManager::ButtonManager(uint8_t pin)
-    : pin(pin), lastButtonState(HIGH), lastDebounceTime(0) {}
+    : pin(pin), lastButtonState(HIGH), lastChangeUs(0), scheduler(nullptr), edgeEvent(Scheduler::invalidId),
+      debounceTimer(Scheduler::invalidId), gestureTimer(Scheduler::invalidId), phase(GesturePhase::Idle), secondClick(false),
+      clickHandler(nullptr), gestureHandler(nullptr), gestureContext(nullptr), gestureMask(0) {}
 
 /**
  * @brief Sets up the button pin as an input with a pull-up resistor.
+ * @param scheduler Scheduler that runs the edge and gesture handlers.
  */
-void ButtonManager::setup() {
-    pinMode(pin, INPUT_PULLUP);
-    DebugLogger::info("Button initialized on pin " + String(pin));
+void ButtonManager::setup(Scheduler& scheduler) {
+    this->scheduler = &scheduler;
+    edgeEvent = scheduler.addEvent(onEdges, this);
+    debounceTimer = scheduler.addTimer(onDebounceExpired, this);
+    gestureTimer = scheduler.addTimer(onGestureTimer, this);
+    hal::pinMode(pin, INPUT_PULLUP);
+    lastButtonState = hal::digitalRead(pin);
+    lastChangeUs = hal::micros();
+    hal::attachInterrupt(pin, onEdgeInterrupt, this);
+    LOG_INFO("Button initialized on pin %u", pin);
 }
 
 /**
- * @brief Checks if the button has been clicked (short press).
- * @return True if the button has been clicked, false otherwise.
+ * @brief Sets the function called when the button is clicked.
+ * @param handler Click handler, or nullptr to ignore clicks.
  */
-bool ButtonManager::isClicked() {
-    bool currentState = digitalRead(pin);
-    bool clicked = (currentState == LOW && lastButtonState == HIGH);
-    lastButtonState = currentState;
-    if (clicked) {
-        DebugLogger::info("Button clicked on pin " + String(pin));
-    }
-    return clicked;
+void ButtonManager::setClickHandler(ClickHandler handler) {
+    clickHandler = handler;
+}
+
+/**
+ * @brief Sets the function receiving the gestures in a mask.
+ * @param handler Gesture handler, or nullptr.
+ * @param context Argument passed to the handler.
+ * @param gestureMask Combination of gestureBit() values.
+ */
+void ButtonManager::setGestureHandler(GestureHandler handler, void* context, uint8_t gestureMask) {
+    gestureHandler = handler;
+    gestureContext = context;
+    this->gestureMask = handler != nullptr ? gestureMask : 0;
+}
+
+/**
+ * @brief Checks whether the button is currently held down.
+ * @return True if pressed, false otherwise.
+ */
+bool ButtonManager::isPressed() const {
+    return lastButtonState == LOW;
+}
+
+/**
+ * @brief Number of edges lost because the edge ring was full.
+ */
+uint32_t ButtonManager::getDroppedEdges() const {
+    return edges.getDropped();
 }
 
 /**
- * @brief Updates the button state based on the current input and debounce delay.
+ * @brief Pin change interrupt. Timestamps the edge and defers everything else.
+ */
+void HAL_ISR_ATTR ButtonManager::onEdgeInterrupt(void* context) {
+    ButtonManager* button = static_cast<ButtonManager*>(context);
+    Edge edge = {hal::microsFromIsr(), static_cast<uint8_t>(hal::digitalReadFromIsr(button->pin))};
+    button->edges.push(edge);
+    button->scheduler->post(button->edgeEvent);
+}
+
+/**
+ * @brief Debounces the queued edges by their timestamps.
  *
- * This method should be called regularly (e.g., in the loop() function) to
- * keep the button state updated.
+ * An edge to the other level is accepted at once if the last accepted change
+ * is at least debounceDelay old. Edges inside the window are contact bounce;
+ * the debounce timer re-reads the pin when the window closes.
+ */
+void ButtonManager::onEdges(void* context) {
+    ButtonManager* button = static_cast<ButtonManager*>(context);
+    Edge edge;
+    while (button->edges.pop(edge)) {
+        if (edge.level == button->lastButtonState) {
+            continue;
+        }
+        uint32_t sinceChangeUs = edge.timestampUs - button->lastChangeUs;
+        if (sinceChangeUs >= debounceDelay * 1000) {
+            button->acceptLevel(edge.level, edge.timestampUs);
+        } else if (!button->scheduler->isTimerActive(button->debounceTimer)) {
+            button->scheduler->startTimer(button->debounceTimer, debounceDelay - sinceChangeUs / 1000);
+        }
+    }
+}
+
+/**
+ * @brief Closes the debounce window and picks up a change that happened inside it.
+ */
+void ButtonManager::onDebounceExpired(void* context) {
+    ButtonManager* button = static_cast<ButtonManager*>(context);
+    uint8_t level = hal::digitalRead(button->pin);
+    if (level != button->lastButtonState) {
+        button->acceptLevel(level, static_cast<uint32_t>(hal::micros()));
+    }
+}
+
+/**
+ * @brief Commits a debounced level change and opens a new debounce window.
+ */
+void ButtonManager::acceptLevel(uint8_t level, uint32_t timestampUs) {
+    lastButtonState = level;
+    lastChangeUs = timestampUs;
+    scheduler->startTimer(debounceTimer, debounceDelay);
+    if (level == LOW) {
+        onPress();
+    } else {
+        onRelease();
+    }
+}
+
+/**
+ * @brief Starts a gesture; fires the click at once if nothing needs to wait for the release.
+ */
+void ButtonManager::onPress() {
+    bool deferClick = isEnabled(ButtonGesture::LongPress) || isEnabled(ButtonGesture::HoldRepeat) ||
+        isEnabled(ButtonGesture::DoubleClick);
+    if (!deferClick) {
+        emit(ButtonGesture::Click);
+        return;
+    }
+    // A press inside the double-click window is decided on its release.
+    secondClick = phase == GesturePhase::ClickPending;
+    scheduler->stopTimer(gestureTimer);
+    phase = GesturePhase::Pressed;
+    if (isEnabled(ButtonGesture::LongPress) || isEnabled(ButtonGesture::HoldRepeat)) {
+        scheduler->startTimer(gestureTimer, longPressDelay);
+    }
+}
+
+/**
+ * @brief Ends a gesture: a short press becomes a click or completes a double click.
+ */
+void ButtonManager::onRelease() {
+    GesturePhase released = phase;
+    scheduler->stopTimer(gestureTimer);
+    phase = GesturePhase::Idle;
+    if (released != GesturePhase::Pressed) {
+        return;
+    }
+    if (secondClick) {
+        emit(ButtonGesture::DoubleClick);
+    } else if (isEnabled(ButtonGesture::DoubleClick)) {
+        phase = GesturePhase::ClickPending;
+        scheduler->startTimer(gestureTimer, doubleClickWindow);
+    } else {
+        emit(ButtonGesture::Click);
+    }
+}
+
+/**
+ * @brief Long press, hold repeat and double-click window timeouts.
  */
-void ButtonManager::update() {
-    bool currentState = digitalRead(pin);
-    if (currentState != lastButtonState) {
-        lastDebounceTime = millis();
+void ButtonManager::onGestureTimer(void* context) {
+    ButtonManager* button = static_cast<ButtonManager*>(context);
+    switch (button->phase) {
+        case GesturePhase::Pressed:
+            button->phase = GesturePhase::Holding;
+            button->emit(ButtonGesture::LongPress);
+            if (button->isEnabled(ButtonGesture::HoldRepeat)) {
+                button->scheduler->startTimer(button->gestureTimer, holdRepeatInterval, holdRepeatInterval);
+            }
+            break;
+        case GesturePhase::Holding:
+            button->emit(ButtonGesture::HoldRepeat);
+            break;
+        case GesturePhase::ClickPending:
+            button->phase = GesturePhase::Idle;
+            button->emit(ButtonGesture::Click);
+            break;
+        case GesturePhase::Idle:
+            break;
     }
-    if ((millis() - lastDebounceTime) > debounceDelay) {
-        lastButtonState = currentState;
+}
+
+/**
+ * @brief Delivers a gesture to the click handler and/or the gesture handler.
+ */
+void ButtonManager::emit(ButtonGesture gesture) {
+    if (gesture == ButtonGesture::Click) {
+        LOG_INFO("Button clicked on pin %u", pin);
+        if (clickHandler != nullptr) {
+            clickHandler();
+        }
+    }
+    if (gestureHandler != nullptr && isEnabled(gesture)) {
+        gestureHandler(gesture, gestureContext);
     }
-}
\ No newline at end of file
+}
+
+bool ButtonManager::isEnabled(ButtonGesture gesture) const {
+    return (gestureMask & gestureBit(gesture)) != 0;
+}
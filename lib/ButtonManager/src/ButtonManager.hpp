@@ -2,14 +2,48 @@
 #ifndef ButtonManager_h
 #define ButtonManager_h
 
-#include <Arduino.h>
+#include "HAL.hpp"
 #include "DebugLogger.hpp"
+#include "Scheduler.hpp"
+#include "SpscRing.hpp"
 
 /**
- * @brief Manages button input with debouncing and click detection.
+ * @brief Gestures recognised by ButtonManager.
+ */
+enum class ButtonGesture : uint8_t {
+    Click,          // Short press and release.
+    DoubleClick,    // Two clicks within the double-click window.
+    LongPress,      // Held for longer than the long-press delay.
+    HoldRepeat      // Repeats while still held after a long press.
+};
+
+/**
+ * @brief Manages button input with debouncing and gesture detection.
+ *
+ * The pin change interrupt only timestamps the edge, pushes it into a
+ * lock-free ring and posts a scheduler event. Debouncing and gesture
+ * recognition run in the scheduler task on those timestamps; timers are only
+ * armed while a gesture is in progress, so an untouched button costs nothing.
  */
 class ButtonManager {
 public:
+    /**
+     * @brief Signature of the function called when the button is clicked.
+     */
+    typedef void (*ClickHandler)();
+
+    /**
+     * @brief Signature of the function called for each enabled gesture.
+     */
+    typedef void (*GestureHandler)(ButtonGesture gesture, void* context);
+
+    /**
+     * @brief Bit of a gesture in a gesture mask.
+     */
+    static constexpr uint8_t gestureBit(ButtonGesture gesture) {
+        return static_cast<uint8_t>(1 << static_cast<uint8_t>(gesture));
+    }
+
     /**
      * @brief Constructs a new ButtonManager object.
      * @param pin The GPIO pin number for the button.
@@ -17,29 +51,87 @@ public:
     ButtonManager(uint8_t pin);
 
     /**
-     * @brief Sets up the button pin as an input with a pull-up resistor.
+     * @brief Sets up the button pin as an input with a pull-up resistor and attaches it to a scheduler.
+     * @param scheduler Scheduler that runs the edge and gesture handlers.
      */
-    void setup();
+    void setup(Scheduler& scheduler);
 
     /**
-     * @brief Checks if the button has been clicked (short press).
-     * @return True if the button has been clicked, false otherwise.
+     * @brief Sets the function called when the button is clicked (short press).
+     *
+     * Without other gestures enabled, the click fires on the press itself.
+     *
+     * @param handler Click handler, or nullptr to ignore clicks.
      */
-    bool isClicked();
+    void setClickHandler(ClickHandler handler);
 
     /**
-     * @brief Updates the button state based on the current input and debounce delay.
+     * @brief Sets the function receiving the gestures in a mask.
+     *
+     * Enabling LongPress or HoldRepeat delays Click to the release, enabling
+     * DoubleClick delays it until the double-click window has passed.
      *
-     * This method should be called regularly (e.g., in the loop() function) to
-     * keep the button state updated.
+     * @param handler Gesture handler, or nullptr.
+     * @param context Argument passed to the handler.
+     * @param gestureMask Combination of gestureBit() values.
      */
-    void update();
+    void setGestureHandler(GestureHandler handler, void* context, uint8_t gestureMask);
+
+    /**
+     * @brief Checks whether the button is currently held down (debounced).
+     * @return True if pressed, false otherwise.
+     */
+    bool isPressed() const;
+
+    /**
+     * @brief Number of edges lost because the edge ring was full.
+     */
+    uint32_t getDroppedEdges() const;
 
 private:
+    /**
+     * @brief Pin change captured in interrupt context.
+     */
+    struct Edge {
+        uint32_t timestampUs; // hal::micros() at the interrupt
+        uint8_t level; // Pin level after the change
+    };
+
+    static void HAL_ISR_ATTR onEdgeInterrupt(void* context); // Pin change interrupt
+    static void onEdges(void* context); // Drains the edge ring
+    static void onDebounceExpired(void* context); // Ends the debounce window
+    static void onGestureTimer(void* context); // Long press, repeat and double-click timeouts
+    void acceptLevel(uint8_t level, uint32_t timestampUs); // Commits a debounced change
+    void onPress(); // Starts a gesture
+    void onRelease(); // Completes a gesture
+    void emit(ButtonGesture gesture);
+    bool isEnabled(ButtonGesture gesture) const;
+
+    enum class GesturePhase : uint8_t {
+        Idle,           // Released, nothing pending
+        Pressed,        // Held, long press not reached
+        Holding,        // Held after a long press
+        ClickPending    // Released, waiting for a possible second click
+    };
+
     uint8_t pin; // GPIO pin number associated with the button
-    bool lastButtonState; // The previous read state of the button
-    unsigned long lastDebounceTime; // Last time the button state changed
+    uint8_t lastButtonState; // The last debounced state of the button
+    uint32_t lastChangeUs; // Timestamp of the last debounced change
+    Scheduler* scheduler; // Scheduler running the handlers
+    uint8_t edgeEvent; // Event posted by the pin interrupt
+    uint8_t debounceTimer; // Timer ending the debounce window
+    uint8_t gestureTimer; // Timer for the current gesture phase
+    GesturePhase phase; // Gesture recognition state
+    bool secondClick; // Current press started inside the double-click window
+    SpscRing<Edge, 16> edges; // Edges from the interrupt, in order
+    ClickHandler clickHandler; // Called on a click
+    GestureHandler gestureHandler; // Called on enabled gestures
+    void* gestureContext; // Argument passed to gestureHandler
+    uint8_t gestureMask; // Gestures delivered to gestureHandler
     static constexpr unsigned long debounceDelay = 80; // Debounce delay in milliseconds   
+    static constexpr unsigned long longPressDelay = 800; // Hold time for a long press (ms)
+    static constexpr unsigned long holdRepeatInterval = 250; // Repeat period while held (ms)
+    static constexpr unsigned long doubleClickWindow = 300; // Max gap between two clicks (ms)
 };
 
-#endif
\ No newline at end of file
+#endif
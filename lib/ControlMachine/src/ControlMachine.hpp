@@ -0,0 +1,268 @@
+/**
+ * @file ControlMachine.hpp
+ * @brief What the buttons do to the outputs, as a transition table built by the compiler.
+ */
+
+#ifndef ControlMachine_hpp
+#define ControlMachine_hpp
+
+#include <stddef.h>
+#include <stdint.h>
+#include "AppState.hpp"
+
+/**
+ * The controller's behaviour as a finite state machine over the AppState word.
+ *
+ * The mode is not stored anywhere: it is read from the state word, so the
+ * machine always agrees with what the outputs show, whoever changed them.
+ * The rules below are the whole behaviour. The compiler turns them into one
+ * table cell per mode and event holding the bits to clear and to set and the
+ * commands for the caller, so dispatch is one lookup and one compare-and-swap
+ * whatever the state. Entering or leaving a mode is an output diff against
+ * the mode's outputs, never a raw write, and the table is checked at compile
+ * time: no two rules for one cell, no cell leading to outputs that break
+ * invariantsHold(), every mode reachable from Off.
+ */
+namespace control {
+
+/**
+ * @brief Mode of the controller, read from the state word by modeOf().
+ */
+enum class Mode : uint8_t {
+    Off,        // Power off, every output off
+    Idle,       // Power on, no grow mode
+    Vegetative, // Vegetative light program on the strip
+    Flowering,  // Flowering light program on the strip
+    count
+};
+
+/**
+ * @brief Input of the machine.
+ */
+enum class Event : uint8_t {
+    Power,              // Power button with the WiFi link idle
+    PowerWhileLinkBusy, // Power button while the WiFi link is still connecting, backing off or up
+    Pump,               // Pump button
+    Vegetable,          // Vegetable button
+    Flower,             // Flower button
+    count
+};
+
+/**
+ * @brief Work outside AppState that a transition asks of the caller, as bits.
+ */
+enum Command : uint8_t {
+    NoCommand = 0,
+    ConnectWiFi = 1 << 0,
+    DisconnectWiFi = 1 << 1,
+    EnablePumps = 1 << 2,
+    DisablePumps = 1 << 3,
+    TogglePump = 1 << 4 // Switch the circulation pump by hand
+};
+
+constexpr uint8_t modeCount = static_cast<uint8_t>(Mode::count);
+constexpr uint8_t eventCount = static_cast<uint8_t>(Event::count);
+
+constexpr uint32_t powerBit = AppState::bit(AppState::Field::Power);
+constexpr uint32_t vegetableBit = AppState::bit(AppState::Field::VegetableLedDiode);
+constexpr uint32_t flowerBit = AppState::bit(AppState::Field::FlowerLedDiode);
+constexpr uint32_t stripBit = AppState::bit(AppState::Field::LedStrip);
+constexpr uint32_t wifiBit = AppState::bit(AppState::Field::WiFiLedDiode);
+
+/**
+ * @brief State bits a mode owns, on while the controller is in it.
+ */
+constexpr uint32_t outputsOf(Mode mode) {
+    return mode == Mode::Idle ? powerBit
+        : mode == Mode::Vegetative ? powerBit | vegetableBit | stripBit
+        : mode == Mode::Flowering ? powerBit | flowerBit | stripBit
+        : 0;
+}
+
+/**
+ * @brief The rules every state word must follow: at most one grow mode, the
+ * strip on exactly when a grow mode is, and nothing on without power.
+ */
+constexpr bool invariantsHold(uint32_t state) {
+    return (state & (vegetableBit | flowerBit)) != (vegetableBit | flowerBit) &&
+        ((state & stripBit) != 0) == ((state & (vegetableBit | flowerBit)) != 0) &&
+        ((state & powerBit) != 0 || state == 0);
+}
+
+/**
+ * @brief Mode a state word is in.
+ */
+constexpr Mode modeOf(uint32_t state) {
+    return (state & powerBit) == 0 ? Mode::Off
+        : (state & vegetableBit) != 0 ? Mode::Vegetative
+        : (state & flowerBit) != 0 ? Mode::Flowering
+        : Mode::Idle;
+}
+
+/**
+ * @brief One line of the behaviour: in a mode, an event leads to a mode, with extra commands.
+ */
+struct Rule {
+    Mode from;
+    Event event;
+    Mode to;
+    uint8_t commands; // Command bits besides those of entering or leaving Off
+};
+
+// The behaviour. An event with no rule in a mode is ignored. Power-up is
+// refused while the link is still busy from the last power-down.
+constexpr Rule rules[] = {
+    {Mode::Off, Event::Power, Mode::Idle, NoCommand},
+    {Mode::Idle, Event::Power, Mode::Off, NoCommand},
+    {Mode::Idle, Event::PowerWhileLinkBusy, Mode::Off, NoCommand},
+    {Mode::Idle, Event::Pump, Mode::Idle, TogglePump},
+    {Mode::Idle, Event::Vegetable, Mode::Vegetative, NoCommand},
+    {Mode::Idle, Event::Flower, Mode::Flowering, NoCommand},
+    {Mode::Vegetative, Event::Power, Mode::Off, NoCommand},
+    {Mode::Vegetative, Event::PowerWhileLinkBusy, Mode::Off, NoCommand},
+    {Mode::Vegetative, Event::Pump, Mode::Vegetative, TogglePump},
+    {Mode::Vegetative, Event::Vegetable, Mode::Idle, NoCommand},
+    {Mode::Vegetative, Event::Flower, Mode::Flowering, NoCommand},
+    {Mode::Flowering, Event::Power, Mode::Off, NoCommand},
+    {Mode::Flowering, Event::PowerWhileLinkBusy, Mode::Off, NoCommand},
+    {Mode::Flowering, Event::Pump, Mode::Flowering, TogglePump},
+    {Mode::Flowering, Event::Vegetable, Mode::Vegetative, NoCommand},
+    {Mode::Flowering, Event::Flower, Mode::Idle, NoCommand},
+};
+constexpr size_t ruleCount = sizeof(rules) / sizeof(rules[0]);
+
+/**
+ * @brief What an event does in a mode: an output diff and commands.
+ */
+struct Transition {
+    Mode next;
+    uint8_t commands; // Command bits
+    bool handled; // A rule covers the cell; otherwise the event is ignored
+    uint32_t clearMask; // State bits switched off
+    uint32_t setMask; // State bits switched on
+};
+
+/**
+ * @brief Every mode and event's transition, built from the rules at compile time.
+ *
+ * Leaving the powered modes for Off clears the whole word, pump and WiFi
+ * LEDs included, and stops the pumps and the link; entering them from Off
+ * also lights the WiFi LED, which follows the link from then on, and starts
+ * the pumps and the link. Between powered modes only the mode outputs change.
+ */
+class TransitionTable {
+public:
+    constexpr TransitionTable() : cells(), duplicates(0) {
+        for (uint8_t mode = 0; mode < modeCount; mode++) {
+            for (uint8_t event = 0; event < eventCount; event++) {
+                cells[mode][event] = {static_cast<Mode>(mode), NoCommand, false, 0, 0};
+            }
+        }
+        for (size_t i = 0; i < ruleCount; i++) {
+            const Rule& rule = rules[i];
+            Transition& cell = cells[static_cast<uint8_t>(rule.from)][static_cast<uint8_t>(rule.event)];
+            if (cell.handled) {
+                duplicates++;
+            }
+            cell = build(rule);
+        }
+    }
+
+    /**
+     * @brief Transition of an event in a mode.
+     */
+    constexpr const Transition& at(Mode mode, Event event) const {
+        return cells[static_cast<uint8_t>(mode)][static_cast<uint8_t>(event)];
+    }
+
+    /**
+     * @brief Cells covered by more than one rule.
+     */
+    constexpr size_t duplicateRules() const {
+        return duplicates;
+    }
+
+    /**
+     * @brief True if every cell, applied to its mode's outputs, lands on its
+     * next mode's outputs, and those follow invariantsHold().
+     */
+    constexpr bool diffsReachNextMode() const {
+        for (uint8_t mode = 0; mode < modeCount; mode++) {
+            for (uint8_t event = 0; event < eventCount; event++) {
+                const Transition& cell = cells[mode][event];
+                uint32_t from = outputsOf(static_cast<Mode>(mode)) | (mode != 0 ? wifiBit : 0);
+                uint32_t state = (from & ~cell.clearMask) | cell.setMask;
+                if (modeOf(state) != cell.next || (state & ~wifiBit) != outputsOf(cell.next) || !invariantsHold(state)) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    /**
+     * @brief True if every mode can be reached from Off.
+     */
+    constexpr bool allModesReachable() const {
+        bool reached[modeCount] = {};
+        reached[static_cast<uint8_t>(Mode::Off)] = true;
+        for (uint8_t round = 0; round < modeCount; round++) {
+            for (uint8_t mode = 0; mode < modeCount; mode++) {
+                for (uint8_t event = 0; event < eventCount && reached[mode]; event++) {
+                    reached[static_cast<uint8_t>(cells[mode][event].next)] = true;
+                }
+            }
+        }
+        for (uint8_t mode = 0; mode < modeCount; mode++) {
+            if (!reached[mode]) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+private:
+    static constexpr Transition build(const Rule& rule) {
+        uint32_t from = outputsOf(rule.from);
+        uint32_t to = outputsOf(rule.to);
+        bool leavingPower = rule.from != Mode::Off && rule.to == Mode::Off;
+        bool enteringPower = rule.from == Mode::Off && rule.to != Mode::Off;
+        uint8_t commands = rule.commands;
+        if (leavingPower) {
+            commands |= DisconnectWiFi | DisablePumps;
+        } else if (enteringPower) {
+            commands |= ConnectWiFi | EnablePumps;
+        }
+        return {rule.to, commands, true, leavingPower ? ~0u : from & ~to, (to & ~from) | (enteringPower ? wifiBit : 0)};
+    }
+
+    Transition cells[modeCount][eventCount];
+    size_t duplicates;
+};
+
+constexpr TransitionTable table;
+static_assert(table.duplicateRules() == 0, "two rules for one mode and event");
+static_assert(table.diffsReachNextMode(), "a transition breaks an invariant or misses its next mode");
+static_assert(table.allModesReachable(), "a mode cannot be reached from Off");
+
+/**
+ * @brief Applies an event to the state word and returns the commands for the caller.
+ *
+ * Reads the mode from the word, looks up its cell and applies the cell's
+ * diff in one compare-and-swap, retrying with the new word if another task
+ * changed it meanwhile. Observers see the diff on the next notifyObservers().
+ *
+ * @return Command bits to carry out, NoCommand if the event was ignored.
+ */
+inline uint8_t dispatch(AppState& state, Event event) {
+    uint32_t expected = state.snapshot();
+    const Transition* cell;
+    do {
+        cell = &table.at(modeOf(expected), event);
+    } while (!state.compareAndSwap(expected, (expected & ~cell->clearMask) | cell->setMask));
+    return cell->commands;
+}
+
+} // namespace control
+
+#endif /* ControlMachine_hpp */
@@ -0,0 +1,186 @@
+/**
+ * @file BinaryLog.hpp
+ * @brief Argument encoding and framing for deferred-formatting binary logs.
+ *
+ * In binary mode a log record carries the offset of its format string from
+ * debugLogFormatAnchor instead of the formatted text. Arguments are stored
+ * raw with a one-byte type tag, integers as LEB128 varints. The drain task
+ * frames each record with COBS between zero bytes; tools/log_decode.py looks
+ * the format strings up in the firmware ELF and rebuilds the text.
+ *
+ * Frame payload, before COBS:
+ *   level (1 byte), format offset (zigzag varint),
+ *   microseconds since the previous record (zigzag varint),
+ *   arguments (tag + value)..., checksum (1 byte, XOR of the preceding bytes).
+ */
+
+#ifndef BinaryLog_hpp
+#define BinaryLog_hpp
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <type_traits>
+
+/**
+ * @brief Link-time reference point for format string offsets.
+ */
+extern "C" const char debugLogFormatAnchor[];
+
+/**
+ * @brief Type tag stored in front of each binary log argument.
+ */
+enum class BinaryLogTag : uint8_t {
+    Unsigned = 0,   // Varint.
+    Signed = 1,     // Zigzag varint.
+    Double = 2,     // 8 bytes, IEEE 754 little-endian.
+    String = 3,     // Length byte followed by the bytes, no terminator.
+    Truncated = 4   // The remaining arguments did not fit.
+};
+
+/**
+ * @brief Writes tagged arguments into a fixed buffer, stopping cleanly when it is full.
+ */
+class BinaryLogWriter {
+public:
+    BinaryLogWriter(uint8_t* buffer, size_t capacity) : buffer(buffer), capacity(capacity), length(0), full(false) {}
+
+    /**
+     * @brief Appends all arguments in order.
+     */
+    template<typename... Args>
+    void writeAll(Args... args) {
+        int expand[] = {0, (write(args), 0)...};
+        (void)expand;
+    }
+
+    template<typename T, typename std::enable_if<std::is_integral<T>::value && std::is_signed<T>::value, int>::type = 0>
+    void write(T value) {
+        writeTagged(BinaryLogTag::Signed, zigzag(static_cast<int64_t>(value)));
+    }
+
+    template<typename T, typename std::enable_if<std::is_integral<T>::value && !std::is_signed<T>::value, int>::type = 0>
+    void write(T value) {
+        writeTagged(BinaryLogTag::Unsigned, static_cast<uint64_t>(value));
+    }
+
+    template<typename T, typename std::enable_if<std::is_enum<T>::value, int>::type = 0>
+    void write(T value) {
+        write(static_cast<typename std::underlying_type<T>::type>(value));
+    }
+
+    void write(double value) {
+        uint8_t bytes[1 + sizeof(double)];
+        bytes[0] = static_cast<uint8_t>(BinaryLogTag::Double);
+        memcpy(bytes + 1, &value, sizeof(double));
+        append(bytes, sizeof(bytes));
+    }
+
+    void write(float value) {
+        write(static_cast<double>(value));
+    }
+
+    void write(const char* text) {
+        if (full || length + 2 > capacity) {
+            markFull();
+            return;
+        }
+        // Strings are shortened to fit; the record stays decodable.
+        size_t room = capacity - length - 2;
+        if (room > 255) {
+            room = 255;
+        }
+        size_t textLength = 0;
+        while (text != nullptr && textLength < room && text[textLength] != '\0') {
+            textLength++;
+        }
+        buffer[length++] = static_cast<uint8_t>(BinaryLogTag::String);
+        buffer[length++] = static_cast<uint8_t>(textLength);
+        memcpy(buffer + length, text, textLength);
+        length += textLength;
+    }
+
+    void write(const void* pointer) {
+        writeTagged(BinaryLogTag::Unsigned, reinterpret_cast<uintptr_t>(pointer));
+    }
+
+    /**
+     * @brief Number of bytes written.
+     */
+    size_t size() const { return length; }
+
+    /**
+     * @brief Encodes an unsigned LEB128 varint.
+     * @return Number of bytes used (at most 10).
+     */
+    static size_t encodeVarint(uint64_t value, uint8_t* out) {
+        size_t count = 0;
+        do {
+            uint8_t byte = value & 0x7F;
+            value >>= 7;
+            out[count++] = byte | (value != 0 ? 0x80 : 0);
+        } while (value != 0);
+        return count;
+    }
+
+    /**
+     * @brief Maps signed to unsigned so that small magnitudes stay short.
+     */
+    static uint64_t zigzag(int64_t value) {
+        return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+    }
+
+private:
+    void writeTagged(BinaryLogTag tag, uint64_t value) {
+        uint8_t bytes[11];
+        bytes[0] = static_cast<uint8_t>(tag);
+        append(bytes, 1 + encodeVarint(value, bytes + 1));
+    }
+
+    void append(const uint8_t* bytes, size_t count) {
+        if (full || length + count > capacity) {
+            markFull();
+            return;
+        }
+        memcpy(buffer + length, bytes, count);
+        length += count;
+    }
+
+    void markFull() {
+        if (!full && length < capacity) {
+            buffer[length++] = static_cast<uint8_t>(BinaryLogTag::Truncated);
+        }
+        full = true;
+    }
+
+    uint8_t* buffer; // Destination
+    size_t capacity; // Size of the destination
+    size_t length; // Bytes written
+    bool full; // An argument did not fit
+};
+
+/**
+ * @brief COBS-encodes a payload so that it contains no zero bytes.
+ * @param out Destination of at least length + length / 254 + 1 bytes.
+ * @return Encoded length.
+ */
+inline size_t cobsEncode(const uint8_t* payload, size_t length, uint8_t* out) {
+    size_t codeIndex = 0;
+    size_t written = 1;
+    uint8_t code = 1;
+    for (size_t i = 0; i < length; i++) {
+        if (payload[i] != 0) {
+            out[written++] = payload[i];
+            code++;
+        }
+        if (payload[i] == 0 || code == 0xFF) {
+            out[codeIndex] = code;
+            codeIndex = written++;
+            code = 1;
+        }
+    }
+    out[codeIndex] = code;
+    return written;
+}
+
+#endif /* BinaryLog_hpp */
@@ -1,25 +1,60 @@
 // DebugLogger.cpp
 #include "DebugLogger.hpp"
+#include <stdio.h>
+
+// Drain task parameters: below the application loop, on the core the loop does not run on.
+static constexpr uint32_t drainTaskStackBytes = 3072;
+static constexpr uint8_t drainTaskPriority = 1;
+static constexpr int8_t drainTaskCore = 0;
 
 bool DebugLogger::isDebugEnabled = false;
+MpscRing<DebugLogger::Record, DebugLogger::queueLength> DebugLogger::queue;
+hal::TaskHandle DebugLogger::drainTaskHandle = nullptr;
+uint32_t DebugLogger::reportedDrops = 0;
+uint32_t DebugLogger::lastTimestampUs = 0;
+
+// Binary format strings are identified by their offset from this string.
+extern "C" const char debugLogFormatAnchor[] = "";
+
+/**
+ * @brief Formats a message and queues it for output.
+ * @param level Severity of the message.
+ * @param format printf-style format string.
+ */
+void DebugLogger::log(LogLevel level, const char* format, ...) {
+    va_list arguments;
+    va_start(arguments, format);
+    logv(level, format, arguments);
+    va_end(arguments);
+}
 
 /**
- * @brief Logs an informational message.
- * @param message The message to be logged.
+ * @brief Formats a message from a va_list and queues it for output.
  */
-void DebugLogger::info(const String& message) {
-    if (isDebugEnabled) {
-        Serial.println("[INFO] " + message);
+void DebugLogger::logv(LogLevel level, const char* format, va_list arguments) {
+    if (!isDebugEnabled) {
+        return;
     }
+    Record record;
+    record.level = level;
+    record.timestampUs = static_cast<uint32_t>(hal::micros());
+    record.format = nullptr;
+    int length = vsnprintf(reinterpret_cast<char*>(record.data), sizeof(record.data), format, arguments);
+    record.length = static_cast<uint8_t>(length < 0 ? 0 : (length < static_cast<int>(sizeof(record.data)) ? length : sizeof(record.data) - 1));
+    enqueue(record);
 }
 
 /**
- * @brief Logs an error message.
- * @param message The message to be logged.
+ * @brief Queues a record and wakes the drain task.
  */
-void DebugLogger::error(const String& message) {
-    if (isDebugEnabled) {
-        Serial.println("[ERROR] " + message);
+void DebugLogger::enqueue(const Record& record) {
+    if (!queue.push(record)) {
+        return;
+    }
+    if (drainTaskHandle != nullptr) {
+        hal::notifyTask(drainTaskHandle);
+    } else {
+        flush();
     }
 }
 
@@ -28,10 +63,114 @@ void DebugLogger::error(const String& message) {
  * @param enable True to enable debug logging, false to disable.
  */
 void DebugLogger::setDebug(bool enable) {
-    isDebugEnabled = enable;
     if (enable) {
-        Serial.begin(115200);
+        hal::serialBegin(115200);
+        if (drainTaskHandle == nullptr) {
+            drainTaskHandle = hal::startTask("log", drainTask, nullptr, drainTaskStackBytes, drainTaskPriority, drainTaskCore);
+        }
     } else {
-        Serial.end();
+        if (drainTaskHandle == nullptr) {
+            flush();
+        }
+        hal::serialEnd();
+    }
+    isDebugEnabled = enable;
+}
+
+/**
+ * @brief Writes all queued messages from the calling task.
+ */
+void DebugLogger::flush() {
+    Record record;
+    while (queue.pop(record)) {
+        writeRecord(record);
+    }
+    uint32_t dropped = queue.getDropped();
+    if (dropped != reportedDrops) {
+        // Written directly: the queue may still be full.
+        static const char droppedFormat[] = "%lu log messages dropped";
+        unsigned long count = dropped - reportedDrops;
+        record.level = LogLevel::Warn;
+        record.timestampUs = static_cast<uint32_t>(hal::micros());
+#ifdef LOG_BINARY
+        record.format = droppedFormat;
+        BinaryLogWriter writer(record.data, sizeof(record.data));
+        writer.write(count);
+        record.length = static_cast<uint8_t>(writer.size());
+#else
+        record.format = nullptr;
+        snprintf(reinterpret_cast<char*>(record.data), sizeof(record.data), droppedFormat, count);
+#endif
+        writeRecord(record);
+        reportedDrops = dropped;
+    }
+}
+
+/**
+ * @brief Number of messages dropped because the queue was full.
+ */
+uint32_t DebugLogger::getDroppedCount() {
+    return queue.getDropped();
+}
+
+/**
+ * @brief Sleeps until messages are queued and writes them out.
+ */
+void DebugLogger::drainTask(void* context) {
+    (void)context;
+    for (;;) {
+        hal::waitForNotification(hal::waitForever);
+        flush();
+    }
+}
+
+/**
+ * @brief Writes one record to serial, as a text line or as a binary frame.
+ */
+void DebugLogger::writeRecord(const Record& record) {
+    if (record.format != nullptr) {
+        writeBinaryRecord(record);
+        return;
     }
-}
\ No newline at end of file
+    char line[maxMessageLength + 8];
+    snprintf(line, sizeof(line), "%s%s", levelPrefix(record.level), reinterpret_cast<const char*>(record.data));
+    hal::serialPrintln(line);
+}
+
+/**
+ * @brief Frames a binary record as documented in BinaryLog.hpp and writes it.
+ */
+void DebugLogger::writeBinaryRecord(const Record& record) {
+    uint8_t payload[1 + 10 + 10 + maxMessageLength + 1];
+    size_t length = 0;
+    payload[length++] = static_cast<uint8_t>(record.level);
+    int64_t offset = static_cast<int64_t>(reinterpret_cast<uintptr_t>(record.format)) -
+        static_cast<int64_t>(reinterpret_cast<uintptr_t>(debugLogFormatAnchor));
+    length += BinaryLogWriter::encodeVarint(BinaryLogWriter::zigzag(offset), payload + length);
+    int32_t elapsedUs = static_cast<int32_t>(record.timestampUs - lastTimestampUs);
+    length += BinaryLogWriter::encodeVarint(BinaryLogWriter::zigzag(elapsedUs), payload + length);
+    lastTimestampUs = record.timestampUs;
+    memcpy(payload + length, record.data, record.length);
+    length += record.length;
+    uint8_t checksum = 0;
+    for (size_t i = 0; i < length; i++) {
+        checksum ^= payload[i];
+    }
+    payload[length++] = checksum;
+
+    uint8_t frame[sizeof(payload) + sizeof(payload) / 254 + 3];
+    frame[0] = 0;
+    size_t frameLength = 1 + cobsEncode(payload, length, frame + 1);
+    frame[frameLength++] = 0;
+    hal::serialWrite(frame, frameLength);
+}
+
+const char* DebugLogger::levelPrefix(LogLevel level) {
+    switch (level) {
+        case LogLevel::Error: return "[ERROR] ";
+        case LogLevel::Warn: return "[WARN] ";
+        case LogLevel::Info: return "[INFO] ";
+        case LogLevel::Debug: return "[DEBUG] ";
+    }
+    return "";
+}
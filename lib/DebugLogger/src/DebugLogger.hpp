@@ -2,33 +2,171 @@
 #ifndef DebugLogger_h
 #define DebugLogger_h
 
-#include <Arduino.h>
+#include "HAL.hpp"
+#include "MpscRing.hpp"
+#include "BinaryLog.hpp"
+#include <stdarg.h>
+
+// Log levels for LOG_LEVEL, from quietest to most verbose.
+#define LOG_LEVEL_NONE 0
+#define LOG_LEVEL_ERROR 1
+#define LOG_LEVEL_WARN 2
+#define LOG_LEVEL_INFO 3
+#define LOG_LEVEL_DEBUG 4
+
+// Most verbose level compiled in. Calls above it vanish, arguments included.
+#ifndef LOG_LEVEL
+#define LOG_LEVEL LOG_LEVEL_INFO
+#endif
+
+// With LOG_BINARY defined, records carry the format string offset and raw
+// arguments instead of text; decode the serial output with tools/log_decode.py.
+#ifdef LOG_BINARY
+#define DEBUG_LOG_EMIT(level, ...) \
+    do { \
+        if (false) DebugLogger::checkFormat(__VA_ARGS__); \
+        DebugLogger::logBinary(level, __VA_ARGS__); \
+    } while (0)
+#else
+#define DEBUG_LOG_EMIT(level, ...) DebugLogger::log(level, __VA_ARGS__)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_ERROR
+#define LOG_ERROR(...) DEBUG_LOG_EMIT(LogLevel::Error, __VA_ARGS__)
+#else
+#define LOG_ERROR(...) do {} while (0)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_WARN
+#define LOG_WARN(...) DEBUG_LOG_EMIT(LogLevel::Warn, __VA_ARGS__)
+#else
+#define LOG_WARN(...) do {} while (0)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_INFO
+#define LOG_INFO(...) DEBUG_LOG_EMIT(LogLevel::Info, __VA_ARGS__)
+#else
+#define LOG_INFO(...) do {} while (0)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_DEBUG
+#define LOG_DEBUG(...) DEBUG_LOG_EMIT(LogLevel::Debug, __VA_ARGS__)
+#else
+#define LOG_DEBUG(...) do {} while (0)
+#endif
+
+/**
+ * @brief Severity of a log message.
+ */
+enum class LogLevel : uint8_t {
+    Error = LOG_LEVEL_ERROR,
+    Warn = LOG_LEVEL_WARN,
+    Info = LOG_LEVEL_INFO,
+    Debug = LOG_LEVEL_DEBUG
+};
 
 /**
  * @brief Provides static methods for logging debug information.
+ *
+ * Messages are formatted printf-style into a preallocated lock-free ring and
+ * written to serial by a low-priority task, so logging never allocates and
+ * never waits for the UART. Messages that find the ring full are dropped and
+ * counted. Use the LOG_* macros so that levels above LOG_LEVEL cost nothing.
+ *
+ * In binary mode (LOG_BINARY) formatting is deferred to the host: a record
+ * holds a timestamp, the format string's offset in the firmware image and
+ * the raw arguments, which is several times less to build and to send.
  */
 class DebugLogger {
 public:
+    static constexpr size_t maxMessageLength = 96; // Longer messages are truncated.
+    static constexpr uint32_t queueLength = 32; // Messages buffered for the drain task.
+
+    /**
+     * @brief Formats a message and queues it for output.
+     * @param level Severity of the message.
+     * @param format printf-style format string.
+     */
+    static void log(LogLevel level, const char* format, ...) __attribute__((format(printf, 2, 3)));
+
+    /**
+     * @brief Formats a message from a va_list and queues it for output.
+     */
+    static void logv(LogLevel level, const char* format, va_list arguments);
+
     /**
-     * @brief Logs an informational message.
-     * @param message The message to be logged.
+     * @brief Queues a binary record without formatting it.
+     * @param level Severity of the message.
+     * @param format printf-style format string literal, identified by its address.
+     * @param args Integers, floating point values, strings or pointers.
      */
-    static void info(const String& message);
+    template<typename... Args>
+    static void logBinary(LogLevel level, const char* format, Args... args) {
+        if (!isDebugEnabled) {
+            return;
+        }
+        Record record;
+        record.level = level;
+        record.timestampUs = static_cast<uint32_t>(hal::micros());
+        record.format = format;
+        BinaryLogWriter writer(record.data, sizeof(record.data));
+        writer.writeAll(args...);
+        record.length = static_cast<uint8_t>(writer.size());
+        enqueue(record);
+    }
 
     /**
-     * @brief Logs an error message.
-     * @param message The message to be logged.
+     * @brief Lets the compiler check binary log arguments against the format. Never called.
      */
-    static void error(const String& message);
+    __attribute__((format(printf, 1, 2))) static void checkFormat(const char* format, ...) {
+        (void)format;
+    }
 
     /**
      * @brief Enables or disables debug logging.
+     *
+     * Enabling opens the serial port and starts the drain task on first use.
+     *
      * @param enable True to enable debug logging, false to disable.
      */
     static void setDebug(bool enable);
 
+    /**
+     * @brief Writes all queued messages from the calling task.
+     *
+     * The queue has a single consumer: only call this where no drain task
+     * runs, such as on the native backend.
+     */
+    static void flush();
+
+    /**
+     * @brief Number of messages dropped because the queue was full.
+     */
+    static uint32_t getDroppedCount();
+
 private:
+    /**
+     * @brief A formatted message waiting for output.
+     */
+    struct Record {
+        LogLevel level; // Severity
+        uint8_t length; // Bytes used in data
+        uint32_t timestampUs; // hal::micros() when logged
+        const char* format; // Format string of a binary record, nullptr for text
+        uint8_t data[maxMessageLength]; // NUL-terminated text or encoded arguments
+    };
+
+    static void enqueue(const Record& record); // Queues a record and wakes the drain task
+    static void drainTask(void* context); // Body of the drain task
+    static void writeRecord(const Record& record); // Writes one record to serial
+    static void writeBinaryRecord(const Record& record); // Frames and writes a binary record
+    static const char* levelPrefix(LogLevel level);
+
     static bool isDebugEnabled; // Flag to indicate if debug logging is enabled.
+    static MpscRing<Record, queueLength> queue; // Messages waiting for output
+    static hal::TaskHandle drainTaskHandle; // Task writing the queue to serial
+    static uint32_t reportedDrops; // Drops already reported on serial
+    static uint32_t lastTimestampUs; // Timestamp of the last binary record written
 };
 
-#endif
\ No newline at end of file
+#endif
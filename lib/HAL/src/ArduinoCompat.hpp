@@ -0,0 +1,28 @@
+/**
+ * @file ArduinoCompat.hpp
+ * @brief Minimal stand-ins for the Arduino constants on the native backend.
+ *
+ * Only what the firmware libraries actually use is provided here. This header
+ * is included by HAL.hpp when building without the Arduino core.
+ */
+
+#ifndef ArduinoCompat_hpp
+#define ArduinoCompat_hpp
+
+#ifndef ARDUINO
+
+#include <stdint.h>
+
+#define LOW 0x0
+#define HIGH 0x1
+
+#define INPUT 0x01
+#define OUTPUT 0x03
+#define INPUT_PULLUP 0x05
+
+#define LSBFIRST 0
+#define MSBFIRST 1
+
+#endif /* ARDUINO */
+
+#endif /* ArduinoCompat_hpp */
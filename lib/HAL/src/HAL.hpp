@@ -0,0 +1,568 @@
+/**
+ * @file HAL.hpp
+ * @brief Hardware abstraction layer used by every firmware library.
+ *
+ * All GPIO, shift-out, LEDC PWM, ADC, flash storage, settings, clock, serial,
+ * WiFi and TCP access goes through the functions declared here. The ESP32
+ * backend (HAL_ESP32.cpp) forwards to the Arduino core and ESP-IDF, the
+ * native backend (HAL_Native.cpp) simulates pins, PWM channels, ADC inputs,
+ * flash, settings, the WiFi link and a virtual clock so the firmware can run
+ * on a build machine; its TCP sockets are real. The backend is selected by the build
+ * environment.
+ */
+
+#ifndef HAL_hpp
+#define HAL_hpp
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#define HAL_ISR_ATTR IRAM_ATTR
+#else
+#include "ArduinoCompat.hpp"
+#define HAL_ISR_ATTR
+#endif
+
+namespace hal {
+
+/**
+ * @enum WiFiStatus
+ * @brief Backend independent view of the WiFi station status.
+ */
+enum class WiFiStatus : uint8_t {
+    Idle,           // Radio off or no connection attempted yet.
+    Connected,      // Associated and holding an IP address.
+    Disconnected,   // Link lost or disconnected on request.
+    ConnectFailed   // Network not found or authentication failed.
+};
+
+/**
+ * @enum WiFiEvent
+ * @brief Link events reported asynchronously by the WiFi driver.
+ */
+enum class WiFiEvent : uint8_t {
+    GotIp,          // Associated and an IP address was assigned.
+    Disconnected,   // Association lost, refused or ended on request.
+    Stopped         // Radio stopped.
+};
+
+/**
+ * @brief Handler invoked from the WiFi driver task on a link event.
+ */
+typedef void (*WiFiEventHandler)(WiFiEvent event, void* context);
+
+/**
+ * @brief Handler invoked from interrupt context on a pin level change.
+ */
+typedef void (*InterruptHandler)(void* context);
+
+/**
+ * @brief Handler invoked when a watched socket is ready. On the ESP32 it runs
+ * in the socket watcher task.
+ */
+typedef void (*SocketReadyHandler)(void* context);
+
+/**
+ * @brief Opaque handle of a task that can be woken with notifyTask().
+ */
+typedef void* TaskHandle;
+
+/**
+ * @brief Body of a task started with startTask(). Must not return.
+ */
+typedef void (*TaskFunction)(void* context);
+
+/**
+ * @brief Opaque handle of an SPI device used to clock out shift register chains.
+ */
+typedef void* SpiShiftHandle;
+
+/**
+ * @brief Opaque handle of an RMT channel sending addressable LED frames.
+ */
+typedef void* PixelOutputHandle;
+
+/**
+ * @brief Timeout value that makes waitForNotification() block until notified.
+ */
+constexpr uint32_t waitForever = 0xFFFFFFFF;
+
+/**
+ * @brief Core value that lets startTask() run the task on either core.
+ */
+constexpr int8_t anyCore = -1;
+
+// GPIO
+
+/**
+ * @brief Configures a GPIO pin (INPUT, OUTPUT or INPUT_PULLUP).
+ */
+void pinMode(uint8_t pin, uint8_t mode);
+
+/**
+ * @brief Drives an output pin HIGH or LOW.
+ */
+void digitalWrite(uint8_t pin, uint8_t level);
+
+/**
+ * @brief Reads the level of an input pin.
+ * @return HIGH or LOW.
+ */
+int digitalRead(uint8_t pin);
+
+/**
+ * @brief digitalRead() for interrupt handlers: in IRAM, reads the input register directly.
+ */
+int digitalReadFromIsr(uint8_t pin);
+
+/**
+ * @brief Bit-bangs one byte out on a data/clock pin pair.
+ */
+void shiftOut(uint8_t dataPin, uint8_t clockPin, uint8_t bitOrder, uint8_t value);
+
+/**
+ * @brief Calls a handler from interrupt context on every level change of a pin.
+ *
+ * The handler must be placed in IRAM (HAL_ISR_ATTR) and may only call
+ * interrupt safe functions such as notifyTask(), microsFromIsr() and
+ * digitalReadFromIsr(). Anything else may sit in flash and crash the
+ * handler while flash is being written.
+ */
+void attachInterrupt(uint8_t pin, InterruptHandler handler, void* context);
+
+// SPI shift-out
+
+/**
+ * @brief Claims a free SPI peripheral to drive a shift register chain.
+ *
+ * MOSI and SCLK are routed to the data and clock pins; the chip select line
+ * drives the latch, so its rising edge at the end of each transfer latches the
+ * new image in hardware. Chains longer than the peripheral FIFO use DMA.
+ *
+ * @param maxBytes Longest transfer that will be requested.
+ * @param clockHz Serial clock frequency.
+ * @return Device handle, or nullptr if no peripheral is available.
+ */
+SpiShiftHandle spiShiftBegin(uint8_t dataPin, uint8_t clockPin, uint8_t latchPin, size_t maxBytes, uint32_t clockHz);
+
+/**
+ * @brief Starts clocking out bytes in transmission order without waiting for completion.
+ *
+ * The data is copied, so the caller may change its buffer at once. If the
+ * previous transfer is still running, waits for it first.
+ */
+void spiShiftWrite(SpiShiftHandle handle, const uint8_t* data, size_t length);
+
+/**
+ * @brief Waits for the last transfer and releases the SPI peripheral.
+ */
+void spiShiftEnd(SpiShiftHandle handle);
+
+// Addressable pixels
+
+/**
+ * @brief Claims an RMT channel to send WS2812/SK6812 frames on a pin.
+ *
+ * Bits go out at 800 kHz; the line is then held low for the latch time
+ * before the next frame may start.
+ *
+ * @param maxBytes Longest frame that will be sent.
+ * @return Output handle, or nullptr if no RMT channel is free.
+ */
+PixelOutputHandle pixelOutputBegin(uint8_t dataPin, size_t maxBytes);
+
+/**
+ * @brief Starts sending a frame, in wire order, without waiting for it.
+ *
+ * The data is not copied: the peripheral reads it while the frame goes out,
+ * so the buffer must not change until pixelOutputBusy() returns false.
+ *
+ * @return False, sending nothing, if the previous frame has not finished.
+ */
+bool pixelOutputWrite(PixelOutputHandle handle, const uint8_t* data, size_t length);
+
+/**
+ * @brief Checks whether a frame, or the latch time after it, is still going on.
+ */
+bool pixelOutputBusy(PixelOutputHandle handle);
+
+/**
+ * @brief Waits for the last frame and releases the RMT channel.
+ */
+void pixelOutputEnd(PixelOutputHandle handle);
+
+// LEDC PWM
+
+/**
+ * @brief Configures a LEDC channel with the given frequency and resolution.
+ */
+void ledcSetup(uint8_t channel, uint32_t frequency, uint8_t resolutionBits);
+
+/**
+ * @brief Routes a LEDC channel to a GPIO pin.
+ */
+void ledcAttachPin(uint8_t pin, uint8_t channel);
+
+/**
+ * @brief Sets the duty cycle of a LEDC channel.
+ */
+void ledcWrite(uint8_t channel, uint32_t duty);
+
+/**
+ * @brief Starts a hardware fade of a LEDC channel and returns at once.
+ *
+ * The duty ramps linearly from its current value, including a value part-way
+ * through an earlier fade, which this one replaces. The ramp runs in the LEDC
+ * peripheral without CPU involvement.
+ *
+ * @param channel LEDC channel.
+ * @param targetDuty Duty at the end of the ramp.
+ * @param durationMs Ramp length; 0 sets the duty immediately.
+ */
+void ledcFade(uint8_t channel, uint32_t targetDuty, uint32_t durationMs);
+
+/**
+ * @brief Current duty cycle of a LEDC channel, also while it is fading.
+ */
+uint32_t ledcReadDuty(uint8_t channel);
+
+// Continuous ADC
+
+/**
+ * @brief Shift of the channel number in a continuous ADC sample.
+ *
+ * Samples are 16-bit words holding the 12-bit conversion result in the low
+ * bits and the ADC1 channel above it, which is the layout the ESP32 DMA
+ * writes, so samples are read without conversion.
+ */
+constexpr uint8_t adcSampleChannelShift = 12;
+
+/**
+ * @brief Mask of the conversion result in a continuous ADC sample.
+ */
+constexpr uint16_t adcSampleValueMask = 0x0FFF;
+
+/**
+ * @brief Starts sampling ADC1 channels in turn by DMA into a driver ring buffer.
+ *
+ * The CPU is not involved per sample; adcContinuousRead() collects the
+ * samples in batches. Samples arriving while the ring is full are lost.
+ *
+ * @param channels ADC1 channel numbers (0-7), sampled in this order.
+ * @param count Number of channels.
+ * @param sampleRateHz Total conversions per second over all channels (ESP32: 20 kHz to 2 MHz).
+ * @param bufferSamples Capacity of the driver ring in samples.
+ * @return False if the ADC could not be started.
+ */
+bool adcContinuousBegin(const uint8_t* channels, uint8_t count, uint32_t sampleRateHz, size_t bufferSamples);
+
+/**
+ * @brief Moves the samples collected so far out of the ring without waiting.
+ * @return Number of samples written to the buffer.
+ */
+size_t adcContinuousRead(uint16_t* samples, size_t maxSamples);
+
+/**
+ * @brief Stops continuous sampling and releases the driver.
+ */
+void adcContinuousEnd();
+
+// Flash storage
+
+/**
+ * @brief Erase unit of the storage partition in bytes.
+ */
+constexpr size_t storageSectorSize = 4096;
+
+/**
+ * @brief Size of the data partition labelled "storage" in bytes, 0 if there is none.
+ */
+size_t storageSize();
+
+/**
+ * @brief Reads bytes from the storage partition.
+ * @return False if the range is outside the partition or the read failed.
+ */
+bool storageRead(size_t offset, void* data, size_t length);
+
+/**
+ * @brief Programs bytes of the storage partition.
+ *
+ * Flash semantics: programming can only clear bits, so a byte must be erased
+ * (0xFF) before it is written, except to clear more of its bits.
+ *
+ * @return False if the range is outside the partition or the write failed.
+ */
+bool storageWrite(size_t offset, const void* data, size_t length);
+
+/**
+ * @brief Erases whole sectors of the storage partition to 0xFF.
+ *
+ * Takes tens of milliseconds per sector on the ESP32, during which code
+ * running from flash on either core is held.
+ *
+ * @param offset Start, a multiple of storageSectorSize.
+ * @param length Bytes, a multiple of storageSectorSize.
+ * @return False if the range is not sector aligned, outside the partition or the erase failed.
+ */
+bool storageErase(size_t offset, size_t length);
+
+// Settings
+
+/**
+ * @brief Longest settings key, without the terminator.
+ */
+constexpr size_t nvsMaxKeyLength = 15;
+
+/**
+ * @brief Reads a settings blob from non-volatile storage (NVS on the ESP32).
+ * @return False if the key is unknown or its blob is not exactly length bytes.
+ */
+bool nvsRead(const char* key, void* data, size_t length);
+
+/**
+ * @brief Writes a settings blob and commits it.
+ *
+ * NVS spreads writes over its pages, but every write still wears flash: only
+ * write when the value changed.
+ *
+ * @return False if the write failed.
+ */
+bool nvsWrite(const char* key, const void* data, size_t length);
+
+// Clock
+
+/**
+ * @brief Milliseconds since boot.
+ */
+unsigned long millis();
+
+/**
+ * @brief Microseconds since boot.
+ */
+unsigned long micros();
+
+/**
+ * @brief micros() for interrupt handlers: in IRAM, on the same clock as micros().
+ */
+uint32_t microsFromIsr();
+
+/**
+ * @brief Blocks for the given number of milliseconds.
+ */
+void delay(unsigned long ms);
+
+/**
+ * @brief Free running CPU cycle counter, for measuring short spans.
+ *
+ * Wraps around; only differences between two readings are meaningful.
+ */
+uint32_t cycleCount();
+
+/**
+ * @brief Rate of cycleCount() in counts per microsecond.
+ */
+uint32_t cyclesPerMicrosecond();
+
+/**
+ * @brief 32 random bits, for jitter. Deterministic on the native backend.
+ */
+uint32_t randomU32();
+
+// Tasks
+
+/**
+ * @brief Starts a task running concurrently with the caller.
+ *
+ * The native backend runs everything on one thread and cannot start tasks;
+ * callers must do the task's work inline when this returns nullptr.
+ *
+ * @param name Task name for diagnostics.
+ * @param function Task body.
+ * @param context Argument passed to the body.
+ * @param stackBytes Stack size.
+ * @param priority Scheduling priority, higher runs first.
+ * @param core Core to pin the task to, or anyCore.
+ * @return Handle of the new task, or nullptr if it could not be started.
+ */
+TaskHandle startTask(const char* name, TaskFunction function, void* context, uint32_t stackBytes, uint8_t priority, int8_t core);
+
+/**
+ * @brief Handle of the calling task.
+ */
+TaskHandle currentTask();
+
+/**
+ * @brief Wakes a task blocked in waitForNotification(). Safe to call from interrupts.
+ *
+ * A notification sent while the task is not waiting is remembered, so the
+ * next wait returns immediately.
+ */
+void notifyTask(TaskHandle task);
+
+/**
+ * @brief Blocks the calling task until it is notified or the timeout elapses.
+ * @param timeoutMs Maximum time to sleep, or waitForever.
+ * @return True if woken by a notification, false on timeout.
+ */
+bool waitForNotification(uint32_t timeoutMs);
+
+// Serial
+
+/**
+ * @brief Opens the debug serial port.
+ */
+void serialBegin(unsigned long baud);
+
+/**
+ * @brief Closes the debug serial port.
+ */
+void serialEnd();
+
+/**
+ * @brief Writes one line to the debug serial port.
+ */
+void serialPrintln(const char* line);
+
+/**
+ * @brief Writes raw bytes to the debug serial port.
+ */
+void serialWrite(const uint8_t* data, size_t length);
+
+/**
+ * @brief Reads one received byte from the debug serial port without blocking.
+ * @return The byte, or -1 if nothing was received.
+ */
+int serialRead();
+
+// WiFi
+
+/**
+ * @brief Registers the handler receiving WiFi link events.
+ *
+ * The handler runs in the WiFi driver task and must only hand the event
+ * over, for example with Scheduler::post().
+ */
+void wifiOnEvent(WiFiEventHandler handler, void* context);
+
+/**
+ * @brief Starts connecting the station interface to a network.
+ *
+ * Returns at once; the outcome is reported through the event handler. The
+ * driver does not reconnect on its own.
+ */
+void wifiBegin(const char* ssid, const char* password);
+
+/**
+ * @brief Requests disconnection from the current network without waiting for it.
+ * @return True if the request was accepted.
+ */
+bool wifiDisconnect();
+
+/**
+ * @brief Powers the WiFi radio down.
+ */
+void wifiOff();
+
+/**
+ * @brief Current station status.
+ */
+WiFiStatus wifiStatus();
+
+/**
+ * @brief Copies the SSID of the network the station is associated with.
+ * @param buffer Destination, always NUL-terminated.
+ * @param size Size of the destination in bytes.
+ */
+void wifiSSID(char* buffer, size_t size);
+
+/**
+ * @brief Station IPv4 address, first octet in the lowest byte. 0 if none.
+ */
+uint32_t wifiLocalIP();
+
+// TCP sockets
+
+/**
+ * @brief Socket handle returned when no socket could be opened.
+ */
+constexpr int invalidSocket = -1;
+
+/**
+ * @brief Opens a non-blocking listening socket on all interfaces.
+ *
+ * The native backend adds 8000 to ports below 1024, so port 80 is served on
+ * 8080 without root rights.
+ *
+ * @return Socket, or invalidSocket if the port could not be bound.
+ */
+int tcpListen(uint16_t port, uint8_t backlog);
+
+/**
+ * @brief Starts connecting to a server without blocking.
+ *
+ * Watch the socket as writable to be told when the attempt has finished,
+ * then ask tcpConnected() how it went.
+ *
+ * @param address IPv4 address, first octet in the lowest byte like wifiLocalIP().
+ * @return Socket, or invalidSocket if none could be opened.
+ */
+int tcpConnect(uint32_t address, uint16_t port);
+
+/**
+ * @brief State of a connection started with tcpConnect().
+ * @return 1 if connected, 0 if still connecting, -1 if the attempt failed.
+ */
+int tcpConnected(int socket);
+
+/**
+ * @brief Accepts a waiting connection without blocking.
+ * @return Non-blocking connected socket, or invalidSocket if none is waiting.
+ */
+int tcpAccept(int listener);
+
+/**
+ * @brief Reads received bytes without blocking.
+ * @return Bytes read, 0 if none are waiting, -1 if the peer closed or the connection failed.
+ */
+int tcpRead(int socket, void* data, size_t maxLength);
+
+/**
+ * @brief Queues bytes for sending without blocking.
+ * @return Bytes queued, 0 if the send buffer is full, -1 if the connection failed.
+ */
+int tcpWrite(int socket, const void* data, size_t length);
+
+/**
+ * @brief Closes a socket and stops watching it.
+ */
+void tcpClose(int socket);
+
+/**
+ * @brief Asks once to be told when a socket is ready.
+ *
+ * The ready handler is called the next time the socket has bytes or a
+ * connection waiting, or with writable also when it can take more bytes.
+ * The watch then ends; call again after handling the socket.
+ */
+void tcpWatch(int socket, bool writable);
+
+/**
+ * @brief Most handlers tcpOnReady() keeps.
+ */
+constexpr uint8_t maxSocketReadyHandlers = 4;
+
+/**
+ * @brief Registers a handler called whenever any watched socket is ready.
+ *
+ * Every registered handler is called for every ready socket; each user of
+ * the sockets registers one. Registering the same handler and context again
+ * has no effect.
+ */
+void tcpOnReady(SocketReadyHandler handler, void* context);
+
+} // namespace hal
+
+#endif /* HAL_hpp */
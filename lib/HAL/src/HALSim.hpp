@@ -0,0 +1,222 @@
+/**
+ * @file HALSim.hpp
+ * @brief Control surface of the native HAL backend: virtual clock, simulated pins, ADC, flash and WiFi.
+ *
+ * Only available when building without the Arduino core. Host programs use
+ * these functions to drive inputs and inspect outputs of the real firmware.
+ */
+
+#ifndef HALSim_hpp
+#define HALSim_hpp
+
+#ifndef ARDUINO
+
+#include "HAL.hpp"
+
+namespace hal {
+namespace sim {
+
+/**
+ * @brief Kind of output an edge was seen on.
+ */
+enum class OutputKind : uint8_t {
+    Pin,           // GPIO written with digitalWrite
+    ShiftRegister, // Output of a shift register chain, changed when the chain is latched
+    Ledc           // LEDC channel set or sent fading to a new duty
+};
+
+/**
+ * @brief One change of an output.
+ */
+struct OutputEdge {
+    uint64_t us; // Virtual time
+    OutputKind kind;
+    uint8_t pin; // GPIO, data pin of the chain or LEDC channel
+    uint16_t output; // Chain output (register * 8 + bit); 0 for the other kinds
+    uint32_t value; // New level, or the duty a fade ends on
+    uint32_t fadeMs; // Length of the fade to value; 0 for a step
+};
+
+/**
+ * @brief Function receiving every output edge.
+ */
+typedef void (*OutputRecorder)(const OutputEdge& edge, void* context);
+
+/**
+ * @brief Restores all pins, channels, the clock and the WiFi link to power-on state.
+ *
+ * The storage partition keeps its content, as flash does over a power cycle.
+ */
+void reset();
+
+/**
+ * @brief Advances the virtual clock.
+ * @param us Number of microseconds to advance.
+ */
+void advanceMicros(uint64_t us);
+
+/**
+ * @brief Current virtual time in microseconds.
+ */
+uint64_t nowMicros();
+
+/**
+ * @brief Latest virtual time an idle waitForNotification() may advance the clock to.
+ *
+ * Host programs set this to the time of their next stimulus so that a
+ * sleeping firmware wakes up exactly when an input changes.
+ */
+void setIdleHorizon(uint64_t us);
+
+/**
+ * @brief Drives the level seen by digitalRead on an input pin.
+ *
+ * A level change invokes the interrupt handler attached to the pin, if any.
+ */
+void setInput(uint8_t pin, int level);
+
+/**
+ * @brief Level last written to an output pin.
+ */
+int outputLevel(uint8_t pin);
+
+/**
+ * @brief Byte most recently clocked out with shiftOut on the given data pin.
+ */
+uint8_t lastShiftedByte(uint8_t dataPin);
+
+/**
+ * @brief Content of one register in the chain fed by a data pin.
+ * @param registerIndex 0 for the register nearest the MCU (the byte shifted last).
+ */
+uint8_t shiftedByte(uint8_t dataPin, uint16_t registerIndex);
+
+/**
+ * @brief Total number of bytes clocked out with shiftOut since reset.
+ */
+uint32_t shiftOutCount();
+
+/**
+ * @brief Last frame sent with pixelOutputWrite() on a data pin.
+ * @param length Set to the frame length in bytes, 0 if none was sent.
+ * @return Frame bytes in wire order, valid until the next frame or reset().
+ */
+const uint8_t* pixelFrame(uint8_t dataPin, size_t* length);
+
+/**
+ * @brief Number of frames sent with pixelOutputWrite() on a data pin since reset().
+ */
+uint32_t pixelFrameCount(uint8_t dataPin);
+
+/**
+ * @brief Duty cycle currently applied to a LEDC channel, part-way through a fade if one runs.
+ */
+uint32_t ledcDuty(uint8_t channel);
+
+/**
+ * @brief Sets the level a simulated ADC channel converts to.
+ * @param channel ADC1 channel.
+ * @param raw Mean conversion result (0-4095).
+ * @param noise Peak deviation of deterministic noise around the mean.
+ */
+void setAdcLevel(uint8_t channel, uint16_t raw, uint16_t noise);
+
+/**
+ * @brief Replays a recorded sample stream instead of the channel levels.
+ *
+ * The samples, in the layout adcContinuousRead() returns, are delivered at
+ * the configured sample rate over the virtual clock and repeated from the
+ * start when they run out.
+ *
+ * @param samples Recording that must outlive the replay, or nullptr to go back to the levels.
+ * @param count Number of samples.
+ */
+void setAdcRecording(const uint16_t* samples, size_t count);
+
+/**
+ * @brief Replaces the storage partition with an erased one of the given size.
+ * @param bytes Partition size, rounded down to whole sectors.
+ */
+void setStorageSize(size_t bytes);
+
+/**
+ * @brief Content of the storage partition, storageSize() bytes.
+ */
+const uint8_t* storageImage();
+
+/**
+ * @brief Number of sectors erased since the partition was created.
+ */
+uint32_t storageEraseCount();
+
+/**
+ * @brief Number of nvsWrite() calls since the program started.
+ */
+uint32_t nvsWriteCount();
+
+/**
+ * @brief Calls a function on every output edge from now on, or nullptr to stop.
+ *
+ * Cleared by reset().
+ */
+void setOutputRecorder(OutputRecorder recorder, void* context);
+
+/**
+ * @brief Output edges since reset(), recorded or not.
+ */
+uint64_t outputEdgeCount();
+
+/**
+ * @brief Writes the storage partition and the NVS settings to a file, as a power cut leaves them.
+ */
+bool savePersistent(const char* path);
+
+/**
+ * @brief Replaces the storage partition and the NVS settings with those saved by savePersistent().
+ * @return False if the file could not be read; nothing is changed then.
+ */
+bool loadPersistent(const char* path);
+
+/**
+ * @brief Converts at a fraction of the configured sample rate, to keep long runs fast.
+ * @param divider Rate divider; 1 restores the configured rate.
+ */
+void setAdcRateDivider(uint32_t divider);
+
+/**
+ * @brief Time the simulated access point takes to accept a connection.
+ * @param ms Delay between wifiBegin and the Connected status.
+ */
+void setWiFiConnectDelay(unsigned long ms);
+
+/**
+ * @brief Makes subsequent connection attempts fail or succeed.
+ */
+void setWiFiReachable(bool reachable);
+
+/**
+ * @brief Drops an established link, as if the access point went away.
+ *
+ * Emits a Disconnected event if the link was up.
+ */
+void dropWiFi();
+
+/**
+ * @brief Enables or disables echoing serial output to stdout.
+ */
+void setSerialEcho(bool echo);
+
+/**
+ * @brief Makes the clock follow the wall clock from its current reading on.
+ *
+ * Waiting then really waits, on the sockets passed to tcpWatch(), so the
+ * firmware can serve TCP clients from the host. Off by default.
+ */
+void setRealTime(bool realTime);
+
+} // namespace sim
+} // namespace hal
+
+#endif /* ARDUINO */
+
+#endif /* HALSim_hpp */
@@ -0,0 +1,813 @@
+/**
+ * @file HAL_ESP32.cpp
+ * @brief ESP32 backend of the hardware abstraction layer, forwarding to the Arduino core.
+ */
+
+#ifdef ARDUINO
+
+#include "HAL.hpp"
+#include <WiFi.h>
+#include <driver/adc.h>
+#include <driver/ledc.h>
+#include <driver/rmt.h>
+#include <driver/spi_master.h>
+#include <esp_heap_caps.h>
+#include <esp_partition.h>
+#include <esp_timer.h>
+#include <esp_vfs_eventfd.h>
+#include <esp_wifi.h>
+#include <fcntl.h>
+#include <hal/gpio_ll.h>
+#include <nvs.h>
+#include <lwip/sockets.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#if ESP_IDF_VERSION < ESP_IDF_VERSION_VAL(4, 4, 0)
+#error "hal::ledcFade needs ledc_fade_stop() from ESP-IDF 4.4 (arduino-esp32 2.0.3) or later"
+#endif
+
+namespace {
+
+bool ledcFadeInstalled = false;
+
+/**
+ * Arduino LEDC channels 0-7 are the high-speed group, 8-15 the low-speed group.
+ */
+ledc_mode_t ledcSpeedMode(uint8_t channel) {
+    return static_cast<ledc_mode_t>(channel / 8);
+}
+
+ledc_channel_t ledcChannel(uint8_t channel) {
+    return static_cast<ledc_channel_t>(channel % 8);
+}
+
+constexpr uint32_t adcBytesPerInterrupt = 256; // DMA frame; the driver copies each into its ring
+bool adcRunning = false;
+
+/**
+ * The data partition labelled "storage" from partitions.csv, looked up once.
+ */
+const esp_partition_t* storagePartition() {
+    static const esp_partition_t* partition =
+        esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, "storage");
+    return partition;
+}
+
+hal::WiFiEventHandler wifiEventHandler = nullptr;
+void* wifiEventContext = nullptr;
+
+/**
+ * Translates Arduino WiFi events into HAL link events.
+ */
+void onArduinoWiFiEvent(arduino_event_id_t event) {
+    if (wifiEventHandler == nullptr) {
+        return;
+    }
+    switch (event) {
+        case ARDUINO_EVENT_WIFI_STA_GOT_IP:
+            wifiEventHandler(hal::WiFiEvent::GotIp, wifiEventContext);
+            break;
+        case ARDUINO_EVENT_WIFI_STA_DISCONNECTED:
+        case ARDUINO_EVENT_WIFI_STA_LOST_IP:
+            wifiEventHandler(hal::WiFiEvent::Disconnected, wifiEventContext);
+            break;
+        case ARDUINO_EVENT_WIFI_STA_STOP:
+            wifiEventHandler(hal::WiFiEvent::Stopped, wifiEventContext);
+            break;
+        default:
+            break;
+    }
+}
+
+/**
+ * SPI device driving one shift register chain, with its DMA capable buffer.
+ */
+struct SpiShiftDevice {
+    spi_host_device_t host;
+    uint8_t hostIndex;
+    spi_device_handle_t device;
+    spi_transaction_t transaction;
+    uint8_t* buffer;
+    size_t capacity;
+    bool inFlight;
+};
+
+constexpr size_t spiFifoBytes = 64; // Longest transfer the SPI peripheral handles without DMA.
+bool spiHostClaimed[2] = {false, false};
+const spi_host_device_t spiHosts[2] = {SPI3_HOST, SPI2_HOST}; // VSPI first, HSPI as spare
+
+void finishSpiTransfer(SpiShiftDevice* device) {
+    if (device->inFlight) {
+        spi_transaction_t* done = nullptr;
+        spi_device_get_trans_result(device->device, &done, portMAX_DELAY);
+        device->inFlight = false;
+    }
+}
+
+/**
+ * RMT channel sending addressable LED frames. The classic ESP32 RMT has no
+ * DMA: the driver's translator turns frame bytes into RMT items from the
+ * channel interrupt as the channel memory drains, reading the caller's
+ * buffer until the frame has gone out.
+ */
+struct PixelOutputDevice {
+    rmt_channel_t channel;
+    size_t capacity;
+    volatile bool sending; // A frame is going out
+    volatile int64_t sentUs; // esp_timer time the last frame ended
+};
+
+constexpr uint8_t rmtClockDivider = 2; // 80 MHz APB clock to 25 ns ticks
+constexpr uint16_t pixelZeroHighTicks = 14; // 0.35 us, within WS2812 and SK6812 limits
+constexpr uint16_t pixelZeroLowTicks = 36; // 0.9 us
+constexpr uint16_t pixelOneHighTicks = 28; // 0.7 us
+constexpr uint16_t pixelOneLowTicks = 22; // 0.55 us
+constexpr int64_t pixelLatchUs = 80; // SK6812 reset time, longer than the WS2812's
+PixelOutputDevice* pixelOutputs[RMT_CHANNEL_MAX] = {};
+
+/**
+ * Turns frame bytes into RMT items, most significant bit first. Runs in the RMT interrupt.
+ */
+void IRAM_ATTR translatePixels(const void* source, rmt_item32_t* destination, size_t sourceSize, size_t wantedItems,
+    size_t* translatedSize, size_t* itemCount) {
+    const rmt_item32_t zero = {{{pixelZeroHighTicks, 1, pixelZeroLowTicks, 0}}};
+    const rmt_item32_t one = {{{pixelOneHighTicks, 1, pixelOneLowTicks, 0}}};
+    const uint8_t* bytes = static_cast<const uint8_t*>(source);
+    size_t size = 0;
+    size_t items = 0;
+    while (size < sourceSize && items + 8 <= wantedItems) {
+        for (uint8_t bit = 0x80; bit != 0; bit >>= 1) {
+            destination[items++] = (bytes[size] & bit) ? one : zero;
+        }
+        size++;
+    }
+    *translatedSize = size;
+    *itemCount = items;
+}
+
+/**
+ * Marks a pixel output idle when its frame has gone out. Runs in the RMT interrupt.
+ */
+void IRAM_ATTR onPixelFrameSent(rmt_channel_t channel, void* context) {
+    (void)context;
+    PixelOutputDevice* device = pixelOutputs[channel];
+    if (device != nullptr) {
+        device->sentUs = esp_timer_get_time();
+        device->sending = false;
+    }
+}
+
+/**
+ * Sockets waiting to be reported ready, watched by one task blocked in
+ * select(). An eventfd wakes it when the table changes.
+ */
+struct SocketWatch {
+    int socket;
+    bool writable;
+};
+
+constexpr uint8_t maxWatchedSockets = 16;
+SocketWatch watchedSockets[maxWatchedSockets];
+uint8_t watchedSocketCount = 0;
+portMUX_TYPE socketWatchLock = portMUX_INITIALIZER_UNLOCKED;
+int socketWatchWakeup = -1; // eventfd
+hal::SocketReadyHandler socketReadyHandlers[hal::maxSocketReadyHandlers] = {};
+void* socketReadyContexts[hal::maxSocketReadyHandlers] = {};
+uint8_t socketReadyHandlerCount = 0;
+
+void runSocketWatcher(void* context) {
+    (void)context;
+    for (;;) {
+        fd_set readable;
+        fd_set writable;
+        FD_ZERO(&readable);
+        FD_ZERO(&writable);
+        FD_SET(socketWatchWakeup, &readable);
+        int maxSocket = socketWatchWakeup;
+        portENTER_CRITICAL(&socketWatchLock);
+        for (uint8_t i = 0; i < watchedSocketCount; i++) {
+            FD_SET(watchedSockets[i].socket, &readable);
+            if (watchedSockets[i].writable) {
+                FD_SET(watchedSockets[i].socket, &writable);
+            }
+            maxSocket = watchedSockets[i].socket > maxSocket ? watchedSockets[i].socket : maxSocket;
+        }
+        portEXIT_CRITICAL(&socketWatchLock);
+        if (select(maxSocket + 1, &readable, &writable, nullptr, nullptr) <= 0) {
+            continue;
+        }
+        if (FD_ISSET(socketWatchWakeup, &readable)) {
+            uint64_t count;
+            read(socketWatchWakeup, &count, sizeof(count));
+        }
+        bool ready = false;
+        portENTER_CRITICAL(&socketWatchLock);
+        for (uint8_t i = 0; i < watchedSocketCount;) {
+            if (FD_ISSET(watchedSockets[i].socket, &readable) || FD_ISSET(watchedSockets[i].socket, &writable)) {
+                watchedSockets[i] = watchedSockets[--watchedSocketCount];
+                ready = true;
+            } else {
+                i++;
+            }
+        }
+        portEXIT_CRITICAL(&socketWatchLock);
+        if (ready) {
+            portENTER_CRITICAL(&socketWatchLock);
+            uint8_t count = socketReadyHandlerCount;
+            portEXIT_CRITICAL(&socketWatchLock);
+            for (uint8_t i = 0; i < count; i++) {
+                socketReadyHandlers[i](socketReadyContexts[i]);
+            }
+        }
+    }
+}
+
+/**
+ * Removes a socket from the watch table and wakes the watcher if it was there.
+ */
+void unwatchSocket(int socket) {
+    bool removed = false;
+    portENTER_CRITICAL(&socketWatchLock);
+    for (uint8_t i = 0; i < watchedSocketCount; i++) {
+        if (watchedSockets[i].socket == socket) {
+            watchedSockets[i] = watchedSockets[--watchedSocketCount];
+            removed = true;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&socketWatchLock);
+    if (removed) {
+        uint64_t one = 1;
+        write(socketWatchWakeup, &one, sizeof(one));
+    }
+}
+
+int makeNonBlocking(int socket) {
+    if (socket >= 0) {
+        fcntl(socket, F_SETFL, fcntl(socket, F_GETFL, 0) | O_NONBLOCK);
+    }
+    return socket;
+}
+
+} // namespace
+
+namespace hal {
+
+void pinMode(uint8_t pin, uint8_t mode) {
+    ::pinMode(pin, mode);
+}
+
+void digitalWrite(uint8_t pin, uint8_t level) {
+    ::digitalWrite(pin, level);
+}
+
+int digitalRead(uint8_t pin) {
+    return ::digitalRead(pin);
+}
+
+int HAL_ISR_ATTR digitalReadFromIsr(uint8_t pin) {
+    // gpio_ll_get_level() is inline, so nothing here runs from flash.
+    return gpio_ll_get_level(&GPIO, static_cast<gpio_num_t>(pin));
+}
+
+void shiftOut(uint8_t dataPin, uint8_t clockPin, uint8_t bitOrder, uint8_t value) {
+    ::shiftOut(dataPin, clockPin, bitOrder, value);
+}
+
+void attachInterrupt(uint8_t pin, InterruptHandler handler, void* context) {
+    ::attachInterruptArg(digitalPinToInterrupt(pin), handler, context, CHANGE);
+}
+
+SpiShiftHandle spiShiftBegin(uint8_t dataPin, uint8_t clockPin, uint8_t latchPin, size_t maxBytes, uint32_t clockHz) {
+    spi_bus_config_t bus = {};
+    bus.mosi_io_num = dataPin;
+    bus.miso_io_num = -1;
+    bus.sclk_io_num = clockPin;
+    bus.quadwp_io_num = -1;
+    bus.quadhd_io_num = -1;
+    bus.max_transfer_sz = static_cast<int>(maxBytes);
+
+    for (uint8_t i = 0; i < 2; i++) {
+        if (spiHostClaimed[i]) {
+            continue;
+        }
+        spi_dma_chan_t dma = maxBytes > spiFifoBytes ? SPI_DMA_CH_AUTO : SPI_DMA_DISABLED;
+        if (spi_bus_initialize(spiHosts[i], &bus, dma) != ESP_OK) {
+            continue;
+        }
+        spi_device_interface_config_t config = {};
+        config.mode = 0;
+        config.clock_speed_hz = static_cast<int>(clockHz);
+        config.spics_io_num = latchPin; // Rising edge after the last bit latches the outputs.
+        config.cs_ena_posttrans = 1;
+        config.queue_size = 1;
+        SpiShiftDevice* device = new SpiShiftDevice();
+        device->host = spiHosts[i];
+        device->hostIndex = i;
+        device->buffer = static_cast<uint8_t*>(heap_caps_malloc(maxBytes, MALLOC_CAP_DMA));
+        device->capacity = maxBytes;
+        device->inFlight = false;
+        if (device->buffer == nullptr || spi_bus_add_device(spiHosts[i], &config, &device->device) != ESP_OK) {
+            heap_caps_free(device->buffer);
+            delete device;
+            spi_bus_free(spiHosts[i]);
+            return nullptr;
+        }
+        spiHostClaimed[i] = true;
+        return device;
+    }
+    return nullptr;
+}
+
+void spiShiftWrite(SpiShiftHandle handle, const uint8_t* data, size_t length) {
+    SpiShiftDevice* device = static_cast<SpiShiftDevice*>(handle);
+    finishSpiTransfer(device);
+    if (length > device->capacity) {
+        length = device->capacity;
+    }
+    memcpy(device->buffer, data, length);
+    memset(&device->transaction, 0, sizeof(device->transaction));
+    device->transaction.length = length * 8;
+    device->transaction.tx_buffer = device->buffer;
+    device->inFlight = spi_device_queue_trans(device->device, &device->transaction, portMAX_DELAY) == ESP_OK;
+}
+
+void spiShiftEnd(SpiShiftHandle handle) {
+    SpiShiftDevice* device = static_cast<SpiShiftDevice*>(handle);
+    finishSpiTransfer(device);
+    spi_bus_remove_device(device->device);
+    spi_bus_free(device->host);
+    spiHostClaimed[device->hostIndex] = false;
+    heap_caps_free(device->buffer);
+    delete device;
+}
+
+PixelOutputHandle pixelOutputBegin(uint8_t dataPin, size_t maxBytes) {
+    for (uint8_t i = 0; i < RMT_CHANNEL_MAX; i++) {
+        rmt_channel_t channel = static_cast<rmt_channel_t>(i);
+        if (pixelOutputs[i] != nullptr) {
+            continue;
+        }
+        rmt_config_t config = {};
+        config.rmt_mode = RMT_MODE_TX;
+        config.channel = channel;
+        config.gpio_num = static_cast<gpio_num_t>(dataPin);
+        config.clk_div = rmtClockDivider;
+        config.mem_block_num = 1;
+        config.tx_config.idle_level = RMT_IDLE_LEVEL_LOW;
+        config.tx_config.idle_output_en = true;
+        if (rmt_config(&config) != ESP_OK) {
+            continue;
+        }
+        if (rmt_driver_install(channel, 0, 0) != ESP_OK) {
+            continue;
+        }
+        if (rmt_translator_init(channel, translatePixels) != ESP_OK) {
+            rmt_driver_uninstall(channel);
+            return nullptr;
+        }
+        PixelOutputDevice* device = new PixelOutputDevice();
+        device->channel = channel;
+        device->capacity = maxBytes;
+        device->sending = false;
+        device->sentUs = 0;
+        pixelOutputs[i] = device;
+        rmt_register_tx_end_callback(onPixelFrameSent, nullptr);
+        return device;
+    }
+    return nullptr;
+}
+
+bool pixelOutputWrite(PixelOutputHandle handle, const uint8_t* data, size_t length) {
+    PixelOutputDevice* device = static_cast<PixelOutputDevice*>(handle);
+    if (pixelOutputBusy(handle)) {
+        return false;
+    }
+    if (length > device->capacity) {
+        length = device->capacity;
+    }
+    device->sending = true;
+    if (rmt_write_sample(device->channel, data, length, false) != ESP_OK) {
+        device->sending = false;
+        return false;
+    }
+    return true;
+}
+
+bool pixelOutputBusy(PixelOutputHandle handle) {
+    PixelOutputDevice* device = static_cast<PixelOutputDevice*>(handle);
+    return device->sending || esp_timer_get_time() - device->sentUs < pixelLatchUs;
+}
+
+void pixelOutputEnd(PixelOutputHandle handle) {
+    PixelOutputDevice* device = static_cast<PixelOutputDevice*>(handle);
+    rmt_wait_tx_done(device->channel, portMAX_DELAY);
+    rmt_driver_uninstall(device->channel);
+    pixelOutputs[device->channel] = nullptr;
+    delete device;
+}
+
+void ledcSetup(uint8_t channel, uint32_t frequency, uint8_t resolutionBits) {
+    ::ledcSetup(channel, frequency, resolutionBits);
+}
+
+void ledcAttachPin(uint8_t pin, uint8_t channel) {
+    ::ledcAttachPin(pin, channel);
+}
+
+void ledcWrite(uint8_t channel, uint32_t duty) {
+    ::ledcWrite(channel, duty);
+}
+
+void ledcFade(uint8_t channel, uint32_t targetDuty, uint32_t durationMs) {
+    if (!ledcFadeInstalled) {
+        ledcFadeInstalled = ledc_fade_func_install(0) == ESP_OK;
+    }
+    ledc_mode_t mode = ledcSpeedMode(channel);
+    ledc_channel_t ledcChannelId = ledcChannel(channel);
+    // Freezes the duty where the running fade has got to; the new ramp starts there.
+    ledc_fade_stop(mode, ledcChannelId);
+    if (durationMs == 0) {
+        ledc_set_duty_and_update(mode, ledcChannelId, targetDuty, 0);
+    } else {
+        ledc_set_fade_time_and_start(mode, ledcChannelId, targetDuty, durationMs, LEDC_FADE_NO_WAIT);
+    }
+}
+
+uint32_t ledcReadDuty(uint8_t channel) {
+    return ledc_get_duty(ledcSpeedMode(channel), ledcChannel(channel));
+}
+
+/**
+ * Uses the ESP-IDF 4.4 continuous mode driver, which on the ESP32 runs the
+ * ADC through the I2S0 DMA. Results come out in TYPE1 format, a 12-bit value
+ * below a 4-bit channel number, the layout of hal samples.
+ */
+bool adcContinuousBegin(const uint8_t* channels, uint8_t count, uint32_t sampleRateHz, size_t bufferSamples) {
+    if (adcRunning || count == 0 || count > SOC_ADC_PATT_LEN_MAX) {
+        return false;
+    }
+    adc_digi_init_config_t init = {};
+    init.max_store_buf_size = bufferSamples * sizeof(uint16_t);
+    init.conv_num_each_intr = adcBytesPerInterrupt;
+    adc_digi_pattern_config_t pattern[SOC_ADC_PATT_LEN_MAX] = {};
+    for (uint8_t i = 0; i < count; i++) {
+        init.adc1_chan_mask |= 1u << channels[i];
+        pattern[i].atten = ADC_ATTEN_DB_11;
+        pattern[i].channel = channels[i];
+        pattern[i].unit = 0; // ADC1; ADC2 is unusable while WiFi runs
+        pattern[i].bit_width = SOC_ADC_DIGI_MAX_BITWIDTH;
+    }
+    if (adc_digi_initialize(&init) != ESP_OK) {
+        return false;
+    }
+    adc_digi_configuration_t config = {};
+    config.conv_limit_en = true; // Required on the ESP32
+    config.conv_limit_num = 250;
+    config.pattern_num = count;
+    config.adc_pattern = pattern;
+    config.sample_freq_hz = sampleRateHz;
+    config.conv_mode = ADC_CONV_SINGLE_UNIT_1;
+    config.format = ADC_DIGI_OUTPUT_FORMAT_TYPE1;
+    if (adc_digi_controller_configure(&config) != ESP_OK || adc_digi_start() != ESP_OK) {
+        adc_digi_deinitialize();
+        return false;
+    }
+    adcRunning = true;
+    return true;
+}
+
+size_t adcContinuousRead(uint16_t* samples, size_t maxSamples) {
+    if (!adcRunning) {
+        return 0;
+    }
+    uint32_t length = 0;
+    esp_err_t result = adc_digi_read_bytes(reinterpret_cast<uint8_t*>(samples), maxSamples * sizeof(uint16_t), &length, 0);
+    // ESP_ERR_INVALID_STATE reports that the ring overflowed; the data read is still valid.
+    if (result != ESP_OK && result != ESP_ERR_INVALID_STATE) {
+        return 0;
+    }
+    return length / sizeof(uint16_t);
+}
+
+void adcContinuousEnd() {
+    if (adcRunning) {
+        adc_digi_stop();
+        adc_digi_deinitialize();
+        adcRunning = false;
+    }
+}
+
+size_t storageSize() {
+    const esp_partition_t* partition = storagePartition();
+    return partition != nullptr ? partition->size : 0;
+}
+
+bool storageRead(size_t offset, void* data, size_t length) {
+    const esp_partition_t* partition = storagePartition();
+    return partition != nullptr && esp_partition_read(partition, offset, data, length) == ESP_OK;
+}
+
+bool storageWrite(size_t offset, const void* data, size_t length) {
+    const esp_partition_t* partition = storagePartition();
+    return partition != nullptr && esp_partition_write(partition, offset, data, length) == ESP_OK;
+}
+
+bool storageErase(size_t offset, size_t length) {
+    const esp_partition_t* partition = storagePartition();
+    return partition != nullptr && esp_partition_erase_range(partition, offset, length) == ESP_OK;
+}
+
+/**
+ * Settings live in the "app" namespace of the nvs partition, which the
+ * Arduino core initialises for the WiFi driver.
+ */
+bool nvsRead(const char* key, void* data, size_t length) {
+    nvs_handle_t handle;
+    if (nvs_open("app", NVS_READONLY, &handle) != ESP_OK) {
+        return false;
+    }
+    size_t stored = length;
+    esp_err_t result = nvs_get_blob(handle, key, data, &stored);
+    nvs_close(handle);
+    return result == ESP_OK && stored == length;
+}
+
+bool nvsWrite(const char* key, const void* data, size_t length) {
+    nvs_handle_t handle;
+    if (nvs_open("app", NVS_READWRITE, &handle) != ESP_OK) {
+        return false;
+    }
+    bool written = nvs_set_blob(handle, key, data, length) == ESP_OK && nvs_commit(handle) == ESP_OK;
+    nvs_close(handle);
+    return written;
+}
+
+unsigned long millis() {
+    return ::millis();
+}
+
+unsigned long micros() {
+    return ::micros();
+}
+
+uint32_t HAL_ISR_ATTR microsFromIsr() {
+    return static_cast<uint32_t>(esp_timer_get_time());
+}
+
+void delay(unsigned long ms) {
+    ::delay(ms);
+}
+
+uint32_t HAL_ISR_ATTR cycleCount() {
+    return ESP.getCycleCount();
+}
+
+uint32_t cyclesPerMicrosecond() {
+    return getCpuFrequencyMhz();
+}
+
+uint32_t randomU32() {
+    return esp_random();
+}
+
+TaskHandle startTask(const char* name, TaskFunction function, void* context, uint32_t stackBytes, uint8_t priority, int8_t core) {
+    TaskHandle_t task = nullptr;
+    BaseType_t coreId = core == anyCore ? tskNO_AFFINITY : core;
+    if (xTaskCreatePinnedToCore(function, name, stackBytes, context, priority, &task, coreId) != pdPASS) {
+        return nullptr;
+    }
+    return task;
+}
+
+TaskHandle currentTask() {
+    return xTaskGetCurrentTaskHandle();
+}
+
+void HAL_ISR_ATTR notifyTask(TaskHandle task) {
+    if (task == nullptr) {
+        return;
+    }
+    if (xPortInIsrContext()) {
+        BaseType_t higherPriorityTaskWoken = pdFALSE;
+        vTaskNotifyGiveFromISR(static_cast<TaskHandle_t>(task), &higherPriorityTaskWoken);
+        if (higherPriorityTaskWoken) {
+            portYIELD_FROM_ISR();
+        }
+    } else {
+        xTaskNotifyGive(static_cast<TaskHandle_t>(task));
+    }
+}
+
+bool waitForNotification(uint32_t timeoutMs) {
+    TickType_t ticks = portMAX_DELAY;
+    if (timeoutMs != waitForever) {
+        // Round up so a wait never ends before the requested deadline.
+        ticks = (timeoutMs + portTICK_PERIOD_MS - 1) / portTICK_PERIOD_MS;
+    }
+    return ulTaskNotifyTake(pdTRUE, ticks) != 0;
+}
+
+void serialBegin(unsigned long baud) {
+    Serial.begin(baud);
+}
+
+void serialEnd() {
+    Serial.end();
+}
+
+void serialPrintln(const char* line) {
+    Serial.println(line);
+}
+
+void serialWrite(const uint8_t* data, size_t length) {
+    Serial.write(data, length);
+}
+
+int serialRead() {
+    return Serial.read();
+}
+
+void wifiOnEvent(WiFiEventHandler handler, void* context) {
+    wifiEventHandler = handler;
+    wifiEventContext = context;
+    WiFi.onEvent(onArduinoWiFiEvent);
+}
+
+void wifiBegin(const char* ssid, const char* password) {
+    WiFi.setAutoReconnect(false);
+    WiFi.begin(ssid, password);
+}
+
+bool wifiDisconnect() {
+    return WiFi.disconnect();
+}
+
+void wifiOff() {
+    WiFi.mode(WIFI_OFF);
+}
+
+/**
+ * Maps the Arduino wl_status_t codes onto the backend independent status.
+ */
+WiFiStatus wifiStatus() {
+    switch (WiFi.status()) {
+        case WL_CONNECTED: return WiFiStatus::Connected;
+        case WL_DISCONNECTED:
+        case WL_CONNECTION_LOST: return WiFiStatus::Disconnected;
+        case WL_NO_SSID_AVAIL:
+        case WL_CONNECT_FAILED: return WiFiStatus::ConnectFailed;
+        default: return WiFiStatus::Idle;
+    }
+}
+
+void wifiSSID(char* buffer, size_t size) {
+    wifi_ap_record_t accessPoint;
+    if (size == 0) {
+        return;
+    }
+    buffer[0] = '\0';
+    if (esp_wifi_sta_get_ap_info(&accessPoint) == ESP_OK) {
+        strlcpy(buffer, reinterpret_cast<const char*>(accessPoint.ssid), size);
+    }
+}
+
+uint32_t wifiLocalIP() {
+    return static_cast<uint32_t>(WiFi.localIP());
+}
+
+int tcpListen(uint16_t port, uint8_t backlog) {
+    int listener = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (listener < 0) {
+        return invalidSocket;
+    }
+    int reuse = 1;
+    setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    if (bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || listen(listener, backlog) != 0) {
+        close(listener);
+        return invalidSocket;
+    }
+    return makeNonBlocking(listener);
+}
+
+int tcpConnect(uint32_t address, uint16_t port) {
+    int connection = makeNonBlocking(socket(AF_INET, SOCK_STREAM, IPPROTO_TCP));
+    if (connection < 0) {
+        return invalidSocket;
+    }
+    int noDelay = 1;
+    setsockopt(connection, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+    sockaddr_in server = {};
+    server.sin_family = AF_INET;
+    server.sin_port = htons(port);
+    server.sin_addr.s_addr = address;
+    if (connect(connection, reinterpret_cast<sockaddr*>(&server), sizeof(server)) != 0 && errno != EINPROGRESS) {
+        close(connection);
+        return invalidSocket;
+    }
+    return connection;
+}
+
+int tcpConnected(int socket) {
+    fd_set writable;
+    FD_ZERO(&writable);
+    FD_SET(socket, &writable);
+    timeval noWait = {0, 0};
+    if (select(socket + 1, nullptr, &writable, nullptr, &noWait) <= 0) {
+        return 0;
+    }
+    int error = 0;
+    socklen_t length = sizeof(error);
+    return getsockopt(socket, SOL_SOCKET, SO_ERROR, &error, &length) == 0 && error == 0 ? 1 : -1;
+}
+
+int tcpAccept(int listener) {
+    int connection = accept(listener, nullptr, nullptr);
+    if (connection < 0) {
+        return invalidSocket;
+    }
+    int noDelay = 1;
+    setsockopt(connection, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+    return makeNonBlocking(connection);
+}
+
+int tcpRead(int socket, void* data, size_t maxLength) {
+    ssize_t count = recv(socket, data, maxLength, MSG_DONTWAIT);
+    if (count > 0) {
+        return static_cast<int>(count);
+    }
+    return count < 0 && (errno == EAGAIN || errno == EWOULDBLOCK) ? 0 : -1;
+}
+
+int tcpWrite(int socket, const void* data, size_t length) {
+    ssize_t count = send(socket, data, length, MSG_DONTWAIT);
+    if (count >= 0) {
+        return static_cast<int>(count);
+    }
+    return errno == EAGAIN || errno == EWOULDBLOCK ? 0 : -1;
+}
+
+void tcpClose(int socket) {
+    unwatchSocket(socket);
+    close(socket);
+}
+
+/**
+ * Hands the socket to the watcher task, which wakes from select() to pick it up.
+ */
+void tcpWatch(int socket, bool writable) {
+    bool added = false;
+    portENTER_CRITICAL(&socketWatchLock);
+    uint8_t i = 0;
+    while (i < watchedSocketCount && watchedSockets[i].socket != socket) {
+        i++;
+    }
+    if (i < maxWatchedSockets) {
+        watchedSockets[i] = {socket, writable};
+        watchedSocketCount = i == watchedSocketCount ? i + 1 : watchedSocketCount;
+        added = true;
+    }
+    portEXIT_CRITICAL(&socketWatchLock);
+    if (added && socketWatchWakeup >= 0) {
+        uint64_t one = 1;
+        write(socketWatchWakeup, &one, sizeof(one));
+    }
+}
+
+/**
+ * The first call starts the watcher task on core 0, next to the WiFi stack.
+ * Handlers are only ever added, so the watcher can call the ones it counted
+ * without holding the lock.
+ */
+void tcpOnReady(SocketReadyHandler handler, void* context) {
+    portENTER_CRITICAL(&socketWatchLock);
+    bool known = false;
+    for (uint8_t i = 0; i < socketReadyHandlerCount; i++) {
+        known = known || (socketReadyHandlers[i] == handler && socketReadyContexts[i] == context);
+    }
+    if (!known && socketReadyHandlerCount < maxSocketReadyHandlers) {
+        socketReadyHandlers[socketReadyHandlerCount] = handler;
+        socketReadyContexts[socketReadyHandlerCount] = context;
+        socketReadyHandlerCount++;
+    }
+    portEXIT_CRITICAL(&socketWatchLock);
+    if (socketWatchWakeup >= 0) {
+        return;
+    }
+    esp_vfs_eventfd_config_t config = ESP_VFS_EVENTD_CONFIG_DEFAULT();
+    esp_vfs_eventfd_register(&config);
+    socketWatchWakeup = eventfd(0, 0);
+    if (socketWatchWakeup >= 0) {
+        startTask("sockets", runSocketWatcher, nullptr, 3072, 3, 0);
+    }
+}
+
+} // namespace hal
+
+#endif /* ARDUINO */
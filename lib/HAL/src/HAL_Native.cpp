@@ -0,0 +1,1037 @@
+/**
+ * @file HAL_Native.cpp
+ * @brief Native (Linux) backend of the hardware abstraction layer.
+ *
+ * Pins, LEDC channels, ADC inputs, flash, settings and the WiFi link are plain memory, and time is a
+ * virtual clock that only moves when delay() is called or a host program
+ * advances it. Runs are therefore deterministic and much faster than real time.
+ * TCP sockets are real POSIX sockets; to serve them the clock can be switched
+ * to follow the wall clock, and waiting then blocks in select().
+ */
+
+#ifndef ARDUINO
+
+#include "HAL.hpp"
+#include "HALSim.hpp"
+#include <chrono>
+#include <errno.h>
+#include <fcntl.h>
+#include <map>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdio.h>
+#include <string>
+#include <string.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+constexpr uint8_t pinCount = 64;
+constexpr uint8_t ledcChannelCount = 16;
+constexpr uint16_t chainLength = 256; // Registers tracked per simulated data line.
+constexpr uint8_t adcChannelCount = 8;
+
+/**
+ * Simulated SPI device; transfers land in the same register chain as shiftOut.
+ */
+struct SpiShiftDevice {
+    uint8_t dataPin;
+    size_t capacity;
+};
+
+/**
+ * Simulated RMT pixel output; a frame keeps it busy for its wire time and the latch time.
+ */
+struct PixelOutputDevice {
+    uint8_t dataPin;
+    size_t capacity;
+    uint64_t busyUntilUs; // Virtual time the output can take the next frame
+};
+
+constexpr uint64_t pixelByteNs = 10000; // 8 bits at 800 kHz
+constexpr uint64_t pixelLatchUs = 80; // SK6812 reset time, longer than the WS2812's
+
+struct SimState {
+    uint64_t nowUs = 0;
+    uint8_t pinModes[pinCount] = {};
+    uint8_t outputLevels[pinCount] = {};
+    uint8_t inputLevels[pinCount] = {};
+    uint8_t shiftedBytes[pinCount][chainLength] = {};
+    uint8_t latchedBytes[pinCount][chainLength] = {}; // Chain content at the last latch, for edges
+    uint16_t chainShiftedBytes[pinCount] = {}; // Bytes shifted in since the last latch: the chain's length
+    uint32_t shiftOutCount = 0;
+    std::map<uint8_t, std::vector<uint8_t>> pixelFrames; // Last frame per data pin
+    std::map<uint8_t, uint32_t> pixelFrameCounts; // Frames sent per data pin
+    hal::sim::OutputRecorder outputRecorder = nullptr;
+    void* outputRecorderContext = nullptr;
+    uint64_t outputEdgeCount = 0;
+    hal::InterruptHandler interruptHandlers[pinCount] = {};
+    void* interruptContexts[pinCount] = {};
+    uint32_t ledcDuty[ledcChannelCount] = {}; // Duty at the start of the current ramp
+    uint32_t ledcTargetDuty[ledcChannelCount] = {}; // Duty at the end of the current ramp
+    uint64_t ledcFadeStartUs[ledcChannelCount] = {};
+    uint64_t ledcFadeLengthUs[ledcChannelCount] = {}; // 0 when not fading
+    bool adcRunning = false;
+    uint8_t adcPattern[adcChannelCount] = {}; // Channels in conversion order
+    uint8_t adcPatternLength = 0;
+    uint32_t adcSampleRateHz = 0;
+    uint32_t adcRateDivider = 1;
+    size_t adcBufferSamples = 0;
+    uint64_t adcStartUs = 0;
+    uint64_t adcConverted = 0; // Samples converted up to the last read, including lost ones
+    uint16_t adcLevel[adcChannelCount] = {};
+    uint16_t adcNoise[adcChannelCount] = {};
+    uint32_t adcNoiseState = 0x2545F491;
+    const uint16_t* adcRecording = nullptr;
+    size_t adcRecordingLength = 0;
+    bool notified = false;
+    uint64_t idleHorizonUs = 0;
+    hal::WiFiStatus wifiStatus = hal::WiFiStatus::Idle;
+    bool wifiConnecting = false;
+    bool wifiReachable = true;
+    uint64_t wifiConnectAtUs = 0;
+    unsigned long wifiConnectDelayMs = 1500;
+    hal::WiFiEventHandler wifiEventHandler = nullptr;
+    void* wifiEventContext = nullptr;
+    uint32_t randomState = 0x9E3779B9;
+    bool serialOpen = false;
+    bool serialEcho = true;
+    bool realTime = false;
+    uint64_t realTimeOriginUs = 0; // Steady clock reading at virtual time 0
+
+    SimState() {
+        for (auto& level : inputLevels) {
+            level = HIGH;
+        }
+    }
+};
+
+SimState state;
+
+/**
+ * Counts an output change and hands it to the recorder, if one is set.
+ */
+void recordEdge(hal::sim::OutputKind kind, uint8_t pin, uint16_t output, uint32_t value, uint32_t fadeMs) {
+    state.outputEdgeCount++;
+    if (state.outputRecorder != nullptr) {
+        hal::sim::OutputEdge edge = {state.nowUs, kind, pin, output, value, fadeMs};
+        state.outputRecorder(edge, state.outputRecorderContext);
+    }
+}
+
+/**
+ * Moves what was shifted into each chain to its outputs, recording every
+ * output that changed. Only as many registers as bytes were shifted in since
+ * the last latch are taken to exist; older bytes fell off the end of the
+ * chain. Output n of a chain is bit n % 8 of register n / 8.
+ */
+void latchChains() {
+    for (uint8_t pin = 0; pin < pinCount; pin++) {
+        uint16_t length = state.chainShiftedBytes[pin];
+        state.chainShiftedBytes[pin] = 0;
+        for (uint16_t index = 0; index < length; index++) {
+            uint8_t changed = state.shiftedBytes[pin][index] ^ state.latchedBytes[pin][index];
+            for (uint8_t bit = 0; changed != 0; bit++, changed >>= 1) {
+                if (changed & 1) {
+                    recordEdge(hal::sim::OutputKind::ShiftRegister, pin, static_cast<uint16_t>(index * 8 + bit),
+                        (state.shiftedBytes[pin][index] >> bit) & 1, 0);
+                }
+            }
+            state.latchedBytes[pin][index] = state.shiftedBytes[pin][index];
+        }
+    }
+}
+
+/**
+ * Simulated storage partition. Like flash it survives reset(); writes can
+ * only clear bits.
+ */
+struct SimFlash {
+    std::vector<uint8_t> bytes = std::vector<uint8_t>(0x160000, 0xFF); // Size of the partition in partitions.csv
+    uint32_t eraseCount = 0; // Sectors erased
+};
+
+SimFlash flash;
+
+/**
+ * Simulated NVS settings. Like flash they survive reset().
+ */
+struct SimSettings {
+    std::map<std::string, std::vector<uint8_t>> blobs;
+    uint32_t writeCount = 0;
+};
+
+SimSettings settings;
+
+/**
+ * Sockets waiting to be reported ready. Like flash they are not part of the
+ * simulated state, since they belong to the host.
+ */
+struct SimSockets {
+    std::vector<int> readable;
+    std::vector<int> writable;
+    std::vector<hal::SocketReadyHandler> handlers;
+    std::vector<void*> contexts;
+};
+
+SimSockets sockets;
+
+uint64_t steadyMicros() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+/**
+ * In real-time mode, moves the virtual clock up to the wall clock.
+ */
+void syncRealTime() {
+    if (state.realTime) {
+        uint64_t nowUs = steadyMicros() - state.realTimeOriginUs;
+        state.nowUs = nowUs > state.nowUs ? nowUs : state.nowUs;
+    }
+}
+
+void removeSocket(std::vector<int>& list, int socket) {
+    for (size_t i = 0; i < list.size(); i++) {
+        if (list[i] == socket) {
+            list[i] = list.back();
+            list.pop_back();
+            return;
+        }
+    }
+}
+
+/**
+ * Blocks in select() until a watched socket is ready or timeoutUs passes.
+ * Fires the ready handler once for all sockets that became ready.
+ */
+void pollSockets(uint64_t timeoutUs) {
+    fd_set readable;
+    fd_set writable;
+    FD_ZERO(&readable);
+    FD_ZERO(&writable);
+    int maxSocket = -1;
+    for (int socket : sockets.readable) {
+        FD_SET(socket, &readable);
+        maxSocket = socket > maxSocket ? socket : maxSocket;
+    }
+    for (int socket : sockets.writable) {
+        FD_SET(socket, &writable);
+        maxSocket = socket > maxSocket ? socket : maxSocket;
+    }
+    timeval timeout = {static_cast<time_t>(timeoutUs / 1000000), static_cast<suseconds_t>(timeoutUs % 1000000)};
+    if (select(maxSocket + 1, &readable, &writable, nullptr, &timeout) <= 0) {
+        return;
+    }
+    bool ready = false;
+    for (int socket = 0; socket <= maxSocket; socket++) {
+        if (FD_ISSET(socket, &readable) || FD_ISSET(socket, &writable)) {
+            removeSocket(sockets.readable, socket);
+            removeSocket(sockets.writable, socket);
+            ready = true;
+        }
+    }
+    for (size_t i = 0; ready && i < sockets.handlers.size(); i++) {
+        sockets.handlers[i](sockets.contexts[i]);
+    }
+}
+
+int makeNonBlocking(int socket) {
+    if (socket >= 0) {
+        fcntl(socket, F_SETFL, fcntl(socket, F_GETFL, 0) | O_NONBLOCK);
+    }
+    return socket;
+}
+
+bool inStorage(size_t offset, size_t length) {
+    return offset <= flash.bytes.size() && length <= flash.bytes.size() - offset;
+}
+
+void emitWiFiEvent(hal::WiFiEvent event) {
+    if (state.wifiEventHandler != nullptr) {
+        state.wifiEventHandler(event, state.wifiEventContext);
+    }
+}
+
+/**
+ * Resolves a pending connection attempt once its virtual deadline has passed.
+ */
+void updateWiFi() {
+    if (state.wifiConnecting && state.nowUs >= state.wifiConnectAtUs) {
+        state.wifiConnecting = false;
+        if (state.wifiReachable) {
+            state.wifiStatus = hal::WiFiStatus::Connected;
+            emitWiFiEvent(hal::WiFiEvent::GotIp);
+        } else {
+            state.wifiStatus = hal::WiFiStatus::ConnectFailed;
+            emitWiFiEvent(hal::WiFiEvent::Disconnected);
+        }
+    }
+}
+
+} // namespace
+
+namespace hal {
+
+void pinMode(uint8_t pin, uint8_t mode) {
+    if (pin < pinCount) {
+        state.pinModes[pin] = mode;
+    }
+}
+
+void digitalWrite(uint8_t pin, uint8_t level) {
+    if (pin >= pinCount) {
+        return;
+    }
+    uint8_t newLevel = level ? HIGH : LOW;
+    if (newLevel == state.outputLevels[pin]) {
+        return;
+    }
+    state.outputLevels[pin] = newLevel;
+    recordEdge(hal::sim::OutputKind::Pin, pin, 0, newLevel, 0);
+    if (newLevel == HIGH) {
+        latchChains(); // A rising latch pin moves what was shifted in to the outputs.
+    }
+}
+
+int digitalRead(uint8_t pin) {
+    if (pin >= pinCount) {
+        return LOW;
+    }
+    return state.pinModes[pin] == OUTPUT ? state.outputLevels[pin] : state.inputLevels[pin];
+}
+
+int digitalReadFromIsr(uint8_t pin) {
+    return digitalRead(pin);
+}
+
+/**
+ * Pushes one byte into the simulated register chain: every register passes
+ * its content on to the next one, register 0 receives the new byte.
+ */
+void shiftOut(uint8_t dataPin, uint8_t clockPin, uint8_t bitOrder, uint8_t value) {
+    (void)clockPin;
+    (void)bitOrder;
+    if (dataPin < pinCount) {
+        uint8_t* chain = state.shiftedBytes[dataPin];
+        memmove(chain + 1, chain, chainLength - 1);
+        chain[0] = value;
+        if (state.chainShiftedBytes[dataPin] < chainLength) {
+            state.chainShiftedBytes[dataPin]++;
+        }
+    }
+    state.shiftOutCount++;
+}
+
+SpiShiftHandle spiShiftBegin(uint8_t dataPin, uint8_t clockPin, uint8_t latchPin, size_t maxBytes, uint32_t clockHz) {
+    (void)clockPin;
+    (void)latchPin;
+    (void)clockHz;
+    return new SpiShiftDevice{dataPin, maxBytes};
+}
+
+void spiShiftWrite(SpiShiftHandle handle, const uint8_t* data, size_t length) {
+    SpiShiftDevice* device = static_cast<SpiShiftDevice*>(handle);
+    if (length > device->capacity) {
+        length = device->capacity;
+    }
+    for (size_t i = 0; i < length; i++) {
+        shiftOut(device->dataPin, 0, MSBFIRST, data[i]);
+    }
+    latchChains(); // Chip select rising at the end of the transfer latches it.
+}
+
+void spiShiftEnd(SpiShiftHandle handle) {
+    delete static_cast<SpiShiftDevice*>(handle);
+}
+
+PixelOutputHandle pixelOutputBegin(uint8_t dataPin, size_t maxBytes) {
+    return new PixelOutputDevice{dataPin, maxBytes, 0};
+}
+
+bool pixelOutputWrite(PixelOutputHandle handle, const uint8_t* data, size_t length) {
+    PixelOutputDevice* device = static_cast<PixelOutputDevice*>(handle);
+    syncRealTime();
+    if (state.nowUs < device->busyUntilUs) {
+        return false;
+    }
+    if (length > device->capacity) {
+        length = device->capacity;
+    }
+    state.pixelFrames[device->dataPin].assign(data, data + length);
+    state.pixelFrameCounts[device->dataPin]++;
+    device->busyUntilUs = state.nowUs + (length * pixelByteNs + 999) / 1000 + pixelLatchUs;
+    return true;
+}
+
+bool pixelOutputBusy(PixelOutputHandle handle) {
+    syncRealTime();
+    return state.nowUs < static_cast<PixelOutputDevice*>(handle)->busyUntilUs;
+}
+
+void pixelOutputEnd(PixelOutputHandle handle) {
+    delete static_cast<PixelOutputDevice*>(handle);
+}
+
+void attachInterrupt(uint8_t pin, InterruptHandler handler, void* context) {
+    if (pin < pinCount) {
+        state.interruptHandlers[pin] = handler;
+        state.interruptContexts[pin] = context;
+    }
+}
+
+void ledcSetup(uint8_t channel, uint32_t frequency, uint8_t resolutionBits) {
+    (void)frequency;
+    (void)resolutionBits;
+    if (channel < ledcChannelCount) {
+        ledcWrite(channel, 0);
+    }
+}
+
+void ledcAttachPin(uint8_t pin, uint8_t channel) {
+    (void)pin;
+    (void)channel;
+}
+
+void ledcWrite(uint8_t channel, uint32_t duty) {
+    if (channel < ledcChannelCount) {
+        if (duty != ledcReadDuty(channel) || state.ledcFadeLengthUs[channel] != 0) {
+            recordEdge(hal::sim::OutputKind::Ledc, channel, 0, duty, 0);
+        }
+        state.ledcDuty[channel] = duty;
+        state.ledcTargetDuty[channel] = duty;
+        state.ledcFadeLengthUs[channel] = 0;
+    }
+}
+
+/**
+ * Fades are interpolated over the virtual clock when the duty is read.
+ */
+void ledcFade(uint8_t channel, uint32_t targetDuty, uint32_t durationMs) {
+    if (channel >= ledcChannelCount) {
+        return;
+    }
+    state.ledcDuty[channel] = ledcReadDuty(channel);
+    if (targetDuty != state.ledcDuty[channel] || durationMs == 0) {
+        recordEdge(hal::sim::OutputKind::Ledc, channel, 0, targetDuty, durationMs);
+    }
+    state.ledcTargetDuty[channel] = targetDuty;
+    state.ledcFadeStartUs[channel] = state.nowUs;
+    state.ledcFadeLengthUs[channel] = static_cast<uint64_t>(durationMs) * 1000;
+    if (durationMs == 0) {
+        state.ledcDuty[channel] = targetDuty;
+    }
+}
+
+uint32_t ledcReadDuty(uint8_t channel) {
+    if (channel >= ledcChannelCount) {
+        return 0;
+    }
+    uint64_t lengthUs = state.ledcFadeLengthUs[channel];
+    uint64_t elapsedUs = state.nowUs - state.ledcFadeStartUs[channel];
+    if (lengthUs == 0 || elapsedUs >= lengthUs) {
+        return state.ledcTargetDuty[channel];
+    }
+    int64_t from = state.ledcDuty[channel];
+    int64_t to = state.ledcTargetDuty[channel];
+    return static_cast<uint32_t>(from + (to - from) * static_cast<int64_t>(elapsedUs) / static_cast<int64_t>(lengthUs));
+}
+
+bool adcContinuousBegin(const uint8_t* channels, uint8_t count, uint32_t sampleRateHz, size_t bufferSamples) {
+    if (count == 0 || count > adcChannelCount || sampleRateHz == 0 || bufferSamples == 0) {
+        return false;
+    }
+    for (uint8_t i = 0; i < count; i++) {
+        if (channels[i] >= adcChannelCount) {
+            return false;
+        }
+        state.adcPattern[i] = channels[i];
+    }
+    state.adcPatternLength = count;
+    state.adcSampleRateHz = sampleRateHz;
+    state.adcBufferSamples = bufferSamples;
+    state.adcStartUs = state.nowUs;
+    state.adcConverted = 0;
+    state.adcRunning = true;
+    return true;
+}
+
+/**
+ * Conversions happen at the sample rate over the virtual clock. Of those made
+ * since the last read, only as many as fit the ring survive, like on the
+ * device when the reader falls behind.
+ */
+size_t adcContinuousRead(uint16_t* samples, size_t maxSamples) {
+    if (!state.adcRunning) {
+        return 0;
+    }
+    uint64_t converted = (state.nowUs - state.adcStartUs) * state.adcSampleRateHz / state.adcRateDivider / 1000000;
+    uint64_t pending = converted - state.adcConverted;
+    if (pending > state.adcBufferSamples) {
+        state.adcConverted = converted - state.adcBufferSamples;
+        pending = state.adcBufferSamples;
+    }
+    size_t count = pending < maxSamples ? static_cast<size_t>(pending) : maxSamples;
+    for (size_t i = 0; i < count; i++) {
+        uint64_t index = state.adcConverted + i;
+        if (state.adcRecording != nullptr) {
+            samples[i] = state.adcRecording[index % state.adcRecordingLength];
+            continue;
+        }
+        uint8_t channel = state.adcPattern[index % state.adcPatternLength];
+        int32_t value = state.adcLevel[channel];
+        if (state.adcNoise[channel] > 0) {
+            uint32_t x = state.adcNoiseState;
+            x ^= x << 13;
+            x ^= x >> 17;
+            x ^= x << 5;
+            state.adcNoiseState = x;
+            value += static_cast<int32_t>(x % (2u * state.adcNoise[channel] + 1)) - state.adcNoise[channel];
+        }
+        value = value < 0 ? 0 : (value > adcSampleValueMask ? adcSampleValueMask : value);
+        samples[i] = static_cast<uint16_t>((channel << adcSampleChannelShift) | value);
+    }
+    state.adcConverted += count;
+    return count;
+}
+
+void adcContinuousEnd() {
+    state.adcRunning = false;
+}
+
+size_t storageSize() {
+    return flash.bytes.size();
+}
+
+bool storageRead(size_t offset, void* data, size_t length) {
+    if (!inStorage(offset, length)) {
+        return false;
+    }
+    memcpy(data, flash.bytes.data() + offset, length);
+    return true;
+}
+
+bool storageWrite(size_t offset, const void* data, size_t length) {
+    if (!inStorage(offset, length)) {
+        return false;
+    }
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    for (size_t i = 0; i < length; i++) {
+        flash.bytes[offset + i] &= bytes[i];
+    }
+    return true;
+}
+
+bool storageErase(size_t offset, size_t length) {
+    if (!inStorage(offset, length) || offset % storageSectorSize != 0 || length % storageSectorSize != 0) {
+        return false;
+    }
+    memset(flash.bytes.data() + offset, 0xFF, length);
+    flash.eraseCount += static_cast<uint32_t>(length / storageSectorSize);
+    return true;
+}
+
+bool nvsRead(const char* key, void* data, size_t length) {
+    auto blob = settings.blobs.find(key);
+    if (blob == settings.blobs.end() || blob->second.size() != length) {
+        return false;
+    }
+    memcpy(data, blob->second.data(), length);
+    return true;
+}
+
+bool nvsWrite(const char* key, const void* data, size_t length) {
+    if (strlen(key) > nvsMaxKeyLength) {
+        return false;
+    }
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    settings.blobs[key].assign(bytes, bytes + length);
+    settings.writeCount++;
+    return true;
+}
+
+unsigned long millis() {
+    syncRealTime();
+    return static_cast<unsigned long>(state.nowUs / 1000);
+}
+
+unsigned long micros() {
+    syncRealTime();
+    return static_cast<unsigned long>(state.nowUs);
+}
+
+uint32_t microsFromIsr() {
+    return static_cast<uint32_t>(micros());
+}
+
+void delay(unsigned long ms) {
+    sim::advanceMicros(static_cast<uint64_t>(ms) * 1000);
+}
+
+/**
+ * There is no portable cycle counter, so the host uses monotonic nanoseconds.
+ */
+uint32_t cycleCount() {
+    return static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+uint32_t cyclesPerMicrosecond() {
+    return 1000;
+}
+
+/**
+ * xorshift32, so runs are reproducible.
+ */
+uint32_t randomU32() {
+    uint32_t x = state.randomState;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    state.randomState = x;
+    return x;
+}
+
+/**
+ * The simulator is single-threaded, so no task can be started.
+ */
+TaskHandle startTask(const char* name, TaskFunction function, void* context, uint32_t stackBytes, uint8_t priority, int8_t core) {
+    (void)name;
+    (void)function;
+    (void)context;
+    (void)stackBytes;
+    (void)priority;
+    (void)core;
+    return nullptr;
+}
+
+TaskHandle currentTask() {
+    return &state;
+}
+
+void notifyTask(TaskHandle task) {
+    (void)task;
+    state.notified = true;
+}
+
+/**
+ * Instead of sleeping, moves the virtual clock to the timeout, but never past
+ * the idle horizon set by the host program or a pending simulated WiFi event.
+ * In real-time mode it waits that long on the watched sockets instead.
+ */
+bool waitForNotification(uint32_t timeoutMs) {
+    if (state.notified) {
+        state.notified = false;
+        return true;
+    }
+    uint64_t targetUs = state.idleHorizonUs;
+    if (timeoutMs != waitForever) {
+        uint64_t deadlineUs = state.nowUs + static_cast<uint64_t>(timeoutMs) * 1000;
+        if (deadlineUs < targetUs) {
+            targetUs = deadlineUs;
+        }
+    }
+    if (state.wifiConnecting && state.wifiConnectAtUs < targetUs) {
+        targetUs = state.wifiConnectAtUs;
+    }
+    if (state.realTime) {
+        syncRealTime();
+        while (state.nowUs < targetUs && !state.notified) {
+            pollSockets(targetUs - state.nowUs);
+            syncRealTime();
+        }
+    } else if (targetUs > state.nowUs) {
+        state.nowUs = targetUs;
+    }
+    updateWiFi();
+    if (state.notified) {
+        state.notified = false;
+        return true;
+    }
+    return false;
+}
+
+void serialBegin(unsigned long baud) {
+    (void)baud;
+    state.serialOpen = true;
+}
+
+void serialEnd() {
+    state.serialOpen = false;
+}
+
+void serialPrintln(const char* line) {
+    if (state.serialOpen && state.serialEcho) {
+        printf("%s\n", line);
+    }
+}
+
+void serialWrite(const uint8_t* data, size_t length) {
+    if (state.serialOpen && state.serialEcho) {
+        fwrite(data, 1, length, stdout);
+    }
+}
+
+int serialRead() {
+    return -1;
+}
+
+void wifiOnEvent(WiFiEventHandler handler, void* context) {
+    state.wifiEventHandler = handler;
+    state.wifiEventContext = context;
+}
+
+void wifiBegin(const char* ssid, const char* password) {
+    (void)ssid;
+    (void)password;
+    state.wifiStatus = WiFiStatus::Disconnected;
+    state.wifiConnecting = true;
+    state.wifiConnectAtUs = state.nowUs + static_cast<uint64_t>(state.wifiConnectDelayMs) * 1000;
+}
+
+bool wifiDisconnect() {
+    bool wasActive = state.wifiConnecting || state.wifiStatus == WiFiStatus::Connected;
+    state.wifiConnecting = false;
+    state.wifiStatus = WiFiStatus::Disconnected;
+    if (wasActive) {
+        emitWiFiEvent(WiFiEvent::Disconnected);
+    }
+    return true;
+}
+
+void wifiOff() {
+    bool wasOn = state.wifiStatus != WiFiStatus::Idle;
+    state.wifiConnecting = false;
+    state.wifiStatus = WiFiStatus::Idle;
+    if (wasOn) {
+        emitWiFiEvent(WiFiEvent::Stopped);
+    }
+}
+
+WiFiStatus wifiStatus() {
+    updateWiFi();
+    return state.wifiStatus;
+}
+
+void wifiSSID(char* buffer, size_t size) {
+    if (size > 0) {
+        snprintf(buffer, size, "%s", wifiStatus() == WiFiStatus::Connected ? "simulated-ap" : "");
+    }
+}
+
+uint32_t wifiLocalIP() {
+    // 192.168.4.2, first octet in the lowest byte.
+    return wifiStatus() == WiFiStatus::Connected ? 0x0204A8C0 : 0;
+}
+
+/**
+ * Privileged ports are moved up by 8000 (80 becomes 8080), so the host
+ * program needs no root.
+ */
+int tcpListen(uint16_t port, uint8_t backlog) {
+    int listener = socket(AF_INET, SOCK_STREAM, 0);
+    if (listener < 0) {
+        return invalidSocket;
+    }
+    int reuse = 1;
+    setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port < 1024 ? port + 8000 : port);
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    if (bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || listen(listener, backlog) != 0) {
+        close(listener);
+        return invalidSocket;
+    }
+    return makeNonBlocking(listener);
+}
+
+/**
+ * The address is used as given: the broker or server must run on the host.
+ */
+int tcpConnect(uint32_t address, uint16_t port) {
+    int connection = makeNonBlocking(socket(AF_INET, SOCK_STREAM, 0));
+    if (connection < 0) {
+        return invalidSocket;
+    }
+    int noDelay = 1;
+    setsockopt(connection, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+    sockaddr_in server = {};
+    server.sin_family = AF_INET;
+    server.sin_port = htons(port);
+    server.sin_addr.s_addr = address;
+    if (connect(connection, reinterpret_cast<sockaddr*>(&server), sizeof(server)) != 0 && errno != EINPROGRESS) {
+        close(connection);
+        return invalidSocket;
+    }
+    return connection;
+}
+
+int tcpConnected(int socket) {
+    fd_set writable;
+    FD_ZERO(&writable);
+    FD_SET(socket, &writable);
+    timeval noWait = {0, 0};
+    if (select(socket + 1, nullptr, &writable, nullptr, &noWait) <= 0) {
+        return 0;
+    }
+    int error = 0;
+    socklen_t length = sizeof(error);
+    return getsockopt(socket, SOL_SOCKET, SO_ERROR, &error, &length) == 0 && error == 0 ? 1 : -1;
+}
+
+int tcpAccept(int listener) {
+    int connection = accept(listener, nullptr, nullptr);
+    if (connection < 0) {
+        return invalidSocket;
+    }
+    int noDelay = 1;
+    setsockopt(connection, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+    return makeNonBlocking(connection);
+}
+
+int tcpRead(int socket, void* data, size_t maxLength) {
+    ssize_t count = recv(socket, data, maxLength, MSG_DONTWAIT);
+    if (count > 0) {
+        return static_cast<int>(count);
+    }
+    return count < 0 && (errno == EAGAIN || errno == EWOULDBLOCK) ? 0 : -1;
+}
+
+int tcpWrite(int socket, const void* data, size_t length) {
+    ssize_t count = send(socket, data, length, MSG_DONTWAIT | MSG_NOSIGNAL);
+    if (count >= 0) {
+        return static_cast<int>(count);
+    }
+    return errno == EAGAIN || errno == EWOULDBLOCK ? 0 : -1;
+}
+
+void tcpClose(int socket) {
+    removeSocket(sockets.readable, socket);
+    removeSocket(sockets.writable, socket);
+    close(socket);
+}
+
+void tcpWatch(int socket, bool writable) {
+    removeSocket(sockets.readable, socket);
+    removeSocket(sockets.writable, socket);
+    sockets.readable.push_back(socket);
+    if (writable) {
+        sockets.writable.push_back(socket);
+    }
+}
+
+/**
+ * Readiness is only checked while waitForNotification() waits in real-time mode.
+ */
+void tcpOnReady(SocketReadyHandler handler, void* context) {
+    for (size_t i = 0; i < sockets.handlers.size(); i++) {
+        if (sockets.handlers[i] == handler && sockets.contexts[i] == context) {
+            return;
+        }
+    }
+    if (sockets.handlers.size() < maxSocketReadyHandlers) {
+        sockets.handlers.push_back(handler);
+        sockets.contexts.push_back(context);
+    }
+}
+
+namespace sim {
+
+void reset() {
+    state = SimState();
+}
+
+void advanceMicros(uint64_t us) {
+    state.nowUs += us;
+    updateWiFi();
+}
+
+uint64_t nowMicros() {
+    return state.nowUs;
+}
+
+void setIdleHorizon(uint64_t us) {
+    state.idleHorizonUs = us;
+}
+
+void setRealTime(bool realTime) {
+    state.realTime = realTime;
+    state.realTimeOriginUs = steadyMicros() - state.nowUs;
+}
+
+void setInput(uint8_t pin, int level) {
+    if (pin >= pinCount) {
+        return;
+    }
+    uint8_t newLevel = level ? HIGH : LOW;
+    if (state.inputLevels[pin] == newLevel) {
+        return;
+    }
+    state.inputLevels[pin] = newLevel;
+    if (state.interruptHandlers[pin] != nullptr) {
+        state.interruptHandlers[pin](state.interruptContexts[pin]);
+    }
+}
+
+int outputLevel(uint8_t pin) {
+    return pin < pinCount ? state.outputLevels[pin] : LOW;
+}
+
+uint8_t lastShiftedByte(uint8_t dataPin) {
+    return shiftedByte(dataPin, 0);
+}
+
+uint8_t shiftedByte(uint8_t dataPin, uint16_t registerIndex) {
+    return dataPin < pinCount && registerIndex < chainLength ? state.shiftedBytes[dataPin][registerIndex] : 0;
+}
+
+uint32_t shiftOutCount() {
+    return state.shiftOutCount;
+}
+
+const uint8_t* pixelFrame(uint8_t dataPin, size_t* length) {
+    auto frame = state.pixelFrames.find(dataPin);
+    if (frame == state.pixelFrames.end()) {
+        *length = 0;
+        return nullptr;
+    }
+    *length = frame->second.size();
+    return frame->second.data();
+}
+
+uint32_t pixelFrameCount(uint8_t dataPin) {
+    auto count = state.pixelFrameCounts.find(dataPin);
+    return count != state.pixelFrameCounts.end() ? count->second : 0;
+}
+
+uint32_t ledcDuty(uint8_t channel) {
+    return ledcReadDuty(channel);
+}
+
+void setAdcLevel(uint8_t channel, uint16_t raw, uint16_t noise) {
+    if (channel < adcChannelCount) {
+        state.adcLevel[channel] = raw;
+        state.adcNoise[channel] = noise;
+    }
+}
+
+void setAdcRecording(const uint16_t* samples, size_t count) {
+    state.adcRecording = count > 0 ? samples : nullptr;
+    state.adcRecordingLength = count;
+}
+
+void setStorageSize(size_t bytes) {
+    flash.bytes.assign(bytes / storageSectorSize * storageSectorSize, 0xFF);
+    flash.eraseCount = 0;
+}
+
+const uint8_t* storageImage() {
+    return flash.bytes.data();
+}
+
+uint32_t storageEraseCount() {
+    return flash.eraseCount;
+}
+
+uint32_t nvsWriteCount() {
+    return settings.writeCount;
+}
+
+void setOutputRecorder(OutputRecorder recorder, void* context) {
+    state.outputRecorder = recorder;
+    state.outputRecorderContext = context;
+}
+
+uint64_t outputEdgeCount() {
+    return state.outputEdgeCount;
+}
+
+bool savePersistent(const char* path) {
+    FILE* file = fopen(path, "wb");
+    if (file == nullptr) {
+        return false;
+    }
+    uint32_t size = static_cast<uint32_t>(flash.bytes.size());
+    uint32_t count = static_cast<uint32_t>(settings.blobs.size());
+    bool written = fwrite(&size, sizeof(size), 1, file) == 1 &&
+        fwrite(flash.bytes.data(), 1, size, file) == size &&
+        fwrite(&count, sizeof(count), 1, file) == 1;
+    for (const auto& blob : settings.blobs) {
+        uint8_t keyLength = static_cast<uint8_t>(blob.first.size());
+        uint16_t length = static_cast<uint16_t>(blob.second.size());
+        written = written && fwrite(&keyLength, sizeof(keyLength), 1, file) == 1 &&
+            fwrite(blob.first.data(), 1, keyLength, file) == keyLength &&
+            fwrite(&length, sizeof(length), 1, file) == 1 &&
+            fwrite(blob.second.data(), 1, length, file) == length;
+    }
+    return fclose(file) == 0 && written;
+}
+
+bool loadPersistent(const char* path) {
+    FILE* file = fopen(path, "rb");
+    if (file == nullptr) {
+        return false;
+    }
+    uint32_t size = 0;
+    uint32_t count = 0;
+    std::vector<uint8_t> image;
+    SimSettings loaded;
+    bool read = fread(&size, sizeof(size), 1, file) == 1 && size % storageSectorSize == 0;
+    if (read) {
+        image.resize(size);
+        read = fread(image.data(), 1, size, file) == size && fread(&count, sizeof(count), 1, file) == 1;
+    }
+    for (uint32_t i = 0; read && i < count; i++) {
+        uint8_t keyLength = 0;
+        uint16_t length = 0;
+        char key[256];
+        read = fread(&keyLength, sizeof(keyLength), 1, file) == 1 && fread(key, 1, keyLength, file) == keyLength &&
+            fread(&length, sizeof(length), 1, file) == 1;
+        if (read) {
+            std::vector<uint8_t>& blob = loaded.blobs[std::string(key, keyLength)];
+            blob.resize(length);
+            read = fread(blob.data(), 1, length, file) == length;
+        }
+    }
+    fclose(file);
+    if (!read) {
+        return false;
+    }
+    flash.bytes.swap(image);
+    flash.eraseCount = 0;
+    settings.blobs.swap(loaded.blobs);
+    return true;
+}
+
+void setAdcRateDivider(uint32_t divider) {
+    state.adcRateDivider = divider > 0 ? divider : 1;
+}
+
+void setWiFiConnectDelay(unsigned long ms) {
+    state.wifiConnectDelayMs = ms;
+}
+
+void setWiFiReachable(bool reachable) {
+    state.wifiReachable = reachable;
+}
+
+void dropWiFi() {
+    if (state.wifiStatus == WiFiStatus::Connected) {
+        state.wifiStatus = WiFiStatus::Disconnected;
+        emitWiFiEvent(WiFiEvent::Disconnected);
+    }
+}
+
+void setSerialEcho(bool echo) {
+    state.serialEcho = echo;
+}
+
+} // namespace sim
+
+} // namespace hal
+
+#endif /* ARDUINO */
@@ -0,0 +1,656 @@
+/**
+ * @file HttpServer.cpp
+ * @brief Implementation of the non-blocking HTTP/1.1 JSON server.
+ */
+
+#include "HttpServer.hpp"
+#include "DebugLogger.hpp"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+namespace {
+
+constexpr size_t chunkPrefixSize = 5; // Three hex digits and CRLF
+constexpr size_t chunkSuffixSize = 2; // CRLF after the chunk data
+constexpr size_t lastChunkSize = 5; // "0\r\n\r\n"
+constexpr uint32_t idleCheckInterval = HttpServer::idleTimeoutMs / 3;
+
+const char* reasonPhrase(uint16_t status) {
+    switch (status) {
+        case 200: return "OK";
+        case 202: return "Accepted";
+        case 400: return "Bad Request";
+        case 404: return "Not Found";
+        case 405: return "Method Not Allowed";
+        case 413: return "Payload Too Large";
+        case 431: return "Request Header Fields Too Large";
+        case 500: return "Internal Server Error";
+        case 503: return "Service Unavailable";
+        default: return "Unknown";
+    }
+}
+
+/**
+ * Finds the blank line ending the headers.
+ * @return Offset of its CRLFCRLF, or length if there is none yet.
+ */
+size_t findHeaderEnd(const char* data, size_t length) {
+    for (size_t i = 0; i + 3 < length; i++) {
+        if (data[i] == '\r' && data[i + 1] == '\n' && data[i + 2] == '\r' && data[i + 3] == '\n') {
+            return i;
+        }
+    }
+    return length;
+}
+
+/**
+ * Checks whether a header line starts with the given name and a colon.
+ * @return Start of the value with leading spaces skipped, or nullptr.
+ */
+const char* headerValue(const char* line, const char* name) {
+    size_t length = strlen(name);
+    if (strncasecmp(line, name, length) != 0 || line[length] != ':') {
+        return nullptr;
+    }
+    line += length + 1;
+    while (*line == ' ' || *line == '\t') {
+        line++;
+    }
+    return line;
+}
+
+/**
+ * Reads a Content-Length value: decimal digits up to the end of the line,
+ * with trailing spaces allowed. Values above limit are stored as limit + 1,
+ * so adding them to an offset cannot wrap.
+ * @return False if the value is empty or not a number.
+ */
+bool parseContentLength(const char* value, size_t limit, size_t& length) {
+    length = 0;
+    const char* digit = value;
+    for (; *digit >= '0' && *digit <= '9'; digit++) {
+        if (length <= limit) {
+            length = length * 10 + static_cast<size_t>(*digit - '0');
+        }
+    }
+    if (length > limit) {
+        length = limit + 1;
+    }
+    while (*digit == ' ' || *digit == '\t') {
+        digit++;
+    }
+    return digit != value && (*digit == '\r' || *digit == '\0');
+}
+
+} // namespace
+
+/**
+ * @brief Finds a query parameter.
+ * @param[out] length Length of the value, which is not terminated.
+ * @return Start of the value, or nullptr if the parameter is absent.
+ */
+const char* HttpServer::Request::param(const char* name, size_t& length) const {
+    size_t nameLength = strlen(name);
+    for (const char* field = query; *field != '\0';) {
+        const char* end = strchr(field, '&');
+        if (end == nullptr) {
+            end = field + strlen(field);
+        }
+        if (static_cast<size_t>(end - field) > nameLength && strncmp(field, name, nameLength) == 0 &&
+            field[nameLength] == '=') {
+            length = static_cast<size_t>(end - field) - nameLength - 1;
+            return field + nameLength + 1;
+        }
+        field = *end == '&' ? end + 1 : end;
+    }
+    return nullptr;
+}
+
+/**
+ * @brief Reads a query parameter as a decimal integer.
+ * @return False if the parameter is absent or not a number; value is then unchanged.
+ */
+bool HttpServer::Request::intParam(const char* name, int64_t& value) const {
+    size_t length = 0;
+    const char* text = param(name, length);
+    if (text == nullptr) {
+        return false;
+    }
+    bool negative = length > 0 && text[0] == '-';
+    size_t i = negative ? 1 : 0;
+    if (i == length || length - i > 18) {
+        return false;
+    }
+    int64_t result = 0;
+    for (; i < length; i++) {
+        if (text[i] < '0' || text[i] > '9') {
+            return false;
+        }
+        result = result * 10 + (text[i] - '0');
+    }
+    value = negative ? -result : result;
+    return true;
+}
+
+HttpServer::Response::Response(char* body, size_t capacity, uint8_t* state)
+    : status(200), writer(body, capacity), streamFunction(nullptr), streamContext(nullptr), state(state) {}
+
+/**
+ * @brief Sets the status code; 200 unless changed.
+ */
+void HttpServer::Response::setStatus(uint16_t status) {
+    this->status = status;
+}
+
+/**
+ * @brief Writer of the body. An overflowed body is answered with 500.
+ */
+JsonWriter& HttpServer::Response::json() {
+    return writer;
+}
+
+/**
+ * @brief Streams the body in chunks instead; anything written to json() is discarded.
+ */
+void HttpServer::Response::stream(StreamFunction function, void* context) {
+    streamFunction = function;
+    streamContext = context;
+}
+
+/**
+ * @brief Scratch bytes passed to the stream function, to set up where it starts.
+ */
+uint8_t* HttpServer::Response::streamState() {
+    return state;
+}
+
+/**
+ * @brief Constructs a stopped server with no routes.
+ */
+HttpServer::HttpServer()
+    : routes(), routeCount(0), connections(), scheduler(nullptr), readyEvent(Scheduler::invalidId),
+      idleTimer(Scheduler::invalidId), listener(hal::invalidSocket), requestCount(0), errorCount(0), maxLatencyUs(0) {
+    for (Connection& connection : connections) {
+        connection.socket = hal::invalidSocket;
+    }
+}
+
+/**
+ * @brief Adds a route. Must be called before begin().
+ * @param path Exact path, or a prefix ending in '*' that matches any rest of the path.
+ * @return Route identifier, or invalidId if the table is full.
+ */
+uint8_t HttpServer::addRoute(Method method, const char* path, RouteHandler handler, void* context) {
+    if (routeCount >= maxRoutes) {
+        LOG_ERROR("HTTP route %s rejected.", path);
+        return invalidId;
+    }
+    routes[routeCount] = {method, path, handler, context};
+    return routeCount++;
+}
+
+/**
+ * @brief Starts listening. May be called again after end().
+ *
+ * The scheduler event and idle timer are registered on the first call.
+ *
+ * @return False if the port could not be bound.
+ */
+bool HttpServer::begin(Scheduler& scheduler, uint16_t port) {
+    if (listener != hal::invalidSocket) {
+        return true;
+    }
+    if (this->scheduler == nullptr) {
+        this->scheduler = &scheduler;
+        readyEvent = scheduler.addEvent(onReadyEvent, this);
+        idleTimer = scheduler.addTimer(onIdleTimer, this);
+        if (readyEvent == Scheduler::invalidId || idleTimer == Scheduler::invalidId) {
+            LOG_ERROR("HTTP server has no scheduler event or timer.");
+            return false;
+        }
+    }
+    listener = hal::tcpListen(port, maxConnections);
+    if (listener == hal::invalidSocket) {
+        LOG_ERROR("HTTP server cannot listen on port %u.", port);
+        return false;
+    }
+    hal::tcpOnReady(onSocketReady, this);
+    hal::tcpWatch(listener, false);
+    LOG_INFO("HTTP server listening on port %u.", port);
+    return true;
+}
+
+/**
+ * @brief Closes the listener and every connection.
+ */
+void HttpServer::end() {
+    if (listener == hal::invalidSocket) {
+        return;
+    }
+    for (Connection& connection : connections) {
+        if (connection.socket != hal::invalidSocket) {
+            close(connection);
+        }
+    }
+    hal::tcpClose(listener);
+    listener = hal::invalidSocket;
+    scheduler->stopTimer(idleTimer);
+}
+
+/**
+ * @brief True between a successful begin() and end().
+ */
+bool HttpServer::isRunning() const {
+    return listener != hal::invalidSocket;
+}
+
+/**
+ * @brief Requests answered since construction.
+ */
+uint32_t HttpServer::getRequestCount() const {
+    return requestCount;
+}
+
+/**
+ * @brief Requests answered with a 4xx or 5xx status.
+ */
+uint32_t HttpServer::getErrorCount() const {
+    return errorCount;
+}
+
+/**
+ * @brief Longest time from a complete request to its last byte handed to TCP.
+ */
+uint32_t HttpServer::getMaxLatencyUs() const {
+    return maxLatencyUs;
+}
+
+/**
+ * @brief Open client connections.
+ */
+uint8_t HttpServer::getConnectionCount() const {
+    uint8_t count = 0;
+    for (const Connection& connection : connections) {
+        count += connection.socket != hal::invalidSocket ? 1 : 0;
+    }
+    return count;
+}
+
+/**
+ * @brief Moves the work to the server's task. May run in the HAL's socket task.
+ */
+void HttpServer::onSocketReady(void* context) {
+    HttpServer* server = static_cast<HttpServer*>(context);
+    server->scheduler->post(server->readyEvent);
+}
+
+/**
+ * @brief Accepts new clients and services every connection.
+ *
+ * The HAL does not say which socket is ready, so all are tried; a socket
+ * with nothing to do costs one failed non-blocking read.
+ */
+void HttpServer::onReadyEvent(void* context) {
+    HttpServer* server = static_cast<HttpServer*>(context);
+    if (server->listener == hal::invalidSocket) {
+        return;
+    }
+    server->accept();
+    for (Connection& connection : server->connections) {
+        if (connection.socket != hal::invalidSocket) {
+            server->service(connection);
+        }
+    }
+}
+
+/**
+ * @brief Closes connections idle for longer than idleTimeoutMs, and stops once none are open.
+ */
+void HttpServer::onIdleTimer(void* context) {
+    HttpServer* server = static_cast<HttpServer*>(context);
+    uint32_t now = hal::millis();
+    for (Connection& connection : server->connections) {
+        if (connection.socket != hal::invalidSocket && now - connection.lastActivityMs >= idleTimeoutMs) {
+            server->close(connection);
+        }
+    }
+    if (server->getConnectionCount() == 0) {
+        server->scheduler->stopTimer(server->idleTimer);
+    }
+}
+
+/**
+ * @brief Takes waiting clients into free slots.
+ *
+ * With every slot taken the listener is not watched: further clients wait in
+ * the backlog until a connection closes.
+ */
+void HttpServer::accept() {
+    for (Connection& connection : connections) {
+        if (connection.socket != hal::invalidSocket) {
+            continue;
+        }
+        int socket = hal::tcpAccept(listener);
+        if (socket == hal::invalidSocket) {
+            hal::tcpWatch(listener, false);
+            return;
+        }
+        connection.socket = socket;
+        connection.requestLength = 0;
+        connection.sendOffset = 0;
+        connection.sendEnd = 0;
+        connection.keepAlive = true;
+        connection.stream = nullptr;
+        connection.lastActivityMs = hal::millis();
+        if (!scheduler->isTimerActive(idleTimer)) {
+            scheduler->startTimer(idleTimer, idleCheckInterval, idleCheckInterval);
+        }
+    }
+}
+
+/**
+ * @brief Sends, reads and dispatches as far as the socket allows, then watches it.
+ *
+ * A response is sent completely before the next request is read, so a client
+ * that does not read its responses is only ever holding one buffer.
+ */
+void HttpServer::service(Connection& connection) {
+    for (;;) {
+        if (connection.sendOffset < connection.sendEnd) {
+            if (!send(connection)) {
+                close(connection);
+                return;
+            }
+            if (connection.sendOffset < connection.sendEnd) {
+                hal::tcpWatch(connection.socket, true);
+                return;
+            }
+            if (connection.stream != nullptr) {
+                nextChunk(connection, 0);
+                continue;
+            }
+            finishRequest(connection);
+            if (!connection.keepAlive) {
+                close(connection);
+                return;
+            }
+        }
+        if (parse(connection)) {
+            continue;
+        }
+        if (connection.requestLength >= requestBufferSize) {
+            connection.keepAlive = false;
+            connection.requestLength = 0;
+            respondError(connection, 431, "request too large");
+            continue;
+        }
+        int count = hal::tcpRead(connection.socket, connection.request + connection.requestLength,
+            requestBufferSize - connection.requestLength);
+        if (count < 0) {
+            close(connection);
+            return;
+        }
+        if (count == 0) {
+            break;
+        }
+        connection.requestLength += static_cast<size_t>(count);
+        connection.lastActivityMs = hal::millis();
+    }
+    hal::tcpWatch(connection.socket, false);
+}
+
+/**
+ * @brief Hands as much of the pending response to TCP as it takes.
+ * @return False if the connection failed.
+ */
+bool HttpServer::send(Connection& connection) {
+    while (connection.sendOffset < connection.sendEnd) {
+        int count = hal::tcpWrite(connection.socket, connection.response + connection.sendOffset,
+            connection.sendEnd - connection.sendOffset);
+        if (count < 0) {
+            return false;
+        }
+        if (count == 0) {
+            return true;
+        }
+        connection.sendOffset += static_cast<size_t>(count);
+        connection.lastActivityMs = hal::millis();
+    }
+    return true;
+}
+
+/**
+ * @brief Parses and dispatches the first request in the buffer, if it is complete.
+ *
+ * The request line is terminated in place, so the strings of the Request
+ * point into the buffer. The request's bytes are dropped once
+ * its response has been produced; pipelined requests behind it stay.
+ *
+ * @return False if no complete request is buffered.
+ */
+bool HttpServer::parse(Connection& connection) {
+    char* data = connection.request;
+    size_t headerEnd = findHeaderEnd(data, connection.requestLength);
+    if (headerEnd == connection.requestLength) {
+        return false;
+    }
+    size_t bodyLength = 0;
+    bool lengthValid = true;
+    bool keepAlive = true;
+    data[headerEnd] = '\0';
+    char* lineEnd = strstr(data, "\r\n");
+    for (char* header = lineEnd != nullptr ? lineEnd + 2 : data + headerEnd; header < data + headerEnd;) {
+        const char* value = headerValue(header, "Content-Length");
+        if (value != nullptr) {
+            lengthValid = parseContentLength(value, requestBufferSize, bodyLength) && lengthValid;
+        } else if ((value = headerValue(header, "Connection")) != nullptr) {
+            keepAlive = strncasecmp(value, "close", 5) != 0;
+        }
+        char* next = strstr(header, "\r\n");
+        header = next != nullptr ? next + 2 : data + headerEnd;
+    }
+    // Without a valid length the end of the request is unknown, so the
+    // connection cannot carry on.
+    if (!lengthValid) {
+        connection.keepAlive = false;
+        connection.requestLength = 0;
+        respondError(connection, 400, "invalid Content-Length");
+        return true;
+    }
+    size_t requestEnd = headerEnd + 4 + bodyLength;
+    if (requestEnd > requestBufferSize) {
+        connection.keepAlive = false;
+        connection.requestLength = 0;
+        respondError(connection, 413, "request too large");
+        return true;
+    }
+    if (requestEnd > connection.requestLength) {
+        data[headerEnd] = '\r'; // Wait for the rest of the body.
+        return false;
+    }
+    if (lineEnd != nullptr) {
+        *lineEnd = '\0';
+    }
+
+    char* line = data;
+    Request request = {Method::Get, "", "", "", data + headerEnd + 4, bodyLength};
+    char* target = strchr(line, ' ');
+    char* version = target != nullptr ? strchr(target + 1, ' ') : nullptr;
+    connection.requestStartUs = static_cast<uint32_t>(hal::micros());
+    if (version == nullptr) {
+        connection.keepAlive = false;
+        respondError(connection, 400, "malformed request line");
+    } else {
+        *target++ = '\0';
+        *version++ = '\0';
+        connection.keepAlive = keepAlive && strcmp(version, "HTTP/1.0") != 0;
+        char* query = strchr(target, '?');
+        if (query != nullptr) {
+            *query++ = '\0';
+            request.query = query;
+        }
+        request.path = target;
+        if (strcmp(line, "GET") == 0) {
+            dispatch(connection, request);
+        } else if (strcmp(line, "POST") == 0) {
+            request.method = Method::Post;
+            dispatch(connection, request);
+        } else {
+            respondError(connection, 405, "method not allowed");
+        }
+    }
+    connection.requestLength -= requestEnd;
+    memmove(connection.request, connection.request + requestEnd, connection.requestLength);
+    return true;
+}
+
+/**
+ * @brief Runs the route matching the request and queues its response.
+ */
+void HttpServer::dispatch(Connection& connection, Request& request) {
+    bool pathMatched = false;
+    for (uint8_t i = 0; i < routeCount; i++) {
+        const Route& route = routes[i];
+        size_t length = strlen(route.path);
+        bool matches;
+        if (length > 0 && route.path[length - 1] == '*') {
+            matches = strncmp(request.path, route.path, length - 1) == 0;
+            request.wildcard = matches ? request.path + length - 1 : "";
+        } else {
+            matches = strcmp(request.path, route.path) == 0;
+            request.wildcard = "";
+        }
+        if (!matches) {
+            continue;
+        }
+        pathMatched = true;
+        if (route.method != request.method) {
+            continue;
+        }
+        memset(connection.streamState, 0, sizeof(connection.streamState));
+        Response response(connection.response + headerReserve, responseBufferSize - headerReserve,
+            connection.streamState);
+        route.handler(request, response, route.context);
+        if (response.streamFunction != nullptr) {
+            connection.stream = response.streamFunction;
+            connection.streamContext = response.streamContext;
+            connection.streamWriter = JsonWriter();
+            respond(connection, response.status, 0, true);
+            nextChunk(connection, headerReserve);
+        } else if (response.writer.overflowed()) {
+            LOG_ERROR("HTTP response to %s too large.", request.path);
+            respondError(connection, 500, "response too large");
+        } else {
+            respond(connection, response.status, response.writer.length(), false);
+        }
+        return;
+    }
+    if (pathMatched) {
+        respondError(connection, 405, "method not allowed");
+    } else {
+        respondError(connection, 404, "not found");
+    }
+}
+
+/**
+ * @brief Puts the status line and headers in front of a body already in the response buffer.
+ * @param bodyLength Bytes of body at headerReserve; ignored for a chunked body.
+ */
+void HttpServer::respond(Connection& connection, uint16_t status, size_t bodyLength, bool chunked) {
+    char header[headerReserve];
+    int length;
+    if (chunked) {
+        length = snprintf(header, sizeof(header),
+            "HTTP/1.1 %u %s\r\nContent-Type: application/json\r\nCache-Control: no-store\r\n"
+            "Transfer-Encoding: chunked\r\nConnection: %s\r\n\r\n",
+            status, reasonPhrase(status), connection.keepAlive ? "keep-alive" : "close");
+    } else {
+        length = snprintf(header, sizeof(header),
+            "HTTP/1.1 %u %s\r\nContent-Type: application/json\r\nCache-Control: no-store\r\n"
+            "Content-Length: %u\r\nConnection: %s\r\n\r\n",
+            status, reasonPhrase(status), static_cast<unsigned>(bodyLength),
+            connection.keepAlive ? "keep-alive" : "close");
+    }
+    memcpy(connection.response + headerReserve - length, header, static_cast<size_t>(length));
+    connection.sendOffset = headerReserve - static_cast<size_t>(length);
+    connection.sendEnd = headerReserve + (chunked ? 0 : bodyLength);
+    if (status >= 400) {
+        errorCount++;
+    }
+}
+
+/**
+ * @brief Answers with {"error": message}.
+ */
+void HttpServer::respondError(Connection& connection, uint16_t status, const char* message) {
+    JsonWriter writer(connection.response + headerReserve, responseBufferSize - headerReserve);
+    writer.beginObject().key("error").string(message).endObject();
+    connection.stream = nullptr;
+    respond(connection, status, writer.length(), false);
+}
+
+/**
+ * @brief Lets the stream function fill the next chunk, framed in place at offset.
+ *
+ * The chunk data is written after room for its size line; the last chunk is
+ * followed by the terminating empty chunk in the same buffer. A stream
+ * function that writes nothing without finishing ends the body, so a faulty
+ * stream cannot spin.
+ */
+void HttpServer::nextChunk(Connection& connection, size_t offset) {
+    static const char hex[] = "0123456789abcdef";
+    char* chunk = connection.response + offset;
+    size_t capacity = responseBufferSize - offset - chunkPrefixSize - chunkSuffixSize - lastChunkSize;
+    connection.streamWriter.rebind(chunk + chunkPrefixSize, capacity);
+    bool done = connection.stream(connection.streamWriter, connection.streamState, connection.streamContext);
+    size_t length = connection.streamWriter.length();
+    if (length == 0 && !done) {
+        LOG_ERROR("HTTP stream wrote nothing.");
+        done = true;
+    }
+    size_t end = offset;
+    if (length > 0) {
+        chunk[0] = hex[length >> 8 & 15];
+        chunk[1] = hex[length >> 4 & 15];
+        chunk[2] = hex[length & 15];
+        chunk[3] = '\r';
+        chunk[4] = '\n';
+        end += chunkPrefixSize + length;
+        memcpy(connection.response + end, "\r\n", chunkSuffixSize);
+        end += chunkSuffixSize;
+    }
+    if (done) {
+        memcpy(connection.response + end, "0\r\n\r\n", lastChunkSize);
+        end += lastChunkSize;
+        connection.stream = nullptr;
+    }
+    if (offset == 0) {
+        connection.sendOffset = 0;
+    }
+    connection.sendEnd = end;
+}
+
+/**
+ * @brief Counts a response whose last byte was handed to TCP.
+ */
+void HttpServer::finishRequest(Connection& connection) {
+    uint32_t latencyUs = static_cast<uint32_t>(hal::micros()) - connection.requestStartUs;
+    maxLatencyUs = latencyUs > maxLatencyUs ? latencyUs : maxLatencyUs;
+    requestCount++;
+    connection.sendOffset = 0;
+    connection.sendEnd = 0;
+}
+
+/**
+ * @brief Closes a connection and frees its slot, so the listener is watched again.
+ */
+void HttpServer::close(Connection& connection) {
+    hal::tcpClose(connection.socket);
+    connection.socket = hal::invalidSocket;
+    connection.stream = nullptr;
+    if (listener != hal::invalidSocket) {
+        hal::tcpWatch(listener, false);
+    }
+}
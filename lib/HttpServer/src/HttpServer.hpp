@@ -0,0 +1,240 @@
+/**
+ * @file HttpServer.hpp
+ * @brief Non-blocking HTTP/1.1 server for a JSON API, driven by the scheduler.
+ */
+
+#ifndef HttpServer_hpp
+#define HttpServer_hpp
+
+#include <stdint.h>
+#include <stddef.h>
+#include "HAL.hpp"
+#include "JsonWriter.hpp"
+#include "Scheduler.hpp"
+
+/**
+ * @class HttpServer
+ * @brief Serves JSON routes to a few keep-alive clients without blocking or allocating.
+ *
+ * The sockets are non-blocking and watched by the HAL, which posts a
+ * scheduler event when any of them is ready; the event handler then reads,
+ * dispatches and writes whatever each connection allows and returns. A slow
+ * client therefore never stalls the task, and a request costs no wakeups
+ * beyond its own.
+ *
+ * Each connection owns a request buffer and a response buffer. A route
+ * handler writes its JSON body straight into the response buffer, behind
+ * room left for the status line and headers, which are then put in front of
+ * it: the body is never copied. Bodies too large for the buffer are streamed
+ * as chunked transfer encoding: a stream function fills the buffer with the
+ * next chunk each time the previous one has been handed to TCP, so a
+ * response of any length needs one buffer of RAM.
+ *
+ * Requests may be pipelined. Only GET and POST are understood, bodies must
+ * fit the request buffer and query parameters are not percent-decoded.
+ * There is no authentication: the API is meant for the local network.
+ */
+class HttpServer {
+public:
+    static constexpr uint8_t maxConnections = 4;
+    static constexpr uint8_t maxRoutes = 12;
+    static constexpr size_t requestBufferSize = 768; // Request line, headers and body
+    static constexpr size_t responseBufferSize = 1460; // One TCP segment on Ethernet MTU
+    static constexpr size_t headerReserve = 160; // Room for the status line and headers
+    static constexpr size_t streamStateSize = 32; // Scratch bytes of a streamed response
+    static constexpr uint32_t idleTimeoutMs = 15000; // Keep-alive connections close after this
+    static constexpr uint8_t invalidId = 0xFF;
+
+    /**
+     * @enum Method
+     * @brief Request methods a route can match.
+     */
+    enum class Method : uint8_t {
+        Get,
+        Post
+    };
+
+    /**
+     * @struct Request
+     * @brief A parsed request. Its strings live in the connection's buffer until the handler returns.
+     */
+    struct Request {
+        Method method;
+        const char* path; // Without the query string
+        const char* query; // After '?', empty if none
+        const char* wildcard; // Part of the path matched by a route's trailing '*', empty if none
+        const char* body; // Not terminated
+        size_t bodyLength;
+
+        /**
+         * @brief Finds a query parameter.
+         * @param[out] length Length of the value, which is not terminated.
+         * @return Start of the value, or nullptr if the parameter is absent.
+         */
+        const char* param(const char* name, size_t& length) const;
+
+        /**
+         * @brief Reads a query parameter as a decimal integer.
+         * @return False if the parameter is absent or not a number; value is then unchanged.
+         */
+        bool intParam(const char* name, int64_t& value) const;
+    };
+
+    /**
+     * @brief Fills the next chunk of a streamed body.
+     *
+     * Called with a writer bound to the free part of the response buffer,
+     * which continues the same document from chunk to chunk.
+     *
+     * @param state streamStateSize bytes kept across calls, zeroed before the first unless the route handler set them.
+     * @return True when the body is complete.
+     */
+    typedef bool (*StreamFunction)(JsonWriter& writer, uint8_t* state, void* context);
+
+    /**
+     * @class Response
+     * @brief What a route handler answers: a status and a JSON body or a body stream.
+     */
+    class Response {
+    public:
+        /**
+         * @brief Sets the status code; 200 unless changed.
+         */
+        void setStatus(uint16_t status);
+
+        /**
+         * @brief Writer of the body. An overflowed body is answered with 500.
+         */
+        JsonWriter& json();
+
+        /**
+         * @brief Streams the body in chunks instead; anything written to json() is discarded.
+         */
+        void stream(StreamFunction function, void* context);
+
+        /**
+         * @brief Scratch bytes passed to the stream function, to set up where it starts.
+         */
+        uint8_t* streamState();
+
+    private:
+        friend class HttpServer;
+        Response(char* body, size_t capacity, uint8_t* state);
+
+        uint16_t status;
+        JsonWriter writer;
+        StreamFunction streamFunction;
+        void* streamContext;
+        uint8_t* state;
+    };
+
+    /**
+     * @brief Signature of route handlers.
+     */
+    typedef void (*RouteHandler)(const Request& request, Response& response, void* context);
+
+    /**
+     * @brief Constructs a stopped server with no routes.
+     */
+    HttpServer();
+
+    /**
+     * @brief Adds a route. Must be called before begin().
+     * @param path Exact path, or a prefix ending in '*' that matches any rest of the path.
+     * @return Route identifier, or invalidId if the table is full.
+     */
+    uint8_t addRoute(Method method, const char* path, RouteHandler handler, void* context);
+
+    /**
+     * @brief Starts listening. May be called again after end().
+     * @return False if the port could not be bound.
+     */
+    bool begin(Scheduler& scheduler, uint16_t port);
+
+    /**
+     * @brief Closes the listener and every connection.
+     */
+    void end();
+
+    /**
+     * @brief True between a successful begin() and end().
+     */
+    bool isRunning() const;
+
+    /**
+     * @brief Requests answered since construction.
+     */
+    uint32_t getRequestCount() const;
+
+    /**
+     * @brief Requests answered with a 4xx or 5xx status.
+     */
+    uint32_t getErrorCount() const;
+
+    /**
+     * @brief Longest time from a complete request to its last byte handed to TCP.
+     */
+    uint32_t getMaxLatencyUs() const;
+
+    /**
+     * @brief Open client connections.
+     */
+    uint8_t getConnectionCount() const;
+
+private:
+    /**
+     * @brief A route table entry.
+     */
+    struct Route {
+        Method method;
+        const char* path;
+        RouteHandler handler;
+        void* context;
+    };
+
+    /**
+     * @brief State of one client connection.
+     */
+    struct Connection {
+        int socket; // hal::invalidSocket when the slot is free
+        char request[requestBufferSize + 1]; // Received bytes, terminated while parsing
+        size_t requestLength; // Bytes in request
+        char response[responseBufferSize]; // Response being sent
+        size_t sendOffset; // First byte of response not yet sent
+        size_t sendEnd; // End of the bytes to send
+        bool keepAlive; // Read the next request once the response is sent
+        StreamFunction stream; // Producing a chunked body, or nullptr
+        void* streamContext;
+        uint8_t streamState[streamStateSize];
+        JsonWriter streamWriter; // Document state across chunks
+        uint32_t requestStartUs; // When the request was complete
+        uint32_t lastActivityMs; // Last byte received or sent
+    };
+
+    static void onSocketReady(void* context); // From the HAL, possibly in another task
+    static void onReadyEvent(void* context); // Services the sockets
+    static void onIdleTimer(void* context); // Closes idle connections
+    void accept();
+    void service(Connection& connection); // Sends, reads and dispatches as far as possible
+    bool send(Connection& connection); // False if the connection failed
+    bool parse(Connection& connection); // Dispatches a complete request; false if there is none yet
+    void dispatch(Connection& connection, Request& request);
+    void respond(Connection& connection, uint16_t status, size_t bodyLength, bool chunked);
+    void respondError(Connection& connection, uint16_t status, const char* message);
+    void nextChunk(Connection& connection, size_t offset); // Lets the stream fill a chunk
+    void close(Connection& connection);
+    void finishRequest(Connection& connection);
+
+    Route routes[maxRoutes];
+    uint8_t routeCount;
+    Connection connections[maxConnections];
+    Scheduler* scheduler;
+    uint8_t readyEvent;
+    uint8_t idleTimer;
+    int listener; // hal::invalidSocket when stopped
+    uint32_t requestCount;
+    uint32_t errorCount;
+    uint32_t maxLatencyUs;
+};
+
+#endif /* HttpServer_hpp */
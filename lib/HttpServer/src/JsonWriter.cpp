@@ -0,0 +1,232 @@
+/**
+ * @file JsonWriter.cpp
+ * @brief Implementation of the fixed-buffer JSON serializer.
+ */
+
+#include "JsonWriter.hpp"
+#include <string.h>
+
+/**
+ * @brief Starts an empty document without a buffer; rebind() before writing.
+ */
+JsonWriter::JsonWriter() : JsonWriter(nullptr, 0) {}
+
+/**
+ * @brief Starts an empty document in a buffer.
+ */
+JsonWriter::JsonWriter(char* buffer, size_t capacity)
+    : buffer(buffer), capacity(capacity), used(0), depth(0), hasElements(0), afterKey(false), overflow(false) {}
+
+/**
+ * @brief Continues the same document in another buffer, starting it empty.
+ */
+void JsonWriter::rebind(char* buffer, size_t capacity) {
+    this->buffer = buffer;
+    this->capacity = capacity;
+    used = 0;
+    overflow = false;
+}
+
+JsonWriter& JsonWriter::beginObject() {
+    open('{');
+    return *this;
+}
+
+JsonWriter& JsonWriter::endObject() {
+    close('}');
+    return *this;
+}
+
+JsonWriter& JsonWriter::beginArray() {
+    open('[');
+    return *this;
+}
+
+JsonWriter& JsonWriter::endArray() {
+    close(']');
+    return *this;
+}
+
+/**
+ * @brief Writes a member name. The next token is its value.
+ */
+JsonWriter& JsonWriter::key(const char* name) {
+    string(name);
+    put(':');
+    afterKey = true;
+    return *this;
+}
+
+/**
+ * @brief Writes an escaped string.
+ */
+JsonWriter& JsonWriter::string(const char* text) {
+    return string(text, strlen(text));
+}
+
+/**
+ * @brief Writes an escaped string of a given length, which need not be terminated.
+ *
+ * Quotes, backslashes and control characters are escaped; other bytes,
+ * including UTF-8 sequences, are copied.
+ */
+JsonWriter& JsonWriter::string(const char* text, size_t length) {
+    static const char hex[] = "0123456789abcdef";
+    beforeValue();
+    put('"');
+    for (size_t i = 0; i < length; i++) {
+        uint8_t c = static_cast<uint8_t>(text[i]);
+        if (c == '"' || c == '\\') {
+            put('\\');
+            put(static_cast<char>(c));
+        } else if (c < 0x20) {
+            char escape[6] = {'\\', 'u', '0', '0', hex[c >> 4], hex[c & 15]};
+            put(escape, sizeof(escape));
+        } else {
+            put(static_cast<char>(c));
+        }
+    }
+    put('"');
+    return *this;
+}
+
+JsonWriter& JsonWriter::number(int64_t value) {
+    beforeValue();
+    if (value < 0) {
+        put('-');
+        putUnsigned(0 - static_cast<uint64_t>(value));
+    } else {
+        putUnsigned(static_cast<uint64_t>(value));
+    }
+    return *this;
+}
+
+JsonWriter& JsonWriter::boolean(bool value) {
+    beforeValue();
+    put(value ? "true" : "false", value ? 4 : 5);
+    return *this;
+}
+
+JsonWriter& JsonWriter::null() {
+    beforeValue();
+    put("null", 4);
+    return *this;
+}
+
+/**
+ * @brief Writes a fixed-point number: fixed(6012, 3) writes 6.012.
+ */
+JsonWriter& JsonWriter::fixed(int32_t value, uint8_t decimals) {
+    beforeValue();
+    uint32_t magnitude = value < 0 ? 0 - static_cast<uint32_t>(value) : static_cast<uint32_t>(value);
+    uint32_t scale = 1;
+    for (uint8_t i = 0; i < decimals; i++) {
+        scale *= 10;
+    }
+    if (value < 0) {
+        put('-');
+    }
+    putUnsigned(magnitude / scale);
+    if (decimals > 0) {
+        put('.');
+        uint32_t fraction = magnitude % scale;
+        for (scale /= 10; scale > 0; scale /= 10) {
+            put(static_cast<char>('0' + fraction / scale % 10));
+        }
+    }
+    return *this;
+}
+
+/**
+ * @brief Start of the buffer.
+ */
+const char* JsonWriter::data() const {
+    return buffer;
+}
+
+/**
+ * @brief Bytes written to the buffer.
+ */
+size_t JsonWriter::length() const {
+    return used;
+}
+
+/**
+ * @brief Bytes left in the buffer.
+ */
+size_t JsonWriter::remaining() const {
+    return capacity - used;
+}
+
+/**
+ * @brief True if a token did not fit; the document is then cut short.
+ */
+bool JsonWriter::overflowed() const {
+    return overflow;
+}
+
+/**
+ * @brief Writes the comma in front of every element of a container but the first.
+ */
+void JsonWriter::beforeValue() {
+    if (afterKey) {
+        afterKey = false;
+        return;
+    }
+    if (depth > 0) {
+        uint16_t bit = static_cast<uint16_t>(1u << (depth - 1));
+        if (hasElements & bit) {
+            put(',');
+        }
+        hasElements |= bit;
+    }
+}
+
+void JsonWriter::open(char bracket) {
+    beforeValue();
+    put(bracket);
+    if (depth < maxDepth) {
+        depth++;
+        hasElements &= static_cast<uint16_t>(~(1u << (depth - 1)));
+    } else {
+        overflow = true;
+    }
+}
+
+void JsonWriter::close(char bracket) {
+    put(bracket);
+    if (depth > 0) {
+        depth--;
+    }
+}
+
+void JsonWriter::put(char c) {
+    if (overflow || used >= capacity) {
+        overflow = true;
+        return;
+    }
+    buffer[used++] = c;
+}
+
+void JsonWriter::put(const char* text, size_t length) {
+    if (overflow || length > capacity - used) {
+        overflow = true;
+        return;
+    }
+    memcpy(buffer + used, text, length);
+    used += length;
+}
+
+void JsonWriter::putUnsigned(uint64_t value) {
+    char digits[20];
+    size_t count = 0;
+    do {
+        digits[count++] = static_cast<char>('0' + value % 10);
+        value /= 10;
+    } while (value > 0);
+    char text[20];
+    for (size_t i = 0; i < count; i++) {
+        text[i] = digits[count - 1 - i];
+    }
+    put(text, count);
+}
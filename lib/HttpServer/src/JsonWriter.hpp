@@ -0,0 +1,108 @@
+/**
+ * @file JsonWriter.hpp
+ * @brief JSON serializer writing into a caller-provided fixed buffer.
+ */
+
+#ifndef JsonWriter_hpp
+#define JsonWriter_hpp
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * @class JsonWriter
+ * @brief Appends JSON tokens to a buffer, inserting commas and colons itself.
+ *
+ * Nothing is allocated: the writer only tracks the nesting depth and whether
+ * each open container already has an element. When a token does not fit the
+ * writer stops writing and reports overflowed(); check remaining() before a
+ * token to avoid that. rebind() moves the writer to a new buffer in the middle
+ * of a document, so a large document can be produced in pieces, each sent
+ * before the next is written into the same memory.
+ */
+class JsonWriter {
+public:
+    static constexpr uint8_t maxDepth = 16; // Nested objects and arrays
+
+    /**
+     * @brief Starts an empty document without a buffer; rebind() before writing.
+     */
+    JsonWriter();
+
+    /**
+     * @brief Starts an empty document in a buffer.
+     */
+    JsonWriter(char* buffer, size_t capacity);
+
+    /**
+     * @brief Continues the same document in another buffer, starting it empty.
+     */
+    void rebind(char* buffer, size_t capacity);
+
+    JsonWriter& beginObject();
+    JsonWriter& endObject();
+    JsonWriter& beginArray();
+    JsonWriter& endArray();
+
+    /**
+     * @brief Writes a member name. The next token is its value.
+     */
+    JsonWriter& key(const char* name);
+
+    /**
+     * @brief Writes an escaped string.
+     */
+    JsonWriter& string(const char* text);
+
+    /**
+     * @brief Writes an escaped string of a given length, which need not be terminated.
+     */
+    JsonWriter& string(const char* text, size_t length);
+
+    JsonWriter& number(int64_t value);
+    JsonWriter& boolean(bool value);
+    JsonWriter& null();
+
+    /**
+     * @brief Writes a fixed-point number: fixed(6012, 3) writes 6.012.
+     */
+    JsonWriter& fixed(int32_t value, uint8_t decimals);
+
+    /**
+     * @brief Start of the buffer.
+     */
+    const char* data() const;
+
+    /**
+     * @brief Bytes written to the buffer.
+     */
+    size_t length() const;
+
+    /**
+     * @brief Bytes left in the buffer.
+     */
+    size_t remaining() const;
+
+    /**
+     * @brief True if a token did not fit; the document is then cut short.
+     */
+    bool overflowed() const;
+
+private:
+    void beforeValue(); // Comma between elements
+    void open(char bracket);
+    void close(char bracket);
+    void put(char c);
+    void put(const char* text, size_t length);
+    void putUnsigned(uint64_t value);
+
+    char* buffer;
+    size_t capacity;
+    size_t used; // Bytes written
+    uint8_t depth; // Open containers
+    uint16_t hasElements; // Bit per depth: the container has an element
+    bool afterKey; // A member name was written, its value is next
+    bool overflow; // A token did not fit
+};
+
+#endif /* JsonWriter_hpp */
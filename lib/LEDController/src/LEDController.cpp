@@ -1,60 +1,48 @@
 // LEDController.cpp
 #include "LEDController.hpp"
-#include "DebugLogger.hpp"
-#include "WiFiManager.hpp"
 
 /**
- * Constructs a LEDController to manage LED diodes and strips.
+ * Sets up the LED strip PWM channels.
  * 
  * @param shiftRegister Pointer to a ShiftRegister object for controlling LEDs via a shift register.
- * @param powerLedDiodePin Pin number for the power LED diode.
- * @param wifiLedDiodePin Pin number for the WiFi LED diode.
- * @param pumpLedDiodePin Pin number for the pump LED diode.
- * @param vegetableLedDiodePin Pin number for the vegetable LED diode.
- * @param flowerLedDiodePin Pin number for the flower LED diode.
+ * @param wifiLedDiodePin Shift register output of the WiFi LED diode, blinked by the blink timer.
  * @param bluePWMPin PWM pin for controlling blue color on the LED strip.
  * @param redPWMPin PWM pin for controlling red color on the LED strip.
  * @param greenPWMPin PWM pin for controlling green color on the LED strip.
  */
-LEDController::LEDController(
-    ShiftRegister* shiftRegister, 
-    uint8_t powerLedDiodePin, 
+LEDControllerBase::LEDControllerBase(
+    ShiftRegisterBase* shiftRegister, 
     uint8_t wifiLedDiodePin, 
-    uint8_t pumpLedDiodePin, 
-    uint8_t vegetableLedDiodePin, 
-    uint8_t flowerLedDiodePin, 
     uint8_t bluePWMPin, 
     uint8_t redPWMPin, 
     uint8_t greenPWMPin): 
         shiftRegister(shiftRegister), 
-        powerLedDiodePin(powerLedDiodePin),
         wifiLedDiodePin(wifiLedDiodePin), 
-        pumpLedDiodePin(pumpLedDiodePin), 
-        vegetableLedDiodePin(vegetableLedDiodePin), 
-        flowerLedDiodePin(flowerLedDiodePin), 
-        bluePWMPin(bluePWMPin), 
-        redPWMPin(redPWMPin), 
-        greenPWMPin(greenPWMPin), 
-        wifiManager(nullptr), 
+        stripFader(1, 2, 0), 
+        pixelStrip(nullptr), 
+        scheduler(nullptr), 
+        blinkTimer(Scheduler::invalidId), 
+        blinkTogglesLeft(0), 
         ledBlinkState(false), 
-        lastBlinkMillis(0), 
-        wifiBlinkCounter(0), 
-        blinkInterval(200){ 
-            ledcSetup(0, 5000, 8);
-            ledcSetup(1, 5000, 8);
-            ledcSetup(2, 5000, 8);
-            ledcAttachPin(bluePWMPin, 0);
-            ledcAttachPin(redPWMPin, 1);
-            ledcAttachPin(greenPWMPin, 2);
+        blinkInterval(200), 
+        wifiBlinkCounter(0){ 
+            hal::ledcSetup(0, 5000, LedStripFader::resolutionBits);
+            hal::ledcSetup(1, 5000, LedStripFader::resolutionBits);
+            hal::ledcSetup(2, 5000, LedStripFader::resolutionBits);
+            hal::ledcAttachPin(bluePWMPin, 0);
+            hal::ledcAttachPin(redPWMPin, 1);
+            hal::ledcAttachPin(greenPWMPin, 2);
 }
 
 /**
- * Sets the WiFiManager to enable LED control based on WiFi connection status.
+ * Sets the scheduler and registers the WiFi LED blink timer with it.
  * 
- * @param manager Reference to a WiFiManager object.
+ * @param scheduler Reference to the Scheduler running the application.
  */
-void LEDController::setWiFiManager(WiFiManager& manager) {
-    wifiManager = &manager;
+void LEDControllerBase::setScheduler(Scheduler& scheduler) {
+    this->scheduler = &scheduler;
+    blinkTimer = scheduler.addTimer(onBlinkTimer, this);
+    stripFader.begin(scheduler);
 }
 
 /**
@@ -62,7 +50,7 @@ void LEDController::setWiFiManager(WiFiManager& manager) {
  * 
  * @param isConnected Indicates whether the WiFi is connected.
  */
-void LEDController::updateWiFiLedDiodeStatus(bool isConnected) {
+void LEDControllerBase::updateWiFiLedDiodeStatus(bool isConnected) {
     if (isConnected) {
         // WiFi is connected
         shiftRegister->setPinState(wifiLedDiodePin, HIGH);
@@ -85,92 +73,135 @@ void LEDController::updateWiFiLedDiodeStatus(bool isConnected) {
 /**
  * Blinks the WiFi LED a specified number of times.
  * 
+ * The blink is driven by a scheduler timer, so nothing has to be polled while
+ * it runs. A call made while a burst is still running has no effect.
+ * 
  * @param count Number of blink cycles.
  */
-void LEDController::blinkWiFiLedDiode(int count) {
-    static unsigned long lastBlinkTime = 0;
-    static bool blinkState = false;
-    static int blinkCounter = 0;
+void LEDControllerBase::blinkWiFiLedDiode(int count) {
+    if (scheduler == nullptr || isWiFiLedDiodeBlinking() || count <= 0) {
+        return;
+    }
+    blinkTogglesLeft = count * 2;
+    scheduler->startTimer(blinkTimer, 0, blinkInterval);
+}
 
-    if (millis() - lastBlinkTime >= blinkInterval) {
-        blinkState = !blinkState;
-        shiftRegister->setPinState(wifiLedDiodePin, blinkState);
-        shiftRegister->write();
-        lastBlinkTime = millis();
+/**
+ * Checks whether a WiFi LED blink burst is in progress.
+ * 
+ * @return True while the blink timer is running.
+ */
+bool LEDControllerBase::isWiFiLedDiodeBlinking() const {
+    return scheduler != nullptr && scheduler->isTimerActive(blinkTimer);
+}
 
-        if (blinkState) {
-            blinkCounter++;
-            if (blinkCounter >= count * 2) {
-                blinkCounter = 0;
-            }
-        }
+/**
+ * Toggles the WiFi LED once and ends the burst after the last toggle.
+ * 
+ * @param context Pointer to the owning LEDController.
+ */
+void LEDControllerBase::onBlinkTimer(void* context) {
+    LEDControllerBase* controller = static_cast<LEDControllerBase*>(context);
+    controller->ledBlinkState = !controller->ledBlinkState;
+    controller->shiftRegister->setPinState(controller->wifiLedDiodePin, controller->ledBlinkState);
+    controller->shiftRegister->write();
+    if (--controller->blinkTogglesLeft <= 0) {
+        controller->stopWiFiLedDiodeBlink();
     }
 }
 
 /**
- * Sets the state of an individual LED diode.
+ * Cancels a running blink burst, leaving the LED as it is.
+ */
+void LEDControllerBase::stopWiFiLedDiodeBlink() {
+    if (scheduler != nullptr) {
+        scheduler->stopTimer(blinkTimer);
+    }
+    blinkTogglesLeft = 0;
+    ledBlinkState = false;
+}
+
+/**
+ * Sets the shift register output of an LED diode.
  * 
- * @param ledDiode The LED diode to modify.
+ * @param pin Output of the diode, from the pin map.
+ * @param isWiFi The diode is the WiFi LED, whose blink burst is cancelled.
  * @param ledDiodeState The desired state (true for on, false for off).
  */
-void LEDController::setLedDiodeState(DiodeType ledDiode, bool ledDiodeState) {
-    uint8_t pin = getLedDiodePin(ledDiode);
+void LEDControllerBase::setDiodeOutput(uint8_t pin, bool isWiFi, bool ledDiodeState) {
+    if (isWiFi) {
+        stopWiFiLedDiodeBlink();
+    }
     shiftRegister->setPinState(pin, ledDiodeState);
     shiftRegister->write();
 }
 
 /**
- * Toggles the state of an individual LED diode.
+ * Toggles the shift register output of an LED diode.
  * 
- * @param ledDiode The LED diode to toggle.
+ * @param pin Output of the diode, from the pin map.
  */
-void LEDController::toggleLedDiodeState(DiodeType ledDiode) {
-    uint8_t pin = getLedDiodePin(ledDiode);
+void LEDControllerBase::toggleDiodeOutput(uint8_t pin) {
     bool currentLedDiodeState = shiftRegister->getPinState(pin);
     shiftRegister->setPinState(pin, !currentLedDiodeState);
     shiftRegister->write();
 }
 
 /**
- * Sets the LED strip mode (color or off) based on the input mode.
+ * Fades the LED strip to the colour of a mode.
  * 
- * @param ledStripMode Mode to set for the LED strip.
+ * @param ledStripMode Mode to set for the LED strip (0 blue, 1 red, 2 off).
  */
-void LEDController::setLedStripMode(uint8_t ledStripMode) {
+void LEDControllerBase::setLedStripMode(uint8_t ledStripMode) {
     switch (ledStripMode) {
         case 0:
-            ledcWrite(0, 255);
-            ledcWrite(1, 0);
-            ledcWrite(2, 0);
+            fadeLedStripTo({0, 0, 255}, stripFadeDuration);
             break;
         case 1:
-            ledcWrite(0, 0);
-            ledcWrite(1, 255);
-            ledcWrite(2, 0);
+            fadeLedStripTo({255, 0, 0}, stripFadeDuration);
             break;
         case 2:
-            ledcWrite(0, 0);
-            ledcWrite(1, 0);
-            ledcWrite(2, 0);
+            fadeLedStripTo({0, 0, 0}, stripFadeDuration);
             break;
     }
 }
 
 /**
- * Retrieves the pin number associated with a given LED diode type.
+ * Fades the LED strip to any colour, taking over from a fade in progress.
  * 
- * @param diode The diode type for which to get the pin number.
- * @return The pin number associated with the specified diode type.
+ * @param color Target colour as perceived lightness per channel.
+ * @param durationMs Fade length; 0 switches at once.
  */
-uint8_t LEDController::getLedDiodePin(DiodeType ledDiodePin) const {
-    switch(ledDiodePin) {
-        case DiodeType::Power: return powerLedDiodePin;
-        case DiodeType::WiFi: return wifiLedDiodePin;
-        case DiodeType::Pump: return pumpLedDiodePin;
-        case DiodeType::Vegetable: return vegetableLedDiodePin;
-        case DiodeType::Flower: return flowerLedDiodePin;
-        default: 
-            DebugLogger::error("Unknown diode type.");
-            return 255; // Invalid pin number
+void LEDControllerBase::fadeLedStripTo(const LedStripFader::Color& color, uint32_t durationMs) {
+    stripFader.fadeTo(color, durationMs);
+    if (pixelStrip != nullptr) {
+        pixelStrip->fadeTo(color, color, durationMs);
     }
-}
\ No newline at end of file
+}
+
+/**
+ * Fades the LED strip to a gradient, taking over from a fade in progress.
+ * 
+ * The pixel strip shows the gradient from its first to its last pixel. The
+ * PWM strip has one colour for all its LEDs and fades to the midpoint.
+ * 
+ * @param start Colour of the first pixel.
+ * @param end Colour of the last pixel.
+ * @param durationMs Fade length; 0 switches at once.
+ */
+void LEDControllerBase::fadeLedStripGradientTo(const LedStripFader::Color& start, const LedStripFader::Color& end,
+    uint32_t durationMs) {
+    stripFader.fadeTo(PixelRenderer::blend(start, end, 32768), durationMs);
+    if (pixelStrip != nullptr) {
+        pixelStrip->fadeTo(start, end, durationMs);
+    }
+}
+
+/**
+ * Attaches an addressable strip that follows the strip fades.
+ * 
+ * @param pixelStrip Strip started with begin(), or nullptr to detach it.
+ */
+void LEDControllerBase::setPixelStrip(PixelStripBase* pixelStrip) {
+    this->pixelStrip = pixelStrip;
+}
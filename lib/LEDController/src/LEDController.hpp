@@ -1,36 +1,24 @@
 #ifndef LED_CONTROLLER_HPP
 #define LED_CONTROLLER_HPP
 
-#include <Arduino.h>
-#include "WiFiManager.hpp"
+#include "HAL.hpp"
 #include "ShiftRegister.hpp"
+#include "Scheduler.hpp"
 #include "DiodeTypes.hpp"
+#include "PinMap.hpp"
+#include "LedStripFader.hpp"
+#include "PixelStrip.hpp"
 
 /**
- * LEDController manages the LED diodes and LED strip, including their colors and states.
+ * Pin independent part of the LED controller: the shift register, the WiFi
+ * LED blink timer and the LED strip.
  */
-class LEDController {
+class LEDControllerBase {
 public:
     /**
-     * Constructor for LEDController.
-     * Initializes with specific pins and components.
-     */
-    LEDController(
-        ShiftRegister* shiftRegister, 
-        uint8_t powerLedDiodePin, 
-        uint8_t wifiLedDiodePin, 
-        uint8_t pumpLedDiodePin, 
-        uint8_t vegetableLedDiodePin, 
-        uint8_t flowerLedDiodePin, 
-        uint8_t bluePWMPin, 
-        uint8_t redPWMPin, 
-        uint8_t greenPWMPin
-    );
-
-    /**
-     * Associates a WiFiManager to enable LED feedback based on WiFi state.
+     * Associates the scheduler that runs the WiFi LED blink timer.
      */
-    void setWiFiManager(WiFiManager& manager);
+    void setScheduler(Scheduler& scheduler);
 
     /**
      * Updates the LED indicator for WiFi connectivity.
@@ -38,49 +26,130 @@ public:
     void updateWiFiLedDiodeStatus(bool isConnected);
 
     /**
-     * Triggers a blinking effect on the WiFi LED.
+     * Starts a burst of blinks on the WiFi LED unless one is already running.
      */
     void blinkWiFiLedDiode(int count = 1);
 
+    /**
+     * Checks whether a WiFi LED blink burst is in progress.
+     */
+    bool isWiFiLedDiodeBlinking() const;
+
+    /**
+     * Fades the LED strip to the colour of a mode (0 blue, 1 red, 2 off).
+     */
+    void setLedStripMode(uint8_t ledStripMode);
+
+    /**
+     * Fades the LED strip to any colour, taking over from a fade in progress.
+     */
+    void fadeLedStripTo(const LedStripFader::Color& color, uint32_t durationMs);
+
+    /**
+     * Fades the LED strip to a gradient. The pixel strip shows the gradient;
+     * the PWM strip, having one colour, fades to its midpoint.
+     */
+    void fadeLedStripGradientTo(const LedStripFader::Color& start, const LedStripFader::Color& end, uint32_t durationMs);
+
+    /**
+     * Attaches an addressable strip that follows the strip fades, or nullptr to detach it.
+     */
+    void setPixelStrip(PixelStripBase* pixelStrip);
+
+    LEDControllerBase(const LEDControllerBase&) = delete;
+    LEDControllerBase& operator=(const LEDControllerBase&) = delete;
+
+protected:
+    /**
+     * Sets up the strip PWM channels. The pins come from the derived class's pin map.
+     */
+    LEDControllerBase(ShiftRegisterBase* shiftRegister, uint8_t wifiLedDiodePin, uint8_t bluePWMPin,
+        uint8_t redPWMPin, uint8_t greenPWMPin);
+
+    /**
+     * Sets a shift register output of a diode.
+     */
+    void setDiodeOutput(uint8_t pin, bool isWiFi, bool ledDiodeState);
+
+    /**
+     * Toggles a shift register output of a diode.
+     */
+    void toggleDiodeOutput(uint8_t pin);
+
+    ShiftRegisterBase* shiftRegister; // Manages shift register for LED control
+
+private:
+    const uint8_t wifiLedDiodePin; // Output blinked by the blink timer
+    LedStripFader stripFader; // Fades the LED strip channels
+    PixelStripBase* pixelStrip; // Addressable strip following the fades, nullptr if none
+    Scheduler* scheduler; // Scheduler running the blink timer
+    uint8_t blinkTimer; // Timer toggling the WiFi LED during a blink burst
+    int blinkTogglesLeft; // Remaining WiFi LED toggles in the current burst
+    bool ledBlinkState; // Current state of LED blinking (on/off)
+    const unsigned long blinkInterval = 500; // Interval between blinks
+    int wifiBlinkCounter; // Counter for blinking WiFi LED
+    static constexpr uint32_t stripFadeDuration = 2000; // Fade time between strip modes (ms)
+    void stopWiFiLedDiodeBlink(); // Cancels a running blink burst
+    static void onBlinkTimer(void* context); // Blink timer handler
+};
+
+/**
+ * LEDController manages the LED diodes and LED strip, including their colors and states.
+ *
+ * The wiring is a PinMap type, so resolving a diode to its shift register
+ * output is a constant and a bad map fails to compile.
+ *
+ * @tparam Pins PinMap describing where the diodes and strip channels are wired.
+ */
+template<typename Pins>
+class LEDController : public LEDControllerBase {
+public:
+    /**
+     * Constructor for LEDController.
+     * Initializes the strip PWM channels on the mapped pins.
+     */
+    explicit LEDController(ShiftRegisterBase* shiftRegister)
+        : LEDControllerBase(shiftRegister, Pins::diodePin(DiodeType::WiFi), Pins::bluePin, Pins::redPin, Pins::greenPin) {}
+
     /**
      * Sets the specified LED diode to the desired state (on/off).
      */
-    void setLedDiodeState(DiodeType ledDiode, bool ledDiodeState);
+    void setLedDiodeState(DiodeType ledDiode, bool ledDiodeState) {
+        setDiodeOutput(Pins::diodePin(ledDiode), ledDiode == DiodeType::WiFi, ledDiodeState);
+    }
 
     /**
      * Toggles the state of a specified LED diode.
      */
-    void toggleLedDiodeState(DiodeType ledDiode);
+    void toggleLedDiodeState(DiodeType ledDiode) {
+        toggleDiodeOutput(Pins::diodePin(ledDiode));
+    }
 
     /**
-     * Configures the LED strip color or turns it off based on the mode.
+     * Sets the state of multiple LEDs in one shift register transaction,
+     * so the outputs change once and show no intermediate state.
      */
-    void setLedStripMode(uint8_t ledStripMode);
-
+    template<typename... Args>
+    void tuneMultipleLedAttributes(Args... attributes) {
+        shiftRegister->beginTransaction();
+        applyLedAttributes(attributes...);
+        shiftRegister->commit();
+    }
+    
+private:
     /**
      * Recursively sets the state of multiple LEDs.
      */
     template<typename... Args>
-    void tuneMultipleLedAttributes(DiodeType ledDiode, bool ledDiodeState, Args... rest) {
+    void applyLedAttributes(DiodeType ledDiode, bool ledDiodeState, Args... rest) {
         setLedDiodeState(ledDiode, ledDiodeState);
-        tuneMultipleLedAttributes(rest...);
+        applyLedAttributes(rest...);
     }
 
     /**
      * Terminates the recursion for setting multiple LED states.
      */
-    void tuneMultipleLedAttributes() {}
-    
-private:
-    ShiftRegister* shiftRegister; // Manages shift register for LED control
-    uint8_t powerLedDiodePin, wifiLedDiodePin, pumpLedDiodePin, vegetableLedDiodePin, flowerLedDiodePin; // Pin numbers for each LED diode
-    uint8_t bluePWMPin, redPWMPin, greenPWMPin; // PWM pins for LED strip colors
-    WiFiManager* wifiManager; // Pointer to the WiFiManager for network status
-    bool ledBlinkState; // Current state of LED blinking (on/off)
-    unsigned long lastBlinkMillis; // Timestamp of the last LED blink
-    const unsigned long blinkInterval = 500; // Interval between blinks
-    int wifiBlinkCounter; // Counter for blinking WiFi LED
-    uint8_t getLedDiodePin(DiodeType diode) const; // Returns the pin number for a given diode type
+    void applyLedAttributes() {}
 };
 
 #endif // LED_CONTROLLER_HPP
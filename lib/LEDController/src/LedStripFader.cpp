@@ -0,0 +1,107 @@
+/**
+ * @file LedStripFader.cpp
+ * @brief Implementation of the LED strip fade engine.
+ */
+
+#include "LedStripFader.hpp"
+#include "LightnessTable.hpp"
+
+namespace {
+
+constexpr LightnessTable<LedStripFader::resolutionBits> lightnessTable;
+
+static_assert(lightnessTable[0] == 0, "black must be off");
+static_assert(lightnessTable[255] == LightnessTable<LedStripFader::resolutionBits>::maxDuty, "white must be full duty");
+static_assert(lightnessTable[128] < lightnessTable.maxDuty / 4, "mid lightness is under a quarter of full duty");
+
+} // namespace
+
+/**
+ * @brief Constructs a fader for three configured LEDC channels.
+ */
+LedStripFader::LedStripFader(uint8_t redChannel, uint8_t greenChannel, uint8_t blueChannel)
+    : channels{redChannel, greenChannel, blueChannel}, startLightness(), targetLightness(), scheduler(nullptr),
+      segmentTimer(Scheduler::invalidId), segment(0), segmentCount(0), segmentMs(0), fading(false) {}
+
+/**
+ * @brief Registers the segment timer with the scheduler.
+ */
+void LedStripFader::begin(Scheduler& scheduler) {
+    this->scheduler = &scheduler;
+    segmentTimer = scheduler.addTimer(onSegmentTimer, this);
+}
+
+/**
+ * @brief Fades from the current output to a colour.
+ *
+ * The start point is read back from the hardware, so a fade that interrupts
+ * another one continues from the exact duty reached.
+ *
+ * @param target Colour at the end of the fade.
+ * @param durationMs Fade length; 0 switches at once.
+ */
+void LedStripFader::fadeTo(const Color& target, uint32_t durationMs) {
+    const uint8_t targets[channelCount] = {target.red, target.green, target.blue};
+    for (uint8_t i = 0; i < channelCount; i++) {
+        startLightness[i] = lightnessTable.lightnessFor(hal::ledcReadDuty(channels[i]));
+        targetLightness[i] = targets[i];
+    }
+    if (scheduler != nullptr) {
+        scheduler->stopTimer(segmentTimer);
+    }
+    segmentCount = static_cast<uint8_t>(durationMs / minSegmentMs);
+    if (segmentCount > maxSegments) {
+        segmentCount = maxSegments;
+    }
+    if (segmentCount == 0 || scheduler == nullptr) {
+        segmentCount = 1;
+    }
+    segmentMs = durationMs / segmentCount;
+    segment = 0;
+    fading = true;
+    startSegment();
+}
+
+/**
+ * @brief Checks whether a fade is still in progress.
+ */
+bool LedStripFader::isFading() const {
+    return fading;
+}
+
+/**
+ * @brief Colour the strip is fading to, or showing.
+ */
+LedStripFader::Color LedStripFader::getTarget() const {
+    return {targetLightness[0], targetLightness[1], targetLightness[2]};
+}
+
+/**
+ * @brief Ramps every channel to the lightness at the end of the current segment.
+ */
+void LedStripFader::startSegment() {
+    for (uint8_t i = 0; i < channelCount; i++) {
+        int from = startLightness[i];
+        int to = targetLightness[i];
+        uint8_t lightness = static_cast<uint8_t>(from + (to - from) * (segment + 1) / segmentCount);
+        hal::ledcFade(channels[i], lightnessTable[lightness], segmentMs);
+    }
+    // After the last segment the timer only marks the end of the fade.
+    if (scheduler != nullptr && segmentMs > 0) {
+        scheduler->startTimer(segmentTimer, segmentMs);
+    } else {
+        fading = false;
+    }
+}
+
+/**
+ * @brief Starts the next segment, or ends the fade after the last one.
+ */
+void LedStripFader::onSegmentTimer(void* context) {
+    LedStripFader* fader = static_cast<LedStripFader*>(context);
+    if (++fader->segment < fader->segmentCount) {
+        fader->startSegment();
+    } else {
+        fader->fading = false;
+    }
+}
@@ -0,0 +1,82 @@
+/**
+ * @file LedStripFader.hpp
+ * @brief Perceptually smooth colour fades of the RGB LED strip on LEDC hardware fades.
+ */
+
+#ifndef LedStripFader_hpp
+#define LedStripFader_hpp
+
+#include "HAL.hpp"
+#include "Scheduler.hpp"
+
+/**
+ * @class LedStripFader
+ * @brief Fades the three strip channels to any colour over any duration.
+ *
+ * Colours are given as perceived lightness per channel and converted to duty
+ * through a compile-time CIE table. The LEDC peripheral ramps linearly in
+ * duty, so a fade is split into up to maxSegments hardware ramps that follow
+ * the lightness curve; the CPU only wakes once per segment. A new fadeTo()
+ * takes over from wherever the running fade has got to, so fades can be
+ * interrupted or retargeted without a visible step.
+ */
+class LedStripFader {
+public:
+    static constexpr uint8_t resolutionBits = 13; // LEDC resolution; 5 kHz x 2^13 fits the 80 MHz clock.
+    static constexpr uint8_t maxSegments = 8; // Hardware ramps per fade.
+    static constexpr uint32_t minSegmentMs = 40; // Shorter fades use fewer segments.
+
+    /**
+     * @brief Colour as perceived lightness (0-255) per channel.
+     */
+    struct Color {
+        uint8_t red;
+        uint8_t green;
+        uint8_t blue;
+    };
+
+    /**
+     * @brief Constructs a fader for three configured LEDC channels.
+     */
+    LedStripFader(uint8_t redChannel, uint8_t greenChannel, uint8_t blueChannel);
+
+    /**
+     * @brief Registers the segment timer with the scheduler.
+     */
+    void begin(Scheduler& scheduler);
+
+    /**
+     * @brief Fades from the current output to a colour.
+     * @param target Colour at the end of the fade.
+     * @param durationMs Fade length; 0 switches at once.
+     */
+    void fadeTo(const Color& target, uint32_t durationMs);
+
+    /**
+     * @brief Checks whether a fade is still in progress.
+     */
+    bool isFading() const;
+
+    /**
+     * @brief Colour the strip is fading to, or showing.
+     */
+    Color getTarget() const;
+
+private:
+    static constexpr uint8_t channelCount = 3;
+
+    static void onSegmentTimer(void* context); // Starts the next segment
+    void startSegment(); // Starts the hardware ramps of the current segment
+
+    uint8_t channels[channelCount]; // LEDC channels: red, green, blue
+    uint8_t startLightness[channelCount]; // Lightness when the fade started
+    uint8_t targetLightness[channelCount]; // Lightness at the end of the fade
+    Scheduler* scheduler; // Scheduler running the segment timer
+    uint8_t segmentTimer; // Fires at the end of each segment
+    uint8_t segment; // Index of the running segment
+    uint8_t segmentCount; // Segments in the running fade
+    uint32_t segmentMs; // Length of one segment
+    bool fading; // A fade is in progress
+};
+
+#endif /* LedStripFader_hpp */
@@ -0,0 +1,70 @@
+/**
+ * @file LightnessTable.hpp
+ * @brief Compile-time CIE 1931 lightness to PWM duty lookup table.
+ */
+
+#ifndef LightnessTable_hpp
+#define LightnessTable_hpp
+
+#include <stdint.h>
+
+/**
+ * @class LightnessTable
+ * @brief Maps perceived lightness (0-255) to PWM duty at a given resolution.
+ *
+ * The eye responds roughly to the cube root of luminance, so equal duty steps
+ * look coarse near black and invisible near full power. The table follows the
+ * CIE 1931 lightness curve instead: Y = L / 903.3 for L <= 8, otherwise
+ * ((L + 16) / 116)^3, with L scaled from 0-255 to 0-100. It is built entirely
+ * by the compiler and lives in flash.
+ *
+ * @tparam ResolutionBits PWM resolution of the target channel.
+ */
+template<uint8_t ResolutionBits>
+class LightnessTable {
+    static_assert(ResolutionBits >= 8 && ResolutionBits <= 16, "LightnessTable supports 8 to 16 bit PWM");
+
+public:
+    static constexpr uint32_t maxDuty = (1UL << ResolutionBits) - 1; // Duty at full lightness.
+
+    constexpr LightnessTable() : duty() {
+        for (int lightness = 0; lightness < 256; lightness++) {
+            duty[lightness] = dutyFor(lightness);
+        }
+    }
+
+    /**
+     * @brief Duty that looks like the given lightness.
+     */
+    constexpr uint16_t operator[](uint8_t lightness) const {
+        return duty[lightness];
+    }
+
+    /**
+     * @brief Inverse lookup: the highest lightness whose duty does not exceed a duty.
+     */
+    uint8_t lightnessFor(uint32_t dutyValue) const {
+        uint8_t low = 0;
+        uint8_t high = 255;
+        while (low < high) {
+            uint8_t middle = static_cast<uint8_t>((low + high + 1) / 2);
+            if (duty[middle] <= dutyValue) {
+                low = middle;
+            } else {
+                high = middle - 1;
+            }
+        }
+        return low;
+    }
+
+private:
+    static constexpr uint16_t dutyFor(int lightness) {
+        double l = lightness * 100.0 / 255.0;
+        double luminance = l <= 8.0 ? l / 903.3 : ((l + 16.0) / 116.0) * ((l + 16.0) / 116.0) * ((l + 16.0) / 116.0);
+        return static_cast<uint16_t>(luminance * maxDuty + 0.5);
+    }
+
+    uint16_t duty[256]; // Duty per lightness step
+};
+
+#endif /* LightnessTable_hpp */
@@ -0,0 +1,101 @@
+/**
+ * @file PinMap.hpp
+ * @brief Compile-time wiring of the LED diodes and the LED strip, checked by the compiler.
+ */
+
+#ifndef PinMap_hpp
+#define PinMap_hpp
+
+#include <stdint.h>
+#include "DiodeTypes.hpp"
+
+/**
+ * @brief True if a pin is one of the others.
+ */
+constexpr bool pinIn(uint8_t) {
+    return false;
+}
+
+template<typename... Rest>
+constexpr bool pinIn(uint8_t pin, uint8_t first, Rest... rest) {
+    return pin == first || pinIn(pin, rest...);
+}
+
+/**
+ * @brief True if no two pins are the same.
+ */
+constexpr bool pinsDistinct() {
+    return true;
+}
+
+template<typename... Rest>
+constexpr bool pinsDistinct(uint8_t first, Rest... rest) {
+    return !pinIn(first, rest...) && pinsDistinct(rest...);
+}
+
+/**
+ * @brief True if an ESP32 GPIO exists and can drive an output.
+ *
+ * GPIO 6-11 belong to the SPI flash and 34-39 are inputs only.
+ */
+constexpr bool isOutputGpio(uint8_t pin) {
+    return pin <= 33 && !(pin >= 6 && pin <= 11) && pin != 20 && pin != 24 && !(pin >= 28 && pin <= 31);
+}
+
+/**
+ * @struct PinMap
+ * @brief Where the diodes and the strip are wired, as template arguments.
+ *
+ * Diodes sit on shift register outputs and the strip channels on GPIOs
+ * driven by LEDC. Everything is a constant: diodePin() is a shift of one
+ * packed word, so with a constant DiodeType it folds to the output number,
+ * and a map with an output beyond the chain, two diodes on one output or
+ * two strip channels on one GPIO does not compile.
+ *
+ * @tparam ShiftOutputs Outputs of the shift register chain the diodes are on.
+ */
+template<uint8_t PowerPin, uint8_t WiFiPin, uint8_t PumpPin, uint8_t VegetablePin, uint8_t FlowerPin,
+         uint8_t BluePin, uint8_t RedPin, uint8_t GreenPin, uint16_t ShiftOutputs = 8>
+struct PinMap {
+    static_assert(PowerPin < ShiftOutputs && WiFiPin < ShiftOutputs && PumpPin < ShiftOutputs &&
+        VegetablePin < ShiftOutputs && FlowerPin < ShiftOutputs, "diode pin beyond the shift register outputs");
+    static_assert(pinsDistinct(PowerPin, WiFiPin, PumpPin, VegetablePin, FlowerPin),
+        "two diodes on one shift register output");
+    static_assert(isOutputGpio(BluePin) && isOutputGpio(RedPin) && isOutputGpio(GreenPin),
+        "strip PWM pin is not an ESP32 output GPIO");
+    static_assert(pinsDistinct(BluePin, RedPin, GreenPin), "two strip channels on one GPIO");
+
+    static constexpr uint16_t shiftOutputs = ShiftOutputs;
+    static constexpr uint8_t bluePin = BluePin;
+    static constexpr uint8_t redPin = RedPin;
+    static constexpr uint8_t greenPin = GreenPin;
+
+    /**
+     * @brief Shift register output of a diode.
+     */
+    static constexpr uint8_t diodePin(DiodeType diode) {
+        return static_cast<uint8_t>(diodePins >> (8 * static_cast<uint8_t>(diode)));
+    }
+
+    /**
+     * @brief True if a diode is wired to a shift register output.
+     */
+    static constexpr bool usesShiftOutput(uint16_t output) {
+        return output < 256 && pinIn(static_cast<uint8_t>(output), PowerPin, WiFiPin, PumpPin, VegetablePin, FlowerPin);
+    }
+
+    /**
+     * @brief True if a strip channel is on a GPIO.
+     */
+    static constexpr bool usesGpio(uint8_t pin) {
+        return pinIn(pin, BluePin, RedPin, GreenPin);
+    }
+
+private:
+    // Diode outputs packed one byte each, in DiodeType order.
+    static constexpr uint64_t diodePins = static_cast<uint64_t>(PowerPin) |
+        static_cast<uint64_t>(WiFiPin) << 8 | static_cast<uint64_t>(PumpPin) << 16 |
+        static_cast<uint64_t>(VegetablePin) << 24 | static_cast<uint64_t>(FlowerPin) << 32;
+};
+
+#endif /* PinMap_hpp */
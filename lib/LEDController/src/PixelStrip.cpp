@@ -0,0 +1,225 @@
+/**
+ * @file PixelStrip.cpp
+ * @brief Implementation of the addressable strip renderer and its double-buffered output.
+ */
+
+#include "PixelStrip.hpp"
+#include "DebugLogger.hpp"
+#include "LightnessTable.hpp"
+
+namespace {
+
+constexpr LightnessTable<8> pixelLevels;
+
+static_assert(pixelLevels[0] == 0 && pixelLevels[255] == 255, "black must be off and white full on");
+
+} // namespace
+
+/**
+ * @brief Renders a gradient from start on the first pixel to end on the last.
+ */
+void PixelRenderer::renderGradient(uint8_t* frame, uint16_t pixelCount, PixelOrder order,
+    const LedStripFader::Color& start, const LedStripFader::Color& end) {
+    if (pixelCount == 0) {
+        return;
+    }
+    // Lightness per channel in 16.16 fixed point, stepped once per pixel.
+    int32_t span = pixelCount > 1 ? pixelCount - 1 : 1;
+    int32_t red = static_cast<int32_t>(start.red) << 16;
+    int32_t green = static_cast<int32_t>(start.green) << 16;
+    int32_t blue = static_cast<int32_t>(start.blue) << 16;
+    int32_t redStep = (static_cast<int32_t>(end.red) - start.red) * 65536 / span;
+    int32_t greenStep = (static_cast<int32_t>(end.green) - start.green) * 65536 / span;
+    int32_t blueStep = (static_cast<int32_t>(end.blue) - start.blue) * 65536 / span;
+    bool white = order == PixelOrder::Grbw;
+    for (uint16_t i = 0; i < pixelCount; i++) {
+        // Round to the nearest lightness so the last pixel lands exactly on end.
+        uint8_t r = static_cast<uint8_t>(pixelLevels[static_cast<uint8_t>((red + 0x8000) >> 16)]);
+        uint8_t g = static_cast<uint8_t>(pixelLevels[static_cast<uint8_t>((green + 0x8000) >> 16)]);
+        uint8_t b = static_cast<uint8_t>(pixelLevels[static_cast<uint8_t>((blue + 0x8000) >> 16)]);
+        if (white) {
+            uint8_t w = r < g ? (r < b ? r : b) : (g < b ? g : b);
+            frame[0] = static_cast<uint8_t>(g - w);
+            frame[1] = static_cast<uint8_t>(r - w);
+            frame[2] = static_cast<uint8_t>(b - w);
+            frame[3] = w;
+            frame += 4;
+        } else {
+            frame[0] = g;
+            frame[1] = r;
+            frame[2] = b;
+            frame += 3;
+        }
+        red += redStep;
+        green += greenStep;
+        blue += blueStep;
+    }
+}
+
+/**
+ * @brief Blends two colours in lightness; weight 0 gives from, 65536 gives to.
+ */
+LedStripFader::Color PixelRenderer::blend(const LedStripFader::Color& from, const LedStripFader::Color& to, uint32_t weight) {
+    if (weight > 65536) {
+        weight = 65536;
+    }
+    int32_t w = static_cast<int32_t>(weight);
+    return {
+        static_cast<uint8_t>(from.red + (((to.red - from.red) * w + 0x8000) >> 16)),
+        static_cast<uint8_t>(from.green + (((to.green - from.green) * w + 0x8000) >> 16)),
+        static_cast<uint8_t>(from.blue + (((to.blue - from.blue) * w + 0x8000) >> 16))};
+}
+
+/**
+ * @brief Initializes the strip state. The buffers belong to the derived class.
+ */
+PixelStripBase::PixelStripBase(uint8_t dataPin, PixelOrder order, uint16_t pixelCount, uint8_t* frontBuffer,
+    uint8_t* backBuffer)
+    : dataPin(dataPin), order(order), pixelCount(pixelCount),
+      frameBytes(static_cast<size_t>(pixelCount) * bytesPerPixel(order)), front(frontBuffer), back(backBuffer),
+      output(nullptr), scheduler(nullptr), frameTimer(Scheduler::invalidId), waiting(false), fading(false),
+      fromStart(), fromEnd(), toStart(), toEnd(), shownStart(), shownEnd(), fadeStartMs(0), fadeDurationMs(0),
+      sentFrames(0), replacedFrames(0) {}
+
+/**
+ * @brief Claims the pixel output, registers the frame timer and sends a black frame.
+ * @return False if no RMT channel was free.
+ */
+bool PixelStripBase::begin(Scheduler& scheduler) {
+    this->scheduler = &scheduler;
+    frameTimer = scheduler.addTimer(onFrameTimer, this);
+    output = hal::pixelOutputBegin(dataPin, frameBytes);
+    if (output == nullptr) {
+        LOG_ERROR("No RMT channel for the pixel strip on pin %u.", dataPin);
+        return false;
+    }
+    PixelRenderer::renderGradient(back, pixelCount, order, shownStart, shownEnd);
+    present();
+    return true;
+}
+
+/**
+ * @brief Buffer to render the next frame into.
+ */
+uint8_t* PixelStripBase::getBackBuffer() {
+    return back;
+}
+
+/**
+ * @brief Sends the back buffer now if the output is free, else on the next frame tick.
+ *
+ * A frame still waiting from an earlier call was overwritten by this one
+ * and is counted as replaced.
+ */
+void PixelStripBase::present() {
+    if (waiting) {
+        replacedFrames++;
+    }
+    waiting = true;
+    if (!trySend() && scheduler != nullptr && !scheduler->isTimerActive(frameTimer)) {
+        scheduler->startTimer(frameTimer, frameIntervalMs, frameIntervalMs);
+    }
+}
+
+/**
+ * @brief Fades to a gradient, taking over from the gradient shown last.
+ */
+void PixelStripBase::fadeTo(const LedStripFader::Color& start, const LedStripFader::Color& end, uint32_t durationMs) {
+    fromStart = shownStart;
+    fromEnd = shownEnd;
+    toStart = start;
+    toEnd = end;
+    fadeStartMs = hal::millis();
+    fadeDurationMs = durationMs;
+    fading = true;
+    renderFadeFrame();
+    if (fading && scheduler != nullptr && !scheduler->isTimerActive(frameTimer)) {
+        scheduler->startTimer(frameTimer, frameIntervalMs, frameIntervalMs);
+    }
+}
+
+/**
+ * @brief Renders the fade frame for the current time into the back buffer and presents it.
+ */
+void PixelStripBase::renderFadeFrame() {
+    if (!fading) {
+        return;
+    }
+    uint32_t elapsedMs = hal::millis() - fadeStartMs;
+    uint32_t weight = elapsedMs >= fadeDurationMs
+        ? 65536 : static_cast<uint32_t>((static_cast<uint64_t>(elapsedMs) << 16) / fadeDurationMs);
+    shownStart = PixelRenderer::blend(fromStart, toStart, weight);
+    shownEnd = PixelRenderer::blend(fromEnd, toEnd, weight);
+    PixelRenderer::renderGradient(back, pixelCount, order, shownStart, shownEnd);
+    fading = weight < 65536;
+    present();
+}
+
+/**
+ * @brief Checks whether a fade is still in progress.
+ */
+bool PixelStripBase::isFading() const {
+    return fading;
+}
+
+uint16_t PixelStripBase::getPixelCount() const {
+    return pixelCount;
+}
+
+PixelOrder PixelStripBase::getOrder() const {
+    return order;
+}
+
+/**
+ * @brief Number of frames handed to the output.
+ */
+uint32_t PixelStripBase::getSentFrameCount() const {
+    return sentFrames;
+}
+
+/**
+ * @brief Number of frames replaced by a newer one before they could be sent.
+ */
+uint32_t PixelStripBase::getReplacedFrameCount() const {
+    return replacedFrames;
+}
+
+/**
+ * @brief Frame timer: renders the next fade frame, or sends the waiting one,
+ * and stops once there is nothing left to do.
+ */
+void PixelStripBase::onFrameTimer(void* context) {
+    PixelStripBase* strip = static_cast<PixelStripBase*>(context);
+    if (strip->fading) {
+        strip->renderFadeFrame();
+    } else {
+        strip->trySend();
+    }
+    if (!strip->fading && !strip->waiting) {
+        strip->scheduler->stopTimer(strip->frameTimer);
+    }
+}
+
+/**
+ * @brief Swaps the buffers and starts sending the waiting frame if the output is free.
+ *
+ * The old front buffer becomes the back buffer only once the output has
+ * finished with it, so rendering never touches bytes on the wire.
+ *
+ * @return True if nothing is left waiting.
+ */
+bool PixelStripBase::trySend() {
+    if (!waiting) {
+        return true;
+    }
+    if (output == nullptr || hal::pixelOutputBusy(output)) {
+        return false;
+    }
+    uint8_t* sent = back;
+    back = front;
+    front = sent;
+    hal::pixelOutputWrite(output, front, frameBytes);
+    waiting = false;
+    sentFrames++;
+    return true;
+}
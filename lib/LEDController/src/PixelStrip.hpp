@@ -0,0 +1,173 @@
+/**
+ * @file PixelStrip.hpp
+ * @brief Addressable WS2812/SK6812 strip, rendered into one frame while the other is sent.
+ */
+
+#ifndef PixelStrip_hpp
+#define PixelStrip_hpp
+
+#include "HAL.hpp"
+#include "LedStripFader.hpp"
+#include "Scheduler.hpp"
+
+/**
+ * @brief Byte layout of one pixel on the wire.
+ */
+enum class PixelOrder : uint8_t {
+    Grb, // WS2812B: green, red, blue
+    Grbw // SK6812 RGBW: green, red, blue, white
+};
+
+/**
+ * @brief Bytes one pixel takes on the wire.
+ */
+constexpr uint8_t bytesPerPixel(PixelOrder order) {
+    return order == PixelOrder::Grbw ? 4 : 3;
+}
+
+/**
+ * @class PixelRenderer
+ * @brief Renders frames in wire order. Pure computation, usable on any host.
+ */
+class PixelRenderer {
+public:
+    /**
+     * @brief Renders a gradient across the strip.
+     *
+     * The first pixel shows start and the last shows end; in between each
+     * channel's lightness is blended linearly, in 16.16 fixed point stepped
+     * per pixel, and converted to an 8-bit level through the CIE table. For
+     * Grbw the level common to red, green and blue goes to the white LED.
+     *
+     * @param frame pixelCount * bytesPerPixel(order) bytes.
+     */
+    static void renderGradient(uint8_t* frame, uint16_t pixelCount, PixelOrder order,
+        const LedStripFader::Color& start, const LedStripFader::Color& end);
+
+    /**
+     * @brief Colour between two colours, blended in lightness.
+     * @param weight 0 gives from, 65536 gives to.
+     */
+    static LedStripFader::Color blend(const LedStripFader::Color& from, const LedStripFader::Color& to, uint32_t weight);
+};
+
+/**
+ * @class PixelStripBase
+ * @brief Size independent part of an addressable strip with two frame buffers.
+ *
+ * One buffer is being sent by the RMT peripheral while the next frame is
+ * rendered into the other; present() swaps them as soon as the output is
+ * free, without waiting for it, and a frame presented again before it went
+ * out simply replaces the waiting one. Fades run on a scheduler timer at
+ * frameIntervalMs, so the control loop only renders, never blocks on the
+ * wire. A 60 frames per second fade fits strips of up to about 500 pixels
+ * (30 us per RGB pixel on the wire).
+ */
+class PixelStripBase {
+public:
+    static constexpr uint32_t frameIntervalMs = 16; // 62.5 frames per second while fading or waiting
+
+    /**
+     * @brief Claims the pixel output, registers the frame timer and sends a black frame.
+     * @return False if no RMT channel was free; the strip then stays dark.
+     */
+    bool begin(Scheduler& scheduler);
+
+    /**
+     * @brief Buffer to render the next frame into. Never the one being sent.
+     */
+    uint8_t* getBackBuffer();
+
+    /**
+     * @brief Sends the back buffer now if the output is free, else on the next frame tick.
+     */
+    void present();
+
+    /**
+     * @brief Fades to a gradient, taking over from a fade in progress.
+     * @param durationMs Fade length; 0 switches at the next frame.
+     */
+    void fadeTo(const LedStripFader::Color& start, const LedStripFader::Color& end, uint32_t durationMs);
+
+    /**
+     * @brief Renders the fade frame for the current time and presents it.
+     *
+     * The frame timer calls it every frameIntervalMs during a fade.
+     */
+    void renderFadeFrame();
+
+    /**
+     * @brief Checks whether a fade is still in progress.
+     */
+    bool isFading() const;
+
+    uint16_t getPixelCount() const;
+    PixelOrder getOrder() const;
+
+    /**
+     * @brief Number of frames handed to the output.
+     */
+    uint32_t getSentFrameCount() const;
+
+    /**
+     * @brief Number of frames replaced by a newer one before they could be sent.
+     */
+    uint32_t getReplacedFrameCount() const;
+
+    PixelStripBase(const PixelStripBase&) = delete;
+    PixelStripBase& operator=(const PixelStripBase&) = delete;
+
+protected:
+    /**
+     * @brief Initializes the strip state. The buffers belong to the derived class.
+     */
+    PixelStripBase(uint8_t dataPin, PixelOrder order, uint16_t pixelCount, uint8_t* frontBuffer, uint8_t* backBuffer);
+
+private:
+    static void onFrameTimer(void* context); // Renders fade frames and sends waiting ones
+    bool trySend(); // Swaps and sends a waiting frame if the output is free
+
+    uint8_t dataPin;
+    PixelOrder order;
+    uint16_t pixelCount;
+    size_t frameBytes; // pixelCount * bytesPerPixel(order)
+    uint8_t* front; // Frame being sent, or last sent
+    uint8_t* back; // Frame being rendered
+    hal::PixelOutputHandle output; // RMT channel, nullptr until begin()
+    Scheduler* scheduler; // Scheduler running the frame timer
+    uint8_t frameTimer; // Ticks at frameIntervalMs while fading or a frame waits
+    bool waiting; // The back buffer was presented but not sent yet
+    bool fading; // A fade is in progress
+    LedStripFader::Color fromStart, fromEnd; // Gradient when the fade started
+    LedStripFader::Color toStart, toEnd; // Gradient at the end of the fade
+    LedStripFader::Color shownStart, shownEnd; // Gradient of the latest rendered frame
+    uint32_t fadeStartMs;
+    uint32_t fadeDurationMs;
+    uint32_t sentFrames;
+    uint32_t replacedFrames;
+};
+
+/**
+ * @brief Addressable strip of a fixed length with its two frame buffers.
+ *
+ * @tparam Pixels Number of pixels.
+ * @tparam Order Byte layout of the pixels.
+ */
+template<uint16_t Pixels, PixelOrder Order = PixelOrder::Grb>
+class PixelStrip : public PixelStripBase {
+    static_assert(Pixels > 0, "a pixel strip needs at least one pixel");
+
+public:
+    static constexpr size_t frameBytes = static_cast<size_t>(Pixels) * bytesPerPixel(Order);
+
+    /**
+     * @brief Constructs a strip. The RMT channel is claimed by begin().
+     */
+    explicit PixelStrip(uint8_t dataPin)
+        : PixelStripBase(dataPin, Order, Pixels, frameBuffers[0], frameBuffers[1]), frameBuffers() {}
+
+private:
+    uint8_t frameBuffers[2][frameBytes];
+};
+
+#endif /* PixelStrip_hpp */
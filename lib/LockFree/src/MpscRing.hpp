@@ -0,0 +1,98 @@
+/**
+ * @file MpscRing.hpp
+ * @brief Bounded lock-free multi-producer/single-consumer ring buffer.
+ */
+
+#ifndef MpscRing_hpp
+#define MpscRing_hpp
+
+#include <atomic>
+#include <stdint.h>
+
+/**
+ * @class MpscRing
+ * @brief FIFO that any number of tasks can push into and exactly one task drains.
+ *
+ * Every slot carries a sequence number telling whether it is free for the
+ * producer claiming that position or published for the consumer, so producers
+ * only contend on one compare-and-swap and never wait for each other. A push
+ * into a full ring fails and is counted instead of blocking.
+ *
+ * @tparam T Trivially copyable item type.
+ * @tparam Capacity Number of slots, a power of two.
+ */
+template<typename T, uint32_t Capacity>
+class MpscRing {
+    static_assert(Capacity > 1 && (Capacity & (Capacity - 1)) == 0, "MpscRing capacity must be a power of two");
+
+public:
+    MpscRing() : head(0), tail(0), dropped(0) {
+        for (uint32_t i = 0; i < Capacity; i++) {
+            slots[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    /**
+     * @brief Appends an item. Safe from any number of tasks at once.
+     * @return False if the ring was full; the item is dropped and counted.
+     */
+    bool push(const T& item) {
+        uint32_t position = head.load(std::memory_order_relaxed);
+        Slot* slot;
+        for (;;) {
+            slot = &slots[position & (Capacity - 1)];
+            int32_t lag = static_cast<int32_t>(slot->sequence.load(std::memory_order_acquire) - position);
+            if (lag == 0) {
+                if (head.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (lag < 0) {
+                dropped.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            } else {
+                position = head.load(std::memory_order_relaxed);
+            }
+        }
+        slot->item = item;
+        slot->sequence.store(position + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief Removes the oldest published item. Consumer side only.
+     * @return False if the ring was empty or the oldest item is still being written.
+     */
+    bool pop(T& item) {
+        uint32_t position = tail.load(std::memory_order_relaxed);
+        Slot& slot = slots[position & (Capacity - 1)];
+        if (slot.sequence.load(std::memory_order_acquire) != position + 1) {
+            return false;
+        }
+        item = slot.item;
+        slot.sequence.store(position + Capacity, std::memory_order_release);
+        tail.store(position + 1, std::memory_order_relaxed);
+        return true;
+    }
+
+    /**
+     * @brief Number of items rejected because the ring was full.
+     */
+    uint32_t getDropped() const {
+        return dropped.load(std::memory_order_relaxed);
+    }
+
+    static constexpr uint32_t capacity = Capacity; // Number of slots.
+
+private:
+    struct Slot {
+        std::atomic<uint32_t> sequence; // Position this slot is free or published for
+        T item; // Stored item
+    };
+
+    Slot slots[Capacity]; // Slot storage
+    std::atomic<uint32_t> head; // Next position to claim, shared by producers
+    std::atomic<uint32_t> tail; // Next position to read, owned by the consumer
+    std::atomic<uint32_t> dropped; // Failed pushes
+};
+
+#endif /* MpscRing_hpp */
@@ -0,0 +1,90 @@
+/**
+ * @file SpscRing.hpp
+ * @brief Bounded lock-free single-producer/single-consumer ring buffer.
+ */
+
+#ifndef SpscRing_hpp
+#define SpscRing_hpp
+
+#include <atomic>
+#include <stdint.h>
+
+/**
+ * @class SpscRing
+ * @brief Wait-free FIFO between exactly one producer and one consumer.
+ *
+ * The producer may be an interrupt handler; push() is always inlined, so it
+ * runs from wherever its caller is placed, such as IRAM. Indices run freely
+ * and are masked on access, so all Capacity slots are usable. A push into a
+ * full ring fails and is counted instead of overwriting unread items.
+ *
+ * @tparam T Trivially copyable item type.
+ * @tparam Capacity Number of slots, a power of two.
+ */
+template<typename T, uint32_t Capacity>
+class SpscRing {
+    static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "SpscRing capacity must be a power of two");
+
+public:
+    SpscRing() : head(0), tail(0), dropped(0) {}
+
+    /**
+     * @brief Appends an item. Producer side only.
+     * @return False if the ring was full; the item is dropped and counted.
+     */
+    __attribute__((always_inline)) bool push(const T& item) {
+        uint32_t write = head.load(std::memory_order_relaxed);
+        if (write - tail.load(std::memory_order_acquire) >= Capacity) {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        items[write & (Capacity - 1)] = item;
+        head.store(write + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief Removes the oldest item. Consumer side only.
+     * @return False if the ring was empty.
+     */
+    bool pop(T& item) {
+        uint32_t read = tail.load(std::memory_order_relaxed);
+        if (read == head.load(std::memory_order_acquire)) {
+            return false;
+        }
+        item = items[read & (Capacity - 1)];
+        tail.store(read + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief Number of unread items. Exact only when called by producer or consumer.
+     */
+    uint32_t size() const {
+        return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire);
+    }
+
+    /**
+     * @brief Checks whether there is nothing to read.
+     */
+    bool empty() const {
+        return size() == 0;
+    }
+
+    /**
+     * @brief Number of items rejected because the ring was full.
+     */
+    uint32_t getDropped() const {
+        return dropped.load(std::memory_order_relaxed);
+    }
+
+    static constexpr uint32_t capacity = Capacity; // Number of slots.
+
+private:
+    T items[Capacity]; // Slot storage
+    std::atomic<uint32_t> head; // Next slot to write, owned by the producer
+    std::atomic<uint32_t> tail; // Next slot to read, owned by the consumer
+    std::atomic<uint32_t> dropped; // Failed pushes
+};
+
+#endif /* SpscRing_hpp */
@@ -0,0 +1,733 @@
+/**
+ * @file MqttClient.cpp
+ * @brief Implementation of the non-blocking MQTT 3.1.1 client.
+ */
+
+#include "MqttClient.hpp"
+#include "DebugLogger.hpp"
+#include <string.h>
+
+namespace {
+
+constexpr size_t fixedHeaderReserve = 5; // Type byte and up to four length bytes
+constexpr uint32_t tickMs = MqttClient::ackTimeoutMs / 2; // Keep-alive and ack timeout checks
+constexpr uint32_t pingIntervalMs = MqttClient::keepAliveSeconds * 1000u / 2;
+
+// Packet types in the high nibble of the first byte
+constexpr uint8_t connectType = 0x10;
+constexpr uint8_t connAckType = 0x20;
+constexpr uint8_t publishType = 0x30;
+constexpr uint8_t pubAckType = 0x40;
+constexpr uint8_t subscribeType = 0x80;
+constexpr uint8_t subAckType = 0x90;
+constexpr uint8_t pingReqType = 0xC0;
+constexpr uint8_t pingRespType = 0xD0;
+
+size_t stringLength(const char* text) {
+    return text != nullptr ? strlen(text) : 0;
+}
+
+} // namespace
+
+/**
+ * @brief Constructs an offline client with no broker.
+ */
+MqttClient::MqttClient()
+    : scheduler(nullptr), readyEvent(Scheduler::invalidId), timer(Scheduler::invalidId), state(State::Offline),
+      socket(hal::invalidSocket), tcpConnected(false), networkAvailable(false), brokerAddress(0), brokerPort(1883),
+      clientId("hydroponics"), user(nullptr), password(nullptr), willTopic(nullptr), willMessage(nullptr),
+      subscriptions(), subscriptionCount(0), messageHandler(nullptr), messageContext(nullptr), stateHandler(nullptr),
+      stateContext(nullptr), ackHandler(nullptr), ackContext(nullptr), packet(), topicLength(0), packetOut(),
+      control(), controlOut(), sendingPacket(false), received(), receivedLength(0), skipLength(0), nextPacketId(1),
+      inFlightId(0), inFlightSinceMs(0), pingOutstanding(false), pingSentMs(0), lastSendMs(0), failedAttempts(0),
+      publishCount(0), connectCount(0) {}
+
+/**
+ * @brief Sets the broker. Takes effect on the next connection attempt.
+ *
+ * Starts connecting at once if the network is up and the client was idle
+ * for want of a broker.
+ *
+ * @param address IPv4 address, first octet in the lowest byte. 0 disables the client.
+ */
+void MqttClient::setBroker(uint32_t address, uint16_t port) {
+    brokerAddress = address;
+    brokerPort = port;
+    if (scheduler != nullptr && networkAvailable && state == State::Offline && address != 0) {
+        connect();
+    }
+}
+
+/**
+ * @brief Sets the broker from a dotted IPv4 address; host names are not resolved.
+ * @return False if the address is malformed; the broker is then unchanged.
+ */
+bool MqttClient::setBroker(const char* address, uint16_t port) {
+    uint32_t result = 0;
+    for (uint8_t octet = 0; octet < 4; octet++) {
+        uint32_t value = 0;
+        uint8_t digits = 0;
+        for (; *address >= '0' && *address <= '9' && digits < 3; address++, digits++) {
+            value = value * 10 + static_cast<uint32_t>(*address - '0');
+        }
+        if (digits == 0 || value > 255 || *address != (octet < 3 ? '.' : '\0')) {
+            return false;
+        }
+        result |= value << (8 * octet);
+        address++;
+    }
+    setBroker(result, port);
+    return true;
+}
+
+/**
+ * @brief Sets the client identifier, which must be unique per broker. The string must outlive the client.
+ */
+void MqttClient::setClientId(const char* clientId) {
+    this->clientId = clientId;
+}
+
+/**
+ * @brief Sets the user name and password, or nullptr for none. The strings must outlive the client.
+ */
+void MqttClient::setCredentials(const char* user, const char* password) {
+    this->user = user;
+    this->password = password;
+}
+
+/**
+ * @brief Sets the retained QoS 1 message the broker publishes if the connection is lost.
+ */
+void MqttClient::setWill(const char* topic, const char* message) {
+    willTopic = topic;
+    willMessage = message;
+}
+
+void MqttClient::setMessageHandler(MessageHandler handler, void* context) {
+    messageHandler = handler;
+    messageContext = context;
+}
+
+void MqttClient::setStateChangeHandler(StateChangeHandler handler, void* context) {
+    stateHandler = handler;
+    stateContext = context;
+}
+
+void MqttClient::setAckHandler(AckHandler handler, void* context) {
+    ackHandler = handler;
+    ackContext = context;
+}
+
+/**
+ * @brief Adds a topic filter subscribed on every connection. Must be called before begin().
+ * @return False if the table is full.
+ */
+bool MqttClient::subscribe(const char* topicFilter) {
+    if (subscriptionCount >= maxSubscriptions) {
+        LOG_ERROR("MQTT subscription %s rejected.", topicFilter);
+        return false;
+    }
+    subscriptions[subscriptionCount++] = topicFilter;
+    return true;
+}
+
+/**
+ * @brief Registers the socket event and the timer.
+ */
+void MqttClient::begin(Scheduler& scheduler) {
+    this->scheduler = &scheduler;
+    readyEvent = scheduler.addEvent(onReadyEvent, this);
+    timer = scheduler.addTimer(onTimer, this);
+    if (readyEvent == Scheduler::invalidId || timer == Scheduler::invalidId) {
+        LOG_ERROR("MQTT client has no scheduler event or timer.");
+        this->scheduler = nullptr;
+        return;
+    }
+    hal::tcpOnReady(onSocketReady, this);
+}
+
+/**
+ * @brief Tells the client whether the network is up; it connects while it is.
+ *
+ * Losing the network drops the connection at once rather than waiting for
+ * TCP to notice; the broker publishes the will when the keep-alive expires.
+ */
+void MqttClient::setNetworkAvailable(bool available) {
+    networkAvailable = available;
+    if (scheduler == nullptr) {
+        return;
+    }
+    if (available) {
+        if (state == State::Offline && brokerAddress != 0) {
+            failedAttempts = 0;
+            connect();
+        }
+        return;
+    }
+    if (socket != hal::invalidSocket) {
+        hal::tcpClose(socket);
+        socket = hal::invalidSocket;
+    }
+    scheduler->stopTimer(timer);
+    inFlightId = 0;
+    setState(State::Offline);
+}
+
+/**
+ * @brief True if connected, the packet buffer is free and no QoS 1 message is in flight.
+ */
+bool MqttClient::canPublish() const {
+    return state == State::Connected && packetOut.end == 0 && topicLength == 0 && inFlightId == 0;
+}
+
+/**
+ * @brief Starts a publish packet and returns where its payload goes.
+ *
+ * The topic is laid out as for QoS 1, with room for the packet identifier
+ * in front of the payload; a QoS 0 publish moves the topic up instead.
+ *
+ * @param[out] capacity Bytes available for the payload.
+ * @return Payload area, or nullptr if canPublish() is false or the topic is too long.
+ */
+char* MqttClient::preparePublish(const char* topic, size_t& capacity) {
+    size_t length = strlen(topic);
+    if (!canPublish() || length == 0 || length > maxTopicLength) {
+        return nullptr;
+    }
+    topicLength = length;
+    size_t offset = fixedHeaderReserve;
+    packet[offset++] = static_cast<uint8_t>(length >> 8);
+    packet[offset++] = static_cast<uint8_t>(length);
+    memcpy(packet + offset, topic, length);
+    offset += length + 2;
+    capacity = packetBufferSize - offset;
+    return reinterpret_cast<char*>(packet + offset);
+}
+
+/**
+ * @brief Sends the packet started by preparePublish() with the payload written there.
+ *
+ * The bytes go out from the client's own event, so this may be called from
+ * any of its handlers.
+ *
+ * @param qos1 Wait for a PUBACK, reported to the ack handler; otherwise QoS 0.
+ * @return False if nothing was prepared or the payload is too long.
+ */
+bool MqttClient::publish(size_t payloadLength, bool qos1, bool retain) {
+    if (topicLength == 0) {
+        return false;
+    }
+    size_t payloadOffset = fixedHeaderReserve + 2 + topicLength + 2;
+    if (payloadLength > packetBufferSize - payloadOffset || state != State::Connected) {
+        topicLength = 0;
+        return false;
+    }
+    size_t start = fixedHeaderReserve;
+    if (qos1) {
+        if (nextPacketId == 0) {
+            nextPacketId = 1;
+        }
+        inFlightId = nextPacketId++;
+        inFlightSinceMs = hal::millis();
+        packet[payloadOffset - 2] = static_cast<uint8_t>(inFlightId >> 8);
+        packet[payloadOffset - 1] = static_cast<uint8_t>(inFlightId);
+    } else {
+        memmove(packet + start + 2, packet + start, 2 + topicLength);
+        start += 2;
+    }
+    uint8_t header[fixedHeaderReserve];
+    header[0] = static_cast<uint8_t>(publishType | (qos1 ? 0x02 : 0) | (retain ? 0x01 : 0));
+    size_t headerLength = 1 + putLength(header + 1, payloadOffset + payloadLength - start);
+    start -= headerLength;
+    memcpy(packet + start, header, headerLength);
+    packetOut = {start, payloadOffset + payloadLength};
+    topicLength = 0;
+    publishCount++;
+    scheduler->post(readyEvent);
+    return true;
+}
+
+/**
+ * @brief Drops the packet started by preparePublish().
+ */
+void MqttClient::cancelPublish() {
+    topicLength = 0;
+}
+
+/**
+ * @brief Publishes a short terminated payload at QoS 0.
+ */
+bool MqttClient::publish(const char* topic, const char* payload, bool retain) {
+    size_t capacity = 0;
+    char* data = preparePublish(topic, capacity);
+    if (data == nullptr) {
+        return false;
+    }
+    size_t length = strlen(payload);
+    if (length > capacity) {
+        topicLength = 0;
+        return false;
+    }
+    memcpy(data, payload, length);
+    return publish(length, false, retain);
+}
+
+MqttClient::State MqttClient::getState() const {
+    return state;
+}
+
+/**
+ * @brief Publish packets handed to TCP since construction.
+ */
+uint32_t MqttClient::getPublishCount() const {
+    return publishCount;
+}
+
+/**
+ * @brief Successful connections since construction.
+ */
+uint32_t MqttClient::getConnectCount() const {
+    return connectCount;
+}
+
+/**
+ * @brief Moves the work to the client's task. May run in the HAL's socket task.
+ */
+void MqttClient::onSocketReady(void* context) {
+    MqttClient* client = static_cast<MqttClient*>(context);
+    client->scheduler->post(client->readyEvent);
+}
+
+void MqttClient::onReadyEvent(void* context) {
+    MqttClient* client = static_cast<MqttClient*>(context);
+    if (client->socket != hal::invalidSocket) {
+        client->service();
+    }
+}
+
+/**
+ * @brief Connect timeout, end of backoff, or keep-alive tick, depending on the state.
+ *
+ * While connected the tick sends a PINGREQ when nothing else went out for
+ * half the keep-alive, and drops the connection when a PUBACK or PINGRESP is
+ * overdue: a half-open TCP connection is noticed within ackTimeoutMs.
+ */
+void MqttClient::onTimer(void* context) {
+    MqttClient* client = static_cast<MqttClient*>(context);
+    uint32_t now = hal::millis();
+    switch (client->state) {
+        case State::Connecting:
+            LOG_WARN("MQTT connection attempt timed out.");
+            client->fail();
+            break;
+        case State::Backoff:
+            client->connect();
+            break;
+        case State::Connected:
+            if ((client->inFlightId != 0 && now - client->inFlightSinceMs >= ackTimeoutMs) ||
+                (client->pingOutstanding && now - client->pingSentMs >= ackTimeoutMs)) {
+                LOG_WARN("MQTT broker stopped answering.");
+                client->fail();
+                break;
+            }
+            if (!client->pingOutstanding && now - client->lastSendMs >= pingIntervalMs) {
+                static const uint8_t pingReq[] = {pingReqType, 0};
+                if (client->queueControl(pingReq, sizeof(pingReq))) {
+                    client->pingOutstanding = true;
+                    client->pingSentMs = now;
+                    client->service();
+                }
+            }
+            break;
+        case State::Offline:
+            break;
+    }
+}
+
+void MqttClient::setState(State newState) {
+    if (state == newState) {
+        return;
+    }
+    state = newState;
+    if (stateHandler != nullptr) {
+        stateHandler(state, stateContext);
+    }
+}
+
+/**
+ * @brief Starts a TCP connection attempt and arms its timeout.
+ */
+void MqttClient::connect() {
+    if (!networkAvailable || brokerAddress == 0) {
+        setState(State::Offline);
+        return;
+    }
+    socket = hal::tcpConnect(brokerAddress, brokerPort);
+    if (socket == hal::invalidSocket) {
+        startBackoff();
+        return;
+    }
+    tcpConnected = false;
+    packetOut = {0, 0};
+    controlOut = {0, 0};
+    sendingPacket = false;
+    topicLength = 0;
+    receivedLength = 0;
+    skipLength = 0;
+    inFlightId = 0;
+    pingOutstanding = false;
+    setState(State::Connecting);
+    scheduler->startTimer(timer, connectTimeoutMs);
+    hal::tcpWatch(socket, true);
+}
+
+/**
+ * @brief Closes the socket and backs off before the next attempt.
+ */
+void MqttClient::fail() {
+    if (socket != hal::invalidSocket) {
+        hal::tcpClose(socket);
+        socket = hal::invalidSocket;
+    }
+    inFlightId = 0;
+    startBackoff();
+}
+
+void MqttClient::startBackoff() {
+    if (failedAttempts < 0xFF) {
+        failedAttempts++;
+    }
+    uint32_t delayMs = nextBackoffDelay();
+    LOG_INFO("Retrying MQTT in %lu ms.", static_cast<unsigned long>(delayMs));
+    setState(State::Backoff);
+    scheduler->startTimer(timer, delayMs);
+}
+
+/**
+ * Exponential backoff with equal jitter, as for WiFi, so a fleet of
+ * controllers does not descend on a restarted broker in lockstep.
+ *
+ * @return Delay before the next attempt in milliseconds.
+ */
+uint32_t MqttClient::nextBackoffDelay() {
+    uint8_t exponent = failedAttempts > 0 ? failedAttempts - 1 : 0;
+    uint32_t ceiling = maxBackoffMs;
+    if (exponent < 16 && (minBackoffMs << exponent) < maxBackoffMs) {
+        ceiling = minBackoffMs << exponent;
+    }
+    uint32_t half = ceiling / 2;
+    return half + hal::randomU32() % (ceiling - half + 1);
+}
+
+/**
+ * @brief Finishes the TCP connect, then sends and receives as far as the socket allows, then watches it.
+ */
+void MqttClient::service() {
+    if (!tcpConnected) {
+        int result = hal::tcpConnected(socket);
+        if (result == 0) {
+            hal::tcpWatch(socket, true);
+            return;
+        }
+        if (result < 0) {
+            LOG_WARN("MQTT broker unreachable.");
+            fail();
+            return;
+        }
+        tcpConnected = true;
+        queueConnect();
+    }
+    if (!flush() || !receive() || !flush()) {
+        LOG_WARN("MQTT connection lost.");
+        fail();
+        return;
+    }
+    hal::tcpWatch(socket, packetOut.end != 0 || controlOut.end != 0);
+}
+
+/**
+ * @brief Hands pending bytes to TCP until they are all sent or the send buffer is full.
+ *
+ * Control packets go ahead of a publish packet unless it already started
+ * going out, so a long backlog never delays a PINGREQ or PUBACK by more than
+ * one packet.
+ *
+ * @return False if the connection failed.
+ */
+bool MqttClient::flush() {
+    for (;;) {
+        bool fromPacket = sendingPacket || (controlOut.end == 0 && packetOut.end != 0);
+        Outgoing& out = fromPacket ? packetOut : controlOut;
+        if (out.end == 0) {
+            return true;
+        }
+        const uint8_t* data = fromPacket ? packet : control;
+        int sent = hal::tcpWrite(socket, data + out.offset, out.end - out.offset);
+        if (sent < 0) {
+            return false;
+        }
+        if (sent == 0) {
+            return true;
+        }
+        lastSendMs = hal::millis();
+        out.offset += static_cast<size_t>(sent);
+        sendingPacket = fromPacket && out.offset < out.end;
+        if (out.offset == out.end) {
+            out = {0, 0};
+        }
+    }
+}
+
+/**
+ * @brief Reads what has arrived and handles every complete packet.
+ *
+ * A packet longer than the receive buffer can only be a PUBLISH on a
+ * subscribed topic; its bytes are read and dropped.
+ *
+ * @return False if the connection failed or a packet was malformed.
+ */
+bool MqttClient::receive() {
+    for (;;) {
+        if (skipLength > 0) {
+            size_t chunk = skipLength < receiveBufferSize ? skipLength : receiveBufferSize;
+            int count = hal::tcpRead(socket, received, chunk);
+            if (count <= 0) {
+                return count == 0;
+            }
+            skipLength -= static_cast<size_t>(count);
+            continue;
+        }
+        int count = hal::tcpRead(socket, received + receivedLength, receiveBufferSize - receivedLength);
+        if (count < 0) {
+            return false;
+        }
+        receivedLength += static_cast<size_t>(count);
+        while (receivedLength >= 2) {
+            size_t length = 0;
+            size_t headerLength = 1;
+            bool complete = false;
+            for (uint8_t shift = 0; headerLength < receivedLength && shift < 28; shift += 7) {
+                uint8_t byte = received[headerLength++];
+                length |= static_cast<size_t>(byte & 0x7F) << shift;
+                if ((byte & 0x80) == 0) {
+                    complete = true;
+                    break;
+                }
+            }
+            if (!complete) {
+                if (headerLength > 4) {
+                    LOG_WARN("MQTT packet length malformed.");
+                    return false;
+                }
+                break;
+            }
+            size_t total = headerLength + length;
+            if (total > receiveBufferSize) {
+                if ((received[0] & 0xF0) != publishType) {
+                    LOG_WARN("MQTT packet type %u too long.", received[0] >> 4);
+                    return false;
+                }
+                LOG_WARN("MQTT message of %lu bytes dropped.", static_cast<unsigned long>(total));
+                skipLength = total - receivedLength;
+                receivedLength = 0;
+                break;
+            }
+            if (total > receivedLength) {
+                break;
+            }
+            if (!handlePacket(received[0], received + headerLength, length)) {
+                return false;
+            }
+            receivedLength -= total;
+            memmove(received, received + total, receivedLength);
+        }
+        if (count == 0 && skipLength == 0) {
+            return true;
+        }
+    }
+}
+
+/**
+ * @brief Acts on one received packet.
+ * @param type First byte of the packet.
+ * @return False if the connection must be dropped.
+ */
+bool MqttClient::handlePacket(uint8_t type, const uint8_t* body, size_t length) {
+    switch (type & 0xF0) {
+        case connAckType:
+            if (length < 2 || body[1] != 0) {
+                LOG_ERROR("MQTT broker refused the connection (%u).", length >= 2 ? body[1] : 0xFF);
+                return false;
+            }
+            connectCount++;
+            failedAttempts = 0;
+            LOG_INFO("MQTT connected.");
+            queueSubscribe();
+            scheduler->startTimer(timer, tickMs, tickMs);
+            setState(State::Connected);
+            return true;
+        case publishType: {
+            uint8_t qos = (type >> 1) & 3;
+            if (length < 2) {
+                return false;
+            }
+            size_t nameLength = (static_cast<size_t>(body[0]) << 8) | body[1];
+            size_t offset = 2 + nameLength + (qos > 0 ? 2 : 0);
+            if (offset > length || nameLength > maxTopicLength) {
+                return false;
+            }
+            if (qos > 0) {
+                uint8_t pubAck[] = {pubAckType, 2, body[2 + nameLength], body[3 + nameLength]};
+                queueControl(pubAck, sizeof(pubAck));
+            }
+            char name[maxTopicLength + 1];
+            memcpy(name, body + 2, nameLength);
+            name[nameLength] = '\0';
+            if (messageHandler != nullptr) {
+                messageHandler(name, body + offset, length - offset, messageContext);
+            }
+            return true;
+        }
+        case pubAckType:
+            if (length >= 2 && inFlightId != 0 && ((body[0] << 8) | body[1]) == inFlightId) {
+                inFlightId = 0;
+                if (ackHandler != nullptr) {
+                    ackHandler(ackContext);
+                }
+            }
+            return true;
+        case subAckType:
+            for (size_t i = 2; i < length; i++) {
+                if (body[i] == 0x80) {
+                    LOG_WARN("MQTT subscription refused.");
+                }
+            }
+            return true;
+        case pingRespType:
+            pingOutstanding = false;
+            return true;
+        default:
+            return true;
+    }
+}
+
+/**
+ * @brief Queues the CONNECT packet: clean session, keep-alive, will and credentials.
+ */
+void MqttClient::queueConnect() {
+    bool hasWill = willTopic != nullptr && willMessage != nullptr;
+    size_t remaining = 10 + 2 + stringLength(clientId);
+    if (hasWill) {
+        remaining += 2 + stringLength(willTopic) + 2 + stringLength(willMessage);
+    }
+    if (user != nullptr) {
+        remaining += 2 + stringLength(user);
+    }
+    if (password != nullptr) {
+        remaining += 2 + stringLength(password);
+    }
+    if (remaining + fixedHeaderReserve > controlBufferSize - controlOut.end) {
+        LOG_ERROR("MQTT client identifier, will or credentials too long.");
+        return;
+    }
+    uint8_t flags = 0x02;
+    if (hasWill) {
+        flags |= 0x04 | 0x08 | 0x20; // Will at QoS 1, retained
+    }
+    if (user != nullptr) {
+        flags |= 0x80;
+    }
+    if (password != nullptr) {
+        flags |= 0x40;
+    }
+    uint8_t* out = control + controlOut.end;
+    size_t length = 0;
+    out[length++] = connectType;
+    length += putLength(out + length, remaining);
+    length += putString(out + length, "MQTT");
+    out[length++] = 4; // Protocol level 3.1.1
+    out[length++] = flags;
+    out[length++] = static_cast<uint8_t>(keepAliveSeconds >> 8);
+    out[length++] = static_cast<uint8_t>(keepAliveSeconds);
+    length += putString(out + length, clientId);
+    if (hasWill) {
+        length += putString(out + length, willTopic);
+        length += putString(out + length, willMessage);
+    }
+    if (user != nullptr) {
+        length += putString(out + length, user);
+    }
+    if (password != nullptr) {
+        length += putString(out + length, password);
+    }
+    controlOut.end += length;
+}
+
+/**
+ * @brief Queues one SUBSCRIBE packet for every topic filter, at QoS 0.
+ */
+void MqttClient::queueSubscribe() {
+    if (subscriptionCount == 0) {
+        return;
+    }
+    uint8_t buffer[controlBufferSize];
+    size_t remaining = 2;
+    for (uint8_t i = 0; i < subscriptionCount; i++) {
+        remaining += 2 + strlen(subscriptions[i]) + 1;
+    }
+    if (remaining + fixedHeaderReserve > sizeof(buffer)) {
+        LOG_ERROR("MQTT subscriptions too long.");
+        return;
+    }
+    size_t length = 0;
+    buffer[length++] = subscribeType | 0x02;
+    length += putLength(buffer + length, remaining);
+    buffer[length++] = static_cast<uint8_t>(nextPacketId >> 8);
+    buffer[length++] = static_cast<uint8_t>(nextPacketId);
+    nextPacketId = nextPacketId == 0xFFFF ? 1 : nextPacketId + 1;
+    for (uint8_t i = 0; i < subscriptionCount; i++) {
+        length += putString(buffer + length, subscriptions[i]);
+        buffer[length++] = 0;
+    }
+    queueControl(buffer, length);
+}
+
+/**
+ * @brief Appends a control packet to the control buffer.
+ * @return False if it is full, which only a broker flooding QoS 1 messages can cause.
+ */
+bool MqttClient::queueControl(const uint8_t* data, size_t length) {
+    if (length > controlBufferSize - controlOut.end) {
+        LOG_WARN("MQTT control packet dropped.");
+        return false;
+    }
+    memcpy(control + controlOut.end, data, length);
+    controlOut.end += length;
+    return true;
+}
+
+/**
+ * @brief Encodes a remaining length.
+ * @return Bytes written, one to four.
+ */
+size_t MqttClient::putLength(uint8_t* out, size_t length) {
+    size_t count = 0;
+    do {
+        uint8_t byte = static_cast<uint8_t>(length & 0x7F);
+        length >>= 7;
+        out[count++] = static_cast<uint8_t>(byte | (length > 0 ? 0x80 : 0));
+    } while (length > 0 && count < 4);
+    return count;
+}
+
+/**
+ * @brief Writes a length-prefixed UTF-8 string.
+ * @return Bytes written.
+ */
+size_t MqttClient::putString(uint8_t* out, const char* text) {
+    size_t length = stringLength(text);
+    out[0] = static_cast<uint8_t>(length >> 8);
+    out[1] = static_cast<uint8_t>(length);
+    memcpy(out + 2, text, length);
+    return 2 + length;
+}
@@ -0,0 +1,238 @@
+/**
+ * @file MqttClient.hpp
+ * @brief Non-blocking MQTT 3.1.1 client on the HAL TCP sockets, driven by the scheduler.
+ */
+
+#ifndef MqttClient_hpp
+#define MqttClient_hpp
+
+#include <stdint.h>
+#include <stddef.h>
+#include "HAL.hpp"
+#include "Scheduler.hpp"
+
+/**
+ * @class MqttClient
+ * @brief Keeps one broker connection up while the network is, without blocking the task.
+ *
+ * Connecting, reading and writing are non-blocking; the HAL posts a
+ * scheduler event when the socket is ready and one timer covers the connect
+ * timeout, the keep-alive pings and the backoff between attempts. Failed or
+ * lost connections are retried with jittered exponential backoff, like
+ * WiFiManager does for the link below.
+ *
+ * Publishing is zero-copy: preparePublish() hands out the payload area of
+ * the packet buffer, behind room for the fixed header, topic and packet
+ * identifier, and publish() frames whatever was written there. One QoS 1
+ * message is in flight at a time; its acknowledgement is reported to the ack
+ * handler. Nothing is retransmitted: a message not acknowledged when the
+ * connection drops is lost, and the publisher sends it again from its own
+ * queue after reconnecting.
+ *
+ * Subscriptions are made at QoS 0 on every connection (clean session), so
+ * nothing is queued for the controller while it is away.
+ */
+class MqttClient {
+public:
+    static constexpr size_t packetBufferSize = 1024; // Largest publish packet
+    static constexpr size_t controlBufferSize = 256; // CONNECT, SUBSCRIBE and small acknowledgements
+    static constexpr size_t receiveBufferSize = 256; // Largest packet received; longer ones are skipped
+    static constexpr uint8_t maxSubscriptions = 4;
+    static constexpr size_t maxTopicLength = 64;
+    static constexpr uint16_t keepAliveSeconds = 60;
+    static constexpr uint32_t connectTimeoutMs = 10000; // TCP connect and CONNACK
+    static constexpr uint32_t ackTimeoutMs = 10000; // PUBACK and PINGRESP
+    static constexpr uint32_t minBackoffMs = 1000;
+    static constexpr uint32_t maxBackoffMs = 120000;
+
+    /**
+     * @enum State
+     * @brief Connection state.
+     */
+    enum class State : uint8_t {
+        Offline,    // No network or no broker
+        Connecting, // TCP connect or waiting for CONNACK
+        Connected,  // Session up, subscriptions sent
+        Backoff     // Waiting before the next attempt
+    };
+
+    /**
+     * @brief Handler of messages received on a subscription.
+     * @param topic Terminated topic name.
+     * @param payload Payload, not terminated.
+     */
+    typedef void (*MessageHandler)(const char* topic, const uint8_t* payload, size_t length, void* context);
+
+    /**
+     * @brief Handler called after every state change.
+     */
+    typedef void (*StateChangeHandler)(State state, void* context);
+
+    /**
+     * @brief Handler called when the QoS 1 message in flight was acknowledged.
+     */
+    typedef void (*AckHandler)(void* context);
+
+    /**
+     * @brief Constructs an offline client with no broker.
+     */
+    MqttClient();
+
+    /**
+     * @brief Sets the broker. Takes effect on the next connection attempt.
+     * @param address IPv4 address, first octet in the lowest byte. 0 disables the client.
+     */
+    void setBroker(uint32_t address, uint16_t port);
+
+    /**
+     * @brief Sets the broker from a dotted IPv4 address; host names are not resolved.
+     * @return False if the address is malformed; the broker is then unchanged.
+     */
+    bool setBroker(const char* address, uint16_t port);
+
+    /**
+     * @brief Sets the client identifier, which must be unique per broker. The string must outlive the client.
+     */
+    void setClientId(const char* clientId);
+
+    /**
+     * @brief Sets the user name and password, or nullptr for none. The strings must outlive the client.
+     */
+    void setCredentials(const char* user, const char* password);
+
+    /**
+     * @brief Sets the retained QoS 1 message the broker publishes if the connection is lost.
+     */
+    void setWill(const char* topic, const char* message);
+
+    void setMessageHandler(MessageHandler handler, void* context);
+    void setStateChangeHandler(StateChangeHandler handler, void* context);
+    void setAckHandler(AckHandler handler, void* context);
+
+    /**
+     * @brief Adds a topic filter subscribed on every connection. Must be called before begin().
+     * @return False if the table is full.
+     */
+    bool subscribe(const char* topicFilter);
+
+    /**
+     * @brief Registers the socket event and the timer.
+     */
+    void begin(Scheduler& scheduler);
+
+    /**
+     * @brief Tells the client whether the network is up; it connects while it is.
+     */
+    void setNetworkAvailable(bool available);
+
+    /**
+     * @brief True if connected, the packet buffer is free and no QoS 1 message is in flight.
+     */
+    bool canPublish() const;
+
+    /**
+     * @brief Starts a publish packet and returns where its payload goes.
+     * @param[out] capacity Bytes available for the payload.
+     * @return Payload area, or nullptr if canPublish() is false or the topic is too long.
+     */
+    char* preparePublish(const char* topic, size_t& capacity);
+
+    /**
+     * @brief Sends the packet started by preparePublish() with the payload written there.
+     * @param qos1 Wait for a PUBACK, reported to the ack handler; otherwise QoS 0.
+     * @return False if nothing was prepared or the payload is too long.
+     */
+    bool publish(size_t payloadLength, bool qos1, bool retain);
+
+    /**
+     * @brief Drops the packet started by preparePublish().
+     */
+    void cancelPublish();
+
+    /**
+     * @brief Publishes a short terminated payload at QoS 0.
+     */
+    bool publish(const char* topic, const char* payload, bool retain);
+
+    State getState() const;
+
+    /**
+     * @brief Publish packets handed to TCP since construction.
+     */
+    uint32_t getPublishCount() const;
+
+    /**
+     * @brief Successful connections since construction.
+     */
+    uint32_t getConnectCount() const;
+
+private:
+    /**
+     * @brief Bytes waiting to be handed to TCP.
+     */
+    struct Outgoing {
+        size_t offset; // Next byte to send
+        size_t end; // End of the bytes to send
+    };
+
+    static void onSocketReady(void* context); // From the HAL, possibly in another task
+    static void onReadyEvent(void* context);
+    static void onTimer(void* context);
+    void setState(State newState);
+    void connect(); // Starts a TCP connection attempt
+    void fail(); // Closes the socket and backs off
+    void startBackoff();
+    uint32_t nextBackoffDelay();
+    void service(); // Connects, sends and receives as far as the socket allows
+    bool flush(); // Sends pending bytes; false if the connection failed
+    bool receive(); // Reads and handles packets; false if the connection failed or a packet was bad
+    bool handlePacket(uint8_t type, const uint8_t* body, size_t length);
+    void queueConnect();
+    void queueSubscribe();
+    bool queueControl(const uint8_t* packet, size_t length);
+    static size_t putLength(uint8_t* out, size_t length); // Remaining length varint
+    static size_t putString(uint8_t* out, const char* text);
+
+    Scheduler* scheduler;
+    uint8_t readyEvent;
+    uint8_t timer;
+    State state;
+    int socket; // hal::invalidSocket when not connected
+    bool tcpConnected; // TCP is up, CONNECT queued
+    bool networkAvailable;
+    uint32_t brokerAddress;
+    uint16_t brokerPort;
+    const char* clientId;
+    const char* user;
+    const char* password;
+    const char* willTopic;
+    const char* willMessage;
+    const char* subscriptions[maxSubscriptions];
+    uint8_t subscriptionCount;
+    MessageHandler messageHandler;
+    void* messageContext;
+    StateChangeHandler stateHandler;
+    void* stateContext;
+    AckHandler ackHandler;
+    void* ackContext;
+    uint8_t packet[packetBufferSize]; // Publish packet being built or sent
+    size_t topicLength; // Topic of the prepared packet, 0 if none is prepared
+    Outgoing packetOut; // Publish bytes to send
+    uint8_t control[controlBufferSize]; // Control packets to send after the publish packet
+    Outgoing controlOut;
+    bool sendingPacket; // The publish packet started going out and must finish first
+    uint8_t received[receiveBufferSize]; // Bytes of the packet being received
+    size_t receivedLength;
+    size_t skipLength; // Bytes left of a packet too long to keep
+    uint16_t nextPacketId;
+    uint16_t inFlightId; // QoS 1 message waiting for PUBACK, 0 if none
+    uint32_t inFlightSinceMs;
+    bool pingOutstanding;
+    uint32_t pingSentMs;
+    uint32_t lastSendMs; // Last packet handed to TCP, for keep-alive
+    uint8_t failedAttempts; // Since the last successful connection
+    uint32_t publishCount;
+    uint32_t connectCount;
+};
+
+#endif /* MqttClient_hpp */
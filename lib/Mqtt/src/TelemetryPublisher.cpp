@@ -0,0 +1,242 @@
+/**
+ * @file TelemetryPublisher.cpp
+ * @brief Implementation of the batched MQTT telemetry publisher.
+ */
+
+#include "TelemetryPublisher.hpp"
+#include "DebugLogger.hpp"
+#include "HAL.hpp"
+
+namespace {
+
+const char cursorKey[] = "mqtt.cursor";
+constexpr size_t closingBytes = 2; // "]}" after the last record
+
+} // namespace
+
+/**
+ * @brief Constructs a publisher of a log through a client.
+ * @param channelNames Name of each log channel, indexed by channel identifier.
+ */
+TelemetryPublisher::TelemetryPublisher(MqttClient& client, TelemetryStore& log, const char* const* channelNames)
+    : client(client), log(log), channelNames(channelNames), scheduler(nullptr), timer(Scheduler::invalidId),
+      topic(nullptr), statusTopic(nullptr), publishIntervalMs(1000 / defaultRate), intervalMs(0), cursor(),
+      pending(), pendingRecords(0), caughtUp(false), logRecordsSeen(0), savedCursor(), lastSaveMs(0),
+      messageCount(0), recordCount(0) {}
+
+/**
+ * @brief Limits batches to this many per second while catching up.
+ */
+void TelemetryPublisher::setRateLimit(uint16_t messagesPerSecond) {
+    publishIntervalMs = messagesPerSecond > 0 && messagesPerSecond < 1000 ? 1000 / messagesPerSecond : 1;
+    if (intervalMs != 0 && !caughtUp) {
+        setInterval(publishIntervalMs);
+    }
+}
+
+/**
+ * @brief Sets the topic where "online" is published, retained, on every connection.
+ *
+ * Also makes "offline" the client's will on that topic, so the topic
+ * always tells whether the controller is reachable.
+ */
+void TelemetryPublisher::setStatusTopic(const char* topic) {
+    statusTopic = topic;
+    client.setWill(topic, "offline");
+}
+
+/**
+ * @brief Restores the cursor from NVS and takes over the client's state and ack handlers.
+ *
+ * Without a saved cursor publishing starts maxBacklogMs back.
+ *
+ * @param topic Telemetry topic; the string must outlive the publisher.
+ */
+void TelemetryPublisher::begin(Scheduler& scheduler, const char* topic) {
+    this->scheduler = &scheduler;
+    this->topic = topic;
+    timer = scheduler.addTimer(onTimer, this);
+    if (timer == Scheduler::invalidId) {
+        LOG_ERROR("Telemetry publisher has no timer.");
+        return;
+    }
+    if (!hal::nvsRead(cursorKey, &cursor, sizeof(cursor))) {
+        cursor = {0, 0};
+    }
+    savedCursor = cursor;
+    lastSaveMs = hal::millis();
+    client.setStateChangeHandler(onClientState, this);
+    client.setAckHandler(onAck, this);
+}
+
+/**
+ * @brief True if the last batch emptied the log and was acknowledged.
+ */
+bool TelemetryPublisher::isCaughtUp() const {
+    return caughtUp && pendingRecords == 0;
+}
+
+/**
+ * @brief Log time of the oldest record not yet acknowledged.
+ */
+uint64_t TelemetryPublisher::getCursorMs() const {
+    return cursor.nextMs;
+}
+
+/**
+ * @brief Batches acknowledged since construction.
+ */
+uint32_t TelemetryPublisher::getMessageCount() const {
+    return messageCount;
+}
+
+/**
+ * @brief Records in the batches acknowledged since construction.
+ */
+uint32_t TelemetryPublisher::getRecordCount() const {
+    return recordCount;
+}
+
+/**
+ * @brief Sends the next batch, unless one is in flight or nothing was logged since the last.
+ */
+void TelemetryPublisher::onTimer(void* context) {
+    TelemetryPublisher* publisher = static_cast<TelemetryPublisher*>(context);
+    if (!publisher->client.canPublish()) {
+        return;
+    }
+    if (publisher->caughtUp && publisher->log.getRecordCount() == publisher->logRecordsSeen) {
+        return;
+    }
+    publisher->publishBatch();
+}
+
+/**
+ * @brief Announces the controller and starts draining on connection; stops on disconnection.
+ *
+ * A cursor older than maxBacklogMs, or ahead of the log clock because the
+ * log was replaced, is moved to maxBacklogMs back.
+ */
+void TelemetryPublisher::onClientState(MqttClient::State state, void* context) {
+    TelemetryPublisher* publisher = static_cast<TelemetryPublisher*>(context);
+    if (state != MqttClient::State::Connected) {
+        publisher->scheduler->stopTimer(publisher->timer);
+        publisher->intervalMs = 0;
+        publisher->pendingRecords = 0;
+        return;
+    }
+    if (publisher->statusTopic != nullptr) {
+        publisher->client.publish(publisher->statusTopic, "online", true);
+    }
+    uint64_t now = publisher->log.now();
+    uint64_t oldest = now > maxBacklogMs ? now - maxBacklogMs : 0;
+    if (publisher->cursor.nextMs < oldest || publisher->cursor.nextMs > now) {
+        LOG_WARN("Telemetry backlog before %llu ms skipped.", static_cast<unsigned long long>(oldest));
+        publisher->cursor = {oldest, 0};
+    }
+    publisher->caughtUp = false;
+    publisher->setInterval(publisher->publishIntervalMs);
+}
+
+/**
+ * @brief Moves the cursor past the acknowledged batch and saves it now and then.
+ */
+void TelemetryPublisher::onAck(void* context) {
+    TelemetryPublisher* publisher = static_cast<TelemetryPublisher*>(context);
+    if (publisher->pendingRecords == 0) {
+        return;
+    }
+    publisher->cursor = publisher->pending;
+    publisher->messageCount++;
+    publisher->recordCount += publisher->pendingRecords;
+    publisher->pendingRecords = 0;
+    uint32_t now = hal::millis();
+    Cursor& saved = publisher->savedCursor;
+    if (now - publisher->lastSaveMs >= cursorSaveIntervalMs &&
+        (saved.nextMs != publisher->cursor.nextMs || saved.written != publisher->cursor.written)) {
+        if (hal::nvsWrite(cursorKey, &publisher->cursor, sizeof(publisher->cursor))) {
+            saved = publisher->cursor;
+        }
+        publisher->lastSaveMs = now;
+    }
+}
+
+/**
+ * @brief Writes one record into the batch and moves the batch cursor past it.
+ *
+ * The records the cursor says were already sent are skipped, as long as
+ * they still carry its time: if the ring has overwritten them, the query
+ * starts at newer records, which are all sent.
+ */
+void TelemetryPublisher::writeRecord(uint8_t channel, uint64_t timeMs, int32_t value, void* context) {
+    Batch& batch = *static_cast<Batch*>(context);
+    if (batch.skip > 0) {
+        if (timeMs == batch.cursor.nextMs) {
+            batch.skip--;
+            return;
+        }
+        batch.skip = 0;
+    }
+    if (batch.full) {
+        return;
+    }
+    JsonWriter& json = *batch.json;
+    if (batch.records >= maxBatchRecords || json.remaining() < recordJson + closingBytes) {
+        batch.full = true;
+        return;
+    }
+    if (batch.records == 0) {
+        json.key("t").number(static_cast<int64_t>(timeMs)).key("r").beginArray();
+        batch.previousMs = timeMs;
+    }
+    const char* name = batch.publisher->channelNames[channel];
+    json.beginArray()
+        .number(static_cast<int64_t>(timeMs - batch.previousMs))
+        .string(name != nullptr ? name : "")
+        .number(value)
+        .endArray();
+    batch.previousMs = timeMs;
+    batch.cursor.written = timeMs == batch.cursor.nextMs ? batch.cursor.written + 1 : 1;
+    batch.cursor.nextMs = timeMs;
+    batch.records++;
+}
+
+/**
+ * @brief Reads the records after the cursor straight into a publish packet and sends it at QoS 1.
+ *
+ * A batch that holds every record up to now means the backlog is drained:
+ * the timer then slows to liveIntervalMs, and speeds up again when a batch
+ * fills up.
+ */
+void TelemetryPublisher::publishBatch() {
+    size_t capacity = 0;
+    char* payload = client.preparePublish(topic, capacity);
+    if (payload == nullptr) {
+        return;
+    }
+    JsonWriter json(payload, capacity);
+    json.beginObject();
+    Batch batch = {this, &json, cursor, cursor.written, 0, 0, false};
+    uint32_t logRecords = log.getRecordCount();
+    log.query(cursor.nextMs, log.now(), writeRecord, &batch, cursor.written + maxBatchRecords + 1);
+    caughtUp = !batch.full;
+    logRecordsSeen = logRecords;
+    setInterval(caughtUp ? liveIntervalMs : publishIntervalMs);
+    if (batch.records == 0) {
+        client.cancelPublish();
+        return;
+    }
+    json.endArray().endObject();
+    if (client.publish(json.length(), true, false)) {
+        pending = batch.cursor;
+        pendingRecords = batch.records;
+    }
+}
+
+void TelemetryPublisher::setInterval(uint32_t intervalMs) {
+    if (this->intervalMs == intervalMs) {
+        return;
+    }
+    this->intervalMs = intervalMs;
+    scheduler->startTimer(timer, intervalMs, intervalMs);
+}
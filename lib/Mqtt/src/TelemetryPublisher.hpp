@@ -0,0 +1,143 @@
+/**
+ * @file TelemetryPublisher.hpp
+ * @brief Publishes the telemetry log to MQTT in batches, catching up after time offline.
+ */
+
+#ifndef TelemetryPublisher_hpp
+#define TelemetryPublisher_hpp
+
+#include <stdint.h>
+#include <stddef.h>
+#include "JsonWriter.hpp"
+#include "MqttClient.hpp"
+#include "Scheduler.hpp"
+#include "TelemetryStore.hpp"
+
+/**
+ * @class TelemetryPublisher
+ * @brief Drains the telemetry log into rate-limited QoS 1 batches.
+ *
+ * The outbound queue is the telemetry log itself: the publisher only keeps a
+ * cursor into it, the time of the last record the broker acknowledged and
+ * how many records at that time were sent. While the broker is unreachable
+ * records keep going to flash as usual and nothing is held in RAM; once it
+ * is back, batches are read from the cursor on, so the backlog is bounded by
+ * the flash ring and maxBacklogMs rather than by memory. The cursor is saved
+ * to NVS now and then, so a restart resends at most the last few minutes.
+ *
+ * Each batch is one message on the telemetry topic:
+ *
+ *     {"t":<log time of the first record>,"r":[[<ms after the previous record>,"<channel>",<value>],...]}
+ *
+ * with times on the log clock and values as logged, like /api/history. The
+ * cursor only moves when the broker acknowledges the batch; a batch lost
+ * with the connection is built again and sent after reconnecting, so every
+ * record arrives at least once.
+ *
+ * A backlog goes out at the rate limit. Once caught up, new records are
+ * collected for liveIntervalMs and sent together.
+ */
+class TelemetryPublisher {
+public:
+    static constexpr uint16_t maxBatchRecords = 64;
+    static constexpr size_t recordJson = 48; // Longest record, with its comma
+    static constexpr uint32_t liveIntervalMs = 5000; // Between batches once caught up
+    static constexpr uint32_t cursorSaveIntervalMs = 300000; // Shortest time between NVS writes
+    static constexpr uint64_t maxBacklogMs = 7ull * 24 * 3600 * 1000; // Older records are not sent
+    static constexpr uint16_t defaultRate = 5; // Messages per second while catching up
+
+    /**
+     * @brief Constructs a publisher of a log through a client.
+     * @param channelNames Name of each log channel, indexed by channel identifier.
+     */
+    TelemetryPublisher(MqttClient& client, TelemetryStore& log, const char* const* channelNames);
+
+    /**
+     * @brief Limits batches to this many per second while catching up.
+     */
+    void setRateLimit(uint16_t messagesPerSecond);
+
+    /**
+     * @brief Sets the topic where "online" is published, retained, on every connection.
+     *
+     * Also makes "offline" the client's will on that topic, so the topic
+     * always tells whether the controller is reachable.
+     */
+    void setStatusTopic(const char* topic);
+
+    /**
+     * @brief Restores the cursor from NVS and takes over the client's state and ack handlers.
+     * @param topic Telemetry topic; the string must outlive the publisher.
+     */
+    void begin(Scheduler& scheduler, const char* topic);
+
+    /**
+     * @brief True if every record logged so far was acknowledged.
+     */
+    bool isCaughtUp() const;
+
+    /**
+     * @brief Log time of the oldest record not yet acknowledged.
+     */
+    uint64_t getCursorMs() const;
+
+    /**
+     * @brief Batches acknowledged since construction.
+     */
+    uint32_t getMessageCount() const;
+
+    /**
+     * @brief Records in the batches acknowledged since construction.
+     */
+    uint32_t getRecordCount() const;
+
+private:
+    /**
+     * @brief Position in the log: the next record is after the first written records at nextMs.
+     */
+    struct Cursor {
+        uint64_t nextMs;
+        uint32_t written;
+    };
+
+    /**
+     * @brief A batch being written.
+     */
+    struct Batch {
+        TelemetryPublisher* publisher;
+        JsonWriter* json;
+        Cursor cursor; // After the last record written
+        uint32_t skip; // Records at the cursor already acknowledged
+        uint64_t previousMs; // Time of the previous record written
+        uint16_t records;
+        bool full; // A record did not fit
+    };
+
+    static void onTimer(void* context);
+    static void onClientState(MqttClient::State state, void* context);
+    static void onAck(void* context);
+    static void writeRecord(uint8_t channel, uint64_t timeMs, int32_t value, void* context);
+    void publishBatch();
+    void setInterval(uint32_t intervalMs);
+
+    MqttClient& client;
+    TelemetryStore& log;
+    const char* const* channelNames;
+    Scheduler* scheduler;
+    uint8_t timer;
+    const char* topic;
+    const char* statusTopic;
+    uint32_t publishIntervalMs; // Between batches while catching up
+    uint32_t intervalMs; // Current timer period
+    Cursor cursor; // Acknowledged up to here
+    Cursor pending; // Where the batch in flight ends
+    uint16_t pendingRecords; // Records in the batch in flight, 0 if none
+    bool caughtUp;
+    uint32_t logRecordsSeen; // Log record count when the publisher last caught up
+    Cursor savedCursor; // Last written to NVS
+    uint32_t lastSaveMs;
+    uint32_t messageCount;
+    uint32_t recordCount;
+};
+
+#endif /* TelemetryPublisher_hpp */
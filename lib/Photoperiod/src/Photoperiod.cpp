@@ -0,0 +1,235 @@
+/**
+ * @file Photoperiod.cpp
+ * @brief Implementation of the photoperiod engine.
+ */
+
+#include "Photoperiod.hpp"
+
+/**
+ * @brief Constructs an idle engine driving the strip of an LED controller.
+ */
+Photoperiod::Photoperiod(LEDControllerBase* ledController)
+    : ledController(ledController), scheduler(nullptr), timer(Scheduler::invalidId), program(nullptr),
+      phase(Phase::Off), timeOfDayMs(0), lastClockMs(0), rampSteps(0), rampScale(1), curveStep(0), curve(0),
+      curveDelta1(0), curveDelta2(0), color{0, 0, 0} {}
+
+/**
+ * @brief Registers the phase timer with the scheduler.
+ *
+ * The time of day starts at midnight until setTimeOfDay() is called.
+ */
+void Photoperiod::begin(Scheduler& scheduler) {
+    this->scheduler = &scheduler;
+    timer = scheduler.addTimer(onTimer, this);
+    lastClockMs = static_cast<uint32_t>(hal::millis());
+}
+
+/**
+ * @brief Sets the time of day and re-evaluates a running program for it.
+ * @param secondsSinceMidnight Current local time; taken modulo one day.
+ */
+void Photoperiod::setTimeOfDay(uint32_t secondsSinceMidnight) {
+    timeOfDayMs = (secondsSinceMidnight % secondsPerDay) * 1000;
+    lastClockMs = static_cast<uint32_t>(hal::millis());
+    if (program != nullptr) {
+        phase = Phase::Off; // The curve generator cannot run backwards; reseed it.
+        evaluate(true);
+    }
+}
+
+/**
+ * @brief Current time of day in milliseconds since midnight.
+ */
+uint32_t Photoperiod::getTimeOfDayMs() {
+    advanceClock();
+    return timeOfDayMs;
+}
+
+/**
+ * @brief Starts or switches to a program, fading to the light it calls for now.
+ *
+ * Ramps longer than half the day are shortened to fit.
+ *
+ * @param program Schedule to follow; must outlive the run.
+ */
+void Photoperiod::start(const PhotoperiodProgram& program) {
+    this->program = &program;
+    uint32_t dayMs = (program.dayLengthSeconds < secondsPerDay ? program.dayLengthSeconds : secondsPerDay) * 1000;
+    rampSteps = program.rampSeconds * 1000 / stepMs;
+    if (rampSteps * stepMs * 2 > dayMs) {
+        rampSteps = dayMs / 2 / stepMs;
+    }
+    rampScale = static_cast<int64_t>(rampSteps) * rampSteps * rampSteps;
+    if (rampScale == 0) {
+        rampScale = 1;
+    }
+    phase = Phase::Off;
+    evaluate(true);
+}
+
+/**
+ * @brief Stops following the program. The strip is left as it is.
+ */
+void Photoperiod::stop() {
+    if (scheduler != nullptr) {
+        scheduler->stopTimer(timer);
+    }
+    program = nullptr;
+    phase = Phase::Off;
+}
+
+/**
+ * @brief Program being followed, or nullptr when stopped.
+ */
+const PhotoperiodProgram* Photoperiod::getProgram() const {
+    return program;
+}
+
+/**
+ * @brief Current phase of the day.
+ */
+Photoperiod::Phase Photoperiod::getPhase() const {
+    return phase;
+}
+
+/**
+ * @brief Colour last sent to the strip.
+ */
+LedStripFader::Color Photoperiod::getColor() const {
+    return color;
+}
+
+/**
+ * @brief Re-evaluates at a step or phase boundary.
+ */
+void Photoperiod::onTimer(void* context) {
+    static_cast<Photoperiod*>(context)->evaluate(false);
+}
+
+/**
+ * @brief Adds the millis() elapsed since the last call to the time of day.
+ *
+ * Works on differences only, so the 49-day millis() wrap does not disturb it.
+ */
+void Photoperiod::advanceClock() {
+    uint32_t now = static_cast<uint32_t>(hal::millis());
+    uint32_t elapsed = (now - lastClockMs) % msPerDay;
+    lastClockMs = now;
+    timeOfDayMs = (timeOfDayMs + elapsed) % msPerDay;
+}
+
+/**
+ * @brief Sets phase, light and timer for the current time.
+ *
+ * Within a ramp the generator is stepped on from where it was; after a
+ * phase change, a restart or a stall that left it behind in another phase it
+ * is seeded afresh.
+ *
+ * @param restart Send the light level even if it has not changed.
+ */
+void Photoperiod::evaluate(bool restart) {
+    advanceClock();
+    if (program == nullptr) {
+        return;
+    }
+    const uint32_t lightsOnMs = (program->lightsOnSecond % secondsPerDay) * 1000;
+    const uint32_t dayMs = (program->dayLengthSeconds < secondsPerDay ? program->dayLengthSeconds : secondsPerDay) * 1000;
+    const uint32_t rampMs = rampSteps * stepMs;
+    const uint32_t sinceLightsOn = (timeOfDayMs + msPerDay - lightsOnMs) % msPerDay;
+
+    Phase next;
+    uint32_t phaseStart;
+    uint32_t phaseEnd;
+    if (sinceLightsOn >= dayMs) {
+        next = Phase::Night;
+        phaseStart = dayMs;
+        phaseEnd = msPerDay;
+    } else if (sinceLightsOn < rampMs) {
+        next = Phase::Dawn;
+        phaseStart = 0;
+        phaseEnd = rampMs;
+    } else if (sinceLightsOn < dayMs - rampMs) {
+        next = Phase::Day;
+        phaseStart = rampMs;
+        phaseEnd = dayMs - rampMs;
+    } else {
+        next = Phase::Dusk;
+        phaseStart = dayMs - rampMs;
+        phaseEnd = dayMs;
+    }
+
+    uint32_t wait = phaseEnd - sinceLightsOn;
+    int32_t level = next == Phase::Day ? fullLevel : 0;
+    uint32_t fadeMs = startFadeMs;
+    if (next == Phase::Dawn || next == Phase::Dusk) {
+        // Fade to the level of the next step boundary and arrive on it.
+        uint32_t intoRamp = sinceLightsOn - phaseStart;
+        uint32_t step = intoRamp / stepMs + 1;
+        wait = step * stepMs - intoRamp;
+        fadeMs = wait;
+        if (next == phase && step >= curveStep) {
+            while (curveStep < step) {
+                advanceRamp();
+            }
+        } else {
+            seedRamp(step);
+        }
+        level = static_cast<int32_t>(curve * fullLevel / rampScale);
+        if (next == Phase::Dusk) {
+            level = fullLevel - level;
+        }
+        restart = true;
+    } else if (next != phase) {
+        restart = true;
+    }
+    phase = next;
+    if (restart) {
+        output(level, fadeMs);
+    }
+    if (scheduler != nullptr) {
+        scheduler->startTimer(timer, wait);
+    }
+}
+
+/**
+ * @brief Sets the curve generator to a step in closed form.
+ */
+void Photoperiod::seedRamp(uint32_t step) {
+    const int64_t n = rampSteps;
+    const int64_t k = step;
+    curveStep = step;
+    curve = 3 * n * k * k - 2 * k * k * k;
+    curveDelta1 = 6 * n * k + 3 * n - 6 * k * k - 6 * k - 2;
+    curveDelta2 = 6 * n - 12 * k - 12;
+}
+
+/**
+ * @brief Moves the curve generator one step on: three additions.
+ */
+void Photoperiod::advanceRamp() {
+    curve += curveDelta1;
+    curveDelta1 += curveDelta2;
+    curveDelta2 -= 12;
+    curveStep++;
+}
+
+/**
+ * @brief Fades the strip to a light level.
+ *
+ * The spectrum is blended from the edge colour to the day colour by the
+ * level, and the result is scaled by the level again.
+ *
+ * @param level Light level, 0 to fullLevel.
+ * @param fadeMs Fade length.
+ */
+void Photoperiod::output(int32_t level, uint32_t fadeMs) {
+    const uint8_t edge[3] = {program->edgeColor.red, program->edgeColor.green, program->edgeColor.blue};
+    const uint8_t day[3] = {program->dayColor.red, program->dayColor.green, program->dayColor.blue};
+    uint8_t channels[3];
+    for (uint8_t i = 0; i < 3; i++) {
+        int32_t blended = (edge[i] * fullLevel + (day[i] - edge[i]) * level) / fullLevel;
+        channels[i] = static_cast<uint8_t>(blended * level / fullLevel);
+    }
+    color = {channels[0], channels[1], channels[2]};
+    ledController->fadeLedStripTo(color, fadeMs);
+}
@@ -0,0 +1,134 @@
+/**
+ * @file Photoperiod.hpp
+ * @brief Daily light schedule with smooth dawn and dusk ramps on the LED strip.
+ */
+
+#ifndef Photoperiod_hpp
+#define Photoperiod_hpp
+
+#include <stdint.h>
+#include "LEDController.hpp"
+#include "Scheduler.hpp"
+
+/**
+ * @brief Light schedule of one grow stage.
+ *
+ * The lit part of the day starts with dawn at lightsOnSecond and ends with
+ * the end of dusk dayLengthSeconds later; it may run past midnight. Over a
+ * ramp the intensity follows a smoothstep curve and the spectrum moves from
+ * edgeColor to dayColor, so first and last light are dim and warm or cool as
+ * the stage needs.
+ */
+struct PhotoperiodProgram {
+    uint32_t lightsOnSecond;        // Start of dawn, seconds after midnight
+    uint32_t dayLengthSeconds;      // Start of dawn to end of dusk
+    uint32_t rampSeconds;           // Length of dawn and of dusk, rounded down to whole steps
+    LedStripFader::Color edgeColor; // Spectrum at first and last light
+    LedStripFader::Color dayColor;  // Colour during the day
+};
+
+/**
+ * @class Photoperiod
+ * @brief Runs a PhotoperiodProgram on the LED strip.
+ *
+ * The engine keeps its own time of day, advanced by the elapsed millis()
+ * between evaluations, and wakes only at phase boundaries and, during a ramp,
+ * once per step. Each step hands the LEDC hardware a fade to the level of the
+ * next step, so the light moves continuously in between. The ramp curve
+ * S(k) = 3Nk^2 - 2k^3 over N steps is evaluated by exact integer forward
+ * differences: every step costs three additions, and only starting a program
+ * or recovering from a long stall evaluates it in closed form.
+ */
+class Photoperiod {
+public:
+    static constexpr uint32_t secondsPerDay = 86400;
+    static constexpr uint32_t stepMs = 10000; // Ramp evaluation interval
+    static constexpr uint32_t startFadeMs = 2000; // Fade to the current light level when a program starts
+
+    /**
+     * @enum Phase
+     * @brief Part of the day the program is in.
+     */
+    enum class Phase : uint8_t {
+        Off,    // No program running.
+        Night,  // Lights off.
+        Dawn,   // Ramping up.
+        Day,    // Full day colour.
+        Dusk    // Ramping down.
+    };
+
+    /**
+     * @brief Constructs an idle engine driving the strip of an LED controller.
+     */
+    explicit Photoperiod(LEDControllerBase* ledController);
+
+    /**
+     * @brief Registers the phase timer with the scheduler.
+     */
+    void begin(Scheduler& scheduler);
+
+    /**
+     * @brief Sets the time of day, for example from a network clock.
+     * @param secondsSinceMidnight Current local time; taken modulo one day.
+     */
+    void setTimeOfDay(uint32_t secondsSinceMidnight);
+
+    /**
+     * @brief Current time of day in milliseconds since midnight.
+     */
+    uint32_t getTimeOfDayMs();
+
+    /**
+     * @brief Starts or switches to a program, fading to the light it calls for now.
+     * @param program Schedule to follow; must outlive the run.
+     */
+    void start(const PhotoperiodProgram& program);
+
+    /**
+     * @brief Stops following the program. The strip is left as it is.
+     */
+    void stop();
+
+    /**
+     * @brief Program being followed, or nullptr when stopped.
+     */
+    const PhotoperiodProgram* getProgram() const;
+
+    /**
+     * @brief Current phase of the day.
+     */
+    Phase getPhase() const;
+
+    /**
+     * @brief Colour last sent to the strip.
+     */
+    LedStripFader::Color getColor() const;
+
+private:
+    static constexpr uint32_t msPerDay = secondsPerDay * 1000;
+    static constexpr int32_t fullLevel = 65535; // Level of full day light
+
+    static void onTimer(void* context); // Re-evaluates at a step or phase boundary
+    void advanceClock(); // Adds the millis() elapsed since the last call to the time of day
+    void evaluate(bool restart); // Sets phase, light and timer for the current time
+    void seedRamp(uint32_t step); // Sets the curve generator to step in closed form
+    void advanceRamp(); // Moves the curve generator one step on
+    void output(int32_t level, uint32_t fadeMs); // Fades the strip to a light level
+
+    LEDControllerBase* ledController; // Owner of the strip fader
+    Scheduler* scheduler; // Scheduler running the phase timer
+    uint8_t timer; // Fires at the next step or phase boundary
+    const PhotoperiodProgram* program; // Program being followed
+    Phase phase; // Current phase
+    uint32_t timeOfDayMs; // Milliseconds since midnight at lastClockMs
+    uint32_t lastClockMs; // millis() when the time of day was last advanced
+    uint32_t rampSteps; // N, steps per ramp
+    int64_t rampScale; // N^3, the curve value at the end of a ramp
+    uint32_t curveStep; // k, step the generator is at
+    int64_t curve; // S(k)
+    int64_t curveDelta1; // S(k+1) - S(k)
+    int64_t curveDelta2; // Second difference at k; the third is constant
+    LedStripFader::Color color; // Colour last sent to the strip
+};
+
+#endif /* Photoperiod_hpp */
@@ -0,0 +1,134 @@
+/**
+ * @file Profiler.cpp
+ * @brief Implementation of the latency histograms and their serial dump.
+ */
+
+#include "Profiler.hpp"
+#include <stdio.h>
+
+LatencyHistogram* Profiler::head = nullptr;
+
+/**
+ * @brief Creates an empty histogram and prepends it to the global list.
+ * @param name Label printed by Profiler::dump().
+ */
+LatencyHistogram::LatencyHistogram(const char* name) : name(name), next(Profiler::head) {
+    reset();
+    Profiler::head = this;
+}
+
+/**
+ * @brief Adds one sample.
+ * @param cycles Duration in CPU cycles.
+ */
+void LatencyHistogram::record(uint32_t cycles) {
+    buckets[bucketFor(cycles)]++;
+    count++;
+    if (cycles > maxCycles) {
+        maxCycles = cycles;
+    }
+}
+
+/**
+ * @brief Estimates a percentile from the bucket counts.
+ * @param percent Percentile between 0 and 100.
+ * @return Upper bound of the bucket holding the percentile, capped at the maximum.
+ */
+uint32_t LatencyHistogram::percentile(uint8_t percent) const {
+    if (count == 0) {
+        return 0;
+    }
+    uint64_t rank = (static_cast<uint64_t>(count) * percent + 99) / 100;
+    if (rank == 0) {
+        rank = 1;
+    }
+    uint64_t seen = 0;
+    for (uint8_t bucket = 0; bucket < bucketCount; bucket++) {
+        seen += buckets[bucket];
+        if (seen >= rank) {
+            uint32_t bound = bucketUpperBound(bucket);
+            return bound < maxCycles ? bound : maxCycles;
+        }
+    }
+    return maxCycles;
+}
+
+/**
+ * @brief Discards all samples.
+ */
+void LatencyHistogram::reset() {
+    for (auto& bucket : buckets) {
+        bucket = 0;
+    }
+    count = 0;
+    maxCycles = 0;
+}
+
+/**
+ * @brief Maps a value to its bucket: exact below 4, then four buckets per octave.
+ */
+uint8_t LatencyHistogram::bucketFor(uint32_t cycles) {
+    constexpr uint32_t subBuckets = 1U << subBucketBits;
+    if (cycles < subBuckets) {
+        return static_cast<uint8_t>(cycles);
+    }
+    uint8_t msb = 31 - __builtin_clz(cycles);
+    uint8_t sub = (cycles >> (msb - subBucketBits)) & (subBuckets - 1);
+    return static_cast<uint8_t>(((msb - subBucketBits + 1) << subBucketBits) + sub);
+}
+
+/**
+ * @brief Largest value that maps to the given bucket.
+ */
+uint32_t LatencyHistogram::bucketUpperBound(uint8_t bucket) {
+    constexpr uint32_t subBuckets = 1U << subBucketBits;
+    if (bucket < subBuckets) {
+        return bucket;
+    }
+    uint8_t shift = (bucket >> subBucketBits) - 1;
+    uint64_t lower = static_cast<uint64_t>(subBuckets + (bucket & (subBuckets - 1))) << shift;
+    uint64_t upper = lower + (1ULL << shift) - 1;
+    return upper > 0xFFFFFFFFULL ? 0xFFFFFFFFUL : static_cast<uint32_t>(upper);
+}
+
+/**
+ * @brief Prints one line per histogram with microsecond values.
+ */
+void Profiler::dump() {
+    uint32_t perUs = hal::cyclesPerMicrosecond();
+    hal::serialPrintln("[PROFILE] span                        count      p50 us      p99 us      max us");
+    for (LatencyHistogram* histogram = head; histogram != nullptr; histogram = histogram->getNext()) {
+        char line[112];
+        snprintf(line, sizeof(line), "[PROFILE] %-24s %9lu %11.2f %11.2f %11.2f",
+            histogram->getName(),
+            static_cast<unsigned long>(histogram->getCount()),
+            static_cast<double>(histogram->percentile(50)) / perUs,
+            static_cast<double>(histogram->percentile(99)) / perUs,
+            static_cast<double>(histogram->getMax()) / perUs);
+        hal::serialPrintln(line);
+    }
+}
+
+/**
+ * @brief Clears every registered histogram.
+ */
+void Profiler::resetAll() {
+    for (LatencyHistogram* histogram = head; histogram != nullptr; histogram = histogram->getNext()) {
+        histogram->reset();
+    }
+}
+
+/**
+ * @brief Executes pending single-character serial commands.
+ */
+void Profiler::pollSerial() {
+    int command;
+    while ((command = hal::serialRead()) >= 0) {
+        if (command == 'p') {
+            dump();
+        } else if (command == 'r') {
+            resetAll();
+            hal::serialPrintln("[PROFILE] histograms reset");
+        }
+    }
+}
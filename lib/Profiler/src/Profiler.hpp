@@ -0,0 +1,119 @@
+/**
+ * @file Profiler.hpp
+ * @brief Cycle-accurate latency spans feeding fixed-memory log-scale histograms.
+ *
+ * Profiling is compiled in only when PROFILING_ENABLED is defined. Otherwise
+ * PROFILE_HISTOGRAM and PROFILE_SPAN expand to nothing and cost nothing.
+ */
+
+#ifndef Profiler_hpp
+#define Profiler_hpp
+
+#include "HAL.hpp"
+
+/**
+ * @class LatencyHistogram
+ * @brief Log-linear histogram of durations measured in CPU cycles.
+ *
+ * Each power of two is split into four sub-buckets, so a reported percentile
+ * is within 25% of the true value while the whole 32-bit range fits into a
+ * fixed array. Histograms register themselves in a global list for dumping.
+ */
+class LatencyHistogram {
+public:
+    static constexpr uint8_t subBucketBits = 2; // Sub-buckets per octave = 1 << subBucketBits
+    static constexpr uint8_t bucketCount = (32 - subBucketBits + 1) << subBucketBits; // Covers all uint32_t values
+
+    /**
+     * @brief Creates an empty histogram and adds it to the global list.
+     * @param name Label printed by Profiler::dump(). Must outlive the histogram.
+     */
+    explicit LatencyHistogram(const char* name);
+
+    /**
+     * @brief Adds one sample.
+     * @param cycles Duration in CPU cycles.
+     */
+    void record(uint32_t cycles);
+
+    /**
+     * @brief Estimates a percentile from the recorded samples.
+     * @param percent Percentile between 0 and 100.
+     * @return Upper bound of the bucket holding the percentile, in cycles.
+     */
+    uint32_t percentile(uint8_t percent) const;
+
+    /**
+     * @brief Discards all samples.
+     */
+    void reset();
+
+    const char* getName() const { return name; }
+    uint32_t getCount() const { return count; }
+    uint32_t getMax() const { return maxCycles; }
+    LatencyHistogram* getNext() const { return next; }
+
+private:
+    static uint8_t bucketFor(uint32_t cycles);
+    static uint32_t bucketUpperBound(uint8_t bucket);
+
+    const char* name; // Label printed by Profiler::dump()
+    uint32_t buckets[bucketCount]; // Sample counts per bucket
+    uint32_t count; // Total number of samples
+    uint32_t maxCycles; // Largest sample seen
+    LatencyHistogram* next; // Next histogram in the global list
+};
+
+/**
+ * @class ProfileSpan
+ * @brief Records the lifetime of a scope into a histogram.
+ */
+class ProfileSpan {
+public:
+    explicit ProfileSpan(LatencyHistogram& histogram) : histogram(histogram), start(hal::cycleCount()) {}
+    ~ProfileSpan() { histogram.record(hal::cycleCount() - start); }
+
+private:
+    LatencyHistogram& histogram; // Destination of the measurement
+    uint32_t start; // Cycle count at scope entry
+};
+
+/**
+ * @class Profiler
+ * @brief Access to all registered histograms.
+ */
+class Profiler {
+public:
+    /**
+     * @brief Prints count, p50, p99 and max of every histogram to the serial port.
+     */
+    static void dump();
+
+    /**
+     * @brief Clears every histogram.
+     */
+    static void resetAll();
+
+    /**
+     * @brief Handles serial commands: 'p' dumps, 'r' resets. Call periodically.
+     */
+    static void pollSerial();
+
+private:
+    friend class LatencyHistogram;
+    static LatencyHistogram* head; // First registered histogram
+};
+
+#ifdef PROFILING_ENABLED
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+/** Defines a histogram with static storage duration. */
+#define PROFILE_HISTOGRAM(name) static LatencyHistogram name(#name)
+/** Measures the rest of the enclosing scope into a histogram. */
+#define PROFILE_SPAN(name) ProfileSpan PROFILE_CONCAT(profileSpan, __LINE__)(name)
+#else
+#define PROFILE_HISTOGRAM(name)
+#define PROFILE_SPAN(name)
+#endif
+
+#endif /* Profiler_hpp */
@@ -0,0 +1,383 @@
+/**
+ * @file PumpController.cpp
+ * @brief Implementation of the pump relay scheduler.
+ */
+
+#include "PumpController.hpp"
+#include "DebugLogger.hpp"
+
+namespace {
+
+constexpr uint32_t maxWaitTicks = 86400; // Longest single sleep; the wheel is re-checked after it
+
+} // namespace
+
+/**
+ * @brief Constructs a controller with no relays, driving a shift register chain.
+ */
+PumpController::PumpController(ShiftRegisterBase* shiftRegister)
+    : shiftRegister(shiftRegister), scheduler(nullptr), timer(Scheduler::invalidId), pumps(), pumpCount(0),
+      schedules(), enabled(false), lastClockMs(0), pendingMs(0), stateChangeHandler(nullptr),
+      stateChangeContext(nullptr) {
+    for (uint8_t i = 0; i < maxPumps; i++) {
+        pumpContexts[i] = {this, i};
+        pumps[i].manualJob.bind(onManualJob, &pumpContexts[i]);
+    }
+    for (uint8_t i = 0; i < maxSchedules; i++) {
+        scheduleContexts[i] = {this, i};
+        schedules[i].job.bind(onScheduleJob, &scheduleContexts[i]);
+    }
+}
+
+/**
+ * @brief Registers the wheel timer with the scheduler.
+ */
+void PumpController::begin(Scheduler& scheduler) {
+    this->scheduler = &scheduler;
+    timer = scheduler.addTimer(onTimer, this);
+}
+
+/**
+ * @brief Adds a relay, initially off.
+ * @param relayPin Shift register output driving the relay.
+ * @return Pump identifier, or invalidId if the table is full.
+ */
+uint8_t PumpController::addPump(uint16_t relayPin) {
+    if (pumpCount >= maxPumps) {
+        LOG_ERROR("Pump table full.");
+        return invalidId;
+    }
+    Pump& pump = pumps[pumpCount];
+    pump.relayPin = relayPin;
+    pump.demand = 0;
+    pump.override = Override::None;
+    pump.running = false;
+    shiftRegister->setPinState(relayPin, LOW);
+    shiftRegister->write();
+    return pumpCount++;
+}
+
+/**
+ * @brief Runs a pump for runSeconds out of every everySeconds.
+ * @param offsetSeconds Delay of the first run after enabling.
+ * @return Schedule identifier, or invalidId if the table is full or the timing is invalid.
+ */
+uint8_t PumpController::addInterval(uint8_t pump, uint32_t everySeconds, uint32_t runSeconds, uint32_t offsetSeconds) {
+    if (pump >= pumpCount || runSeconds == 0 || runSeconds > everySeconds) {
+        return invalidId;
+    }
+    const Phase phases[] = {{pump, runSeconds}, {invalidId, everySeconds - runSeconds}};
+    return addSchedule(phases, 2, offsetSeconds);
+}
+
+/**
+ * @brief Runs a pump for dutyPercent of every cycleSeconds.
+ * @return Schedule identifier, or invalidId if the table is full or the timing is invalid.
+ */
+uint8_t PumpController::addDutyCycle(uint8_t pump, uint32_t cycleSeconds, uint8_t dutyPercent, uint32_t offsetSeconds) {
+    if (dutyPercent > 100) {
+        return invalidId;
+    }
+    return addInterval(pump, cycleSeconds, static_cast<uint32_t>(static_cast<uint64_t>(cycleSeconds) * dutyPercent / 100),
+        offsetSeconds);
+}
+
+/**
+ * @brief Floods with one relay, holds, then drains with another, every everySeconds.
+ * @return Schedule identifier, or invalidId if the table is full or the timing is invalid.
+ */
+uint8_t PumpController::addFloodDrain(uint8_t floodPump, uint8_t drainPump, uint32_t everySeconds,
+    uint32_t floodSeconds, uint32_t holdSeconds, uint32_t drainSeconds, uint32_t offsetSeconds) {
+    uint64_t busySeconds = static_cast<uint64_t>(floodSeconds) + holdSeconds + drainSeconds;
+    if (floodPump >= pumpCount || drainPump >= pumpCount || floodSeconds == 0 || busySeconds > everySeconds) {
+        return invalidId;
+    }
+    const Phase phases[] = {
+        {floodPump, floodSeconds},
+        {invalidId, holdSeconds},
+        {drainPump, drainSeconds},
+        {invalidId, static_cast<uint32_t>(everySeconds - busySeconds)}
+    };
+    return addSchedule(phases, 4, offsetSeconds);
+}
+
+/**
+ * @brief Deletes a schedule, releasing its relay if it was running it.
+ */
+void PumpController::removeSchedule(uint8_t schedule) {
+    if (schedule >= maxSchedules || !schedules[schedule].used) {
+        return;
+    }
+    Schedule& entry = schedules[schedule];
+    wheel.cancel(entry.job);
+    uint8_t pump = entry.phase != invalidId ? entry.phases[entry.phase].pump : invalidId;
+    leavePhase(schedule);
+    entry.used = false;
+    if (pump != invalidId) {
+        applyRelay(pump);
+    }
+}
+
+/**
+ * @brief Starts or stops all schedules. Disabling switches every relay off
+ * and ends every override.
+ */
+void PumpController::setEnabled(bool enabled) {
+    if (enabled == this->enabled) {
+        return;
+    }
+    this->enabled = enabled;
+    if (enabled) {
+        lastClockMs = static_cast<uint32_t>(hal::millis());
+        pendingMs = 0;
+        for (uint8_t i = 0; i < maxSchedules; i++) {
+            if (schedules[i].used) {
+                startSchedule(i);
+            }
+        }
+        armTimer();
+        return;
+    }
+    for (uint8_t i = 0; i < maxSchedules; i++) {
+        wheel.cancel(schedules[i].job);
+        schedules[i].phase = invalidId;
+    }
+    shiftRegister->beginTransaction();
+    for (uint8_t i = 0; i < pumpCount; i++) {
+        wheel.cancel(pumps[i].manualJob);
+        pumps[i].demand = 0;
+        pumps[i].override = Override::None;
+        applyRelay(i);
+    }
+    shiftRegister->commit();
+    if (scheduler != nullptr) {
+        scheduler->stopTimer(timer);
+    }
+}
+
+/**
+ * @brief Forces a relay on or off until resume() or the override timeout.
+ *
+ * Ignored while the controller is disabled.
+ */
+void PumpController::setManual(uint8_t pump, bool running) {
+    if (pump >= pumpCount || !enabled) {
+        return;
+    }
+    advanceClock();
+    pumps[pump].override = running ? Override::On : Override::Off;
+    wheel.schedule(pumps[pump].manualJob, manualTimeoutSeconds * 1000 / tickMs);
+    applyRelay(pump);
+    armTimer();
+}
+
+/**
+ * @brief Switches a relay to the opposite state by hand. If that is what
+ * its schedules want anyway, the override ends instead.
+ */
+void PumpController::toggleManual(uint8_t pump) {
+    if (pump >= pumpCount) {
+        return;
+    }
+    bool wanted = !pumps[pump].running;
+    if (wanted == (pumps[pump].demand > 0)) {
+        resume(pump);
+    } else {
+        setManual(pump, wanted);
+    }
+}
+
+/**
+ * @brief Ends the override of a relay; its schedules take over again.
+ */
+void PumpController::resume(uint8_t pump) {
+    if (pump >= pumpCount) {
+        return;
+    }
+    wheel.cancel(pumps[pump].manualJob);
+    pumps[pump].override = Override::None;
+    applyRelay(pump);
+}
+
+/**
+ * @brief Checks whether a relay is on.
+ */
+bool PumpController::isRunning(uint8_t pump) const {
+    return pump < pumpCount && pumps[pump].running;
+}
+
+/**
+ * @brief Checks whether a relay is under manual override.
+ */
+bool PumpController::isManual(uint8_t pump) const {
+    return pump < pumpCount && pumps[pump].override != Override::None;
+}
+
+/**
+ * @brief Registers the handler informed of relay switches.
+ */
+void PumpController::setStateChangeHandler(StateChangeHandler handler, void* context) {
+    stateChangeHandler = handler;
+    stateChangeContext = context;
+}
+
+/**
+ * @brief Advances the wheel to now, running the jobs that came due, and
+ * sleeps until its next event.
+ */
+void PumpController::onTimer(void* context) {
+    PumpController* controller = static_cast<PumpController*>(context);
+    controller->advanceClock();
+    controller->armTimer();
+}
+
+/**
+ * @brief Moves a schedule to its next phase with a non-zero length.
+ */
+void PumpController::onScheduleJob(void* context) {
+    JobContext* job = static_cast<JobContext*>(context);
+    PumpController* controller = job->controller;
+    Schedule& entry = controller->schedules[job->index];
+    uint8_t previousPump = entry.phase != invalidId ? entry.phases[entry.phase].pump : invalidId;
+    uint8_t phase = entry.phase;
+    controller->leavePhase(job->index);
+    do {
+        phase = phase == invalidId ? 0 : static_cast<uint8_t>((phase + 1) % entry.phaseCount);
+    } while (entry.phases[phase].seconds == 0);
+    controller->enterPhase(job->index, phase);
+    // Released after the new phase took its demand, so back-to-back runs of one relay do not blink it.
+    if (previousPump != invalidId) {
+        controller->applyRelay(previousPump);
+    }
+}
+
+/**
+ * @brief Ends an override when it times out.
+ */
+void PumpController::onManualJob(void* context) {
+    JobContext* job = static_cast<JobContext*>(context);
+    LOG_INFO("Pump %u manual override timed out.", job->index);
+    job->controller->resume(job->index);
+}
+
+/**
+ * @brief Stores a schedule and starts it if the controller is enabled.
+ */
+uint8_t PumpController::addSchedule(const Phase* phases, uint8_t phaseCount, uint32_t offsetSeconds) {
+    for (uint8_t i = 0; i < maxSchedules; i++) {
+        Schedule& entry = schedules[i];
+        if (entry.used) {
+            continue;
+        }
+        entry.used = true;
+        entry.phaseCount = phaseCount;
+        entry.phase = invalidId;
+        entry.offsetSeconds = offsetSeconds;
+        for (uint8_t p = 0; p < phaseCount; p++) {
+            entry.phases[p] = phases[p];
+        }
+        if (enabled) {
+            advanceClock();
+            startSchedule(i);
+            armTimer();
+        }
+        return i;
+    }
+    LOG_ERROR("Pump schedule table full.");
+    return invalidId;
+}
+
+/**
+ * @brief Arms the first phase, at once or after the schedule's offset.
+ */
+void PumpController::startSchedule(uint8_t schedule) {
+    Schedule& entry = schedules[schedule];
+    entry.phase = invalidId;
+    if (entry.offsetSeconds == 0) {
+        onScheduleJob(&scheduleContexts[schedule]);
+    } else {
+        wheel.schedule(entry.job, entry.offsetSeconds * 1000 / tickMs);
+    }
+}
+
+/**
+ * @brief Takes the demand of a phase and arms its end.
+ */
+void PumpController::enterPhase(uint8_t schedule, uint8_t phase) {
+    Schedule& entry = schedules[schedule];
+    entry.phase = phase;
+    uint8_t pump = entry.phases[phase].pump;
+    if (pump != invalidId) {
+        pumps[pump].demand++;
+        applyRelay(pump);
+    }
+    wheel.schedule(entry.job, entry.phases[phase].seconds * 1000 / tickMs);
+}
+
+/**
+ * @brief Releases the demand of the running phase without touching the relay.
+ */
+void PumpController::leavePhase(uint8_t schedule) {
+    Schedule& entry = schedules[schedule];
+    if (entry.phase == invalidId) {
+        return;
+    }
+    uint8_t pump = entry.phases[entry.phase].pump;
+    if (pump != invalidId && pumps[pump].demand > 0) {
+        pumps[pump].demand--;
+    }
+    entry.phase = invalidId;
+}
+
+/**
+ * @brief Writes a relay if its wanted state changed.
+ */
+void PumpController::applyRelay(uint8_t pump) {
+    Pump& entry = pumps[pump];
+    bool wanted = entry.override == Override::None ? entry.demand > 0 : entry.override == Override::On;
+    wanted = wanted && enabled;
+    if (wanted == entry.running) {
+        return;
+    }
+    entry.running = wanted;
+    shiftRegister->setPinState(entry.relayPin, wanted);
+    shiftRegister->write();
+    LOG_INFO("Pump %u %s.", pump, wanted ? "on" : "off");
+    if (stateChangeHandler != nullptr) {
+        stateChangeHandler(pump, wanted, stateChangeContext);
+    }
+}
+
+/**
+ * @brief Moves the wheel by the whole ticks elapsed since the last call.
+ *
+ * Works on millis() differences, so its wrap does not disturb the schedules.
+ */
+void PumpController::advanceClock() {
+    uint32_t now = static_cast<uint32_t>(hal::millis());
+    pendingMs += now - lastClockMs;
+    lastClockMs = now;
+    uint32_t ticks = pendingMs / tickMs;
+    pendingMs %= tickMs;
+    if (ticks > 0) {
+        wheel.advance(ticks);
+    }
+}
+
+/**
+ * @brief Sleeps until the wheel's next event, or stops the timer if it is empty.
+ */
+void PumpController::armTimer() {
+    if (scheduler == nullptr) {
+        return;
+    }
+    uint32_t ticks = wheel.ticksUntilNext();
+    if (ticks == TimingWheel::idle) {
+        scheduler->stopTimer(timer);
+        return;
+    }
+    if (ticks > maxWaitTicks) {
+        ticks = maxWaitTicks;
+    }
+    scheduler->startTimer(timer, ticks * tickMs - pendingMs);
+}
@@ -0,0 +1,181 @@
+/**
+ * @file PumpController.hpp
+ * @brief Scheduled pump relays on the shift register with manual override.
+ */
+
+#ifndef PumpController_hpp
+#define PumpController_hpp
+
+#include <stdint.h>
+#include "Scheduler.hpp"
+#include "ShiftRegisterChain.hpp"
+#include "TimingWheel.hpp"
+
+/**
+ * @class PumpController
+ * @brief Runs watering schedules on pump and valve relays.
+ *
+ * A schedule is a repeating sequence of phases, each running one relay or
+ * none for a number of seconds: an interval schedule runs a pump for a while
+ * every so often, a duty cycle schedule is the same given as a share of the
+ * cycle, and a flood/drain schedule fills a tray, lets it soak, then runs the
+ * drain. Schedules may overlap; a relay is on while any of them wants it on.
+ * All phase changes are jobs in one TimingWheel, and a single scheduler timer
+ * sleeps until the wheel's next event, so the number of schedules does not
+ * change the cost of a tick.
+ *
+ * A manual override forces a relay on or off regardless of its schedules and
+ * ends by itself after manualTimeoutSeconds. Schedules start counting when the
+ * controller is enabled and stop, with every relay off, when it is disabled.
+ */
+class PumpController {
+public:
+    static constexpr uint8_t maxPumps = 8; // Relays
+    static constexpr uint8_t maxSchedules = 16;
+    static constexpr uint8_t maxPhases = 4; // Phases per schedule
+    static constexpr uint8_t invalidId = 0xFF;
+    static constexpr uint32_t tickMs = 1000; // Schedule resolution
+    static constexpr uint32_t manualTimeoutSeconds = 30 * 60; // A forgotten override ends after this
+
+    /**
+     * @brief Handler invoked when a relay switches.
+     */
+    typedef void (*StateChangeHandler)(uint8_t pump, bool running, void* context);
+
+    /**
+     * @brief Constructs a controller with no relays, driving a shift register chain.
+     */
+    explicit PumpController(ShiftRegisterBase* shiftRegister);
+
+    /**
+     * @brief Registers the wheel timer with the scheduler.
+     */
+    void begin(Scheduler& scheduler);
+
+    /**
+     * @brief Adds a relay, initially off.
+     * @param relayPin Shift register output driving the relay.
+     * @return Pump identifier, or invalidId if the table is full.
+     */
+    uint8_t addPump(uint16_t relayPin);
+
+    /**
+     * @brief Runs a pump for runSeconds out of every everySeconds.
+     * @param offsetSeconds Delay of the first run after enabling.
+     * @return Schedule identifier, or invalidId if the table is full or the timing is invalid.
+     */
+    uint8_t addInterval(uint8_t pump, uint32_t everySeconds, uint32_t runSeconds, uint32_t offsetSeconds = 0);
+
+    /**
+     * @brief Runs a pump for dutyPercent of every cycleSeconds.
+     * @return Schedule identifier, or invalidId if the table is full or the timing is invalid.
+     */
+    uint8_t addDutyCycle(uint8_t pump, uint32_t cycleSeconds, uint8_t dutyPercent, uint32_t offsetSeconds = 0);
+
+    /**
+     * @brief Floods with one relay, holds, then drains with another, every everySeconds.
+     * @return Schedule identifier, or invalidId if the table is full or the timing is invalid.
+     */
+    uint8_t addFloodDrain(uint8_t floodPump, uint8_t drainPump, uint32_t everySeconds, uint32_t floodSeconds,
+        uint32_t holdSeconds, uint32_t drainSeconds, uint32_t offsetSeconds = 0);
+
+    /**
+     * @brief Deletes a schedule, releasing its relay if it was running it.
+     */
+    void removeSchedule(uint8_t schedule);
+
+    /**
+     * @brief Starts or stops all schedules. Disabling switches every relay off
+     * and ends every override.
+     */
+    void setEnabled(bool enabled);
+
+    /**
+     * @brief Forces a relay on or off until resume() or the override timeout.
+     */
+    void setManual(uint8_t pump, bool running);
+
+    /**
+     * @brief Switches a relay to the opposite state by hand. If that is what
+     * its schedules want anyway, the override ends instead.
+     */
+    void toggleManual(uint8_t pump);
+
+    /**
+     * @brief Ends the override of a relay; its schedules take over again.
+     */
+    void resume(uint8_t pump);
+
+    /**
+     * @brief Checks whether a relay is on.
+     */
+    bool isRunning(uint8_t pump) const;
+
+    /**
+     * @brief Checks whether a relay is under manual override.
+     */
+    bool isManual(uint8_t pump) const;
+
+    /**
+     * @brief Registers the handler informed of relay switches.
+     */
+    void setStateChangeHandler(StateChangeHandler handler, void* context);
+
+private:
+    enum class Override : uint8_t { None, On, Off };
+
+    struct Pump {
+        uint16_t relayPin;  // Shift register output
+        uint8_t demand;     // Schedule phases currently wanting the relay on
+        Override override;  // Manual override
+        bool running;       // Relay state last written
+        TimingWheel::Job manualJob; // Ends the override
+    };
+
+    struct Phase {
+        uint8_t pump;       // Relay to run, or invalidId to rest
+        uint32_t seconds;   // Phase length
+    };
+
+    struct Schedule {
+        bool used;          // Slot holds a schedule
+        uint8_t phaseCount; // Phases in the cycle
+        uint8_t phase;      // Running phase, invalidId before the first
+        uint32_t offsetSeconds; // Delay of the first phase after enabling
+        Phase phases[maxPhases]; // Cycle
+        TimingWheel::Job job; // Ends the running phase
+    };
+
+    struct JobContext {
+        PumpController* controller;
+        uint8_t index;
+    };
+
+    static void onTimer(void* context); // Advances the wheel to now
+    static void onScheduleJob(void* context); // Moves a schedule to its next phase
+    static void onManualJob(void* context); // Ends an override
+    uint8_t addSchedule(const Phase* phases, uint8_t phaseCount, uint32_t offsetSeconds);
+    void startSchedule(uint8_t schedule); // Arms the first phase
+    void enterPhase(uint8_t schedule, uint8_t phase); // Switches demand and arms the phase end
+    void leavePhase(uint8_t schedule); // Releases the demand of the running phase
+    void applyRelay(uint8_t pump); // Writes a relay if its wanted state changed
+    void advanceClock(); // Moves the wheel by the ticks elapsed since the last call
+    void armTimer(); // Sleeps until the wheel's next event
+
+    ShiftRegisterBase* shiftRegister; // Chain with the relay outputs
+    Scheduler* scheduler; // Scheduler running the wheel timer
+    uint8_t timer; // Fires at the wheel's next event
+    TimingWheel wheel; // Phase ends and override timeouts
+    Pump pumps[maxPumps]; // Relays
+    uint8_t pumpCount; // Relays added
+    Schedule schedules[maxSchedules]; // Schedule slots
+    JobContext pumpContexts[maxPumps]; // Job contexts of the override timeouts
+    JobContext scheduleContexts[maxSchedules]; // Job contexts of the schedules
+    bool enabled; // Schedules are running
+    uint32_t lastClockMs; // millis() at the last wheel advance
+    uint32_t pendingMs; // Milliseconds not yet worth a whole tick
+    StateChangeHandler stateChangeHandler; // Informed of relay switches
+    void* stateChangeContext; // Argument passed to the handler
+};
+
+#endif /* PumpController_hpp */
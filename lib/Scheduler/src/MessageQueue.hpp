@@ -0,0 +1,90 @@
+/**
+ * @file MessageQueue.hpp
+ * @brief Bounded lock-free queue that wakes the consuming scheduler.
+ */
+
+#ifndef MessageQueue_hpp
+#define MessageQueue_hpp
+
+#include "Scheduler.hpp"
+#include "SpscRing.hpp"
+
+/**
+ * @class MessageQueue
+ * @brief One-way channel between two tasks, possibly on different cores.
+ *
+ * send() pushes into an SpscRing and posts an event on the consumer's
+ * scheduler, whose handler drains the queue with receive(). Neither side ever
+ * blocks or takes a lock: a message sent into a full queue is dropped and
+ * counted. The highest depth seen is tracked to size the queue.
+ *
+ * @tparam T Trivially copyable message type.
+ * @tparam Capacity Number of messages, a power of two.
+ */
+template<typename T, uint32_t Capacity>
+class MessageQueue {
+public:
+    MessageQueue() : consumer(nullptr), event(Scheduler::invalidId), maxDepth(0) {}
+
+    /**
+     * @brief Registers the handler that drains the queue.
+     * @param scheduler Scheduler of the consuming task.
+     * @param handler Called after messages were sent; must receive() until empty.
+     * @param context Argument passed to the handler.
+     */
+    void attachConsumer(Scheduler& scheduler, Scheduler::Handler handler, void* context) {
+        consumer = &scheduler;
+        event = scheduler.addEvent(handler, context);
+    }
+
+    /**
+     * @brief Queues a message and wakes the consumer. Producer side only.
+     * @return False if the queue was full and the message was dropped.
+     */
+    bool send(const T& message) {
+        bool queued = ring.push(message);
+        if (queued) {
+            uint32_t depth = ring.size();
+            if (depth > maxDepth.load(std::memory_order_relaxed)) {
+                maxDepth.store(depth, std::memory_order_relaxed);
+            }
+        }
+        if (consumer != nullptr) {
+            consumer->post(event);
+        }
+        return queued;
+    }
+
+    /**
+     * @brief Takes the oldest message. Consumer side only.
+     * @return False if the queue is empty.
+     */
+    bool receive(T& message) {
+        return ring.pop(message);
+    }
+
+    /**
+     * @brief Messages currently queued.
+     */
+    uint32_t getDepth() const { return ring.size(); }
+
+    /**
+     * @brief Highest depth seen since start.
+     */
+    uint32_t getMaxDepth() const { return maxDepth.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief Messages dropped because the queue was full.
+     */
+    uint32_t getDropped() const { return ring.getDropped(); }
+
+    static constexpr uint32_t capacity = Capacity; // Number of messages.
+
+private:
+    SpscRing<T, Capacity> ring; // Message storage
+    Scheduler* consumer; // Scheduler of the consuming task
+    uint8_t event; // Event draining the queue
+    std::atomic<uint32_t> maxDepth; // Highest depth seen, written by the producer
+};
+
+#endif /* MessageQueue_hpp */
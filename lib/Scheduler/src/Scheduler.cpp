@@ -0,0 +1,224 @@
+/**
+ * @file Scheduler.cpp
+ * @brief Implementation of the tick-less cooperative scheduler.
+ */
+
+#include "Scheduler.hpp"
+
+/**
+ * @brief Initializes empty timer and event tables.
+ */
+Scheduler::Scheduler()
+    : timerCount(0), heapSize(0), eventCount(0), pendingEvents(0), owner(nullptr), busyCycles(0) {}
+
+/**
+ * @brief Registers a stopped timer.
+ * @param handler Function called when the timer expires.
+ * @param context Argument passed to the handler.
+ * @return Timer identifier, or invalidId if the table is full.
+ */
+uint8_t Scheduler::addTimer(Handler handler, void* context) {
+    if (timerCount >= maxTimers) {
+        return invalidId;
+    }
+    timers[timerCount] = {handler, context, 0, 0, invalidId};
+    return timerCount++;
+}
+
+/**
+ * @brief Arms a timer, moving it if it is already armed.
+ * @param timer Timer identifier.
+ * @param delayMs Time until the first expiry.
+ * @param periodMs Reload interval, 0 for one-shot.
+ */
+void Scheduler::startTimer(uint8_t timer, uint32_t delayMs, uint32_t periodMs) {
+    if (timer >= timerCount) {
+        return;
+    }
+    stopTimer(timer);
+    timers[timer].deadline = hal::millis() + delayMs;
+    timers[timer].period = periodMs;
+    heapInsert(timer);
+}
+
+/**
+ * @brief Disarms a timer.
+ * @param timer Timer identifier.
+ */
+void Scheduler::stopTimer(uint8_t timer) {
+    if (timer < timerCount && timers[timer].heapIndex != invalidId) {
+        heapRemove(timer);
+    }
+}
+
+/**
+ * @brief Checks whether a timer is armed.
+ * @param timer Timer identifier.
+ * @return True if the timer will expire in the future.
+ */
+bool Scheduler::isTimerActive(uint8_t timer) const {
+    return timer < timerCount && timers[timer].heapIndex != invalidId;
+}
+
+/**
+ * @brief Registers an event source.
+ * @param handler Function called when the event is dispatched.
+ * @param context Argument passed to the handler.
+ * @return Event identifier, or invalidId if the table is full.
+ */
+uint8_t Scheduler::addEvent(Handler handler, void* context) {
+    if (eventCount >= maxEvents) {
+        return invalidId;
+    }
+    events[eventCount] = {handler, context};
+    return eventCount++;
+}
+
+/**
+ * @brief Marks an event pending and wakes the owning task. Interrupt safe.
+ * @param event Event identifier.
+ */
+void HAL_ISR_ATTR Scheduler::post(uint8_t event) {
+    if (event >= maxEvents) {
+        return;
+    }
+    pendingEvents.fetch_or(1UL << event, std::memory_order_release);
+    // Until the owning task has run once there is no one to wake; the
+    // pending bit is picked up by its first runPending().
+    hal::notifyTask(owner.load(std::memory_order_acquire));
+}
+
+/**
+ * @brief Runs the handlers of all posted events, then of all expired timers.
+ *
+ * Periodic timers are re-armed relative to their previous deadline so that
+ * they do not drift; if they fell behind by more than a period they resume
+ * from the current time instead of firing in a burst.
+ */
+void Scheduler::runPending() {
+    owner.store(hal::currentTask(), std::memory_order_release);
+    uint32_t startCycles = hal::cycleCount();
+    uint32_t pending = pendingEvents.exchange(0, std::memory_order_acquire);
+    while (pending != 0) {
+        uint8_t event = static_cast<uint8_t>(__builtin_ctz(pending));
+        pending &= pending - 1;
+        events[event].handler(events[event].context);
+    }
+
+    uint32_t now = hal::millis();
+    while (heapSize > 0 && !isBefore(now, timers[heap[0]].deadline)) {
+        uint8_t timer = heap[0];
+        Timer& entry = timers[timer];
+        heapRemove(timer);
+        if (entry.period != 0) {
+            entry.deadline += entry.period;
+            if (!isBefore(now, entry.deadline)) {
+                entry.deadline = now + entry.period;
+            }
+            heapInsert(timer);
+        }
+        entry.handler(entry.context);
+    }
+    busyCycles.store(busyCycles.load(std::memory_order_relaxed) + (hal::cycleCount() - startCycles), std::memory_order_relaxed);
+}
+
+/**
+ * @brief Sleeps until the next deadline or posted event.
+ */
+void Scheduler::sleep() {
+    owner.store(hal::currentTask(), std::memory_order_release);
+    if (pendingEvents.load(std::memory_order_acquire) == 0) {
+        hal::waitForNotification(millisUntilNextDeadline());
+    }
+}
+
+/**
+ * @brief Dispatches due work and sleeps until more work is due.
+ */
+void Scheduler::runOnce() {
+    runPending();
+    sleep();
+}
+
+/**
+ * @brief Time until the earliest armed timer expires.
+ * @return Milliseconds, 0 if overdue, hal::waitForever if no timer is armed.
+ */
+uint32_t Scheduler::millisUntilNextDeadline() const {
+    if (heapSize == 0) {
+        return hal::waitForever;
+    }
+    uint32_t now = hal::millis();
+    uint32_t deadline = timers[heap[0]].deadline;
+    return isBefore(now, deadline) ? deadline - now : 0;
+}
+
+/**
+ * @brief Checks whether an event was posted and not yet dispatched.
+ */
+bool Scheduler::hasPendingEvents() const {
+    return pendingEvents.load(std::memory_order_acquire) != 0;
+}
+
+/**
+ * @brief Cycles spent in runPending() so far, wrapping at 32 bits.
+ */
+uint32_t Scheduler::getBusyCycles() const {
+    return busyCycles.load(std::memory_order_relaxed);
+}
+
+void Scheduler::heapInsert(uint8_t timer) {
+    uint8_t index = heapSize++;
+    heap[index] = timer;
+    timers[timer].heapIndex = index;
+    siftUp(index);
+}
+
+void Scheduler::heapRemove(uint8_t timer) {
+    uint8_t index = timers[timer].heapIndex;
+    uint8_t last = --heapSize;
+    if (index != last) {
+        heapSwap(index, last);
+        siftDown(index);
+        siftUp(index);
+    }
+    timers[timer].heapIndex = invalidId;
+}
+
+void Scheduler::siftUp(uint8_t index) {
+    while (index > 0) {
+        uint8_t parent = (index - 1) / 2;
+        if (!isBefore(timers[heap[index]].deadline, timers[heap[parent]].deadline)) {
+            break;
+        }
+        heapSwap(index, parent);
+        index = parent;
+    }
+}
+
+void Scheduler::siftDown(uint8_t index) {
+    for (;;) {
+        uint8_t smallest = index;
+        uint8_t left = 2 * index + 1;
+        uint8_t right = left + 1;
+        if (left < heapSize && isBefore(timers[heap[left]].deadline, timers[heap[smallest]].deadline)) {
+            smallest = left;
+        }
+        if (right < heapSize && isBefore(timers[heap[right]].deadline, timers[heap[smallest]].deadline)) {
+            smallest = right;
+        }
+        if (smallest == index) {
+            return;
+        }
+        heapSwap(index, smallest);
+        index = smallest;
+    }
+}
+
+void Scheduler::heapSwap(uint8_t a, uint8_t b) {
+    uint8_t timer = heap[a];
+    heap[a] = heap[b];
+    heap[b] = timer;
+    timers[heap[a]].heapIndex = a;
+    timers[heap[b]].heapIndex = b;
+}
@@ -0,0 +1,151 @@
+/**
+ * @file Scheduler.hpp
+ * @brief Tick-less cooperative scheduler with deadline-ordered timers and event sources.
+ */
+
+#ifndef Scheduler_hpp
+#define Scheduler_hpp
+
+#include <atomic>
+#include "HAL.hpp"
+
+/**
+ * @class Scheduler
+ * @brief Runs timer and event handlers only when they are due.
+ *
+ * Timers are kept in a binary min-heap ordered by deadline. Events are bits in
+ * a pending mask that may be set from interrupts or other tasks. runOnce()
+ * dispatches everything that is due and then sleeps until the earliest
+ * deadline or the next posted event, so the CPU only wakes when there is work.
+ * All handlers run in the task that calls runOnce().
+ */
+class Scheduler {
+public:
+    /**
+     * @brief Signature of timer and event handlers.
+     */
+    typedef void (*Handler)(void* context);
+
+    static constexpr uint8_t maxTimers = 16; // Capacity of the timer table.
+    static constexpr uint8_t maxEvents = 32; // Capacity of the event table (one bit each).
+    static constexpr uint8_t invalidId = 0xFF; // Returned when a table is full.
+
+    /**
+     * @brief Constructs an empty scheduler.
+     */
+    Scheduler();
+
+    /**
+     * @brief Registers a timer. The timer is created stopped.
+     * @param handler Function called when the timer expires.
+     * @param context Argument passed to the handler.
+     * @return Timer identifier, or invalidId if the table is full.
+     */
+    uint8_t addTimer(Handler handler, void* context);
+
+    /**
+     * @brief Arms or re-arms a timer.
+     * @param timer Identifier returned by addTimer().
+     * @param delayMs Time until the first expiry.
+     * @param periodMs Interval between later expiries, 0 for a one-shot timer.
+     */
+    void startTimer(uint8_t timer, uint32_t delayMs, uint32_t periodMs = 0);
+
+    /**
+     * @brief Disarms a timer. Stopping an inactive timer has no effect.
+     */
+    void stopTimer(uint8_t timer);
+
+    /**
+     * @brief Checks whether a timer is armed.
+     */
+    bool isTimerActive(uint8_t timer) const;
+
+    /**
+     * @brief Registers an event source.
+     * @param handler Function called once per dispatch after the event was posted.
+     * @param context Argument passed to the handler.
+     * @return Event identifier, or invalidId if the table is full.
+     */
+    uint8_t addEvent(Handler handler, void* context);
+
+    /**
+     * @brief Marks an event as pending and wakes the scheduler.
+     *
+     * Safe to call from interrupts and other tasks. Posting an event several
+     * times before it is dispatched runs its handler once.
+     */
+    void post(uint8_t event);
+
+    /**
+     * @brief Dispatches pending events and expired timers without sleeping.
+     */
+    void runPending();
+
+    /**
+     * @brief Sleeps until the next timer deadline or posted event.
+     *
+     * Returns immediately if an event is already pending.
+     */
+    void sleep();
+
+    /**
+     * @brief Dispatches due work, then sleeps until the next deadline or event.
+     *
+     * Intended to be the only call in the application loop.
+     */
+    void runOnce();
+
+    /**
+     * @brief Time until the earliest armed timer expires.
+     * @return Milliseconds, 0 if a timer is overdue, hal::waitForever if none is armed.
+     */
+    uint32_t millisUntilNextDeadline() const;
+
+    /**
+     * @brief Checks whether an event was posted and not yet dispatched.
+     */
+    bool hasPendingEvents() const;
+
+    /**
+     * @brief Cycles spent in runPending() so far, wrapping at 32 bits.
+     *
+     * Safe to read from another task. The difference of two readings less
+     * than one wrap period apart (about 17 s at 240 MHz) is the busy time
+     * in between.
+     */
+    uint32_t getBusyCycles() const;
+
+private:
+    struct Timer {
+        Handler handler;    // Function called on expiry
+        void* context;      // Argument passed to the handler
+        uint32_t deadline;  // Expiry time in milliseconds
+        uint32_t period;    // Reload interval, 0 for one-shot timers
+        uint8_t heapIndex;  // Position in the deadline heap, invalidId when stopped
+    };
+
+    struct Event {
+        Handler handler;    // Function called on dispatch
+        void* context;      // Argument passed to the handler
+    };
+
+    Timer timers[maxTimers]; // Registered timers
+    uint8_t timerCount; // Number of registered timers
+    uint8_t heap[maxTimers]; // Armed timers ordered by deadline
+    uint8_t heapSize; // Number of armed timers
+    Event events[maxEvents]; // Registered event sources
+    uint8_t eventCount; // Number of registered event sources
+    std::atomic<uint32_t> pendingEvents; // One bit per posted event
+    std::atomic<hal::TaskHandle> owner; // Task running the handlers, woken by post(); set by runPending() and sleep()
+    std::atomic<uint32_t> busyCycles; // Cycles spent dispatching, written by the owner only
+
+    static bool isBefore(uint32_t a, uint32_t b) { return static_cast<int32_t>(a - b) < 0; }
+    void heapInsert(uint8_t timer);
+    void heapRemove(uint8_t timer);
+    void siftUp(uint8_t index);
+    void siftDown(uint8_t index);
+    void heapSwap(uint8_t a, uint8_t b);
+};
+
+#endif /* Scheduler_hpp */
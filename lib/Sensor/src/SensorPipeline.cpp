@@ -0,0 +1,234 @@
+/**
+ * @file SensorPipeline.cpp
+ * @brief Implementation of the sensor acquisition pipeline.
+ */
+
+#include "SensorPipeline.hpp"
+#include "DebugLogger.hpp"
+
+namespace {
+
+/**
+ * Orders two values so that a <= b, without branches on the data.
+ */
+inline void sortPair(uint16_t& a, uint16_t& b) {
+    uint16_t low = a < b ? a : b;
+    uint16_t high = a < b ? b : a;
+    a = low;
+    b = high;
+}
+
+} // namespace
+
+/**
+ * @brief Constructs a pipeline with no channels, reading the HAL continuous ADC.
+ */
+SensorPipeline::SensorPipeline()
+    : channels(), channelCount(0), adcChannels(), batch(), split(), drainLimit(1), reader(readHal),
+      readerContext(nullptr), publishHandler(nullptr), publishContext(nullptr) {
+    for (uint8_t& entry : channelByAdc) {
+        entry = invalidId;
+    }
+}
+
+/**
+ * @brief Adds a channel. Must be called before begin().
+ * @param adcChannel ADC1 channel the sensor is wired to.
+ * @param calibration Conversion from ADC counts to the reading's unit.
+ * @param emaShift Smoothing: each median moves the average by 1/2^emaShift of its distance.
+ * @return Channel identifier, or invalidId if the table is full.
+ */
+uint8_t SensorPipeline::addChannel(uint8_t adcChannel, const Calibration& calibration, uint8_t emaShift) {
+    if (channelCount >= maxChannels || adcChannel >= sizeof(channelByAdc) || channelByAdc[adcChannel] != invalidId) {
+        LOG_ERROR("Sensor channel %u rejected.", adcChannel);
+        return invalidId;
+    }
+    Channel& channel = channels[channelCount];
+    channel.calibration = calibration;
+    channel.emaShift = emaShift < 15 ? emaShift : 15;
+    channel.pending = 0;
+    channel.primed = false;
+    channel.ema = 0;
+    channel.samples = 0;
+    adcChannels[channelCount] = adcChannel;
+    channelByAdc[adcChannel] = channelCount;
+    return channelCount++;
+}
+
+/**
+ * @brief Replaces the HAL continuous ADC as the sample source. Must be called before begin().
+ */
+void SensorPipeline::setReader(SampleReader reader, void* context) {
+    this->reader = reader;
+    readerContext = context;
+}
+
+/**
+ * @brief Registers the handler receiving the readings.
+ */
+void SensorPipeline::setPublishHandler(PublishHandler handler, void* context) {
+    publishHandler = handler;
+    publishContext = context;
+}
+
+/**
+ * @brief Starts sampling and the publish timer.
+ *
+ * The ring holds two publish intervals of samples, so one late wakeup loses
+ * nothing.
+ *
+ * @param sampleRateHz Total conversions per second over all channels.
+ * @param publishIntervalMs Time between readings, which is also how often the CPU wakes.
+ * @return False if the ADC could not be started.
+ */
+bool SensorPipeline::begin(Scheduler& scheduler, uint32_t sampleRateHz, uint32_t publishIntervalMs) {
+    size_t ringSamples = static_cast<size_t>(static_cast<uint64_t>(sampleRateHz) * publishIntervalMs / 1000) * 2;
+    ringSamples = (ringSamples + batchSamples - 1) / batchSamples * batchSamples;
+    if (ringSamples == 0) {
+        ringSamples = batchSamples;
+    }
+    drainLimit = ringSamples / batchSamples + 1;
+    if (reader == readHal && !hal::adcContinuousBegin(adcChannels, channelCount, sampleRateHz, ringSamples)) {
+        LOG_ERROR("Continuous ADC could not be started.");
+        return false;
+    }
+    uint8_t timer = scheduler.addTimer(onPublishTimer, this);
+    scheduler.startTimer(timer, publishIntervalMs, publishIntervalMs);
+    return true;
+}
+
+/**
+ * @brief Filters a batch of samples. Samples of unknown channels are skipped.
+ *
+ * The batch is first split by channel, so each channel is then filtered in
+ * one tight loop over its own samples.
+ */
+void SensorPipeline::process(const uint16_t* samples, size_t count) {
+    while (count > 0) {
+        size_t chunk = count < batchSamples ? count : batchSamples;
+        size_t fill[maxChannels] = {};
+        for (size_t i = 0; i < chunk; i++) {
+            uint16_t sample = samples[i];
+            uint8_t entry = channelByAdc[sample >> hal::adcSampleChannelShift];
+            if (entry != invalidId) {
+                split[entry][fill[entry]++] = sample & hal::adcSampleValueMask;
+            }
+        }
+        for (uint8_t i = 0; i < channelCount; i++) {
+            filter(channels[i], split[i], fill[i]);
+        }
+        samples += chunk;
+        count -= chunk;
+    }
+}
+
+/**
+ * @brief Latest calibrated reading of a channel; 0 until it has a sample.
+ */
+int32_t SensorPipeline::getReading(uint8_t channel) const {
+    if (channel >= channelCount || !channels[channel].primed) {
+        return 0;
+    }
+    return calibrate(channels[channel]);
+}
+
+/**
+ * @brief Number of samples filtered on a channel since begin().
+ */
+uint32_t SensorPipeline::getSampleCount(uint8_t channel) const {
+    return channel < channelCount ? channels[channel].samples : 0;
+}
+
+/**
+ * @brief Drains the ring in batches, then publishes one reading per channel.
+ *
+ * Reads at most a ring's worth, so a source faster than the CPU cannot hold
+ * the task here.
+ */
+void SensorPipeline::onPublishTimer(void* context) {
+    SensorPipeline* pipeline = static_cast<SensorPipeline*>(context);
+    for (size_t i = 0; i < pipeline->drainLimit; i++) {
+        size_t count = pipeline->reader(pipeline->batch, batchSamples, pipeline->readerContext);
+        pipeline->process(pipeline->batch, count);
+        if (count < batchSamples) {
+            break;
+        }
+    }
+    if (pipeline->publishHandler != nullptr) {
+        int32_t readings[maxChannels];
+        for (uint8_t i = 0; i < pipeline->channelCount; i++) {
+            readings[i] = pipeline->getReading(i);
+        }
+        pipeline->publishHandler(readings, pipeline->channelCount, pipeline->publishContext);
+    }
+}
+
+/**
+ * @brief Default reader: the HAL continuous ADC.
+ */
+size_t SensorPipeline::readHal(uint16_t* samples, size_t maxSamples, void* context) {
+    (void)context;
+    return hal::adcContinuousRead(samples, maxSamples);
+}
+
+/**
+ * @brief Median of five by a fixed network of seven compare-exchanges.
+ */
+uint16_t SensorPipeline::median5(uint16_t a, uint16_t b, uint16_t c, uint16_t d, uint16_t e) {
+    sortPair(a, b);
+    sortPair(d, e);
+    sortPair(a, d);
+    sortPair(b, e);
+    sortPair(b, c);
+    sortPair(c, d);
+    sortPair(b, c);
+    return c;
+}
+
+/**
+ * @brief Runs the median and EMA over one channel's share of a batch.
+ *
+ * Samples left over after the last full window wait in the channel and
+ * complete the first window of the next batch.
+ */
+void SensorPipeline::filter(Channel& channel, const uint16_t* values, size_t count) {
+    channel.samples += count;
+    const uint8_t shift = channel.emaShift;
+    int32_t ema = channel.ema;
+    size_t i = 0;
+    if (channel.pending > 0) {
+        while (channel.pending < medianWindow && i < count) {
+            channel.window[channel.pending++] = values[i++];
+        }
+        if (channel.pending < medianWindow) {
+            return;
+        }
+        channel.pending = 0;
+        int32_t median = static_cast<int32_t>(median5(channel.window[0], channel.window[1], channel.window[2],
+            channel.window[3], channel.window[4])) << 16;
+        ema = channel.primed ? ema + ((median - ema) >> shift) : median;
+        channel.primed = true;
+    }
+    if (!channel.primed && i + medianWindow <= count) {
+        ema = static_cast<int32_t>(median5(values[i], values[i + 1], values[i + 2], values[i + 3], values[i + 4])) << 16;
+        channel.primed = true;
+        i += medianWindow;
+    }
+    for (; i + medianWindow <= count; i += medianWindow) {
+        int32_t median = static_cast<int32_t>(median5(values[i], values[i + 1], values[i + 2], values[i + 3],
+            values[i + 4])) << 16;
+        ema += (median - ema) >> shift;
+    }
+    while (i < count) {
+        channel.window[channel.pending++] = values[i++];
+    }
+    channel.ema = ema;
+}
+
+/**
+ * @brief Reading from the average: raw * gain / 65536 + offset with raw in Q16.
+ */
+int32_t SensorPipeline::calibrate(const Channel& channel) const {
+    return static_cast<int32_t>((static_cast<int64_t>(channel.ema) * channel.calibration.gain) >> 32) +
+        channel.calibration.offset;
+}
@@ -0,0 +1,140 @@
+/**
+ * @file SensorPipeline.hpp
+ * @brief Continuous analog sensor acquisition with fixed-point median and EMA filtering.
+ */
+
+#ifndef SensorPipeline_hpp
+#define SensorPipeline_hpp
+
+#include <stdint.h>
+#include <stddef.h>
+#include "HAL.hpp"
+#include "Scheduler.hpp"
+
+/**
+ * @class SensorPipeline
+ * @brief Turns a stream of interleaved ADC samples into calibrated readings.
+ *
+ * The ADC samples all channels by DMA into the driver's ring buffer; the CPU
+ * only wakes once per publish interval to drain the ring in batches. Each
+ * batch is split by channel and filtered per channel in one pass: a median of
+ * every five samples removes spikes, and an exponential moving average in
+ * Q16 fixed point smooths what is left. Readings are calibrated linearly into
+ * integer units chosen by the caller, such as milli-pH or tenths of a degree.
+ *
+ * Samples come from the HAL continuous ADC unless another reader is set, so
+ * recorded streams or synthetic data can be fed in on the host.
+ */
+class SensorPipeline {
+public:
+    static constexpr uint8_t maxChannels = 4;
+    static constexpr uint8_t medianWindow = 5; // Samples per median
+    static constexpr size_t batchSamples = 256; // Samples moved out of the ring at a time
+    static constexpr uint8_t invalidId = 0xFF;
+
+    /**
+     * @brief Linear calibration: value = raw * gain / 65536 + offset.
+     */
+    struct Calibration {
+        int32_t gain;   // Q16 units per ADC count
+        int32_t offset; // Value at raw 0
+    };
+
+    /**
+     * @brief Calibration through two reference points, such as pH 4 and pH 7 buffers.
+     */
+    static constexpr Calibration twoPoint(int32_t rawLow, int32_t valueLow, int32_t rawHigh, int32_t valueHigh) {
+        return {static_cast<int32_t>((static_cast<int64_t>(valueHigh) - valueLow) * 65536 / (rawHigh - rawLow)),
+            static_cast<int32_t>(valueLow - static_cast<int64_t>(rawLow) *
+                ((static_cast<int64_t>(valueHigh) - valueLow) * 65536 / (rawHigh - rawLow)) / 65536)};
+    }
+
+    /**
+     * @brief Source of samples in the hal continuous ADC layout.
+     * @return Number of samples written, 0 when none are waiting.
+     */
+    typedef size_t (*SampleReader)(uint16_t* samples, size_t maxSamples, void* context);
+
+    /**
+     * @brief Handler receiving the readings of all channels once per publish interval.
+     */
+    typedef void (*PublishHandler)(const int32_t* readings, uint8_t count, void* context);
+
+    /**
+     * @brief Constructs a pipeline with no channels, reading the HAL continuous ADC.
+     */
+    SensorPipeline();
+
+    /**
+     * @brief Adds a channel. Must be called before begin().
+     * @param adcChannel ADC1 channel the sensor is wired to.
+     * @param calibration Conversion from ADC counts to the reading's unit.
+     * @param emaShift Smoothing: each median moves the average by 1/2^emaShift of its distance.
+     * @return Channel identifier, or invalidId if the table is full.
+     */
+    uint8_t addChannel(uint8_t adcChannel, const Calibration& calibration, uint8_t emaShift);
+
+    /**
+     * @brief Replaces the HAL continuous ADC as the sample source. Must be called before begin().
+     */
+    void setReader(SampleReader reader, void* context);
+
+    /**
+     * @brief Registers the handler receiving the readings.
+     */
+    void setPublishHandler(PublishHandler handler, void* context);
+
+    /**
+     * @brief Starts sampling and the publish timer.
+     * @param sampleRateHz Total conversions per second over all channels.
+     * @param publishIntervalMs Time between readings, which is also how often the CPU wakes.
+     * @return False if the ADC could not be started.
+     */
+    bool begin(Scheduler& scheduler, uint32_t sampleRateHz, uint32_t publishIntervalMs);
+
+    /**
+     * @brief Filters a batch of samples. Samples of unknown channels are skipped.
+     */
+    void process(const uint16_t* samples, size_t count);
+
+    /**
+     * @brief Latest calibrated reading of a channel; 0 until it has a sample.
+     */
+    int32_t getReading(uint8_t channel) const;
+
+    /**
+     * @brief Number of samples filtered on a channel since begin().
+     */
+    uint32_t getSampleCount(uint8_t channel) const;
+
+private:
+    struct Channel {
+        Calibration calibration; // ADC counts to reading
+        uint8_t emaShift; // Smoothing factor as a shift
+        uint8_t pending; // Samples waiting in window for the next median
+        bool primed; // ema holds a value
+        uint16_t window[medianWindow]; // Samples of the incomplete median
+        int32_t ema; // Average of the medians, Q16 ADC counts
+        uint32_t samples; // Samples filtered
+    };
+
+    static void onPublishTimer(void* context); // Drains the ring and publishes
+    static size_t readHal(uint16_t* samples, size_t maxSamples, void* context); // Default reader
+    static uint16_t median5(uint16_t a, uint16_t b, uint16_t c, uint16_t d, uint16_t e);
+    void filter(Channel& channel, const uint16_t* values, size_t count); // Median and EMA over one channel's samples
+    int32_t calibrate(const Channel& channel) const; // Reading from the average
+
+    Channel channels[maxChannels]; // Configured channels
+    uint8_t channelCount; // Channels added
+    uint8_t adcChannels[maxChannels]; // ADC1 channel of each entry
+    uint8_t channelByAdc[1 << (16 - hal::adcSampleChannelShift)]; // Entry of each ADC channel, or invalidId
+    uint16_t batch[batchSamples]; // Samples read from the source
+    uint16_t split[maxChannels][batchSamples]; // Batch split by channel
+    size_t drainLimit; // Batches read per publish at most
+    SampleReader reader; // Sample source
+    void* readerContext; // Argument passed to the reader
+    PublishHandler publishHandler; // Receives the readings
+    void* publishContext; // Argument passed to the handler
+};
+
+#endif /* SensorPipeline_hpp */
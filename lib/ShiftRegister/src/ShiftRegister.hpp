@@ -2,12 +2,15 @@
 #ifndef ShiftRegister_h
 #define ShiftRegister_h
 
-#include <Arduino.h>
+#include "ShiftRegisterChain.hpp"
 
 /**
- * @brief Controls a 74HC595N shift register.
+ * @brief Controls a single 74HC595N shift register.
+ *
+ * A one-register chain clocked out by bit-banging. See ShiftRegisterBase for
+ * the transaction and deferred flush API.
  */
-class ShiftRegister {
+class ShiftRegister : public ShiftRegisterChain<1> {
 public:
     /**
      * @brief Constructs a new ShiftRegister object.
@@ -16,31 +19,6 @@ public:
      * @param latchPin The GPIO pin number for storage register clock input (STCP).
      */
     ShiftRegister(uint8_t dataPin, uint8_t clockPin, uint8_t latchPin);
-
-    /**
-     * @brief Sets the state of an individual pin on the shift register.
-     * @param pin The pin number (0-7) to set the state for.
-     * @param state The state to set the pin to (HIGH or LOW).
-     */
-    void setPinState(uint8_t pin, bool state);
-
-    /**
-     * @brief Writes the current state to the shift register outputs.
-     */
-    void write();
-
-    /**
-     * @brief Gets the current state of an individual pin on the shift register.
-     * @param pin The pin number (0-7) to get the state for.
-     * @return The current state of the specified pin (HIGH or LOW).
-     */
-    bool getPinState(uint8_t pin);
-
-private:
-    uint8_t dataPin;   // The GPIO pin number for serial data input (DS).
-    uint8_t clockPin;  // The GPIO pin number for shift register clock input (SHCP).
-    uint8_t latchPin;  // The GPIO pin number for storage register clock input (STCP).
-    uint8_t registers; // The current state of the shift register.
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,181 @@
+// ShiftRegisterChain.cpp
+#include "ShiftRegisterChain.hpp"
+#include "Profiler.hpp"
+#include <string.h>
+
+PROFILE_HISTOGRAM(shiftRegisterWrite);
+
+/**
+ * @brief Initializes an all-off image. Hardware is set up on the first write.
+ */
+ShiftRegisterBase::ShiftRegisterBase(uint8_t dataPin, uint8_t clockPin, uint8_t latchPin, ShiftRegisterBackend backend,
+    uint8_t* image, uint8_t* latched, uint8_t* frame, uint8_t length)
+    : dataPin(dataPin), clockPin(clockPin), latchPin(latchPin), backend(backend), backendStarted(false), spi(nullptr),
+      image(image), latched(latched), frame(frame), length(length), latchedValid(false), deferred(false),
+      transactionDepth(0), requestedWrites(0), physicalWrites(0) {
+    memset(image, 0, length);
+    memset(latched, 0, length);
+    if (backend == ShiftRegisterBackend::BitBang) {
+        startBackend();
+    }
+}
+
+/**
+ * @brief Releases the SPI peripheral so another chain can claim it.
+ */
+ShiftRegisterBase::~ShiftRegisterBase() {
+    if (spi != nullptr) {
+        hal::spiShiftEnd(spi);
+    }
+}
+
+/**
+ * @brief Sets the state of an individual output in the image.
+ * @param pin The output number.
+ * @param state The state to set the pin to (HIGH or LOW).
+ */
+void ShiftRegisterBase::setPinState(uint16_t pin, bool state) {
+    if (pin >= getPinCount()) {
+        return;
+    }
+    uint8_t mask = 1 << (pin & 7);
+    if (state) {
+        image[pin >> 3] |= mask;
+    } else {
+        image[pin >> 3] &= ~mask;
+    }
+}
+
+/**
+ * @brief Gets the state of an individual output in the image.
+ * @param pin The output number.
+ * @return The current state of the specified pin (HIGH or LOW).
+ */
+bool ShiftRegisterBase::getPinState(uint16_t pin) const {
+    return pin < getPinCount() && ((image[pin >> 3] >> (pin & 7)) & 1);
+}
+
+/**
+ * @brief Sets the outputs selected by mask to the bits of values.
+ * @param values New output states, packed like the image.
+ * @param mask Outputs to change, packed like the image.
+ */
+void ShiftRegisterBase::setPinStates(const uint8_t* values, const uint8_t* mask) {
+    for (uint8_t i = 0; i < length; i++) {
+        image[i] = static_cast<uint8_t>((image[i] & ~mask[i]) | (values[i] & mask[i]));
+    }
+}
+
+/**
+ * @brief Writes the current state to the outputs, unless deferred.
+ */
+void ShiftRegisterBase::write() {
+    requestedWrites++;
+    if (transactionDepth == 0 && !deferred) {
+        flush();
+    }
+}
+
+/**
+ * @brief Starts a (possibly nested) transaction.
+ */
+void ShiftRegisterBase::beginTransaction() {
+    transactionDepth++;
+}
+
+/**
+ * @brief Ends a transaction and writes the outputs when the outermost one ends.
+ */
+void ShiftRegisterBase::commit() {
+    if (transactionDepth > 0 && --transactionDepth == 0 && !deferred) {
+        flush();
+    }
+}
+
+/**
+ * @brief Clocks the image out if it differs from what the outputs show.
+ */
+void ShiftRegisterBase::flush() {
+    if (latchedValid && memcmp(image, latched, length) == 0) {
+        return;
+    }
+    PROFILE_SPAN(shiftRegisterWrite);
+    shiftOutImage();
+    memcpy(latched, image, length);
+    latchedValid = true;
+    physicalWrites++;
+}
+
+/**
+ * @brief Enables or disables deferred mode.
+ * @param deferred True to defer writes until flush().
+ */
+void ShiftRegisterBase::setDeferredFlush(bool deferred) {
+    this->deferred = deferred;
+}
+
+/**
+ * @brief Number of write() calls since construction.
+ */
+uint32_t ShiftRegisterBase::getRequestedWriteCount() const {
+    return requestedWrites;
+}
+
+/**
+ * @brief Number of images clocked out since construction.
+ */
+uint32_t ShiftRegisterBase::getPhysicalWriteCount() const {
+    return physicalWrites;
+}
+
+/**
+ * @brief Number of outputs in the chain.
+ */
+uint16_t ShiftRegisterBase::getPinCount() const {
+    return static_cast<uint16_t>(length) * 8;
+}
+
+/**
+ * @brief Backend in use.
+ */
+ShiftRegisterBackend ShiftRegisterBase::getBackend() const {
+    return backend;
+}
+
+/**
+ * @brief Claims the SPI peripheral, falling back to bit-banging if none is free.
+ */
+void ShiftRegisterBase::startBackend() {
+    backendStarted = true;
+    if (backend == ShiftRegisterBackend::Spi) {
+        spi = hal::spiShiftBegin(dataPin, clockPin, latchPin, length, spiClockHz);
+        if (spi != nullptr) {
+            return;
+        }
+        backend = ShiftRegisterBackend::BitBang;
+    }
+    hal::pinMode(dataPin, OUTPUT);
+    hal::pinMode(clockPin, OUTPUT);
+    hal::pinMode(latchPin, OUTPUT);
+}
+
+/**
+ * @brief Clocks the whole image out, last register first.
+ */
+void ShiftRegisterBase::shiftOutImage() {
+    if (!backendStarted) {
+        startBackend();
+    }
+    if (backend == ShiftRegisterBackend::Spi) {
+        for (uint8_t i = 0; i < length; i++) {
+            frame[i] = image[length - 1 - i];
+        }
+        hal::spiShiftWrite(spi, frame, length);
+        return;
+    }
+    hal::digitalWrite(latchPin, LOW);
+    for (uint8_t i = length; i > 0; i--) {
+        hal::shiftOut(dataPin, clockPin, MSBFIRST, image[i - 1]);
+    }
+    hal::digitalWrite(latchPin, HIGH);
+}
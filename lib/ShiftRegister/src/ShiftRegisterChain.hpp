@@ -0,0 +1,168 @@
+// ShiftRegisterChain.h
+#ifndef ShiftRegisterChain_h
+#define ShiftRegisterChain_h
+
+#include "HAL.hpp"
+
+/**
+ * @brief How a shift register chain is clocked out.
+ */
+enum class ShiftRegisterBackend : uint8_t {
+    BitBang,    // GPIO toggling with shiftOut, one byte at a time.
+    Spi         // SPI peripheral (DMA for long chains) with the latch on chip select.
+};
+
+/**
+ * @brief Size independent part of a chain of daisy-chained 74HC595N shift registers.
+ *
+ * Pin changes update a packed in-memory image; the image is clocked out only
+ * when it differs from what the outputs already show. Changes made inside a
+ * transaction, or between flushes in deferred mode, are coalesced into one
+ * physical write so the outputs never show intermediate states. Pin n is
+ * output n % 8 of register n / 8, register 0 being the one wired to the MCU.
+ */
+class ShiftRegisterBase {
+public:
+    /**
+     * @brief Sets the state of an individual output in the image.
+     * @param pin The output number (0 to getPinCount() - 1).
+     * @param state The state to set the pin to (HIGH or LOW).
+     */
+    void setPinState(uint16_t pin, bool state);
+
+    /**
+     * @brief Gets the state of an individual output in the image.
+     * @param pin The output number (0 to getPinCount() - 1).
+     * @return The current state of the specified pin (HIGH or LOW).
+     */
+    bool getPinState(uint16_t pin) const;
+
+    /**
+     * @brief Sets many outputs of the image at once.
+     *
+     * Outputs whose bit is set in mask take their bit from values; the
+     * others keep their state. Both are packed like the image, register 0
+     * first, getPinCount() / 8 bytes each.
+     *
+     * @param values New output states.
+     * @param mask Outputs to change.
+     */
+    void setPinStates(const uint8_t* values, const uint8_t* mask);
+
+    /**
+     * @brief Writes the current state to the shift register outputs.
+     *
+     * Deferred until commit() inside a transaction, or until flush() in
+     * deferred mode. Skipped if the outputs already show the current state.
+     */
+    void write();
+
+    /**
+     * @brief Starts a transaction. Transactions nest.
+     */
+    void beginTransaction();
+
+    /**
+     * @brief Ends a transaction; the outermost commit writes the outputs once.
+     */
+    void commit();
+
+    /**
+     * @brief Clocks the image out now if it differs from the outputs.
+     */
+    void flush();
+
+    /**
+     * @brief Enables deferred mode, in which write() only marks the image and
+     * the application calls flush() once per tick.
+     * @param deferred True to defer writes until flush().
+     */
+    void setDeferredFlush(bool deferred);
+
+    /**
+     * @brief Number of write() calls since construction.
+     */
+    uint32_t getRequestedWriteCount() const;
+
+    /**
+     * @brief Number of times the image was actually clocked out since construction.
+     */
+    uint32_t getPhysicalWriteCount() const;
+
+    /**
+     * @brief Number of outputs in the chain.
+     */
+    uint16_t getPinCount() const;
+
+    /**
+     * @brief Backend in use. Spi falls back to BitBang if no SPI peripheral is free.
+     */
+    ShiftRegisterBackend getBackend() const;
+
+    ShiftRegisterBase(const ShiftRegisterBase&) = delete;
+    ShiftRegisterBase& operator=(const ShiftRegisterBase&) = delete;
+
+protected:
+    /**
+     * @brief Initializes the chain state. The buffers belong to the derived class.
+     */
+    ShiftRegisterBase(uint8_t dataPin, uint8_t clockPin, uint8_t latchPin, ShiftRegisterBackend backend,
+        uint8_t* image, uint8_t* latched, uint8_t* frame, uint8_t length);
+
+    /**
+     * @brief Releases the SPI peripheral, if one was claimed.
+     */
+    ~ShiftRegisterBase();
+
+private:
+    void startBackend(); // Claims the SPI peripheral or configures the GPIOs
+    void shiftOutImage(); // Clocks the image out with the active backend
+
+    uint8_t dataPin;   // The GPIO pin number for serial data input (DS).
+    uint8_t clockPin;  // The GPIO pin number for shift register clock input (SHCP).
+    uint8_t latchPin;  // The GPIO pin number for storage register clock input (STCP).
+    ShiftRegisterBackend backend; // Backend in use
+    bool backendStarted; // Whether startBackend() ran
+    hal::SpiShiftHandle spi; // SPI device when backend is Spi
+    uint8_t* image;    // The current state of the chain, register 0 first.
+    uint8_t* latched;  // The state last clocked out to the outputs.
+    uint8_t* frame;    // Image in transmission order (last register first).
+    uint8_t length;    // Number of registers in the chain.
+    bool latchedValid; // False until the first physical write.
+    bool deferred;     // Whether write() waits for flush().
+    uint8_t transactionDepth; // Nesting level of open transactions.
+    uint32_t requestedWrites; // Calls to write().
+    uint32_t physicalWrites;  // Images actually clocked out.
+    static constexpr uint32_t spiClockHz = 10000000; // Well within the 74HC595 limit at 3.3 V.
+};
+
+/**
+ * @brief Chain of N daisy-chained shift registers with a compile-time sized image.
+ *
+ * @tparam N Number of 8-bit registers in the chain.
+ */
+template<uint8_t N>
+class ShiftRegisterChain : public ShiftRegisterBase {
+    static_assert(N > 0, "A shift register chain needs at least one register");
+
+public:
+    /**
+     * @brief Constructs a chain. The SPI peripheral is claimed on the first write.
+     * @param dataPin The GPIO pin number for serial data input (DS).
+     * @param clockPin The GPIO pin number for shift register clock input (SHCP).
+     * @param latchPin The GPIO pin number for storage register clock input (STCP).
+     * @param backend How the chain is clocked out.
+     */
+    ShiftRegisterChain(uint8_t dataPin, uint8_t clockPin, uint8_t latchPin,
+        ShiftRegisterBackend backend = ShiftRegisterBackend::BitBang)
+        : ShiftRegisterBase(dataPin, clockPin, latchPin, backend, imageBuffer, latchedBuffer, frameBuffer, N) {}
+
+    static constexpr uint16_t pinCount = N * 8; // Number of outputs in the chain.
+
+private:
+    uint8_t imageBuffer[N];   // Current state
+    uint8_t latchedBuffer[N]; // State shown by the outputs
+    uint8_t frameBuffer[N];   // Transmission order scratch buffer
+};
+
+#endif
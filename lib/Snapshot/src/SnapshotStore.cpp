@@ -0,0 +1,109 @@
+/**
+ * @file SnapshotStore.cpp
+ * @brief Implementation of the versioned NVS snapshot.
+ */
+
+#include "SnapshotStore.hpp"
+#include "DebugLogger.hpp"
+#include "HAL.hpp"
+#include <string.h>
+
+/**
+ * @brief Constructs a store for one struct layout.
+ * @param key NVS key, at most hal::nvsMaxKeyLength characters; must outlive the store.
+ * @param version Format version; change it whenever the struct changes.
+ */
+SnapshotStore::SnapshotStore(const char* key, uint8_t version)
+    : key(key), version(version), last(), haveLast(false), writeCount(0), skippedCount(0) {}
+
+/**
+ * @brief Reads the snapshot.
+ *
+ * The record is stored at its used length, so a struct of another size
+ * fails the read before its CRC is even checked.
+ *
+ * @return False if there is none, or it is of another version or length, or corrupt; data is then unchanged.
+ */
+bool SnapshotStore::load(void* data, size_t length) {
+    if (length > maxSize) {
+        return false;
+    }
+    Record record;
+    if (!hal::nvsRead(key, &record, headerSize + length)) {
+        return false;
+    }
+    if (record.version != version || record.length != length || record.crc != recordCrc(record)) {
+        LOG_WARN("Snapshot %s discarded: version %u, length %u.", key, record.version, record.length);
+        return false;
+    }
+    memcpy(data, record.data, length);
+    last = record;
+    haveLast = true;
+    return true;
+}
+
+/**
+ * @brief Writes the snapshot if it differs from the last one loaded or saved.
+ * @return False if the write failed or the struct is larger than maxSize.
+ */
+bool SnapshotStore::save(const void* data, size_t length) {
+    if (length > maxSize) {
+        return false;
+    }
+    if (haveLast && last.length == length && memcmp(last.data, data, length) == 0) {
+        skippedCount++;
+        return true;
+    }
+    Record record = {};
+    record.version = version;
+    record.length = static_cast<uint8_t>(length);
+    memcpy(record.data, data, length);
+    record.crc = recordCrc(record);
+    if (!hal::nvsWrite(key, &record, headerSize + length)) {
+        LOG_ERROR("Snapshot %s could not be written.", key);
+        return false;
+    }
+    writeCount++;
+    last = record;
+    haveLast = true;
+    return true;
+}
+
+/**
+ * @brief NVS writes since construction.
+ */
+uint32_t SnapshotStore::getWriteCount() const {
+    return writeCount;
+}
+
+/**
+ * @brief Saves skipped because nothing changed.
+ */
+uint32_t SnapshotStore::getSkippedCount() const {
+    return skippedCount;
+}
+
+/**
+ * @brief CRC-32 (IEEE 802.3, as zlib) of a buffer, continuing from a previous result.
+ *
+ * Computed a nibble at a time from a 16-entry table: snapshots are a few
+ * dozen bytes, so the 1 KB byte table would not pay for its flash.
+ */
+uint32_t SnapshotStore::crc32(const void* data, size_t length, uint32_t crc) {
+    static const uint32_t nibbleTable[16] = {
+        0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+        0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C};
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    crc = ~crc;
+    for (size_t i = 0; i < length; i++) {
+        crc ^= bytes[i];
+        crc = (crc >> 4) ^ nibbleTable[crc & 15];
+        crc = (crc >> 4) ^ nibbleTable[crc & 15];
+    }
+    return ~crc;
+}
+
+uint32_t SnapshotStore::recordCrc(const Record& record) {
+    uint32_t crc = crc32(&record, 2);
+    return crc32(record.data, record.length, crc);
+}
@@ -0,0 +1,84 @@
+/**
+ * @file SnapshotStore.hpp
+ * @brief Versioned, CRC-checked snapshot of a small struct in NVS.
+ */
+
+#ifndef SnapshotStore_hpp
+#define SnapshotStore_hpp
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * @class SnapshotStore
+ * @brief Keeps one small struct in NVS across restarts, written only when it changed.
+ *
+ * The struct is stored behind a header holding a format version and a
+ * CRC-32 of the version, length and data. load() rejects a snapshot of
+ * another version or length, or one whose CRC does not match, so a firmware
+ * with a changed layout starts from its defaults instead of misreading old
+ * bytes. save() compares with the last snapshot loaded or saved and skips
+ * the write when nothing changed, since every NVS write wears flash.
+ */
+class SnapshotStore {
+public:
+    static constexpr size_t maxSize = 32; // Largest struct kept
+
+    /**
+     * @brief Constructs a store for one struct layout.
+     * @param key NVS key, at most hal::nvsMaxKeyLength characters; must outlive the store.
+     * @param version Format version; change it whenever the struct changes.
+     */
+    SnapshotStore(const char* key, uint8_t version);
+
+    /**
+     * @brief Reads the snapshot.
+     * @return False if there is none, or it is of another version or length, or corrupt; data is then unchanged.
+     */
+    bool load(void* data, size_t length);
+
+    /**
+     * @brief Writes the snapshot if it differs from the last one loaded or saved.
+     * @return False if the write failed or the struct is larger than maxSize.
+     */
+    bool save(const void* data, size_t length);
+
+    /**
+     * @brief NVS writes since construction.
+     */
+    uint32_t getWriteCount() const;
+
+    /**
+     * @brief Saves skipped because nothing changed.
+     */
+    uint32_t getSkippedCount() const;
+
+    /**
+     * @brief CRC-32 (IEEE 802.3, as zlib) of a buffer, continuing from a previous result.
+     */
+    static uint32_t crc32(const void* data, size_t length, uint32_t crc = 0);
+
+private:
+    /**
+     * @brief What is stored under the key: header, then the struct.
+     */
+    struct Record {
+        uint8_t version;
+        uint8_t length; // Bytes of data used
+        uint16_t reserved; // Zero
+        uint32_t crc; // Of version, length and data
+        uint8_t data[maxSize];
+    };
+
+    static constexpr size_t headerSize = 8;
+    static uint32_t recordCrc(const Record& record);
+
+    const char* key;
+    uint8_t version;
+    Record last; // Last snapshot loaded or saved
+    bool haveLast;
+    uint32_t writeCount;
+    uint32_t skippedCount;
+};
+
+#endif /* SnapshotStore_hpp */
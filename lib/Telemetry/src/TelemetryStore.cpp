@@ -0,0 +1,564 @@
+/**
+ * @file TelemetryStore.cpp
+ * @brief Implementation of the on-flash telemetry log.
+ */
+
+#include "TelemetryStore.hpp"
+#include "DebugLogger.hpp"
+#include <string.h>
+
+namespace {
+
+constexpr uint8_t channelMask = 0x0F; // Record header: channel
+constexpr uint8_t sameInterval = 0x10; // Record header: no interval change follows
+constexpr uint8_t sameValue = 0x20; // Record header: no value change follows
+
+uint8_t* putVarint(uint8_t* out, uint64_t value) {
+    while (value >= 0x80) {
+        *out++ = static_cast<uint8_t>(value | 0x80);
+        value >>= 7;
+    }
+    *out++ = static_cast<uint8_t>(value);
+    return out;
+}
+
+/**
+ * Reads a varint, or returns false if it runs past the end.
+ */
+bool getVarint(const uint8_t*& in, const uint8_t* end, uint64_t& value) {
+    value = 0;
+    for (uint8_t shift = 0; shift < 64 && in < end; shift += 7) {
+        uint8_t byte = *in++;
+        value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+uint64_t zigzag(int64_t value) {
+    return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+}
+
+int64_t unzigzag(uint64_t value) {
+    return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
+
+/**
+ * Query handler of mount(): keeps the newest time.
+ */
+void trackNewest(uint8_t channel, uint64_t timeMs, int32_t value, void* context) {
+    (void)channel;
+    (void)value;
+    uint64_t* newest = static_cast<uint64_t*>(context);
+    if (timeMs > *newest) {
+        *newest = timeMs;
+    }
+}
+
+} // namespace
+
+/**
+ * @brief Constructs a store with no channels.
+ */
+TelemetryStore::TelemetryStore()
+    : channelCount(0), encodings(), names(), mounted(false), segmentCount(0), currentSegment(noSegment), header(),
+      blockIndex(0), blockOpen(false), blockTimeMs(0), buffer(), blockLength(0), committedLength(0), commitCount(0),
+      channelStates(), lastTimeMs(0), clockMs(0), lastClockMs(0), recordCount(0), encodedBytes(0), consumedBytes(0) {}
+
+/**
+ * @brief Adds a channel. Must be called before begin().
+ * @param name Up to nameLength characters, stored in every segment for the host tool.
+ * @return Channel identifier, or invalidId if the table is full.
+ */
+uint8_t TelemetryStore::addChannel(const char* name, Encoding encoding) {
+    if (channelCount >= maxChannels || mounted) {
+        LOG_ERROR("Telemetry channel %s rejected.", name);
+        return invalidId;
+    }
+    strncpy(names[channelCount], name, nameLength);
+    encodings[channelCount] = static_cast<uint8_t>(encoding);
+    return channelCount++;
+}
+
+/**
+ * @brief Mounts the log and starts the flush timer.
+ *
+ * Appending continues in the newest segment, or in a new one if the
+ * channels changed since it was written.
+ *
+ * @return False if there is no storage partition of at least two segments.
+ */
+bool TelemetryStore::begin(Scheduler& scheduler, uint32_t flushIntervalMs) {
+    size_t segments = hal::storageSize() / segmentSize;
+    if (segments < 2) {
+        LOG_ERROR("No storage partition for telemetry.");
+        return false;
+    }
+    segmentCount = static_cast<uint16_t>(segments < noSegment ? segments : noSegment - 1);
+    mount();
+    mounted = true;
+    uint8_t timer = scheduler.addTimer(onFlushTimer, this);
+    scheduler.startTimer(timer, flushIntervalMs, flushIntervalMs);
+    return true;
+}
+
+/**
+ * @brief Appends a value stamped with the current time.
+ * @return False if the store is not mounted, the channel is unknown or flash failed.
+ */
+bool TelemetryStore::append(uint8_t channel, int32_t value) {
+    return append(channel, value, static_cast<uint32_t>(hal::millis()));
+}
+
+/**
+ * @brief Appends a value sampled at an earlier hal::millis().
+ *
+ * Records are kept in time order: a timestamp before the newest record is
+ * moved up to it.
+ */
+bool TelemetryStore::append(uint8_t channel, int32_t value, uint32_t uptimeMs) {
+    if (!mounted || channel >= channelCount) {
+        return false;
+    }
+    advanceClock();
+    // The age is a 32-bit difference, so it stays right across a millis() wrap.
+    uint32_t ageMs = lastClockMs - uptimeMs;
+    uint64_t timeMs = ageMs < clockMs ? clockMs - ageMs : 0;
+    if (timeMs < lastTimeMs) {
+        timeMs = lastTimeMs;
+    }
+    uint8_t record[maxRecordBytes];
+    size_t length = 0;
+    if (blockOpen) {
+        ChannelState next = channelStates[channel];
+        length = encode(channel, timeMs, value, next, record);
+        if (blockLength + length <= blockDataSize && timeMs - header.baseTimeMs < unusedBlock) {
+            channelStates[channel] = next;
+        } else {
+            // The block is full: commit it and continue in the next one.
+            if (!commit()) {
+                return false;
+            }
+            if (blockOpen) {
+                blockOpen = false;
+                blockIndex++;
+            }
+            length = 0;
+        }
+    }
+    if (length == 0) {
+        if (!openBlock(timeMs)) {
+            return false;
+        }
+        length = encode(channel, timeMs, value, channelStates[channel], record);
+    }
+    memcpy(buffer + blockLength, record, length);
+    blockLength += length;
+    lastTimeMs = timeMs;
+    recordCount++;
+    encodedBytes += static_cast<uint32_t>(length);
+    return true;
+}
+
+/**
+ * @brief Commits the records collected in RAM to flash.
+ * @return False if flash failed.
+ */
+bool TelemetryStore::flush() {
+    return commit();
+}
+
+/**
+ * @brief Delivers every record from fromMs to toMs inclusive, oldest first.
+ *
+ * Segments follow each other around the partition in time order, starting
+ * after the current one, so the segment holding fromMs is found by binary
+ * search over their headers; erased segments sort first. From there the
+ * block index of each segment skips blocks that end before fromMs. The open
+ * block and the current segment's header are read from RAM, so records not
+ * yet committed are included without spending a commit on them.
+ *
+ * @param maxRecords Stops after this many records, to read a long range in pieces.
+ * @return Number of records delivered.
+ */
+size_t TelemetryStore::query(uint64_t fromMs, uint64_t toMs, RecordHandler handler, void* context,
+    size_t maxRecords) const {
+    if (!mounted || currentSegment == noSegment || fromMs > toMs || maxRecords == 0) {
+        return 0;
+    }
+    SegmentHeader segmentHeader;
+    const size_t prefix = offsetof(SegmentHeader, encodings);
+    uint16_t low = 0;
+    uint16_t high = segmentCount;
+    while (low < high) {
+        uint16_t middle = static_cast<uint16_t>((low + high) / 2);
+        uint16_t segment = static_cast<uint16_t>((currentSegment + 1 + middle) % segmentCount);
+        if (readHeader(segment, segmentHeader, prefix) && segmentHeader.baseTimeMs >= fromMs) {
+            high = middle;
+        } else {
+            low = static_cast<uint16_t>(middle + 1);
+        }
+    }
+    size_t delivered = 0;
+    uint8_t data[blockDataSize];
+    for (uint16_t position = low > 0 ? low - 1 : 0; position < segmentCount; position++) {
+        uint16_t segment = static_cast<uint16_t>((currentSegment + 1 + position) % segmentCount);
+        if (segment == currentSegment) {
+            segmentHeader = header;
+        } else if (!readHeader(segment, segmentHeader, sizeof(segmentHeader))) {
+            continue;
+        }
+        if (segmentHeader.baseTimeMs > toMs) {
+            break;
+        }
+        for (uint8_t block = 0; block < blocksPerSegment && segmentHeader.blockTimes[block] != unusedBlock; block++) {
+            uint64_t startMs = segmentHeader.baseTimeMs + segmentHeader.blockTimes[block];
+            if (startMs > toMs) {
+                return delivered;
+            }
+            if (block + 1 < blocksPerSegment && segmentHeader.blockTimes[block + 1] != unusedBlock &&
+                segmentHeader.baseTimeMs + segmentHeader.blockTimes[block + 1] < fromMs) {
+                continue;
+            }
+            const uint8_t* blockData = buffer;
+            size_t length = blockLength;
+            if (segment != currentSegment || block != blockIndex || !blockOpen) {
+                length = readBlock(segment, block, data);
+                blockData = data;
+            }
+            delivered += decodeBlock(blockData, length, startMs, segmentHeader, fromMs, toMs, handler, context,
+                maxRecords - delivered);
+            if (delivered == maxRecords) {
+                return delivered;
+            }
+        }
+    }
+    return delivered;
+}
+
+/**
+ * @brief Erases every segment. The clock keeps running from where it was.
+ * @return False if flash failed.
+ */
+bool TelemetryStore::format() {
+    SegmentHeader segmentHeader;
+    for (uint16_t segment = 0; segment < segmentCount; segment++) {
+        if (readHeader(segment, segmentHeader, offsetof(SegmentHeader, encodings)) &&
+            !hal::storageErase(segment * segmentSize, segmentSize)) {
+            LOG_ERROR("Telemetry segment %u could not be erased.", segment);
+            return false;
+        }
+    }
+    currentSegment = noSegment;
+    blockOpen = false;
+    return true;
+}
+
+/**
+ * @brief Current time on the log's clock.
+ */
+uint64_t TelemetryStore::now() const {
+    return clockMs + (static_cast<uint32_t>(hal::millis()) - lastClockMs);
+}
+
+/**
+ * @brief Records appended since begin().
+ */
+uint32_t TelemetryStore::getRecordCount() const {
+    return recordCount;
+}
+
+/**
+ * @brief Bytes the records appended since begin() take once encoded.
+ */
+uint32_t TelemetryStore::getEncodedBytes() const {
+    return encodedBytes;
+}
+
+/**
+ * @brief Flash taken since begin() by segment headers and opened blocks, used or not.
+ */
+uint32_t TelemetryStore::getConsumedBytes() const {
+    return consumedBytes;
+}
+
+void TelemetryStore::onFlushTimer(void* context) {
+    TelemetryStore* store = static_cast<TelemetryStore*>(context);
+    // Advancing at least once per flush interval keeps now() within one millis() wrap.
+    store->advanceClock();
+    store->flush();
+}
+
+/**
+ * @brief Decodes a block and delivers its records from fromMs to toMs, at most maxRecords.
+ *
+ * Stops at the first malformed record, such as the end of a block whose last
+ * commit was cut short.
+ *
+ * @return Number of records delivered.
+ */
+size_t TelemetryStore::decodeBlock(const uint8_t* data, size_t length, uint64_t blockTimeMs,
+    const SegmentHeader& header, uint64_t fromMs, uint64_t toMs, RecordHandler handler, void* context,
+    size_t maxRecords) {
+    ChannelState states[maxChannels];
+    for (ChannelState& state : states) {
+        state = {blockTimeMs, 0, 0};
+    }
+    size_t delivered = 0;
+    const uint8_t* in = data;
+    const uint8_t* end = data + length;
+    while (in < end && delivered < maxRecords) {
+        uint8_t flags = *in++;
+        uint8_t channel = flags & channelMask;
+        if (channel >= header.channelCount) {
+            break;
+        }
+        ChannelState& state = states[channel];
+        uint64_t raw = 0;
+        if ((flags & sameInterval) == 0 && !getVarint(in, end, raw)) {
+            break;
+        }
+        state.lastDeltaMs += unzigzag(raw);
+        state.lastTimeMs += static_cast<uint64_t>(state.lastDeltaMs);
+        raw = 0;
+        if ((flags & sameValue) == 0 && !getVarint(in, end, raw)) {
+            break;
+        }
+        if (header.encodings[channel] == static_cast<uint8_t>(Encoding::Xor)) {
+            state.lastValue = static_cast<int32_t>(static_cast<uint32_t>(state.lastValue) ^ static_cast<uint32_t>(raw));
+        } else {
+            state.lastValue = static_cast<int32_t>(state.lastValue + unzigzag(raw));
+        }
+        if (state.lastTimeMs > toMs) {
+            break;
+        }
+        if (state.lastTimeMs >= fromMs) {
+            handler(channel, state.lastTimeMs, state.lastValue, context);
+            delivered++;
+        }
+    }
+    return delivered;
+}
+
+/**
+ * @brief Finds the newest segment and resumes after its last record.
+ *
+ * Only the header prefix of each segment is read, plus the last block of the
+ * newest one for the time of its last record.
+ */
+void TelemetryStore::mount() {
+    SegmentHeader segmentHeader;
+    uint32_t newestSequence = 0;
+    currentSegment = noSegment;
+    for (uint16_t segment = 0; segment < segmentCount; segment++) {
+        if (readHeader(segment, segmentHeader, offsetof(SegmentHeader, encodings)) &&
+            (currentSegment == noSegment || segmentHeader.sequence > newestSequence)) {
+            currentSegment = segment;
+            newestSequence = segmentHeader.sequence;
+        }
+    }
+    blockOpen = false;
+    if (currentSegment == noSegment) {
+        return;
+    }
+    readHeader(currentSegment, header, sizeof(header));
+    blockIndex = 0;
+    while (blockIndex < blocksPerSegment && header.blockTimes[blockIndex] != unusedBlock) {
+        blockIndex++;
+    }
+    uint64_t newest = header.baseTimeMs;
+    if (blockIndex > 0) {
+        uint8_t data[blockDataSize];
+        size_t length = readBlock(currentSegment, blockIndex - 1, data);
+        uint64_t startMs = header.baseTimeMs + header.blockTimes[blockIndex - 1];
+        newest = startMs;
+        decodeBlock(data, length, startMs, header, 0, UINT64_MAX, trackNewest, &newest, SIZE_MAX);
+    }
+    lastTimeMs = newest;
+    lastClockMs = static_cast<uint32_t>(hal::millis());
+    clockMs = newest + 1;
+    // Blocks are decoded with the channel table of their segment, so a
+    // changed table needs a new one.
+    if (header.channelCount != channelCount || memcmp(header.encodings, encodings, sizeof(encodings)) != 0 ||
+        memcmp(header.names, names, sizeof(names)) != 0) {
+        blockIndex = blocksPerSegment;
+    }
+    LOG_INFO("Telemetry resumes in segment %u block %u at %lu s.", currentSegment, blockIndex,
+        static_cast<unsigned long>(lastTimeMs / 1000));
+}
+
+/**
+ * @brief Moves the log clock on by the hal::millis() elapsed since the last call.
+ *
+ * millis() is 32 bits on the ESP32 and wraps after about 49.7 days; the
+ * difference of two readings does not, as long as the clock is advanced more
+ * often than that.
+ */
+void TelemetryStore::advanceClock() {
+    uint32_t nowMs = static_cast<uint32_t>(hal::millis());
+    clockMs += nowMs - lastClockMs;
+    lastClockMs = nowMs;
+}
+
+/**
+ * @brief Erases the next segment and writes its header.
+ *
+ * The magic number is written last, so a segment cut off while opening is
+ * not taken for a valid one.
+ */
+bool TelemetryStore::openSegment(uint64_t timeMs) {
+    uint32_t sequence = currentSegment == noSegment ? 1 : header.sequence + 1;
+    uint16_t segment = currentSegment == noSegment ? 0 : static_cast<uint16_t>((currentSegment + 1) % segmentCount);
+    if (!hal::storageErase(segment * segmentSize, segmentSize)) {
+        LOG_ERROR("Telemetry segment %u could not be erased.", segment);
+        return false;
+    }
+    memset(&header, 0xFF, sizeof(header));
+    header.version = formatVersion;
+    header.channelCount = channelCount;
+    header.blockSize = blockSize;
+    header.sequence = sequence;
+    header.baseTimeMs = timeMs;
+    memcpy(header.encodings, encodings, sizeof(encodings));
+    memcpy(header.names, names, sizeof(names));
+    const size_t body = offsetof(SegmentHeader, blockTimes) - sizeof(header.magic);
+    uint32_t segmentMagic = magic;
+    if (!hal::storageWrite(segment * segmentSize + sizeof(header.magic), &header.version, body) ||
+        !hal::storageWrite(segment * segmentSize, &segmentMagic, sizeof(segmentMagic))) {
+        LOG_ERROR("Telemetry segment %u could not be written.", segment);
+        return false;
+    }
+    header.magic = magic;
+    currentSegment = segment;
+    blockIndex = 0;
+    consumedBytes += blockSize;
+    return true;
+}
+
+/**
+ * @brief Starts the next block, in a new segment if needed.
+ */
+bool TelemetryStore::openBlock(uint64_t timeMs) {
+    if (currentSegment == noSegment || blockIndex >= blocksPerSegment || timeMs - header.baseTimeMs >= unusedBlock) {
+        if (!openSegment(timeMs)) {
+            return false;
+        }
+    }
+    header.blockTimes[blockIndex] = static_cast<uint32_t>(timeMs - header.baseTimeMs);
+    blockTimeMs = timeMs;
+    for (ChannelState& state : channelStates) {
+        state = {timeMs, 0, 0};
+    }
+    blockLength = 0;
+    committedLength = 0;
+    commitCount = 0;
+    blockOpen = true;
+    consumedBytes += blockSize;
+    return true;
+}
+
+/**
+ * @brief Writes the uncommitted bytes of the block and their length.
+ *
+ * The first commit of a block also writes its index entry. A block whose
+ * commit slots are used up is closed.
+ */
+bool TelemetryStore::commit() {
+    if (!blockOpen || blockLength == committedLength) {
+        return true;
+    }
+    const size_t offset = blockOffset(currentSegment, blockIndex);
+    const uint16_t length = static_cast<uint16_t>(blockLength);
+    bool written = true;
+    if (commitCount == 0) {
+        written = hal::storageWrite(currentSegment * segmentSize + offsetof(SegmentHeader, blockTimes) +
+            blockIndex * sizeof(uint32_t), &header.blockTimes[blockIndex], sizeof(uint32_t));
+    }
+    written = written &&
+        hal::storageWrite(offset + commitSlots * sizeof(uint16_t) + committedLength, buffer + committedLength,
+            blockLength - committedLength) &&
+        hal::storageWrite(offset + commitCount * sizeof(uint16_t), &length, sizeof(length));
+    if (!written) {
+        LOG_ERROR("Telemetry block could not be written.");
+        return false;
+    }
+    committedLength = blockLength;
+    if (++commitCount == commitSlots) {
+        blockOpen = false;
+        blockIndex++;
+    }
+    return true;
+}
+
+/**
+ * @brief Encodes a record and advances the channel state past it.
+ * @return Length of the record.
+ */
+size_t TelemetryStore::encode(uint8_t channel, uint64_t timeMs, int32_t value, ChannelState& channelState,
+    uint8_t* record) const {
+    int64_t deltaMs = static_cast<int64_t>(timeMs - channelState.lastTimeMs);
+    int64_t intervalChange = deltaMs - channelState.lastDeltaMs;
+    uint64_t valueChange;
+    if (encodings[channel] == static_cast<uint8_t>(Encoding::Xor)) {
+        valueChange = static_cast<uint32_t>(value) ^ static_cast<uint32_t>(channelState.lastValue);
+    } else {
+        valueChange = zigzag(static_cast<int64_t>(value) - channelState.lastValue);
+    }
+    uint8_t* out = record + 1;
+    record[0] = channel;
+    if (intervalChange == 0) {
+        record[0] |= sameInterval;
+    } else {
+        out = putVarint(out, zigzag(intervalChange));
+    }
+    if (valueChange == 0) {
+        record[0] |= sameValue;
+    } else {
+        out = putVarint(out, valueChange);
+    }
+    channelState.lastTimeMs = timeMs;
+    channelState.lastDeltaMs = deltaMs;
+    channelState.lastValue = value;
+    return static_cast<size_t>(out - record);
+}
+
+/**
+ * @brief Reads the first length bytes of a segment header.
+ * @return False if the segment holds no valid header.
+ */
+bool TelemetryStore::readHeader(uint16_t segment, SegmentHeader& segmentHeader, size_t length) const {
+    return hal::storageRead(segment * segmentSize, &segmentHeader, length) && segmentHeader.magic == magic &&
+        segmentHeader.version == formatVersion && segmentHeader.blockSize == blockSize &&
+        segmentHeader.channelCount <= maxChannels;
+}
+
+/**
+ * @brief Reads the committed bytes of a block.
+ * @return Their length: the last commit slot written, 0 if none.
+ */
+size_t TelemetryStore::readBlock(uint16_t segment, uint8_t block, uint8_t* data) const {
+    uint16_t commits[commitSlots];
+    if (!hal::storageRead(blockOffset(segment, block), commits, sizeof(commits))) {
+        return 0;
+    }
+    size_t length = 0;
+    for (uint16_t commit : commits) {
+        if (commit == 0xFFFF) {
+            break;
+        }
+        length = commit <= blockDataSize ? commit : 0;
+    }
+    if (length > 0 && !hal::storageRead(blockOffset(segment, block) + sizeof(commits), data, length)) {
+        return 0;
+    }
+    return length;
+}
+
+/**
+ * @brief Partition offset of a block slot.
+ */
+size_t TelemetryStore::blockOffset(uint16_t segment, uint8_t block) const {
+    return segment * segmentSize + (block + 1) * blockSize;
+}
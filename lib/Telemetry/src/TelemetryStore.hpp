@@ -0,0 +1,215 @@
+/**
+ * @file TelemetryStore.hpp
+ * @brief Compressed append-only time series log on the flash storage partition.
+ */
+
+#ifndef TelemetryStore_hpp
+#define TelemetryStore_hpp
+
+#include <stdint.h>
+#include <stddef.h>
+#include "HAL.hpp"
+#include "Scheduler.hpp"
+
+/**
+ * @class TelemetryStore
+ * @brief Keeps days of readings and state changes on flash, and finds them by time.
+ *
+ * The storage partition is a circular log of one-sector segments. Appending
+ * only ever programs erased bytes; when the log is full the oldest segment is
+ * erased for the next one, so every sector is erased equally often. A segment
+ * starts with a header naming the channels and holding the start time of each
+ * of its blocks, which is the index a range query uses to skip to the right
+ * segment and block without reading the records in between.
+ *
+ * Records are compressed per channel: the timestamp as the change of the
+ * interval since the channel's previous record (0 for periodic samples), the
+ * value as the difference to the previous one, or as its XOR for bit fields.
+ * An unchanged interval or value costs no byte beyond the record's header
+ * byte. Each block starts from scratch, so it can be decoded on its own.
+ *
+ * Records collect in RAM and are committed once per flush interval and
+ * whenever a block fills. A commit writes the new bytes and then their
+ * length, so a power cut loses at most the uncommitted records and never
+ * leaves a half-written record in view.
+ *
+ * Time is milliseconds of uptime since the log was created: after a restart
+ * the clock resumes just after the newest record, without counting the time
+ * the controller was off. The clock is 64 bits and advances by differences
+ * of the 32-bit hal::millis(), so it runs on past the wrap after 49.7 days.
+ * tools/telemetry_dump.py decodes a partition image.
+ */
+class TelemetryStore {
+public:
+    /**
+     * @enum Encoding
+     * @brief How a channel's values are stored relative to the previous one.
+     */
+    enum class Encoding : uint8_t {
+        Delta,  // Difference, for readings
+        Xor     // Changed bits, for bit fields such as AppState
+    };
+
+    static constexpr uint8_t maxChannels = 16;
+    static constexpr uint8_t nameLength = 8; // Channel name bytes, not necessarily terminated
+    static constexpr size_t segmentSize = hal::storageSectorSize;
+    static constexpr size_t blockSize = 256; // Header slot and block slots of a segment
+    static constexpr uint8_t blocksPerSegment = segmentSize / blockSize - 1;
+    static constexpr uint8_t commitSlots = 8; // Commits per block
+    static constexpr size_t blockDataSize = blockSize - commitSlots * sizeof(uint16_t);
+    static constexpr uint8_t formatVersion = 1;
+    static constexpr uint8_t invalidId = 0xFF;
+
+    /**
+     * @brief Handler receiving the records of a query in time order.
+     */
+    typedef void (*RecordHandler)(uint8_t channel, uint64_t timeMs, int32_t value, void* context);
+
+    /**
+     * @brief Constructs a store with no channels.
+     */
+    TelemetryStore();
+
+    /**
+     * @brief Adds a channel. Must be called before begin().
+     * @param name Up to nameLength characters, stored in every segment for the host tool.
+     * @return Channel identifier, or invalidId if the table is full.
+     */
+    uint8_t addChannel(const char* name, Encoding encoding);
+
+    /**
+     * @brief Mounts the log and starts the flush timer.
+     *
+     * Appending continues in the newest segment, or in a new one if the
+     * channels changed since it was written.
+     *
+     * @return False if there is no storage partition of at least two segments.
+     */
+    bool begin(Scheduler& scheduler, uint32_t flushIntervalMs);
+
+    /**
+     * @brief Appends a value stamped with the current time.
+     * @return False if the store is not mounted, the channel is unknown or flash failed.
+     */
+    bool append(uint8_t channel, int32_t value);
+
+    /**
+     * @brief Appends a value sampled at an earlier hal::millis().
+     *
+     * Records are kept in time order: a timestamp before the newest record is
+     * moved up to it.
+     */
+    bool append(uint8_t channel, int32_t value, uint32_t uptimeMs);
+
+    /**
+     * @brief Commits the records collected in RAM to flash.
+     * @return False if flash failed.
+     */
+    bool flush();
+
+    /**
+     * @brief Delivers every record from fromMs to toMs inclusive, oldest first.
+     *
+     * Includes the records not yet committed.
+     *
+     * @param maxRecords Stops after this many records, to read a long range in pieces.
+     * @return Number of records delivered.
+     */
+    size_t query(uint64_t fromMs, uint64_t toMs, RecordHandler handler, void* context, size_t maxRecords = SIZE_MAX) const;
+
+    /**
+     * @brief Erases every segment. The clock keeps running from where it was.
+     * @return False if flash failed.
+     */
+    bool format();
+
+    /**
+     * @brief Current time on the log's clock.
+     */
+    uint64_t now() const;
+
+    /**
+     * @brief Records appended since begin().
+     */
+    uint32_t getRecordCount() const;
+
+    /**
+     * @brief Bytes the records appended since begin() take once encoded.
+     */
+    uint32_t getEncodedBytes() const;
+
+    /**
+     * @brief Flash taken since begin() by segment headers and opened blocks, used or not.
+     */
+    uint32_t getConsumedBytes() const;
+
+private:
+    static constexpr uint32_t magic = 0x314D4C54; // "TLM1"
+    static constexpr uint32_t unusedBlock = 0xFFFFFFFF; // blockTimes entry of a block not started
+    static constexpr uint16_t noSegment = 0xFFFF;
+    static constexpr size_t maxRecordBytes = 21; // Header byte and two 10-byte varints
+
+    /**
+     * @brief First slot of a segment. Erased fields read as all ones.
+     */
+    struct SegmentHeader {
+        uint32_t magic;
+        uint8_t version;
+        uint8_t channelCount;
+        uint16_t blockSize;
+        uint32_t sequence; // Increases by one per segment opened
+        uint32_t reserved;
+        uint64_t baseTimeMs; // Time of the first record
+        uint8_t encodings[maxChannels]; // Encoding of each channel
+        char names[maxChannels][nameLength]; // Name of each channel
+        uint32_t blockTimes[blocksPerSegment]; // First record of each block, ms after baseTimeMs
+        uint8_t padding[28]; // Reserved, fills the slot
+    };
+    static_assert(sizeof(SegmentHeader) == blockSize, "segment header must fill one slot");
+
+    /**
+     * @brief Encoder or decoder state of one channel within a block.
+     */
+    struct ChannelState {
+        uint64_t lastTimeMs; // Previous record, or the block start
+        int64_t lastDeltaMs; // Interval before the previous record
+        int32_t lastValue; // Previous value, 0 at the block start
+    };
+
+    static void onFlushTimer(void* context); // Commits periodically
+    static size_t decodeBlock(const uint8_t* data, size_t length, uint64_t blockTimeMs, const SegmentHeader& header,
+        uint64_t fromMs, uint64_t toMs, RecordHandler handler, void* context, size_t maxRecords);
+    void mount(); // Finds the newest segment and resumes after its last record
+    void advanceClock(); // Moves the log clock on by the millis() elapsed, wrap-safe
+    bool openSegment(uint64_t timeMs); // Erases the next segment and writes its header
+    bool openBlock(uint64_t timeMs); // Starts the next block, in a new segment if needed
+    bool commit(); // Writes the uncommitted bytes of the block and their length
+    size_t encode(uint8_t channel, uint64_t timeMs, int32_t value, ChannelState& channelState, uint8_t* record) const;
+    bool readHeader(uint16_t segment, SegmentHeader& header, size_t length) const; // Reads and validates
+    size_t readBlock(uint16_t segment, uint8_t block, uint8_t* data) const; // Committed bytes of a block
+    size_t blockOffset(uint16_t segment, uint8_t block) const; // Partition offset of a block slot
+
+    uint8_t channelCount; // Channels added
+    uint8_t encodings[maxChannels]; // Encoding of each channel
+    char names[maxChannels][nameLength]; // Name of each channel
+    bool mounted; // begin() succeeded
+    uint16_t segmentCount; // Segments in the partition
+    uint16_t currentSegment; // Segment being appended to, or noSegment
+    SegmentHeader header; // Header of the current segment
+    uint8_t blockIndex; // Block being appended to, or the next to open
+    bool blockOpen; // blockIndex accepts records
+    uint64_t blockTimeMs; // First record of the open block
+    uint8_t buffer[blockDataSize]; // Records of the open block
+    size_t blockLength; // Bytes in buffer
+    size_t committedLength; // Bytes of buffer on flash
+    uint8_t commitCount; // Commit slots used in the open block
+    ChannelState channelStates[maxChannels]; // Encoder state in the open block
+    uint64_t lastTimeMs; // Newest record
+    uint64_t clockMs; // Log time at lastClockMs
+    uint32_t lastClockMs; // hal::millis() when the clock was last advanced
+    uint32_t recordCount; // Records appended since begin()
+    uint32_t encodedBytes; // Their encoded size
+    uint32_t consumedBytes; // Flash slots taken since begin()
+};
+
+#endif /* TelemetryStore_hpp */
@@ -0,0 +1,207 @@
+/**
+ * @file TimingWheel.cpp
+ * @brief Implementation of the hierarchical timing wheel.
+ */
+
+#include "TimingWheel.hpp"
+
+TimingWheel::Job::Job()
+    : handler(nullptr), context(nullptr), next(nullptr), prev(nullptr), expires(0), slot(notQueued) {}
+
+/**
+ * @brief Sets the handler called when the job expires.
+ */
+void TimingWheel::Job::bind(Handler handler, void* context) {
+    this->handler = handler;
+    this->context = context;
+}
+
+/**
+ * @brief Checks whether the job is waiting to expire.
+ */
+bool TimingWheel::Job::isScheduled() const {
+    return slot != notQueued;
+}
+
+/**
+ * @brief Constructs an empty wheel at tick 0.
+ */
+TimingWheel::TimingWheel() : slots(), occupied(), expiringJobs(nullptr), now(0), count(0) {}
+
+/**
+ * @brief Schedules or reschedules a job.
+ * @param job Job with a handler bound.
+ * @param delayTicks Ticks from now; 0 is treated as 1.
+ */
+void TimingWheel::schedule(Job& job, uint32_t delayTicks) {
+    unlink(job);
+    job.expires = now + (delayTicks > 0 ? delayTicks : 1);
+    enqueue(job);
+    count++;
+}
+
+/**
+ * @brief Cancels a job. Cancelling a job that is not scheduled has no effect.
+ */
+void TimingWheel::cancel(Job& job) {
+    unlink(job);
+}
+
+/**
+ * @brief Moves time on, running every job that expires on the way in tick order.
+ *
+ * Only ticks with an expiry or a cascade are visited, so a long advance over
+ * an almost empty wheel costs little.
+ */
+void TimingWheel::advance(uint32_t ticks) {
+    const uint32_t target = now + ticks;
+    while (count > 0) {
+        uint32_t event = nextEventTick();
+        if (event - now > target - now) {
+            break;
+        }
+        now = event;
+        processTick();
+    }
+    now = target;
+}
+
+/**
+ * @brief Ticks until the wheel next has work: an expiry or a cascade.
+ * @return At least 1, or idle if no job is scheduled.
+ */
+uint32_t TimingWheel::ticksUntilNext() const {
+    if (count == 0) {
+        return idle;
+    }
+    return nextEventTick() - now;
+}
+
+/**
+ * @brief Current tick.
+ */
+uint32_t TimingWheel::getNow() const {
+    return now;
+}
+
+/**
+ * @brief Number of scheduled jobs.
+ */
+uint32_t TimingWheel::getCount() const {
+    return count;
+}
+
+/**
+ * @brief Links a job into the slot its expiry belongs to.
+ *
+ * The level is the highest base-64 digit in which the expiry differs from
+ * now, so the slot always lies ahead of the current position of its level.
+ */
+void TimingWheel::enqueue(Job& job) {
+    uint32_t differing = job.expires ^ now;
+    uint8_t level = differing == 0 ? 0 : static_cast<uint8_t>((31 - __builtin_clz(differing)) / slotBits);
+    uint8_t slot = static_cast<uint8_t>((job.expires >> (level * slotBits)) & (slotsPerLevel - 1));
+    Job*& head = slots[level][slot];
+    job.prev = nullptr;
+    job.next = head;
+    if (head != nullptr) {
+        head->prev = &job;
+    }
+    head = &job;
+    job.slot = static_cast<uint16_t>(level * slotsPerLevel + slot);
+    occupied[level] |= 1ULL << slot;
+}
+
+/**
+ * @brief Removes a job from its slot or the expiring list.
+ */
+void TimingWheel::unlink(Job& job) {
+    if (job.slot == notQueued) {
+        return;
+    }
+    if (job.next != nullptr) {
+        job.next->prev = job.prev;
+    }
+    if (job.prev != nullptr) {
+        job.prev->next = job.next;
+    } else if (job.slot == expiring) {
+        expiringJobs = job.next;
+    } else {
+        uint8_t level = static_cast<uint8_t>(job.slot / slotsPerLevel);
+        uint8_t slot = static_cast<uint8_t>(job.slot % slotsPerLevel);
+        slots[level][slot] = job.next;
+        if (job.next == nullptr) {
+            occupied[level] &= ~(1ULL << slot);
+        }
+    }
+    job.next = nullptr;
+    job.prev = nullptr;
+    job.slot = notQueued;
+    count--;
+}
+
+/**
+ * @brief Empties a slot, returning its list.
+ */
+TimingWheel::Job* TimingWheel::detachSlot(uint8_t level, uint8_t slot) {
+    Job* list = slots[level][slot];
+    slots[level][slot] = nullptr;
+    occupied[level] &= ~(1ULL << slot);
+    return list;
+}
+
+/**
+ * @brief Earliest tick with an expiry or cascade.
+ *
+ * Every occupied slot lies ahead of its level's current position, so the
+ * lowest set bit of each level is that level's next event.
+ */
+uint32_t TimingWheel::nextEventTick() const {
+    uint32_t earliest = idle;
+    uint32_t earliestOffset = idle;
+    for (uint8_t level = 0; level < levels; level++) {
+        if (occupied[level] == 0) {
+            continue;
+        }
+        uint8_t shift = static_cast<uint8_t>(level * slotBits);
+        uint8_t blockShift = static_cast<uint8_t>(shift + slotBits);
+        uint32_t blockStart = blockShift >= 32 ? 0 : now & ~((1UL << blockShift) - 1);
+        uint32_t tick = blockStart | (static_cast<uint32_t>(__builtin_ctzll(occupied[level])) << shift);
+        if (tick - now < earliestOffset) {
+            earliestOffset = tick - now;
+            earliest = tick;
+        }
+    }
+    return earliest;
+}
+
+/**
+ * @brief Cascades and runs the jobs of the current tick.
+ *
+ * Coarser levels cascade first, so a job can drop several levels at once and
+ * still run in this tick if it expires now.
+ */
+void TimingWheel::processTick() {
+    for (uint8_t level = levels - 1; level > 0; level--) {
+        uint8_t shift = static_cast<uint8_t>(level * slotBits);
+        if ((now & ((1UL << shift) - 1)) != 0) {
+            continue;
+        }
+        uint8_t slot = static_cast<uint8_t>((now >> shift) & (slotsPerLevel - 1));
+        Job* job = detachSlot(level, slot);
+        while (job != nullptr) {
+            Job* next = job->next;
+            enqueue(*job);
+            job = next;
+        }
+    }
+    expiringJobs = detachSlot(0, static_cast<uint8_t>(now & (slotsPerLevel - 1)));
+    for (Job* job = expiringJobs; job != nullptr; job = job->next) {
+        job->slot = expiring;
+    }
+    while (expiringJobs != nullptr) {
+        Job& job = *expiringJobs;
+        unlink(job);
+        job.handler(job.context);
+    }
+}
@@ -0,0 +1,123 @@
+/**
+ * @file TimingWheel.hpp
+ * @brief Hierarchical timing wheel with O(1) add, cancel and expiry.
+ */
+
+#ifndef TimingWheel_hpp
+#define TimingWheel_hpp
+
+#include <stdint.h>
+
+/**
+ * @class TimingWheel
+ * @brief Keeps any number of one-shot jobs ordered by expiry tick.
+ *
+ * Jobs are intrusive list nodes owned by the caller, so the wheel never
+ * allocates. A job lives in the level whose slot width is the highest tick
+ * digit (base 64) in which its expiry differs from the current tick. When
+ * time reaches the start of such a slot, its jobs cascade to finer levels;
+ * each job cascades at most levels - 1 times. Adding and cancelling is a list
+ * splice, and a bit per occupied slot finds the next tick with work in a few
+ * instructions, so the owner can sleep until then instead of ticking.
+ *
+ * Ticks are 32-bit and must not wrap during the wheel's lifetime.
+ */
+class TimingWheel {
+public:
+    /**
+     * @brief Signature of job handlers.
+     */
+    typedef void (*Handler)(void* context);
+
+    static constexpr uint8_t slotBits = 6; // log2 of slots per level
+    static constexpr uint8_t slotsPerLevel = 1 << slotBits;
+    static constexpr uint8_t levels = 6; // Enough base-64 digits for 32-bit ticks
+    static constexpr uint32_t idle = 0xFFFFFFFF; // ticksUntilNext() when nothing is queued
+
+    /**
+     * @class Job
+     * @brief One scheduled callback. Embed it in the object it belongs to.
+     */
+    class Job {
+    public:
+        Job();
+
+        /**
+         * @brief Sets the handler called when the job expires.
+         */
+        void bind(Handler handler, void* context);
+
+        /**
+         * @brief Checks whether the job is waiting to expire.
+         */
+        bool isScheduled() const;
+
+    private:
+        friend class TimingWheel;
+
+        Handler handler;    // Function called on expiry
+        void* context;      // Argument passed to the handler
+        Job* next;          // Next job in the same slot
+        Job* prev;          // Previous job in the same slot, nullptr for the first
+        uint32_t expires;   // Expiry tick
+        uint16_t slot;      // level * slotsPerLevel + slot, or one of the markers below
+    };
+
+    /**
+     * @brief Constructs an empty wheel at tick 0.
+     */
+    TimingWheel();
+
+    /**
+     * @brief Schedules or reschedules a job.
+     * @param job Job with a handler bound.
+     * @param delayTicks Ticks from now; 0 is treated as 1.
+     */
+    void schedule(Job& job, uint32_t delayTicks);
+
+    /**
+     * @brief Cancels a job. Cancelling a job that is not scheduled has no effect.
+     */
+    void cancel(Job& job);
+
+    /**
+     * @brief Moves time on, running every job that expires on the way in tick order.
+     *
+     * Handlers may schedule and cancel jobs, including themselves.
+     */
+    void advance(uint32_t ticks);
+
+    /**
+     * @brief Ticks until the wheel next has work: an expiry or a cascade.
+     * @return At least 1, or idle if no job is scheduled.
+     */
+    uint32_t ticksUntilNext() const;
+
+    /**
+     * @brief Current tick.
+     */
+    uint32_t getNow() const;
+
+    /**
+     * @brief Number of scheduled jobs.
+     */
+    uint32_t getCount() const;
+
+private:
+    static constexpr uint16_t notQueued = 0xFFFF;
+    static constexpr uint16_t expiring = 0xFFFE; // In the list of jobs being run
+
+    void enqueue(Job& job); // Links a job into the slot its expiry belongs to
+    void unlink(Job& job); // Removes a job from its slot or the expiring list
+    Job* detachSlot(uint8_t level, uint8_t slot); // Empties a slot, returning its list
+    uint32_t nextEventTick() const; // Earliest tick with an expiry or cascade
+    void processTick(); // Cascades and runs the jobs of the current tick
+
+    Job* slots[levels][slotsPerLevel]; // List heads
+    uint64_t occupied[levels]; // One bit per non-empty slot
+    Job* expiringJobs; // Jobs of the current tick not run yet
+    uint32_t now; // Current tick
+    uint32_t count; // Scheduled jobs
+};
+
+#endif /* TimingWheel_hpp */
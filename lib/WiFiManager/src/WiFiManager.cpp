@@ -1,9 +1,22 @@
 #include "WiFiManager.hpp"
 #include "DebugLogger.hpp"
+#include "Profiler.hpp"
 
-// Static member initialization
-bool WiFiManager::connected = false;
-bool WiFiManager::connecting = false;
+PROFILE_HISTOGRAM(wifiConnectionHandler);
+
+/**
+ * Logs the network and address of a new connection.
+ */
+static void logConnectionDetails() {
+#if LOG_LEVEL >= LOG_LEVEL_INFO
+    char ssid[33];
+    hal::wifiSSID(ssid, sizeof(ssid));
+    uint32_t ip = hal::wifiLocalIP();
+    LOG_INFO("SSID: %s", ssid);
+    LOG_INFO("IP Address: %u.%u.%u.%u", static_cast<unsigned>(ip & 0xFF), static_cast<unsigned>((ip >> 8) & 0xFF),
+        static_cast<unsigned>((ip >> 16) & 0xFF), static_cast<unsigned>(ip >> 24));
+#endif
+}
 
 /**
  * Constructs a WiFiManager to manage WiFi connections.
@@ -12,80 +25,73 @@ bool WiFiManager::connecting = false;
  * @param password WiFi network password.
  */
 WiFiManager::WiFiManager(const char* ssid, const char* password)
-: ssid(ssid), password(password), startTime(0), lastAttemptTime(0) {}
+: ssid(ssid), password(password), scheduler(nullptr), driverEvent(Scheduler::invalidId),
+  timer(Scheduler::invalidId), latestDriverEvent(noDriverEvent), state(State::Off), failedAttempts(0),
+  stateChangeHandler(nullptr), stateChangeContext(nullptr) {}
 
 /**
- * Initiates connection to a WiFi network without blocking.
+ * Registers the driver event handler and the timeout timer.
+ *
+ * @param scheduler Scheduler running the state machine.
  */
-void WiFiManager::connect() {
-    if (!isConnected() && !isConnecting()) {
-        WiFi.begin(ssid, password);
-        connecting = true;
-        startTime = millis();
-        DebugLogger::info("Attempting to connect to WiFi...");
-    }
+void WiFiManager::begin(Scheduler& scheduler) {
+    this->scheduler = &scheduler;
+    driverEvent = scheduler.addEvent(onDriverEventPosted, this);
+    timer = scheduler.addTimer(onTimer, this);
+    hal::wifiOnEvent(onDriverEvent, this);
+}
+
+/**
+ * Sets the function notified of state changes.
+ *
+ * @param handler Function to call, or nullptr.
+ * @param context Argument passed to the handler.
+ */
+void WiFiManager::setStateChangeHandler(StateChangeHandler handler, void* context) {
+    stateChangeHandler = handler;
+    stateChangeContext = context;
 }
 
 /**
- * Manages WiFi connection status, attempting reconnections as needed.
- * Should be called regularly to ensure continuous connectivity.
+ * Initiates connection to a WiFi network without blocking.
  */
-void WiFiManager::handleConnectionResult() {
-    unsigned long currentTime = millis();
-    if (connecting) {
-        if (WiFi.status() == WL_CONNECTED) {
-            if (!connected) {
-                DebugLogger::info("Successfully connected to WiFi.");
-                DebugLogger::info("SSID: " + String(WiFi.SSID()));
-                DebugLogger::info("IP Address: " + WiFi.localIP().toString());
-                connected = true;
-            }
-            connecting = false;
-        } else if (currentTime - lastAttemptTime > attemptInterval && !connecting) {
-            DebugLogger::info("Attempting to reconnect to WiFi...");
-            connect();
-            lastAttemptTime = currentTime;
-        }
-    } else if (!connecting && connected && WiFi.status() != WL_CONNECTED) {
-        DebugLogger::info("WiFi disconnected. Attempting to reconnect...");
-        connect();
-        lastAttemptTime = currentTime;
-    } else if (!connecting && !connected) {
-        DebugLogger::info("Attempting to connect to WiFi...");
-        connect();
-        lastAttemptTime = currentTime;
-    }
-    if (WiFi.status() != WL_CONNECTED) {
-        DebugLogger::info(".");
-        delay(250);
+void WiFiManager::connect() {
+    if (state == State::Off || state == State::Disconnecting) {
+        failedAttempts = 0;
+        startAttempt();
     }
 }
 
 /**
- * Disconnects from the WiFi network, ensuring disconnection is confirmed.
+ * Requests disconnection without waiting for it.
+ * The radio is powered down once the driver confirms, or after a timeout.
  */
 void WiFiManager::disconnect() {
-    if (WiFi.disconnect()) {
-        unsigned long startMillis = millis();
-        while (WiFi.status() != WL_DISCONNECTED && (millis() - startMillis <= 5000)) {}
-        if (WiFi.status() == WL_DISCONNECTED) {
-            DebugLogger::info("Disconnected from WiFi.");
-        } else {
-            DebugLogger::info("Disconnection timeout.");
-        }
-        WiFi.mode(WIFI_OFF);
-        connected = false;
-        connecting = false;
+    switch (state) {
+        case State::Connecting:
+        case State::Connected:
+            setState(State::Disconnecting);
+            scheduler->startTimer(timer, disconnectTimeout);
+            if (!hal::wifiDisconnect()) {
+                powerDown();
+            }
+            break;
+        case State::Backoff:
+            powerDown();
+            break;
+        case State::Off:
+        case State::Disconnecting:
+            break;
     }
 }
 
 /**
- * Returns true if a connection attempt is ongoing.
+ * Returns true if a connection attempt is ongoing or scheduled.
  *
  * @return True if connecting, false otherwise.
  */
-bool WiFiManager::isConnecting() {
-    return connecting;
+bool WiFiManager::isConnecting() const {
+    return state == State::Connecting || state == State::Backoff;
 }
 
 /**
@@ -93,7 +99,157 @@ bool WiFiManager::isConnecting() {
  *
  * @return True if connected, false otherwise.
  */
-bool WiFiManager::isConnected() {
-    connected = WiFi.status() == WL_CONNECTED;
-    return connected;
+bool WiFiManager::isConnected() const {
+    return state == State::Connected;
+}
+
+/**
+ * Current state of the connection state machine.
+ */
+WiFiManager::State WiFiManager::getState() const {
+    return state;
+}
+
+/**
+ * Number of consecutive failed connection attempts.
+ */
+uint8_t WiFiManager::getFailedAttempts() const {
+    return failedAttempts;
+}
+
+/**
+ * Receives driver events in the WiFi task and hands them to the scheduler.
+ * Only the latest event is kept, as it reflects the current link state.
+ */
+void WiFiManager::onDriverEvent(hal::WiFiEvent event, void* context) {
+    WiFiManager* manager = static_cast<WiFiManager*>(context);
+    manager->latestDriverEvent.store(static_cast<uint8_t>(event), std::memory_order_release);
+    manager->scheduler->post(manager->driverEvent);
+}
+
+/**
+ * Feeds the latest driver event into the state machine.
+ */
+void WiFiManager::onDriverEventPosted(void* context) {
+    WiFiManager* manager = static_cast<WiFiManager*>(context);
+    uint8_t event = manager->latestDriverEvent.exchange(noDriverEvent, std::memory_order_acquire);
+    switch (static_cast<hal::WiFiEvent>(event)) {
+        case hal::WiFiEvent::GotIp: manager->dispatch(Input::GotIp); break;
+        case hal::WiFiEvent::Disconnected: manager->dispatch(Input::LinkDown); break;
+        case hal::WiFiEvent::Stopped: manager->dispatch(Input::Stopped); break;
+        default: break;
+    }
+}
+
+/**
+ * Feeds a timeout into the state machine.
+ */
+void WiFiManager::onTimer(void* context) {
+    static_cast<WiFiManager*>(context)->dispatch(Input::Timeout);
+}
+
+/**
+ * Advances the state machine by one input.
+ *
+ * @param input Driver event or timeout.
+ */
+void WiFiManager::dispatch(Input input) {
+    PROFILE_SPAN(wifiConnectionHandler);
+    switch (state) {
+        case State::Connecting:
+            if (input == Input::GotIp) {
+                scheduler->stopTimer(timer);
+                failedAttempts = 0;
+                LOG_INFO("Successfully connected to WiFi.");
+                logConnectionDetails();
+                setState(State::Connected);
+            } else if (input == Input::LinkDown || input == Input::Timeout) {
+                if (input == Input::Timeout) {
+                    hal::wifiDisconnect();
+                }
+                enterBackoff();
+            }
+            break;
+        case State::Connected:
+            if (input == Input::LinkDown || input == Input::Stopped) {
+                LOG_INFO("WiFi disconnected. Attempting to reconnect...");
+                failedAttempts = 0;
+                enterBackoff();
+            }
+            break;
+        case State::Backoff:
+            if (input == Input::Timeout) {
+                startAttempt();
+            }
+            break;
+        case State::Disconnecting:
+            if (input == Input::LinkDown || input == Input::Stopped) {
+                LOG_INFO("Disconnected from WiFi.");
+                powerDown();
+            } else if (input == Input::Timeout) {
+                LOG_INFO("Disconnection timeout.");
+                powerDown();
+            }
+            break;
+        case State::Off:
+            break;
+    }
+}
+
+/**
+ * Begins one connection attempt and arms its timeout.
+ */
+void WiFiManager::startAttempt() {
+    LOG_INFO("Attempting to connect to WiFi...");
+    setState(State::Connecting);
+    scheduler->startTimer(timer, attemptTimeout);
+    hal::wifiBegin(ssid, password);
+}
+
+/**
+ * Counts a failed attempt and schedules the next one.
+ */
+void WiFiManager::enterBackoff() {
+    if (failedAttempts < 0xFF) {
+        failedAttempts++;
+    }
+    uint32_t delayMs = nextBackoffDelay();
+    LOG_INFO("Retrying WiFi in %lu ms.", static_cast<unsigned long>(delayMs));
+    setState(State::Backoff);
+    scheduler->startTimer(timer, delayMs);
+}
+
+/**
+ * Powers the radio down and enters Off.
+ */
+void WiFiManager::powerDown() {
+    scheduler->stopTimer(timer);
+    setState(State::Off);
+    hal::wifiOff();
+}
+
+void WiFiManager::setState(State newState) {
+    if (state == newState) {
+        return;
+    }
+    state = newState;
+    if (stateChangeHandler != nullptr) {
+        stateChangeHandler(state, stateChangeContext);
+    }
+}
+
+/**
+ * Exponential backoff with equal jitter: half of the delay is fixed, the other
+ * half random, so a fleet of controllers does not reconnect in lockstep.
+ *
+ * @return Delay before the next attempt in milliseconds.
+ */
+uint32_t WiFiManager::nextBackoffDelay() {
+    uint8_t exponent = failedAttempts > 0 ? failedAttempts - 1 : 0;
+    uint32_t ceiling = backoffMax;
+    if (exponent < 16 && (backoffBase << exponent) < backoffMax) {
+        ceiling = backoffBase << exponent;
+    }
+    uint32_t half = ceiling / 2;
+    return half + hal::randomU32() % (ceiling - half + 1);
 }
@@ -1,14 +1,36 @@
 #ifndef WiFiManager_h
 #define WiFiManager_h
 
-#include <Arduino.h>
-#include <WiFi.h>
+#include <atomic>
+#include "HAL.hpp"
+#include "Scheduler.hpp"
 
 /**
  * Manages WiFi connectivity, providing methods to connect, disconnect, and check connection status.
+ *
+ * The manager is an explicit state machine driven by WiFi driver events and
+ * scheduler timers. No method blocks: connection attempts time out on a timer,
+ * failed attempts are retried after a jittered exponential backoff, and
+ * disconnection completes when the driver reports it.
  */
 class WiFiManager {
 public:
+    /**
+     * Connection states.
+     */
+    enum class State : uint8_t {
+        Off,            // Radio off, no connection wanted
+        Connecting,     // Association in progress
+        Connected,      // Link up with an IP address
+        Backoff,        // Waiting before the next connection attempt
+        Disconnecting   // Disconnection requested, waiting for the driver
+    };
+
+    /**
+     * Signature of the function called after every state change.
+     */
+    typedef void (*StateChangeHandler)(State state, void* context);
+
     /**
      * Constructor.
      * Initializes a new WiFiManager instance for managing WiFi connections.
@@ -19,43 +41,80 @@ public:
     WiFiManager(const char* ssid, const char* password);
 
     /**
-     * Initiates a non-blocking connection to the specified WiFi network.
+     * Registers the driver event handler and the timers with a scheduler.
+     * Must be called once before connect().
+     *
+     * @param scheduler Scheduler running the state machine.
      */
-    void connect();
+    void begin(Scheduler& scheduler);
+
+    /**
+     * Sets the function notified of state changes.
+     */
+    void setStateChangeHandler(StateChangeHandler handler, void* context);
 
     /**
-     * Monitors and manages the WiFi connection status, attempting reconnections if necessary.
-     * Call this method regularly, such as in the main application loop.
+     * Starts connecting and keeps the link up until disconnect() is called.
      */
-    void handleConnectionResult();
+    void connect();
 
     /**
-     * Disconnects from the currently connected WiFi network.
+     * Disconnects from the currently connected WiFi network and powers the radio down.
      */
     void disconnect();
 
     /**
      * Checks if the device is currently trying to connect to a WiFi network.
      *
-     * @return True if attempting to connect, false otherwise.
+     * @return True while connecting or waiting to retry, false otherwise.
      */
-    bool isConnecting();
+    bool isConnecting() const;
 
     /**
      * Checks if the device is currently connected to a WiFi network.
      *
      * @return True if connected, false otherwise.
      */
-    bool isConnected();
+    bool isConnected() const;
+
+    /**
+     * Current state of the connection state machine.
+     */
+    State getState() const;
+
+    /**
+     * Number of consecutive failed connection attempts.
+     */
+    uint8_t getFailedAttempts() const;
 
 private:
+    enum class Input : uint8_t { GotIp, LinkDown, Stopped, Timeout };
+
+    static void onDriverEvent(hal::WiFiEvent event, void* context); // Runs in the driver task
+    static void onDriverEventPosted(void* context); // Scheduler side of onDriverEvent
+    static void onTimer(void* context); // Attempt, backoff and disconnect timeouts
+    void dispatch(Input input); // Advances the state machine
+    void startAttempt(); // Begins one connection attempt
+    void enterBackoff(); // Schedules the next attempt
+    void powerDown(); // Turns the radio off and enters Off
+    void setState(State newState);
+    uint32_t nextBackoffDelay();
+
     const char* ssid; // SSID of the WiFi network
     const char* password; // Password of the WiFi network
-    static bool connecting; // Flag indicating if a connection attempt is ongoing
-    static bool connected; // Flag indicating if the device is currently connected
-    unsigned long startTime; // Timestamp of the connection attempt start
-    unsigned long lastAttemptTime; // Timestamp of the last connection attempt
-    const unsigned long attemptInterval = 5000; // Interval between connection attempts (ms)
+    Scheduler* scheduler; // Scheduler running the state machine
+    uint8_t driverEvent; // Scheduler event posted from the driver task
+    uint8_t timer; // Timer for the current state's timeout
+    std::atomic<uint8_t> latestDriverEvent; // Last hal::WiFiEvent received, noDriverEvent once consumed
+    State state; // Current state
+    uint8_t failedAttempts; // Consecutive failed attempts, drives the backoff
+    StateChangeHandler stateChangeHandler; // Notified after every state change
+    void* stateChangeContext; // Argument passed to stateChangeHandler
+    static constexpr uint8_t noDriverEvent = 0xFF; // Marks latestDriverEvent as consumed
+    static constexpr uint32_t attemptTimeout = 15000; // Time allowed for one attempt (ms)
+    static constexpr uint32_t disconnectTimeout = 5000; // Time allowed for disconnection (ms)
+    static constexpr uint32_t backoffBase = 500; // First retry delay (ms)
+    static constexpr uint32_t backoffMax = 60000; // Upper bound of the retry delay (ms)
 };
 
 #endif /* WiFiManager_h */
@@ -0,0 +1,269 @@
+/**
+ * @file ZoneController.hpp
+ * @brief Independent grow zones, each with its own light, pump, mode and schedule.
+ */
+
+#ifndef ZoneController_hpp
+#define ZoneController_hpp
+
+#include <stdint.h>
+#include "DebugLogger.hpp"
+#include "HAL.hpp"
+#include "LedStripFader.hpp"
+#include "Photoperiod.hpp"
+#include "ShiftRegisterChain.hpp"
+
+/**
+ * @brief What a zone is doing.
+ */
+enum class ZoneMode : uint8_t {
+    Off,        // Light and pump off
+    Idle,       // Pump on its schedule, light off
+    Vegetative, // Pump on its schedule, light on the zone's vegetative program
+    Flowering   // Pump on its schedule, light on the zone's flowering program
+};
+
+/**
+ * @brief Where a zone's light and pump are wired.
+ */
+struct ZoneWiring {
+    static constexpr uint8_t noPwm = 0xFF;
+
+    uint16_t lightOutput; // Shift register output enabling the light driver
+    uint16_t pumpOutput;  // Shift register output of the pump relay
+    uint8_t ledcChannel;  // LEDC channel dimming the light, or noPwm for on/off only
+    uint8_t pwmPin;       // GPIO driven by the LEDC channel
+};
+
+/**
+ * @class ZoneController
+ * @brief Runs up to MaxZones trays from one shift register chain and the LEDC channels.
+ *
+ * Zones are stored column by column: one array per attribute, indexed by
+ * zone, so the update pass reads each attribute as one contiguous run and
+ * zones can be added without touching the others. update() evaluates every
+ * zone for the current time, builds the bits of all zone outputs in a local
+ * image, hands it to the chain in one masked write and flushes it once, then
+ * writes the LEDC duties that changed. Outputs of the chain that belong to
+ * no zone, such as the panel diodes, keep their state.
+ *
+ * Lights follow the zone's PhotoperiodProgram timing with smoothstep dawn
+ * and dusk, computed in closed form each pass; zones without an LEDC channel
+ * are switched on and off only. Pumps run runSeconds out of every
+ * everySeconds, counted from the time origin plus an offset, so trays on one
+ * water supply can be staggered.
+ *
+ * @tparam MaxZones Capacity of the zone table.
+ * @tparam Registers Length of the shift register chain.
+ */
+template<uint8_t MaxZones, uint8_t Registers>
+class ZoneController {
+public:
+    static constexpr uint8_t invalidId = 0xFF;
+    static constexpr uint8_t ledcChannelCount = 16;
+    static constexpr uint32_t maxDuty = (1u << LedStripFader::resolutionBits) - 1;
+    static constexpr uint32_t pwmFrequency = 5000;
+
+    /**
+     * @brief Creates an empty zone table driving a chain.
+     */
+    explicit ZoneController(ShiftRegisterChain<Registers>& shiftRegister)
+        : shiftRegister(shiftRegister), zoneCount(0), pwmWrites(0), ownedOutputs(), usedChannels(0) {}
+
+    /**
+     * @brief Adds a zone, Off, with no pump schedule.
+     * @return Zone identifier, or invalidId if the table is full or an output
+     * or LEDC channel is out of range or already in use.
+     */
+    uint8_t addZone(const ZoneWiring& wiring) {
+        if (zoneCount >= MaxZones) {
+            LOG_ERROR("Zone table full.");
+            return invalidId;
+        }
+        bool pwm = wiring.ledcChannel != ZoneWiring::noPwm;
+        if (wiring.lightOutput >= outputCount || wiring.pumpOutput >= outputCount ||
+            wiring.lightOutput == wiring.pumpOutput || isOwned(wiring.lightOutput) || isOwned(wiring.pumpOutput) ||
+            (pwm && (wiring.ledcChannel >= ledcChannelCount || (usedChannels & (1u << wiring.ledcChannel)) != 0))) {
+            LOG_ERROR("Zone wiring conflicts or is out of range.");
+            return invalidId;
+        }
+        uint8_t zone = zoneCount++;
+        lightOutputs[zone] = wiring.lightOutput;
+        pumpOutputs[zone] = wiring.pumpOutput;
+        ledcChannels[zone] = wiring.ledcChannel;
+        modes[zone] = ZoneMode::Off;
+        lightsOnSeconds[zone] = 0;
+        dayLengthSeconds[zone] = 0;
+        rampSeconds[zone] = 0;
+        pumpEverySeconds[zone] = 0;
+        pumpRunSeconds[zone] = 0;
+        pumpOffsetSeconds[zone] = 0;
+        duties[zone] = 0;
+        writtenDuties[zone] = 0;
+        pumpStates[zone] = false;
+        ownedOutputs[wiring.lightOutput >> 3] |= static_cast<uint8_t>(1 << (wiring.lightOutput & 7));
+        ownedOutputs[wiring.pumpOutput >> 3] |= static_cast<uint8_t>(1 << (wiring.pumpOutput & 7));
+        if (pwm) {
+            usedChannels |= 1u << wiring.ledcChannel;
+            hal::ledcSetup(wiring.ledcChannel, pwmFrequency, LedStripFader::resolutionBits);
+            hal::ledcAttachPin(wiring.pwmPin, wiring.ledcChannel);
+            hal::ledcWrite(wiring.ledcChannel, 0);
+        }
+        return zone;
+    }
+
+    /**
+     * @brief Switches a zone's mode. Takes effect on the next update().
+     * @param program Light timing for Vegetative and Flowering; the colours
+     * are not used. Ignored for Off and Idle.
+     * @return False if the zone does not exist or a grow mode has no program.
+     */
+    bool setMode(uint8_t zone, ZoneMode mode, const PhotoperiodProgram* program = nullptr) {
+        bool growing = mode == ZoneMode::Vegetative || mode == ZoneMode::Flowering;
+        if (zone >= zoneCount || (growing && program == nullptr)) {
+            return false;
+        }
+        modes[zone] = mode;
+        if (growing) {
+            lightsOnSeconds[zone] = program->lightsOnSecond % Photoperiod::secondsPerDay;
+            dayLengthSeconds[zone] = program->dayLengthSeconds < Photoperiod::secondsPerDay
+                ? program->dayLengthSeconds : Photoperiod::secondsPerDay;
+            rampSeconds[zone] = program->rampSeconds * 2 <= dayLengthSeconds[zone]
+                ? program->rampSeconds : dayLengthSeconds[zone] / 2;
+        }
+        return true;
+    }
+
+    /**
+     * @brief Runs a zone's pump for runSeconds out of every everySeconds
+     * while the zone is not Off. everySeconds 0 keeps the pump off.
+     * @return False if the zone does not exist or runSeconds exceeds everySeconds.
+     */
+    bool setPumpInterval(uint8_t zone, uint32_t everySeconds, uint32_t runSeconds, uint32_t offsetSeconds = 0) {
+        if (zone >= zoneCount || runSeconds > everySeconds) {
+            return false;
+        }
+        pumpEverySeconds[zone] = everySeconds;
+        pumpRunSeconds[zone] = runSeconds;
+        pumpOffsetSeconds[zone] = everySeconds != 0 ? offsetSeconds % everySeconds : 0;
+        return true;
+    }
+
+    /**
+     * @brief Brings every zone's outputs in line with its mode and schedule.
+     *
+     * One pass over the zone columns, one masked write and one flush of the
+     * chain, then one ledcWrite() per dimmed light whose duty changed.
+     *
+     * @param nowSeconds Seconds since midnight of the first day.
+     */
+    void update(uint32_t nowSeconds) {
+        uint32_t secondOfDay = nowSeconds % Photoperiod::secondsPerDay;
+        uint8_t values[Registers] = {};
+        for (uint8_t zone = 0; zone < zoneCount; zone++) {
+            ZoneMode mode = modes[zone];
+            uint32_t duty = mode == ZoneMode::Vegetative || mode == ZoneMode::Flowering ? lightDuty(zone, secondOfDay) : 0;
+            uint32_t every = pumpEverySeconds[zone];
+            bool pump = mode != ZoneMode::Off && every != 0 &&
+                (nowSeconds + pumpOffsetSeconds[zone]) % every < pumpRunSeconds[zone];
+            duties[zone] = static_cast<uint16_t>(duty);
+            pumpStates[zone] = pump;
+            values[lightOutputs[zone] >> 3] |= static_cast<uint8_t>((duty != 0) << (lightOutputs[zone] & 7));
+            values[pumpOutputs[zone] >> 3] |= static_cast<uint8_t>(pump << (pumpOutputs[zone] & 7));
+        }
+        shiftRegister.setPinStates(values, ownedOutputs);
+        shiftRegister.write();
+        for (uint8_t zone = 0; zone < zoneCount; zone++) {
+            if (ledcChannels[zone] != ZoneWiring::noPwm && duties[zone] != writtenDuties[zone]) {
+                hal::ledcWrite(ledcChannels[zone], duties[zone]);
+                writtenDuties[zone] = duties[zone];
+                pwmWrites++;
+            }
+        }
+    }
+
+    /**
+     * @brief Number of zones added.
+     */
+    uint8_t getZoneCount() const {
+        return zoneCount;
+    }
+
+    /**
+     * @brief Mode of a zone, Off if it does not exist.
+     */
+    ZoneMode getMode(uint8_t zone) const {
+        return zone < zoneCount ? modes[zone] : ZoneMode::Off;
+    }
+
+    /**
+     * @brief Light duty of a zone at the last update(), 0 to maxDuty.
+     */
+    uint16_t getDuty(uint8_t zone) const {
+        return zone < zoneCount ? duties[zone] : 0;
+    }
+
+    /**
+     * @brief True if a zone's pump ran at the last update().
+     */
+    bool isPumpOn(uint8_t zone) const {
+        return zone < zoneCount && pumpStates[zone];
+    }
+
+    /**
+     * @brief Number of LEDC duty writes since construction.
+     */
+    uint32_t getPwmWriteCount() const {
+        return pwmWrites;
+    }
+
+private:
+    static constexpr uint16_t outputCount = Registers * 8;
+
+    bool isOwned(uint16_t output) const {
+        return (ownedOutputs[output >> 3] >> (output & 7)) & 1;
+    }
+
+    /**
+     * @brief Light duty of a growing zone: 0 at night, smoothstep 3x^2 - 2x^3
+     * over dawn and dusk in Q16, maxDuty during the day.
+     */
+    uint32_t lightDuty(uint8_t zone, uint32_t secondOfDay) const {
+        uint32_t sinceLightsOn = (secondOfDay + Photoperiod::secondsPerDay - lightsOnSeconds[zone]) % Photoperiod::secondsPerDay;
+        uint32_t dayLength = dayLengthSeconds[zone];
+        uint32_t ramp = rampSeconds[zone];
+        if (sinceLightsOn >= dayLength) {
+            return 0;
+        }
+        uint32_t fromEdge = sinceLightsOn < dayLength - sinceLightsOn ? sinceLightsOn : dayLength - sinceLightsOn;
+        if (fromEdge >= ramp) {
+            return maxDuty;
+        }
+        uint64_t x = (static_cast<uint64_t>(fromEdge) << 16) / ramp;
+        uint64_t smooth = (x * x * ((3u << 16) - 2 * x)) >> 32;
+        return static_cast<uint32_t>((smooth * maxDuty) >> 16);
+    }
+
+    ShiftRegisterChain<Registers>& shiftRegister;
+    uint8_t zoneCount;
+    uint32_t pwmWrites;
+    uint8_t ownedOutputs[Registers]; // Chain outputs belonging to a zone, packed like the image
+    uint16_t usedChannels; // LEDC channels belonging to a zone, one bit each
+
+    // Zone columns, indexed by zone.
+    uint16_t lightOutputs[MaxZones];
+    uint16_t pumpOutputs[MaxZones];
+    uint8_t ledcChannels[MaxZones];
+    ZoneMode modes[MaxZones];
+    uint32_t lightsOnSeconds[MaxZones];
+    uint32_t dayLengthSeconds[MaxZones];
+    uint32_t rampSeconds[MaxZones];
+    uint32_t pumpEverySeconds[MaxZones];
+    uint32_t pumpRunSeconds[MaxZones];
+    uint32_t pumpOffsetSeconds[MaxZones];
+    uint16_t duties[MaxZones]; // Duty computed by the last update()
+    uint16_t writtenDuties[MaxZones]; // Duty last written to the LEDC channel
+    bool pumpStates[MaxZones]; // Pump state computed by the last update()
+};
+
+#endif /* ZoneController_hpp */
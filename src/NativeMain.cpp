@@ -0,0 +1,649 @@
+/**
+ * @file NativeMain.cpp
+ * @brief Host entry point that runs the real setup()/loop() against the native HAL.
+ *
+ * The firmware runs on a simulated clock with simulated pins, so loop() can be
+ * profiled on a build machine. Each loop() call is one scheduler wakeup; while
+ * the firmware sleeps the virtual clock jumps straight to its next deadline or
+ * to the next scripted stimulus. Only compiled for the native environment.
+ *
+ * Virtual time runs as fast as the host allows, so a month of operation takes
+ * seconds; the report starts with simulated seconds per wall-clock second.
+ * Every output edge (GPIO level, latched shift register output, LEDC duty) is
+ * counted and can be written to a CSV trace. Runs are deterministic: the same
+ * options and script give the same trace.
+ *
+ * Usage: program [--seconds N] [--days N] [--power] [--script FILE]
+ *                [--trace FILE] [--wifi-storm] [--grow-days N]
+ *                [--adc-recording FILE] [--telemetry-image FILE] [--serve]
+ *                [--mqtt ADDRESS[:PORT]] [--mqtt-backlog HOURS] [--mqtt-rate N]
+ *                [--warm-boot FILE] [--verbose]
+ *   --seconds N    Simulated run time in seconds (default 600).
+ *   --days N       Simulated run time in days, instead of --seconds.
+ *   --script FILE  Apply the stimuli in FILE, one per line as
+ *                  "SECONDS ACTION [ARGUMENT]": "press power|pump|vegetable|flower",
+ *                  "wifi-drop" (lose the link once), "wifi-down" (refuse
+ *                  connections) or "wifi-up". Blank lines and lines starting
+ *                  with # are skipped. Combines with the other scenarios.
+ *   --trace FILE   Write every output edge to FILE as CSV:
+ *                  us,kind,pin,output,value,fade_ms with kind pin, shift or
+ *                  ledc. For shift, pin is the data pin and output the chain
+ *                  output; for ledc, pin is the channel and value the duty.
+ *   --power        Press the power button after one simulated second.
+ *   --wifi-storm   Power up, then keep dropping, refusing and cycling the WiFi
+ *                  link while pressing the pump button every 250 ms. Reports
+ *                  the virtual button-to-LED latency and fails if any press is
+ *                  handled late or not at all.
+ *   --grow-days N  Power up at midnight, run the vegetative light schedule
+ *                  for the first half of N days and the flowering schedule
+ *                  for the rest, sampling the strip PWM every minute. Fails
+ *                  if a day's lit time is more than 5 minutes off its
+ *                  program, a ramp runs the wrong way or the day light is
+ *                  not steady. Prints a checksum of all samples to compare
+ *                  runs.
+ *   --adc-recording FILE
+ *                  Feed the sensors a recorded stream of raw little-endian
+ *                  16-bit ADC samples (12-bit value, channel in the top four
+ *                  bits), looped, instead of fixed noisy levels.
+ *   --telemetry-image FILE
+ *                  Commit the telemetry log at the end of the run and write
+ *                  the simulated storage partition to FILE, for
+ *                  tools/telemetry_dump.py.
+ *   --serve        Run in real time and power up, so the HTTP API answers
+ *                  on port 8080 (HTTP_PORT + 8000) once the simulated WiFi
+ *                  is connected, for curl or tools/http_load.py. --seconds
+ *                  is then wall-clock time. Prints the server's counters.
+ *   --mqtt ADDRESS[:PORT]
+ *                  Power up and log without a broker for --mqtt-backlog
+ *                  hours of simulated time (default 24), then switch to real
+ *                  time, connect to the broker at the IPv4 address (port
+ *                  1883 by default) and publish for --seconds of wall-clock
+ *                  time. Prints how fast the backlog drained and what
+ *                  queueing it cost.
+ *   --mqtt-rate N  Telemetry messages per second while catching up (default MQTT_RATE).
+ *   --warm-boot FILE
+ *                  Start from the flash and NVS content saved in FILE, if it
+ *                  exists, and save them there at the end of the run without
+ *                  committing the telemetry log, as a power cut would. Prints
+ *                  how long setup() took to restore the outputs.
+ *   --verbose      Echo DebugLogger output to stdout.
+ */
+
+#ifndef ARDUINO
+
+#include <algorithm>
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include "Config.hpp"
+#include "AppState.hpp"
+#include "HALSim.hpp"
+#include "HttpServer.hpp"
+#include "MqttClient.hpp"
+#include "Photoperiod.hpp"
+#include "Profiler.hpp"
+#include "ShiftRegister.hpp"
+#include "TelemetryPublisher.hpp"
+#include "TelemetryStore.hpp"
+
+void setup();
+void loop();
+extern ShiftRegister shiftRegister;
+extern Photoperiod photoperiod;
+extern TelemetryStore telemetryLog;
+extern HttpServer httpServer;
+extern MqttClient mqttClient;
+extern TelemetryPublisher mqttPublisher;
+extern AppState appState;
+extern uint32_t outputsRestoredUs;
+
+namespace {
+
+/**
+ * @brief Scripted change applied at a fixed virtual time.
+ */
+struct Stimulus {
+    enum Kind { Input, DropWiFi, WiFiReachable, WiFiUnreachable, SampleStrip, StartMqtt };
+    uint64_t atUs;
+    Kind kind;
+    uint8_t pin;
+    int level;
+};
+
+constexpr uint64_t second = 1000000;
+constexpr uint64_t buttonHoldUs = 100000;
+constexpr uint64_t maxInputLatencyUs = 1000; // A press must reach its LED within 1 ms of virtual time.
+constexpr uint64_t day = 86400 * second;
+constexpr uint64_t stripSampleUs = 60 * second;
+constexpr uint32_t litToleranceSamples = 5; // Lit minutes may fall short of the program where a ramp rounds to black
+
+void addPress(std::vector<Stimulus>& script, uint64_t atUs, uint8_t pin) {
+    script.push_back({atUs, Stimulus::Input, pin, LOW});
+    script.push_back({atUs + buttonHoldUs, Stimulus::Input, pin, HIGH});
+}
+
+/**
+ * @brief Builds the WiFi storm script. Every 12 s: three link drops in a row,
+ * four seconds of refused connections, then a power off/on cycle. Pump presses
+ * are not placed near power presses so that each one can be judged on its own.
+ */
+void buildWiFiStorm(std::vector<Stimulus>& script, uint64_t endUs) {
+    addPress(script, 1 * second, POWER_BUTTON_PIN);
+    std::vector<uint64_t> powerPresses;
+    for (uint64_t cycle = 3 * second; cycle + 12 * second <= endUs; cycle += 12 * second) {
+        script.push_back({cycle, Stimulus::DropWiFi, 0, 0});
+        script.push_back({cycle + second / 2, Stimulus::DropWiFi, 0, 0});
+        script.push_back({cycle + second, Stimulus::DropWiFi, 0, 0});
+        script.push_back({cycle + 3 * second, Stimulus::WiFiUnreachable, 0, 0});
+        script.push_back({cycle + 3 * second + second / 5, Stimulus::DropWiFi, 0, 0});
+        script.push_back({cycle + 7 * second, Stimulus::WiFiReachable, 0, 0});
+        powerPresses.push_back(cycle + 9 * second);
+        powerPresses.push_back(cycle + 9 * second + 3 * second / 10);
+    }
+    for (uint64_t atUs : powerPresses) {
+        addPress(script, atUs, POWER_BUTTON_PIN);
+    }
+    for (uint64_t atUs = 2 * second; atUs + second <= endUs; atUs += second / 4) {
+        bool nearPowerPress = false;
+        for (uint64_t powerUs : powerPresses) {
+            if (atUs + second / 2 > powerUs && atUs < powerUs + second / 2) {
+                nearPowerPress = true;
+            }
+        }
+        if (!nearPowerPress) {
+            addPress(script, atUs, PUMP_BUTTON_PIN);
+        }
+    }
+    std::stable_sort(script.begin(), script.end(),
+        [](const Stimulus& a, const Stimulus& b) { return a.atUs < b.atUs; });
+}
+
+/**
+ * @brief Builds the grow cycle script: power and vegetative mode right after
+ * midnight, flowering mode at midday halfway through, strip samples every minute.
+ */
+void buildGrowCycle(std::vector<Stimulus>& script, uint64_t days) {
+    addPress(script, 1 * second, POWER_BUTTON_PIN);
+    addPress(script, 2 * second, VEGETABLE_BUTTON_PIN);
+    addPress(script, days / 2 * day + day / 2, FLOWER_BUTTON_PIN);
+    for (uint64_t atUs = stripSampleUs; atUs <= days * day; atUs += stripSampleUs) {
+        script.push_back({atUs, Stimulus::SampleStrip, 0, 0});
+    }
+    std::stable_sort(script.begin(), script.end(),
+        [](const Stimulus& a, const Stimulus& b) { return a.atUs < b.atUs; });
+}
+
+/**
+ * @brief Strip samples of one simulated day, judged when the day is over.
+ */
+struct GrowDay {
+    const PhotoperiodProgram* program; // Program at the end of the day
+    bool programChanged; // The program changed during the day
+    uint32_t litSamples; // Samples with any channel on
+    uint32_t rampErrors; // Dawn samples darker or dusk samples brighter than the one before
+    uint32_t dayErrors; // Day samples differing from the first day sample or dark
+    uint32_t dayDuty[3]; // Duty of the first day sample
+    bool haveDayDuty; // dayDuty is set
+};
+
+/**
+ * @brief Checks one finished day and prints it if it failed.
+ * @return True if the day passed or could not be judged.
+ */
+bool judgeGrowDay(const GrowDay& growDay, uint64_t index) {
+    if (growDay.program == nullptr || growDay.programChanged) {
+        return true;
+    }
+    uint32_t expected = growDay.program->dayLengthSeconds / 60;
+    uint32_t difference = growDay.litSamples > expected ? growDay.litSamples - expected : expected - growDay.litSamples;
+    bool passed = difference <= litToleranceSamples && growDay.rampErrors == 0 && growDay.dayErrors == 0;
+    if (!passed) {
+        printf("day %llu:  lit %lu min (programmed %lu), ramp errors %lu, day errors %lu\n",
+            static_cast<unsigned long long>(index), static_cast<unsigned long>(growDay.litSamples),
+            static_cast<unsigned long>(expected), static_cast<unsigned long>(growDay.rampErrors),
+            static_cast<unsigned long>(growDay.dayErrors));
+    }
+    return passed;
+}
+
+/**
+ * @brief Reads a stimulus script, see --script.
+ * @return False, after printing the offending line, if the file cannot be read or a line is not understood.
+ */
+bool loadScript(const char* path, std::vector<Stimulus>& script) {
+    FILE* file = fopen(path, "r");
+    if (file == nullptr) {
+        fprintf(stderr, "cannot read script %s\n", path);
+        return false;
+    }
+    char line[128];
+    unsigned long lineNumber = 0;
+    bool parsed = true;
+    while (parsed && fgets(line, sizeof(line), file) != nullptr) {
+        lineNumber++;
+        char action[16] = {};
+        char argument[16] = {};
+        double atSeconds = 0;
+        int fields = sscanf(line, "%lf %15s %15s", &atSeconds, action, argument);
+        if (fields <= 0 || line[strspn(line, " \t")] == '#') {
+            continue;
+        }
+        uint64_t atUs = static_cast<uint64_t>(atSeconds * 1e6);
+        if (fields < 2 || atSeconds < 0) {
+            parsed = false;
+        } else if (strcmp(action, "press") == 0 && fields == 3) {
+            uint8_t pin = strcmp(argument, "power") == 0 ? POWER_BUTTON_PIN
+                : strcmp(argument, "pump") == 0 ? PUMP_BUTTON_PIN
+                : strcmp(argument, "vegetable") == 0 ? VEGETABLE_BUTTON_PIN
+                : strcmp(argument, "flower") == 0 ? FLOWER_BUTTON_PIN
+                : 0xFF;
+            parsed = pin != 0xFF;
+            if (parsed) {
+                addPress(script, atUs, pin);
+            }
+        } else if (strcmp(action, "wifi-drop") == 0 && fields == 2) {
+            script.push_back({atUs, Stimulus::DropWiFi, 0, 0});
+        } else if (strcmp(action, "wifi-down") == 0 && fields == 2) {
+            script.push_back({atUs, Stimulus::WiFiUnreachable, 0, 0});
+        } else if (strcmp(action, "wifi-up") == 0 && fields == 2) {
+            script.push_back({atUs, Stimulus::WiFiReachable, 0, 0});
+        } else {
+            parsed = false;
+        }
+    }
+    fclose(file);
+    if (!parsed) {
+        fprintf(stderr, "%s:%lu: cannot understand %s", path, lineNumber, line);
+    }
+    return parsed;
+}
+
+/**
+ * @brief Writes one output edge to the trace file passed as context.
+ */
+void traceEdge(const hal::sim::OutputEdge& edge, void* context) {
+    static const char* const kindNames[] = {"pin", "shift", "ledc"};
+    fprintf(static_cast<FILE*>(context), "%llu,%s,%u,%u,%lu,%lu\n", static_cast<unsigned long long>(edge.us),
+        kindNames[static_cast<uint8_t>(edge.kind)], static_cast<unsigned>(edge.pin), static_cast<unsigned>(edge.output),
+        static_cast<unsigned long>(edge.value), static_cast<unsigned long>(edge.fadeMs));
+}
+
+/**
+ * @brief Loads a recorded ADC sample stream.
+ * @return False if the file could not be read or holds no samples.
+ */
+bool loadAdcRecording(const char* path, std::vector<uint16_t>& samples) {
+    FILE* file = fopen(path, "rb");
+    if (file == nullptr) {
+        return false;
+    }
+    uint8_t bytes[2];
+    while (fread(bytes, 1, sizeof(bytes), file) == sizeof(bytes)) {
+        samples.push_back(static_cast<uint16_t>(bytes[0] | (bytes[1] << 8)));
+    }
+    fclose(file);
+    return !samples.empty();
+}
+
+/**
+ * @brief Writes the simulated storage partition to a file.
+ */
+bool saveStorageImage(const char* path) {
+    FILE* file = fopen(path, "wb");
+    if (file == nullptr) {
+        return false;
+    }
+    bool written = fwrite(hal::sim::storageImage(), 1, hal::storageSize(), file) == hal::storageSize();
+    return fclose(file) == 0 && written;
+}
+
+bool shiftedBit(uint8_t bit) {
+    return (hal::sim::lastShiftedByte(SHIFT_REGISTER_DATA_PIN) >> bit) & 1;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    double seconds = 600;
+    bool pressPower = false;
+    const char* scriptPath = nullptr;
+    const char* tracePath = nullptr;
+    bool wifiStorm = false;
+    unsigned long growDays = 0;
+    const char* adcRecordingPath = nullptr;
+    const char* telemetryImagePath = nullptr;
+    bool serve = false;
+    const char* mqttBroker = nullptr;
+    double mqttBacklogHours = 24;
+    unsigned long mqttRate = 0;
+    const char* warmBootPath = nullptr;
+    bool verbose = false;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc) {
+            seconds = strtod(argv[++i], nullptr);
+        } else if (strcmp(argv[i], "--days") == 0 && i + 1 < argc) {
+            seconds = strtod(argv[++i], nullptr) * 86400;
+        } else if (strcmp(argv[i], "--power") == 0) {
+            pressPower = true;
+        } else if (strcmp(argv[i], "--script") == 0 && i + 1 < argc) {
+            scriptPath = argv[++i];
+        } else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+            tracePath = argv[++i];
+        } else if (strcmp(argv[i], "--wifi-storm") == 0) {
+            wifiStorm = true;
+        } else if (strcmp(argv[i], "--grow-days") == 0 && i + 1 < argc) {
+            growDays = strtoul(argv[++i], nullptr, 10);
+        } else if (strcmp(argv[i], "--adc-recording") == 0 && i + 1 < argc) {
+            adcRecordingPath = argv[++i];
+        } else if (strcmp(argv[i], "--telemetry-image") == 0 && i + 1 < argc) {
+            telemetryImagePath = argv[++i];
+        } else if (strcmp(argv[i], "--serve") == 0) {
+            serve = true;
+        } else if (strcmp(argv[i], "--mqtt") == 0 && i + 1 < argc) {
+            mqttBroker = argv[++i];
+        } else if (strcmp(argv[i], "--mqtt-backlog") == 0 && i + 1 < argc) {
+            mqttBacklogHours = strtod(argv[++i], nullptr);
+        } else if (strcmp(argv[i], "--mqtt-rate") == 0 && i + 1 < argc) {
+            mqttRate = strtoul(argv[++i], nullptr, 10);
+        } else if (strcmp(argv[i], "--warm-boot") == 0 && i + 1 < argc) {
+            warmBootPath = argv[++i];
+        } else if (strcmp(argv[i], "--verbose") == 0) {
+            verbose = true;
+        } else {
+            fprintf(stderr, "usage: %s [--seconds N] [--days N] [--power] [--script FILE] [--trace FILE] [--wifi-storm] [--grow-days N] [--adc-recording FILE] [--telemetry-image FILE] [--serve] [--mqtt ADDRESS[:PORT]] [--mqtt-backlog HOURS] [--mqtt-rate N] [--warm-boot FILE] [--verbose]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    uint64_t endUs = static_cast<uint64_t>(seconds * 1e6);
+    std::vector<Stimulus> script;
+    if (growDays > 0) {
+        endUs = growDays * day + 1;
+        buildGrowCycle(script, growDays);
+    } else if (wifiStorm) {
+        buildWiFiStorm(script, endUs);
+    } else if (mqttBroker != nullptr) {
+        uint64_t backlogUs = static_cast<uint64_t>(mqttBacklogHours * 3600 * 1e6);
+        addPress(script, 1 * second, POWER_BUTTON_PIN);
+        script.push_back({backlogUs > 2 * second ? backlogUs : 2 * second, Stimulus::StartMqtt, 0, 0});
+        endUs = script.back().atUs + endUs;
+    } else if (pressPower || serve) {
+        addPress(script, 1 * second, POWER_BUTTON_PIN);
+    }
+    if (scriptPath != nullptr) {
+        if (!loadScript(scriptPath, script)) {
+            return 1;
+        }
+        std::stable_sort(script.begin(), script.end(),
+            [](const Stimulus& a, const Stimulus& b) { return a.atUs < b.atUs; });
+    }
+    char mqttAddress[16] = {};
+    uint16_t mqttPort = 1883;
+    if (mqttBroker != nullptr) {
+        const char* colon = strchr(mqttBroker, ':');
+        size_t length = colon != nullptr ? static_cast<size_t>(colon - mqttBroker) : strlen(mqttBroker);
+        if (length >= sizeof(mqttAddress)) {
+            fprintf(stderr, "bad broker address %s\n", mqttBroker);
+            return 1;
+        }
+        memcpy(mqttAddress, mqttBroker, length);
+        if (colon != nullptr) {
+            mqttPort = static_cast<uint16_t>(strtoul(colon + 1, nullptr, 10));
+        }
+    }
+
+    hal::sim::reset();
+    hal::sim::setSerialEcho(verbose);
+    // A healthy reservoir: pH 6.0, 1200 uS/cm, 21 C, three quarters full.
+    hal::sim::setAdcLevel(PH_SENSOR_ADC_CHANNEL, 1755, 40);
+    hal::sim::setAdcLevel(EC_SENSOR_ADC_CHANNEL, 983, 40);
+    hal::sim::setAdcLevel(WATER_TEMPERATURE_ADC_CHANNEL, 881, 20);
+    hal::sim::setAdcLevel(LEVEL_SENSOR_ADC_CHANNEL, 3071, 60);
+    std::vector<uint16_t> adcRecording;
+    if (adcRecordingPath != nullptr) {
+        if (!loadAdcRecording(adcRecordingPath, adcRecording)) {
+            fprintf(stderr, "cannot read ADC samples from %s\n", adcRecordingPath);
+            return 1;
+        }
+        hal::sim::setAdcRecording(adcRecording.data(), adcRecording.size());
+    }
+    if (growDays > 0 || mqttBroker != nullptr || endUs >= day) {
+        // Months of sensor sampling would dominate the run; long runs are about
+        // the outputs and the once-a-minute log records.
+        hal::sim::setAdcRateDivider(1000);
+    }
+    FILE* trace = nullptr;
+    if (tracePath != nullptr) {
+        trace = fopen(tracePath, "w");
+        if (trace == nullptr) {
+            fprintf(stderr, "cannot write %s\n", tracePath);
+            return 1;
+        }
+        fputs("us,kind,pin,output,value,fade_ms\n", trace);
+        hal::sim::setOutputRecorder(traceEdge, trace);
+    }
+    bool warmBoot = warmBootPath != nullptr && hal::sim::loadPersistent(warmBootPath);
+    auto setupStart = std::chrono::steady_clock::now();
+    setup();
+    auto setupNs = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - setupStart).count();
+    uint32_t bootState = appState.snapshot();
+    uint32_t bootDayMs = photoperiod.getTimeOfDayMs();
+    if (mqttRate > 0) {
+        mqttPublisher.setRateLimit(static_cast<uint16_t>(mqttRate));
+    }
+    hal::sim::setRealTime(serve);
+
+    using Clock = std::chrono::steady_clock;
+    size_t nextStimulus = 0;
+    unsigned long wakeups = 0;
+    uint64_t totalNs = 0;
+    uint64_t maxNs = 0;
+    bool pumpPressPending = false;
+    bool pumpLedAtPress = false;
+    uint64_t pumpPressUs = 0;
+    unsigned long pumpPresses = 0;
+    unsigned long pumpPressesLate = 0;
+    uint64_t maxLatencyUs = 0;
+    GrowDay growDay = {};
+    uint64_t growDayIndex = 0;
+    uint64_t growDaysJudged = 0;
+    uint64_t growDaysFailed = 0;
+    uint32_t lastStripTotal = 0;
+    Photoperiod::Phase lastPhase = Photoperiod::Phase::Off;
+    uint32_t sampleChecksum = 2166136261u; // FNV-1a over every duty sampled
+    uint64_t mqttStartUs = 0;
+    uint64_t mqttDrainedUs = 0; // Real time from connecting to the backlog sent, 0 until then
+    uint32_t mqttBacklogRecords = 0; // Log records waiting when the broker was set
+    uint32_t mqttDrainedMessages = 0;
+    uint32_t mqttDrainedRecords = 0;
+    uint32_t nvsWritesAtStart = 0;
+    Clock::time_point runStart = Clock::now();
+    while (hal::sim::nowMicros() < endUs) {
+        while (nextStimulus < script.size() && script[nextStimulus].atUs <= hal::sim::nowMicros()) {
+            const Stimulus& stimulus = script[nextStimulus++];
+            switch (stimulus.kind) {
+                case Stimulus::Input:
+                    if (stimulus.pin == PUMP_BUTTON_PIN && stimulus.level == LOW && shiftedBit(POWER_DIODE_PIN)) {
+                        pumpPressPending = true;
+                        pumpLedAtPress = shiftedBit(PUMP_DIODE_PIN);
+                        pumpPressUs = hal::sim::nowMicros();
+                        pumpPresses++;
+                    }
+                    hal::sim::setInput(stimulus.pin, stimulus.level);
+                    break;
+                case Stimulus::DropWiFi: hal::sim::dropWiFi(); break;
+                case Stimulus::WiFiReachable: hal::sim::setWiFiReachable(true); break;
+                case Stimulus::WiFiUnreachable: hal::sim::setWiFiReachable(false); break;
+                case Stimulus::StartMqtt:
+                    mqttBacklogRecords = telemetryLog.getRecordCount();
+                    nvsWritesAtStart = hal::sim::nvsWriteCount();
+                    hal::sim::setRealTime(true);
+                    mqttStartUs = hal::sim::nowMicros();
+                    if (!mqttClient.setBroker(mqttAddress, mqttPort)) {
+                        fprintf(stderr, "bad broker address %s\n", mqttBroker);
+                        return 1;
+                    }
+                    break;
+                case Stimulus::SampleStrip: {
+                    // A sample on midnight closes the day before it.
+                    uint32_t duty[3] = {hal::sim::ledcDuty(0), hal::sim::ledcDuty(1), hal::sim::ledcDuty(2)};
+                    uint32_t total = duty[0] + duty[1] + duty[2];
+                    Photoperiod::Phase phase = photoperiod.getPhase();
+                    for (uint32_t value : duty) {
+                        sampleChecksum = (sampleChecksum ^ value) * 16777619u;
+                    }
+                    if (total > 0) {
+                        growDay.litSamples++;
+                    }
+                    if ((phase == Photoperiod::Phase::Dawn && lastPhase == phase && total < lastStripTotal) ||
+                        (phase == Photoperiod::Phase::Dusk && lastPhase == phase && total > lastStripTotal)) {
+                        growDay.rampErrors++;
+                    }
+                    // The first day sample may still be finishing the last ramp step.
+                    if (phase == Photoperiod::Phase::Day && lastPhase == phase) {
+                        if (!growDay.haveDayDuty) {
+                            memcpy(growDay.dayDuty, duty, sizeof(duty));
+                            growDay.haveDayDuty = true;
+                        } else if (memcmp(growDay.dayDuty, duty, sizeof(duty)) != 0 || total == 0) {
+                            growDay.dayErrors++;
+                        }
+                    }
+                    if (growDay.program != nullptr && photoperiod.getProgram() != growDay.program) {
+                        growDay.programChanged = true;
+                    }
+                    growDay.program = photoperiod.getProgram();
+                    lastStripTotal = total;
+                    lastPhase = phase;
+                    if (stimulus.atUs % day == 0) {
+                        growDaysJudged++;
+                        if (!judgeGrowDay(growDay, growDayIndex)) {
+                            growDaysFailed++;
+                        }
+                        growDay = {};
+                        growDayIndex++;
+                    }
+                    break;
+                }
+            }
+        }
+        uint64_t horizonUs = nextStimulus < script.size() ? script[nextStimulus].atUs : endUs;
+        hal::sim::setIdleHorizon(horizonUs < endUs ? horizonUs : endUs);
+
+        Clock::time_point start = Clock::now();
+        loop();
+        uint64_t elapsedNs = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+        totalNs += elapsedNs;
+        maxNs = std::max(maxNs, elapsedNs);
+        wakeups++;
+
+        if (pumpPressPending && shiftedBit(PUMP_DIODE_PIN) != pumpLedAtPress) {
+            uint64_t latencyUs = hal::sim::nowMicros() - pumpPressUs;
+            maxLatencyUs = std::max(maxLatencyUs, latencyUs);
+            if (latencyUs > maxInputLatencyUs) {
+                pumpPressesLate++;
+            }
+            pumpPressPending = false;
+        } else if (pumpPressPending && hal::sim::nowMicros() - pumpPressUs > second) {
+            pumpPressesLate++;
+            pumpPressPending = false;
+        }
+        if (mqttStartUs != 0 && mqttDrainedUs == 0 && mqttPublisher.isCaughtUp()) {
+            mqttDrainedUs = hal::sim::nowMicros() - mqttStartUs;
+            mqttDrainedMessages = mqttPublisher.getMessageCount();
+            mqttDrainedRecords = mqttPublisher.getRecordCount();
+        }
+    }
+
+    double runSeconds = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - runStart).count() / 1e9;
+    hal::sim::setOutputRecorder(nullptr, nullptr);
+    if (trace != nullptr && fclose(trace) != 0) {
+        fprintf(stderr, "cannot write %s\n", tracePath);
+        return 1;
+    }
+
+    double simulatedSeconds = hal::sim::nowMicros() / 1e6;
+    printf("speed:            %.0f simulated s per wall s (%.3f s wall)\n",
+        runSeconds > 0 ? simulatedSeconds / runSeconds : 0.0, runSeconds);
+    printf("simulated time:   %.3f s\n", simulatedSeconds);
+    printf("wakeups:          %lu (%.2f/s)\n", wakeups, simulatedSeconds > 0 ? wakeups / simulatedSeconds : 0.0);
+    printf("wall time:        %.3f ms\n", totalNs / 1e6);
+    printf("loop() avg:       %.1f ns\n", wakeups ? static_cast<double>(totalNs) / wakeups : 0.0);
+    printf("loop() max:       %llu ns\n", static_cast<unsigned long long>(maxNs));
+    printf("register writes:  %u requested, %u physical\n",
+        shiftRegister.getRequestedWriteCount(), shiftRegister.getPhysicalWriteCount());
+    printf("output edges:     %llu\n", static_cast<unsigned long long>(hal::sim::outputEdgeCount()));
+#ifdef PROFILING_ENABLED
+    hal::sim::setSerialEcho(true);
+    Profiler::dump();
+#endif
+    printf("telemetry log:    %lu records in %lu bytes, %lu sectors erased\n",
+        static_cast<unsigned long>(telemetryLog.getRecordCount()),
+        static_cast<unsigned long>(telemetryLog.getEncodedBytes()),
+        static_cast<unsigned long>(hal::sim::storageEraseCount()));
+    if (serve) {
+        printf("http requests:    %lu, errors %lu, max latency %lu us\n",
+            static_cast<unsigned long>(httpServer.getRequestCount()),
+            static_cast<unsigned long>(httpServer.getErrorCount()),
+            static_cast<unsigned long>(httpServer.getMaxLatencyUs()));
+    }
+    if (mqttBroker != nullptr) {
+        printf("mqtt published:   %lu messages, %lu records, %lu connections\n",
+            static_cast<unsigned long>(mqttPublisher.getMessageCount()),
+            static_cast<unsigned long>(mqttPublisher.getRecordCount()),
+            static_cast<unsigned long>(mqttClient.getConnectCount()));
+        if (mqttDrainedUs > 0) {
+            double drainSeconds = mqttDrainedUs / 1e6;
+            printf("mqtt backlog:     %lu records drained in %.3f s real time, %.1f msg/s, %.0f records/s\n",
+                static_cast<unsigned long>(mqttDrainedRecords), drainSeconds, mqttDrainedMessages / drainSeconds,
+                mqttDrainedRecords / drainSeconds);
+        } else {
+            printf("mqtt backlog:     %lu records, not drained\n", static_cast<unsigned long>(mqttBacklogRecords));
+        }
+        printf("mqtt queueing:    0 B RAM per queued record (%.1f B flash), client %lu B, publisher %lu B\n",
+            telemetryLog.getRecordCount() > 0
+                ? static_cast<double>(telemetryLog.getEncodedBytes()) / telemetryLog.getRecordCount() : 0.0,
+            static_cast<unsigned long>(sizeof(MqttClient)), static_cast<unsigned long>(sizeof(TelemetryPublisher)));
+        printf("mqtt nvs writes:  %lu while connected\n",
+            static_cast<unsigned long>(hal::sim::nvsWriteCount() - nvsWritesAtStart));
+    }
+    if (warmBootPath != nullptr) {
+        printf("boot:             %s, outputs restored at %lu us virtual, setup() %.1f us wall\n",
+            warmBoot ? "warm" : "cold", static_cast<unsigned long>(outputsRestoredUs), setupNs / 1e3);
+        printf("restored:         state %08lx, photoperiod at %02lu:%02lu:%02lu\n", static_cast<unsigned long>(bootState),
+            static_cast<unsigned long>(bootDayMs / 3600000), static_cast<unsigned long>(bootDayMs / 60000 % 60),
+            static_cast<unsigned long>(bootDayMs / 1000 % 60));
+        if (!hal::sim::savePersistent(warmBootPath)) {
+            fprintf(stderr, "cannot write %s\n", warmBootPath);
+            return 1;
+        }
+    }
+    if (telemetryImagePath != nullptr) {
+        telemetryLog.flush();
+        if (!saveStorageImage(telemetryImagePath)) {
+            fprintf(stderr, "cannot write %s\n", telemetryImagePath);
+            return 1;
+        }
+    }
+    if (growDays > 0) {
+        printf("grow days:        %llu, failed %llu (the day of the mode change is not judged)\n",
+            static_cast<unsigned long long>(growDaysJudged),
+            static_cast<unsigned long long>(growDaysFailed));
+        printf("strip checksum:   %08lx\n", static_cast<unsigned long>(sampleChecksum));
+        bool passed = growDaysJudged == growDays && growDaysFailed == 0;
+        printf("grow cycle:       %s\n", passed ? "PASS" : "FAIL");
+        return passed ? 0 : 2;
+    }
+    if (wifiStorm) {
+        printf("pump presses:     %lu, late or lost: %lu\n", pumpPresses, pumpPressesLate);
+        printf("input latency:    max %llu us virtual (limit %llu us)\n",
+            static_cast<unsigned long long>(maxLatencyUs), static_cast<unsigned long long>(maxInputLatencyUs));
+        bool passed = pumpPresses > 0 && pumpPressesLate == 0;
+        printf("wifi storm:       %s\n", passed ? "PASS" : "FAIL");
+        return passed ? 0 : 2;
+    }
+    return 0;
+}
+
+#endif /* ARDUINO */
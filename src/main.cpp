@@ -4,17 +4,59 @@
  * 
  * This file contains the setup and main loop for an ESP32 project designed for smart gardening. 
  * It initializes the system, manages button events, LED states, and WiFi connectivity.
+ *
+ * The work is split over the two cores. The control side (buttons, LEDs, shift
+ * register, application state) runs in a high-priority task on core 1 with a
+ * fixed control period. The network side (WiFi, sensors, telemetry,
+ * statistics, the HTTP API, MQTT) runs on core 0 next to the logger's drain task.
+ * The two sides share no objects and talk only through the bounded lock-free
+ * queues below.
+ * Without task support (the native backend) both sides run in turn in loop().
  */
 
+#include <string.h>
 #include "Config.hpp"
+#include "HAL.hpp"
 #include "AppState.hpp"
+#include "ControlMachine.hpp"
 #include "WiFiManager.hpp"
 #include "ButtonManager.hpp"
 #include "LEDController.hpp"
+#include "Photoperiod.hpp"
+#include "PumpController.hpp"
+#include "SensorPipeline.hpp"
 #include "ShiftRegister.hpp"
+#include "TelemetryStore.hpp"
 #include "DebugLogger.hpp"
+#include "Scheduler.hpp"
+#include "MessageQueue.hpp"
+#include "Profiler.hpp"
+#include "HttpServer.hpp"
+#include "MqttClient.hpp"
+#include "TelemetryPublisher.hpp"
+#include "SnapshotStore.hpp"
+
+#ifndef HTTP_PORT
+#define HTTP_PORT 80 // Port of the JSON API; the native build adds 8000
+#endif
+
+// MQTT is off unless MQTT_BROKER gives the broker's IPv4 address, e.g. "192.168.1.10".
+#ifndef MQTT_PORT
+#define MQTT_PORT 1883
+#endif
+#ifndef MQTT_CLIENT_ID
+#define MQTT_CLIENT_ID "hydroponics" // Unique per broker; also the last topic level
+#endif
+#ifndef MQTT_TOPIC_PREFIX
+#define MQTT_TOPIC_PREFIX "garden"
+#endif
+#ifndef MQTT_RATE
+#define MQTT_RATE 5 // Telemetry messages per second while catching up
+#endif
 
 AppState appState;
+Scheduler controlScheduler; // Runs the control side on core 1
+Scheduler networkScheduler; // Runs the network side on core 0
 
 // Object initialization with configuration parameters.
 WiFiManager wifiManager(WIFI_SSID, WIFI_PASS);
@@ -29,8 +71,10 @@ ShiftRegister shiftRegister(
     SHIFT_REGISTER_CLOCK_PIN, 
     SHIFT_REGISTER_LATCH_PIN
 );
-LEDController ledController(
-    &shiftRegister, 
+
+// Wiring from Config.hpp. PinMap rejects diode outputs beyond the register
+// and clashes among the diodes or the strip channels; the rest is checked here.
+typedef PinMap<
     POWER_DIODE_PIN, 
     WIFI_DIODE_PIN, 
     PUMP_DIODE_PIN, 
@@ -38,21 +82,202 @@ LEDController ledController(
     FLOWER_DIODE_PIN, 
     BLUE_PWM_PIN, 
     RED_PWM_PIN, 
-    GREEN_PWM_PIN
-);
+    GREEN_PWM_PIN, 
+    ShiftRegister::pinCount
+> BoardPins;
+static_assert(PUMP_RELAY_PIN < BoardPins::shiftOutputs, "PUMP_RELAY_PIN is beyond the shift register outputs");
+static_assert(!BoardPins::usesShiftOutput(PUMP_RELAY_PIN), "PUMP_RELAY_PIN is also a diode output");
+static_assert(pinsDistinct(POWER_BUTTON_PIN, PUMP_BUTTON_PIN, VEGETABLE_BUTTON_PIN, FLOWER_BUTTON_PIN,
+    SHIFT_REGISTER_DATA_PIN, SHIFT_REGISTER_CLOCK_PIN, SHIFT_REGISTER_LATCH_PIN, BLUE_PWM_PIN, RED_PWM_PIN, GREEN_PWM_PIN),
+    "two functions on one GPIO");
+static_assert(isOutputGpio(SHIFT_REGISTER_DATA_PIN) && isOutputGpio(SHIFT_REGISTER_CLOCK_PIN) &&
+    isOutputGpio(SHIFT_REGISTER_LATCH_PIN), "shift register pin is not an ESP32 output GPIO");
+LEDController<BoardPins> ledController(&shiftRegister);
+
+// Addressable strip following the strip fades, off unless PIXEL_STRIP_PIN
+// gives its data GPIO.
+#ifdef PIXEL_STRIP_PIN
+#ifndef PIXEL_COUNT
+#define PIXEL_COUNT 60
+#endif
+#ifndef PIXEL_ORDER
+#define PIXEL_ORDER PixelOrder::Grb // PixelOrder::Grbw for SK6812 RGBW
+#endif
+static_assert(isOutputGpio(PIXEL_STRIP_PIN), "PIXEL_STRIP_PIN is not an ESP32 output GPIO");
+static_assert(pinsDistinct(PIXEL_STRIP_PIN, POWER_BUTTON_PIN, PUMP_BUTTON_PIN, VEGETABLE_BUTTON_PIN, FLOWER_BUTTON_PIN,
+    SHIFT_REGISTER_DATA_PIN, SHIFT_REGISTER_CLOCK_PIN, SHIFT_REGISTER_LATCH_PIN, BLUE_PWM_PIN, RED_PWM_PIN, GREEN_PWM_PIN),
+    "PIXEL_STRIP_PIN is already in use");
+PixelStrip<PIXEL_COUNT, PIXEL_ORDER> pixelStrip(PIXEL_STRIP_PIN);
+#endif
+Photoperiod photoperiod(&ledController);
+PumpController pumpController(&shiftRegister);
+uint8_t mainPump = PumpController::invalidId; // Circulation pump relay
+SensorPipeline sensors;
+
+// Sensor readings in integer units. The calibrations map 0-3.3 V at 11 dB
+// attenuation linearly onto each probe board's output range; recalibrate pH
+// and EC against reference solutions with SensorPipeline::twoPoint().
+enum Sensor : uint8_t { PhSensor, EcSensor, WaterTemperatureSensor, LevelSensor, sensorCount };
+int32_t sensorReadings[sensorCount] = {}; // milli-pH, uS/cm, tenths of a degree C, tenths of a percent
+
+// History on flash: every control state change and the sensor readings once a minute.
+TelemetryStore telemetryLog;
+uint8_t stateLogChannel = TelemetryStore::invalidId;
+uint8_t sensorLogChannels[sensorCount] = {};
+const char* logChannelNames[TelemetryStore::maxChannels] = {}; // Names by channel, for the API
+
+// JSON API on the local network, served on the network side once WiFi is up.
+HttpServer httpServer;
+
+// The telemetry log published to an MQTT broker, and button commands from it.
+const char mqttTelemetryTopic[] = MQTT_TOPIC_PREFIX "/" MQTT_CLIENT_ID "/telemetry";
+const char mqttStatusTopic[] = MQTT_TOPIC_PREFIX "/" MQTT_CLIENT_ID "/status";
+const char mqttCommandTopic[] = MQTT_TOPIC_PREFIX "/" MQTT_CLIENT_ID "/command";
+MqttClient mqttClient;
+TelemetryPublisher mqttPublisher(mqttClient, telemetryLog, logChannelNames);
+
+/**
+ * @brief What the user set, restored at boot so a brown-out does not switch the garden off.
+ *
+ * The photoperiod phase is kept as the log time, modulo a day, at which the
+ * light day started: it only moves when the clock is set, so it costs no
+ * writes while the day runs, and the log clock carries on after a restart.
+ */
+struct StateSnapshot {
+    uint32_t state; // AppState bits in persistentStateMask
+    uint32_t dayOriginMs; // Log time of a photoperiod midnight, modulo a day
+};
+SnapshotStore stateSnapshots("state", 1);
+StateSnapshot savedSnapshot = {0, 0}; // Last snapshot saved or restored, network side
+StateSnapshot pendingSnapshot = {0, 0}; // Snapshot waiting for the snapshot timer
+uint8_t snapshotTimer = Scheduler::invalidId;
+bool logMounted = false; // The log clock carries on across restarts
+uint32_t outputsRestoredUs = 0; // hal::micros() when setup() had the outputs restored
+
+// Light schedules of the grow stages: long blue days for vegetative growth,
+// 12/12 red days to trigger flowering. Both rise and set through a warm sunrise tint.
+const PhotoperiodProgram vegetativeProgram = {6 * 3600, 18 * 3600, 30 * 60, {255, 96, 32}, {0, 0, 255}};
+const PhotoperiodProgram floweringProgram = {6 * 3600, 12 * 3600, 45 * 60, {255, 96, 32}, {255, 0, 0}};
 
 // Button identifiers for readability.
 enum Button { Power, Pump, Vegetable, Flower };
+const char* const buttonNames[] = {"power", "pump", "vegetable", "flower"}; // In the HTTP and MQTT APIs
 
+// Requests from the control side to the network side.
+enum class NetworkCommand : uint8_t { ConnectWiFi, DisconnectWiFi };
 
-// Forward declaration for a function handling LED and LED strip logic.
-void handleMultipleLedInteractions(
-    bool& currentLedDiodeState, 
-    bool& otherLedDiodeState, 
-    DiodeType currentLedDiode, 
-    DiodeType otherLedDiode, 
-    uint8_t ledStripMode
-);
+/**
+ * @brief Message from the network side to the control side.
+ */
+struct ControlMessage {
+    enum Kind : uint8_t { WiFiStateChanged, ButtonAction } kind;
+    uint8_t value; // WiFiManager::State for WiFiStateChanged, Button for ButtonAction
+};
+
+/**
+ * @brief Periodic sample of the control side for the network side.
+ */
+struct TelemetrySample {
+    uint32_t timestampMs; // hal::millis() when sampled
+    uint32_t state; // AppState::snapshot()
+    uint32_t dayMs; // Photoperiod time of day
+};
+
+MessageQueue<NetworkCommand, 8> networkCommands; // Control -> network
+MessageQueue<ControlMessage, 8> controlMessages; // Network -> control
+MessageQueue<TelemetrySample, 16> telemetry; // Control -> network
+
+// Task layout. The control task preempts everything else on core 1; on core 0
+// the network task sits above the logger's drain task and below the WiFi driver.
+constexpr int8_t controlCore = 1;
+constexpr int8_t networkCore = 0;
+constexpr uint8_t controlTaskPriority = 5;
+constexpr uint8_t networkTaskPriority = 2;
+constexpr uint32_t taskStackBytes = 4096;
+constexpr uint32_t controlPeriod = 100; // Control cycle (ms); also limits the telemetry rate.
+constexpr uint32_t pumpCycleSeconds = 3600; // Circulation schedule: one run per hour...
+constexpr uint32_t pumpRunSeconds = 15 * 60; // ...of 15 minutes, starting at power-up.
+constexpr uint32_t sensorSampleRate = 20000; // Total ADC conversions per second, the ESP32 DMA minimum
+constexpr uint32_t sensorPublishInterval = 100; // Readings per second and CPU wakeups for sampling (ms)
+constexpr uint8_t sensorSmoothing = 8; // EMA over about 256 medians per channel
+constexpr uint32_t sensorLogInterval = 60000; // Sensor readings written to the telemetry log (ms)
+constexpr uint32_t telemetryFlushInterval = 5 * 60000; // Records lost at most on a power cut (ms)
+constexpr uint32_t statsReportInterval = 10000; // Queue and CPU report (ms), below the cycle counter wrap.
+constexpr uint32_t historyWindowMs = 3600000; // History returned when the request gives no range (ms)
+constexpr size_t historyRecordJson = 48; // Longest history record in JSON, with its comma
+constexpr uint32_t snapshotDelay = 2000; // State left alone this long before it is saved (ms)
+constexpr uint32_t dayOriginToleranceMs = 2000; // Photoperiod phase changes below this are not saved
+constexpr uint32_t msPerDay = 86400000;
+// The state kept across restarts: the pump LED follows its schedule, which
+// restarts at power-up, and the WiFi LED follows the link.
+constexpr uint32_t persistentStateMask = AppState::bit(AppState::Field::Power) |
+    AppState::bit(AppState::Field::VegetableLedDiode) | AppState::bit(AppState::Field::FlowerLedDiode) |
+    AppState::bit(AppState::Field::LedStrip);
+
+bool controlTaskRunning = false; // The control side runs in its own task, not in loop()
+bool networkTaskRunning = false; // The network side runs in its own task, not in loop()
+WiFiManager::State wifiLinkState = WiFiManager::State::Off; // Control side copy of the WiFi state
+TelemetrySample latestTelemetry = {0, 0, 0}; // Network side copy of the control state
+uint32_t lastTelemetryState = 0; // State in the last telemetry sample sent
+uint32_t lastStatsReportUs = 0; // Start of the current statistics interval
+uint32_t lastControlBusyCycles = 0; // Control scheduler busy cycles at that time
+uint32_t lastNetworkBusyCycles = 0; // Network scheduler busy cycles at that time
+
+void handlePowerButtonClick();
+void handlePumpButtonClick();
+void handleVegetableButtonClick();
+void handleFlowerButtonClick();
+void handleWiFiStateChange(WiFiManager::State state, void* context);
+void handlePumpStateChange(uint8_t pump, bool running, void* context);
+void handleSensorReadings(const int32_t* readings, uint8_t count, void* context);
+void handleNetworkCommands(void* context);
+void handleControlMessages(void* context);
+void handleTelemetry(void* context);
+void handleControlPeriod(void* context);
+void handleSensorLogTimer(void* context);
+void handleSnapshotTimer(void* context);
+void handleStatsReport(void* context);
+void handleStateRequest(const HttpServer::Request& request, HttpServer::Response& response, void* context);
+void handleHistoryRequest(const HttpServer::Request& request, HttpServer::Response& response, void* context);
+void handleButtonRequest(const HttpServer::Request& request, HttpServer::Response& response, void* context);
+void handleServerRequest(const HttpServer::Request& request, HttpServer::Response& response, void* context);
+void handleMqttMessage(const char* topic, const uint8_t* payload, size_t length, void* context);
+void runControlTask(void* context);
+void runNetworkTask(void* context);
+
+PROFILE_HISTOGRAM(loopIteration);
+PROFILE_HISTOGRAM(powerButtonHandler);
+PROFILE_HISTOGRAM(pumpButtonHandler);
+PROFILE_HISTOGRAM(vegetableButtonHandler);
+PROFILE_HISTOGRAM(flowerButtonHandler);
+
+#ifdef PROFILING_ENABLED
+// Interval at which serial profiler commands are polled (ms).
+constexpr uint32_t profilerPollInterval = 250;
+
+/**
+ * @brief Answers profiler commands received over serial ('p' dump, 'r' reset).
+ */
+void handleProfilerPollTimer(void* context) {
+    (void)context;
+    Profiler::pollSerial();
+}
+#endif
+
+void applyStateToOutputs(uint32_t changedMask, uint32_t state, void* context);
+void updateWiFiLedDiodeState();
+void restoreOutputs();
+
+/**
+ * @brief Adds a telemetry log channel and remembers its name for the API.
+ */
+uint8_t addLogChannel(const char* name, TelemetryStore::Encoding encoding) {
+    uint8_t channel = telemetryLog.addChannel(name, encoding);
+    if (channel != TelemetryStore::invalidId) {
+        logChannelNames[channel] = name;
+    }
+    return channel;
+}
 
 /**
  * @brief Initializes the system components.
@@ -61,10 +286,106 @@ void handleMultipleLedInteractions(
  */
 void setup() {
     DebugLogger::setDebug(true);
+    // Coalesce all output changes of a tick into one shift register write.
+    shiftRegister.setDeferredFlush(true);
     for (auto& button : allButtons) {
-        button.setup();
+        button.setup(controlScheduler);
     }
-    ledController.setWiFiManager(wifiManager);
+    allButtons[Power].setClickHandler(handlePowerButtonClick);
+    allButtons[Pump].setClickHandler(handlePumpButtonClick);
+    allButtons[Vegetable].setClickHandler(handleVegetableButtonClick);
+    allButtons[Flower].setClickHandler(handleFlowerButtonClick);
+    ledController.setScheduler(controlScheduler);
+#ifdef PIXEL_STRIP_PIN
+    if (pixelStrip.begin(controlScheduler)) {
+        ledController.setPixelStrip(&pixelStrip);
+    }
+#endif
+    photoperiod.begin(controlScheduler);
+    pumpController.begin(controlScheduler);
+    mainPump = pumpController.addPump(PUMP_RELAY_PIN);
+    pumpController.addInterval(mainPump, pumpCycleSeconds, pumpRunSeconds);
+    pumpController.setStateChangeHandler(handlePumpStateChange, nullptr);
+    controlMessages.attachConsumer(controlScheduler, handleControlMessages, nullptr);
+    uint8_t controlTimer = controlScheduler.addTimer(handleControlPeriod, nullptr);
+    controlScheduler.startTimer(controlTimer, controlPeriod, controlPeriod);
+
+    wifiManager.begin(networkScheduler);
+    wifiManager.setStateChangeHandler(handleWiFiStateChange, nullptr);
+    networkCommands.attachConsumer(networkScheduler, handleNetworkCommands, nullptr);
+    telemetry.attachConsumer(networkScheduler, handleTelemetry, nullptr);
+    stateLogChannel = addLogChannel("state", TelemetryStore::Encoding::Xor);
+    sensorLogChannels[PhSensor] = addLogChannel("ph", TelemetryStore::Encoding::Delta);
+    sensorLogChannels[EcSensor] = addLogChannel("ec", TelemetryStore::Encoding::Delta);
+    sensorLogChannels[WaterTemperatureSensor] = addLogChannel("water", TelemetryStore::Encoding::Delta);
+    sensorLogChannels[LevelSensor] = addLogChannel("level", TelemetryStore::Encoding::Delta);
+    logMounted = telemetryLog.begin(networkScheduler, telemetryFlushInterval);
+    snapshotTimer = networkScheduler.addTimer(handleSnapshotTimer, nullptr);
+    restoreOutputs();
+
+    sensors.addChannel(PH_SENSOR_ADC_CHANNEL, SensorPipeline::twoPoint(0, 0, 4095, 14000), sensorSmoothing);
+    sensors.addChannel(EC_SENSOR_ADC_CHANNEL, SensorPipeline::twoPoint(0, 0, 4095, 5000), sensorSmoothing);
+    sensors.addChannel(WATER_TEMPERATURE_ADC_CHANNEL, SensorPipeline::twoPoint(0, -500, 4095, 2800), sensorSmoothing);
+    sensors.addChannel(LEVEL_SENSOR_ADC_CHANNEL, SensorPipeline::twoPoint(0, 0, 4095, 1000), sensorSmoothing);
+    sensors.setPublishHandler(handleSensorReadings, nullptr);
+    sensors.begin(networkScheduler, sensorSampleRate, sensorPublishInterval);
+    if (logMounted) {
+        uint8_t sensorLogTimer = networkScheduler.addTimer(handleSensorLogTimer, nullptr);
+        networkScheduler.startTimer(sensorLogTimer, sensorLogInterval, sensorLogInterval);
+    }
+    httpServer.addRoute(HttpServer::Method::Get, "/api/state", handleStateRequest, nullptr);
+    httpServer.addRoute(HttpServer::Method::Get, "/api/history", handleHistoryRequest, nullptr);
+    httpServer.addRoute(HttpServer::Method::Post, "/api/buttons/*", handleButtonRequest, nullptr);
+    httpServer.addRoute(HttpServer::Method::Get, "/api/server", handleServerRequest, nullptr);
+    mqttClient.setClientId(MQTT_CLIENT_ID);
+#if defined(MQTT_USER) && defined(MQTT_PASS)
+    mqttClient.setCredentials(MQTT_USER, MQTT_PASS);
+#endif
+    mqttClient.subscribe(mqttCommandTopic);
+    mqttClient.setMessageHandler(handleMqttMessage, nullptr);
+    mqttClient.begin(networkScheduler);
+    mqttPublisher.setStatusTopic(mqttStatusTopic);
+    mqttPublisher.setRateLimit(MQTT_RATE);
+    mqttPublisher.begin(networkScheduler, mqttTelemetryTopic);
+#ifdef MQTT_BROKER
+    if (!mqttClient.setBroker(MQTT_BROKER, MQTT_PORT)) {
+        LOG_ERROR("MQTT_BROKER %s is not an IPv4 address.", MQTT_BROKER);
+    }
+#endif
+    uint8_t statsTimer = networkScheduler.addTimer(handleStatsReport, nullptr);
+    networkScheduler.startTimer(statsTimer, statsReportInterval, statsReportInterval);
+    lastStatsReportUs = static_cast<uint32_t>(hal::micros());
+#ifdef PROFILING_ENABLED
+    uint8_t profilerPollTimer = networkScheduler.addTimer(handleProfilerPollTimer, nullptr);
+    networkScheduler.startTimer(profilerPollTimer, profilerPollInterval, profilerPollInterval);
+#endif
+
+    // Each scheduler is driven either by its task or by loop(), never both:
+    // the network task is only started once the control task runs, and if it
+    // fails loop() carries on with the network side alone.
+    controlTaskRunning = hal::startTask("control", runControlTask, nullptr, taskStackBytes, controlTaskPriority,
+        controlCore) != nullptr;
+    if (controlTaskRunning) {
+        networkTaskRunning = hal::startTask("network", runNetworkTask, nullptr, taskStackBytes, networkTaskPriority,
+            networkCore) != nullptr;
+        if (!networkTaskRunning) {
+            LOG_ERROR("Network task could not be started.");
+        }
+    }
+    LOG_INFO("System initialized and ready.");
+}
+
+/**
+ * @brief Sets the outputs to the last saved state, or all off without one.
+ *
+ * Runs in setup() as soon as the telemetry log is mounted, before the
+ * sensors, the API and any WiFi connection, so after a brown-out the lights
+ * and the pump are back within milliseconds. The photoperiod picks up its day
+ * where the log clock says it is; the time the controller was off is not
+ * counted, as there is no clock running through it. The pump schedule
+ * starts over, as it does at every power-up.
+ */
+void restoreOutputs() {
     ledController.tuneMultipleLedAttributes(
         DiodeType::Power, false, 
         DiodeType::WiFi, false, 
@@ -73,181 +394,597 @@ void setup() {
         DiodeType::Flower, false
     );
     ledController.setLedStripMode(STRIP_OFF);
-    
-    // Initialize application states with default values
-    appState.setPowerState(false);
-    appState.setWiFiLedDiodeState(false);
-    appState.setPumpLedDiodeState(false);
-    appState.setVegetableLedDiodeState(false);
-    appState.setFlowerLedDiodeState(false);
-    appState.setLedStripState(false);
+    // AppState starts all off, matching the outputs; from here on it drives them.
+    appState.subscribe(applyStateToOutputs, nullptr);
+    StateSnapshot snapshot;
+    if (stateSnapshots.load(&snapshot, sizeof(snapshot))) {
+        if (logMounted) {
+            uint32_t dayMs = static_cast<uint32_t>((telemetryLog.now() % msPerDay + msPerDay - snapshot.dayOriginMs) % msPerDay);
+            photoperiod.setTimeOfDay(dayMs / 1000);
+        }
+        uint32_t state = snapshot.state & persistentStateMask;
+        if (AppState::test(state, AppState::Field::Power)) {
+            appState.replace(state | AppState::bit(AppState::Field::WiFiLedDiode));
+            pumpController.setEnabled(true);
+            networkCommands.send(NetworkCommand::ConnectWiFi);
+        }
+        savedSnapshot = snapshot;
+        pendingSnapshot = snapshot;
+    }
+    appState.notifyObservers();
+    shiftRegister.flush();
+    outputsRestoredUs = static_cast<uint32_t>(hal::micros());
+    LOG_INFO("Outputs restored %lu us after reset, state 0x%lx.", static_cast<unsigned long>(outputsRestoredUs),
+        static_cast<unsigned long>(appState.snapshot()));
+}
 
-    DebugLogger::info("System initialized and ready.");
+/**
+ * @brief Runs a button through the control machine and carries out what it asks for.
+ *
+ * The machine changes AppState by itself; the LEDs follow through
+ * applyStateToOutputs(). What is left here is the work outside the state
+ * word: the pump schedules and the WiFi link.
+ */
+void dispatchControlEvent(control::Event event) {
+    uint8_t commands = control::dispatch(appState, event);
+    if (commands & control::EnablePumps) {
+        pumpController.setEnabled(true);
+        LOG_INFO("System powered up.");
+    }
+    if (commands & control::DisablePumps) {
+        pumpController.setEnabled(false);
+        LOG_INFO("System powered down.");
+    }
+    if (commands & control::TogglePump) {
+        pumpController.toggleManual(mainPump);
+    }
+    if (commands & control::ConnectWiFi) {
+        networkCommands.send(NetworkCommand::ConnectWiFi);
+    }
+    if (commands & control::DisconnectWiFi) {
+        networkCommands.send(NetworkCommand::DisconnectWiFi);
+    }
 }
 
 /**
  * @brief Toggles the system's power state on power button press.
  * 
- * Manages the system power state, initiates or disconnects WiFi connection, and updates LED states.
+ * Power-up waits until the WiFi link has settled from the last power-down.
  */
 void handlePowerButtonClick() {
-    if (!appState.isPowerOn()) {
-        if (!wifiManager.isConnecting() && !wifiManager.isConnected()) {
-            appState.setPowerState(true);
-            DebugLogger::info("System powered up.");
-            wifiManager.connect();
-            ledController.tuneMultipleLedAttributes(
-                DiodeType::Power, true, 
-                DiodeType::WiFi, true
-            );
-        }
-    } else {
-        appState.setPowerState(false);
-        DebugLogger::info("System powered down.");
-        wifiManager.disconnect();
-        ledController.tuneMultipleLedAttributes(
-            DiodeType::Power, false, 
-            DiodeType::WiFi, false, 
-            DiodeType::Pump, false, 
-            DiodeType::Vegetable, false, 
-            DiodeType::Flower, false
-        );
-        ledController.setLedStripMode(STRIP_OFF);
-        appState.setWiFiLedDiodeState(false);
-        appState.setPumpLedDiodeState(false);
-        appState.setVegetableLedDiodeState(false);
-        appState.setFlowerLedDiodeState(false);
-        appState.setLedStripState(false);
-    }
+    PROFILE_SPAN(powerButtonHandler);
+    bool linkBusy = wifiLinkState == WiFiManager::State::Connecting || wifiLinkState == WiFiManager::State::Backoff ||
+        wifiLinkState == WiFiManager::State::Connected;
+    dispatchControlEvent(linkBusy ? control::Event::PowerWhileLinkBusy : control::Event::Power);
 }
 
 /**
  * @brief Handles pump button click events.
  * 
- * Toggles the state of the pump LED when the pump button is clicked.
+ * Switches the circulation pump on or off by hand. Switching it back to what
+ * its schedule wants hands it back to the schedule.
  */
 void handlePumpButtonClick() {
-    if (appState.isPowerOn()) {
-        ledController.toggleLedDiodeState(DiodeType::Pump);
+    PROFILE_SPAN(pumpButtonHandler);
+    dispatchControlEvent(control::Event::Pump);
+}
+
+/**
+ * @brief Shows the circulation pump relay state on the pump LED.
+ */
+void handlePumpStateChange(uint8_t pump, bool running, void* context) {
+    (void)context;
+    if (pump == mainPump) {
+        appState.setPumpLedDiodeState(running);
     }
 }
 
 /**
  * @brief Handles vegetable button click events.
  * 
- * Manages the LED strip state and color based on the vegetable button's state.
+ * Switches the vegetable mode, and with it the vegetative light schedule, on or off.
  */
 void handleVegetableButtonClick() {
-    if (appState.isPowerOn()) {
-        bool currentVegetableLedDiodeState = appState.getStateForLedDiode(DiodeType::Vegetable);
-        bool currentFlowerLedDiodeState = appState.getStateForLedDiode(DiodeType::Flower);
-        handleMultipleLedInteractions(
-            currentVegetableLedDiodeState, 
-            currentFlowerLedDiodeState, 
-            DiodeType::Vegetable, 
-            DiodeType::Flower, 
-            0
-        );
-        appState.setVegetableLedDiodeState(currentVegetableLedDiodeState);
-        appState.setFlowerLedDiodeState(currentFlowerLedDiodeState);
-    } else if (appState.isVegetableLedDiodeOn()) {
-        appState.setVegetableLedDiodeState(false);
-    }
-    DebugLogger::info("Vegetable Button State: " + String(appState.isVegetableLedDiodeOn()));
+    PROFILE_SPAN(vegetableButtonHandler);
+    dispatchControlEvent(control::Event::Vegetable);
+    LOG_INFO("Vegetable Button State: %d", appState.isVegetableLedDiodeOn());
 }
 
 /**
  * @brief Handles flower button click events.
  * 
- * Manages the LED strip state and color based on the flower button's state.
+ * Switches the flower mode, and with it the flowering light schedule, on or off.
  */
 void handleFlowerButtonClick() {
-    if(appState.isPowerOn()) {
-        bool currentFlowerLedDiodeState = appState.getStateForLedDiode(DiodeType::Flower);
-        bool currentVegetableLedDiodeState = appState.getStateForLedDiode(DiodeType::Vegetable);
-        handleMultipleLedInteractions(
-            currentFlowerLedDiodeState, 
-            currentVegetableLedDiodeState, 
-            DiodeType::Flower, 
-            DiodeType::Vegetable, 
-            1
-        );
-        appState.setFlowerLedDiodeState(currentFlowerLedDiodeState);
-        appState.setVegetableLedDiodeState(currentVegetableLedDiodeState);
-    } else if (appState.isFlowerLedDiodeOn()) {
-        appState.setFlowerLedDiodeState(false);
-    }
-    DebugLogger::info("Flower Button State: " + String(appState.isFlowerLedDiodeOn()));
-}
-
-/**
- * @brief Toggles LED states and updates LED strip mode based on user interaction.
- * 
- * Switches the state of two specified LEDs, ensuring only one is active at any time. Sets the LED strip to the appropriate mode.
- * 
- * @param currentLedDiodeState Reference to the current LED's state.
- * @param otherLedDiodeState Reference to the other LED's state.
- * @param currentLedDiode Current LED being manipulated.
- * @param otherLedDiode Other LED potentially affected by the interaction.
- * @param ledStripMode Mode for the LED strip (0 for vegetable, 1 for flower, 2 for off).
- */
-void handleMultipleLedInteractions(
-    bool& currentLedDiodeState,
-    bool& otherLedDiodeState,
-    DiodeType currentLedDiode,
-    DiodeType otherLedDiode,
-    uint8_t ledStripMode) {
-    if (!currentLedDiodeState) {
-        ledController.setLedDiodeState(currentLedDiode, true);
-        ledController.setLedDiodeState(otherLedDiode, false);
-        currentLedDiodeState = true;
-        otherLedDiodeState = false;
-        ledController.setLedStripMode(ledStripMode);
-        appState.setLedStripState(true);
-    } else {
-        ledController.setLedDiodeState(currentLedDiode, false);
-        currentLedDiodeState = false;
-        if (otherLedDiodeState) {
-            ledController.setLedDiodeState(otherLedDiode, false);
-            otherLedDiodeState = false;
+    PROFILE_SPAN(flowerButtonHandler);
+    dispatchControlEvent(control::Event::Flower);
+    LOG_INFO("Flower Button State: %d", appState.isFlowerLedDiodeOn());
+}
+
+/**
+ * @brief Brings the LEDs in line with the parts of the state that changed.
+ *
+ * A grow mode hands the LED strip to the photoperiod engine with the light
+ * schedule of its stage. Runs once per tick from AppState::notifyObservers().
+ *
+ * @param changedMask Bits changed since the last call.
+ * @param state Current state word.
+ */
+void applyStateToOutputs(uint32_t changedMask, uint32_t state, void* context) {
+    (void)context;
+    static const DiodeType plainDiodes[] = {DiodeType::Power, DiodeType::Pump, DiodeType::Vegetable, DiodeType::Flower};
+    shiftRegister.beginTransaction();
+    for (DiodeType diode : plainDiodes) {
+        if (changedMask & AppState::bit(diode)) {
+            ledController.setLedDiodeState(diode, (state & AppState::bit(diode)) != 0);
+        }
+    }
+    if (changedMask & AppState::bit(AppState::Field::WiFiLedDiode)) {
+        if (AppState::test(state, AppState::Field::WiFiLedDiode)) {
+            updateWiFiLedDiodeState();
+        } else {
+            ledController.setLedDiodeState(DiodeType::WiFi, false);
         }
-        ledController.setLedStripMode(STRIP_OFF);
-        appState.setLedStripState(false);
     }
+    const uint32_t stripBits = AppState::bit(AppState::Field::VegetableLedDiode) |
+        AppState::bit(AppState::Field::FlowerLedDiode) | AppState::bit(AppState::Field::LedStrip);
+    if (changedMask & stripBits) {
+        if (!AppState::test(state, AppState::Field::LedStrip)) {
+            photoperiod.stop();
+            ledController.setLedStripMode(STRIP_OFF);
+        } else if (AppState::test(state, AppState::Field::VegetableLedDiode)) {
+            photoperiod.start(vegetativeProgram);
+        } else {
+            photoperiod.start(floweringProgram);
+        }
+    }
+    shiftRegister.commit();
 }
 
-
 /**
  * @brief Updates WiFi LED state based on current WiFi connection status.
  */
 void updateWiFiLedDiodeState() {
-    if (wifiManager.isConnecting()) {
+    if (wifiLinkState == WiFiManager::State::Connecting || wifiLinkState == WiFiManager::State::Backoff) {
         ledController.blinkWiFiLedDiode(WIFI_BLINK_COUNT);
-    } else if (wifiManager.isConnected()) {
+    } else if (wifiLinkState == WiFiManager::State::Connected) {
         ledController.setLedDiodeState(DiodeType::WiFi, true);
     } else {
-        ledController.setLedDiodeState(DiodeType::Pump, false);
+        ledController.setLedDiodeState(DiodeType::WiFi, false);
+    }
+}
+
+/**
+ * @brief Drains messages from the network side. Runs on the control side.
+ */
+void handleControlMessages(void* context) {
+    (void)context;
+    ControlMessage message;
+    while (controlMessages.receive(message)) {
+        switch (message.kind) {
+            case ControlMessage::WiFiStateChanged:
+                wifiLinkState = static_cast<WiFiManager::State>(message.value);
+                if (appState.isPowerOn()) {
+                    updateWiFiLedDiodeState();
+                }
+                break;
+            case ControlMessage::ButtonAction:
+                switch (message.value) {
+                    case Power: handlePowerButtonClick(); break;
+                    case Pump: handlePumpButtonClick(); break;
+                    case Vegetable: handleVegetableButtonClick(); break;
+                    case Flower: handleFlowerButtonClick(); break;
+                }
+                break;
+        }
+    }
+}
+
+/**
+ * @brief Runs once per control period. Sends the control state to the network
+ * side if it changed, so bursts of changes cost one sample per period.
+ */
+void handleControlPeriod(void* context) {
+    (void)context;
+    uint32_t state = appState.snapshot();
+    if (state != lastTelemetryState &&
+        telemetry.send({static_cast<uint32_t>(hal::millis()), state, photoperiod.getTimeOfDayMs()})) {
+        lastTelemetryState = state;
+    }
+}
+
+/**
+ * @brief Forwards WiFi state changes to the control side and MQTT, and starts
+ * the API with the first connection. Runs on the network side.
+ */
+void handleWiFiStateChange(WiFiManager::State state, void* context) {
+    (void)context;
+    controlMessages.send({ControlMessage::WiFiStateChanged, static_cast<uint8_t>(state)});
+    mqttClient.setNetworkAvailable(state == WiFiManager::State::Connected);
+    if (state == WiFiManager::State::Connected && !httpServer.isRunning()) {
+        httpServer.begin(networkScheduler, HTTP_PORT);
+    }
+}
+
+/**
+ * @brief Carries out requests from the control side. Runs on the network side.
+ */
+void handleNetworkCommands(void* context) {
+    (void)context;
+    NetworkCommand command;
+    while (networkCommands.receive(command)) {
+        switch (command) {
+            case NetworkCommand::ConnectWiFi:
+                wifiManager.connect();
+                break;
+            case NetworkCommand::DisconnectWiFi:
+                wifiManager.disconnect();
+                break;
+        }
+    }
+}
+
+/**
+ * @brief Keeps the latest sensor readings. Runs on the network side.
+ */
+void handleSensorReadings(const int32_t* readings, uint8_t count, void* context) {
+    (void)context;
+    for (uint8_t i = 0; i < count && i < sensorCount; i++) {
+        sensorReadings[i] = readings[i];
+    }
+}
+
+/**
+ * @brief Writes the sensor readings to the telemetry log. Runs on the network side.
+ */
+void handleSensorLogTimer(void* context) {
+    (void)context;
+    for (uint8_t i = 0; i < sensorCount; i++) {
+        telemetryLog.append(sensorLogChannels[i], sensorReadings[i]);
+    }
+}
+
+/**
+ * @brief Keeps the latest control state sample, logs every state change and
+ * saves the state to restore at boot. Runs on the network side.
+ *
+ * The snapshot is saved once the state has been left alone for
+ * snapshotDelay, so a run of clicks costs one flash write.
+ */
+void handleTelemetry(void* context) {
+    (void)context;
+    TelemetrySample sample;
+    while (telemetry.receive(sample)) {
+        latestTelemetry = sample;
+        telemetryLog.append(stateLogChannel, static_cast<int32_t>(sample.state), sample.timestampMs);
+        uint64_t logMs = telemetryLog.now() - (static_cast<uint32_t>(hal::millis()) - sample.timestampMs);
+        StateSnapshot snapshot = {sample.state & persistentStateMask,
+            static_cast<uint32_t>((logMs % msPerDay + msPerDay - sample.dayMs % msPerDay) % msPerDay)};
+        uint32_t drift = snapshot.dayOriginMs > savedSnapshot.dayOriginMs
+            ? snapshot.dayOriginMs - savedSnapshot.dayOriginMs : savedSnapshot.dayOriginMs - snapshot.dayOriginMs;
+        if (drift < dayOriginToleranceMs || msPerDay - drift < dayOriginToleranceMs) {
+            snapshot.dayOriginMs = savedSnapshot.dayOriginMs;
+        }
+        if (snapshot.state != pendingSnapshot.state || snapshot.dayOriginMs != pendingSnapshot.dayOriginMs) {
+            pendingSnapshot = snapshot;
+            networkScheduler.startTimer(snapshotTimer, snapshotDelay);
+        }
+    }
+}
+
+/**
+ * @brief Saves the state to restore at boot once it has settled. Runs on the network side.
+ */
+void handleSnapshotTimer(void* context) {
+    (void)context;
+    if (stateSnapshots.save(&pendingSnapshot, sizeof(pendingSnapshot))) {
+        savedSnapshot = pendingSnapshot;
+    }
+}
+
+/**
+ * @brief Logs per-core scheduler utilisation, the state of the queues and the sensor readings.
+ *
+ * Utilisation is the share of the interval the core's scheduler spent running
+ * handlers. The logger's drain task is not included.
+ */
+void handleStatsReport(void* context) {
+    (void)context;
+    uint32_t nowUs = static_cast<uint32_t>(hal::micros());
+    uint32_t controlCycles = controlScheduler.getBusyCycles();
+    uint32_t networkCycles = networkScheduler.getBusyCycles();
+    uint64_t windowCycles = static_cast<uint64_t>(nowUs - lastStatsReportUs) * hal::cyclesPerMicrosecond();
+    if (windowCycles > 0) {
+        LOG_INFO("CPU: core %d control %lu.%02lu%%, core %d network %lu.%02lu%%",
+            controlCore, static_cast<unsigned long>((controlCycles - lastControlBusyCycles) * 10000ULL / windowCycles / 100),
+            static_cast<unsigned long>((controlCycles - lastControlBusyCycles) * 10000ULL / windowCycles % 100),
+            networkCore, static_cast<unsigned long>((networkCycles - lastNetworkBusyCycles) * 10000ULL / windowCycles / 100),
+            static_cast<unsigned long>((networkCycles - lastNetworkBusyCycles) * 10000ULL / windowCycles % 100));
+    }
+    lastControlBusyCycles = controlCycles;
+    lastNetworkBusyCycles = networkCycles;
+    lastStatsReportUs = nowUs;
+    LOG_INFO("Queue commands: %lu/%lu, max %lu, dropped %lu", static_cast<unsigned long>(networkCommands.getDepth()),
+        static_cast<unsigned long>(networkCommands.capacity), static_cast<unsigned long>(networkCommands.getMaxDepth()),
+        static_cast<unsigned long>(networkCommands.getDropped()));
+    LOG_INFO("Queue messages: %lu/%lu, max %lu, dropped %lu", static_cast<unsigned long>(controlMessages.getDepth()),
+        static_cast<unsigned long>(controlMessages.capacity), static_cast<unsigned long>(controlMessages.getMaxDepth()),
+        static_cast<unsigned long>(controlMessages.getDropped()));
+    LOG_INFO("Queue telemetry: %lu/%lu, max %lu, dropped %lu", static_cast<unsigned long>(telemetry.getDepth()),
+        static_cast<unsigned long>(telemetry.capacity), static_cast<unsigned long>(telemetry.getMaxDepth()),
+        static_cast<unsigned long>(telemetry.getDropped()));
+    LOG_INFO("Log messages dropped: %lu", static_cast<unsigned long>(DebugLogger::getDroppedCount()));
+    LOG_INFO("Telemetry log: %lu records in %lu bytes", static_cast<unsigned long>(telemetryLog.getRecordCount()),
+        static_cast<unsigned long>(telemetryLog.getEncodedBytes()));
+    LOG_INFO("HTTP: %lu requests, %lu errors, max latency %lu us", static_cast<unsigned long>(httpServer.getRequestCount()),
+        static_cast<unsigned long>(httpServer.getErrorCount()), static_cast<unsigned long>(httpServer.getMaxLatencyUs()));
+    static const char* const mqttStates[] = {"offline", "connecting", "connected", "backoff"};
+    LOG_INFO("MQTT: %s, %lu messages, %lu records, %lu s behind", mqttStates[static_cast<uint8_t>(mqttClient.getState())],
+        static_cast<unsigned long>(mqttPublisher.getMessageCount()), static_cast<unsigned long>(mqttPublisher.getRecordCount()),
+        static_cast<unsigned long>(telemetryLog.now() > mqttPublisher.getCursorMs()
+            ? (telemetryLog.now() - mqttPublisher.getCursorMs()) / 1000 : 0));
+    int32_t water = sensorReadings[WaterTemperatureSensor];
+    LOG_INFO("Sensors: pH %ld.%02ld, EC %ld uS/cm, water %s%ld.%ld C, level %ld.%ld%%",
+        static_cast<long>(sensorReadings[PhSensor] / 1000), static_cast<long>(sensorReadings[PhSensor] % 1000 / 10),
+        static_cast<long>(sensorReadings[EcSensor]), water < 0 ? "-" : "",
+        static_cast<long>((water < 0 ? -water : water) / 10), static_cast<long>((water < 0 ? -water : water) % 10),
+        static_cast<long>(sensorReadings[LevelSensor] / 10), static_cast<long>(sensorReadings[LevelSensor] % 10));
+}
+
+/**
+ * @brief GET /api/state: the control state, the WiFi link and the sensor readings.
+ *
+ * Answered from the network side's copies, so the control side is not
+ * touched. logTimeMs is the telemetry log's clock, for /api/history ranges;
+ * restoredUs is how long after reset the outputs were restored at boot.
+ */
+void handleStateRequest(const HttpServer::Request& request, HttpServer::Response& response, void* context) {
+    (void)request;
+    (void)context;
+    static const char* const wifiStates[] = {"off", "connecting", "connected", "backoff", "disconnecting"};
+    uint32_t state = latestTelemetry.state;
+    const char* strip = "off";
+    if (AppState::test(state, AppState::Field::LedStrip)) {
+        strip = AppState::test(state, AppState::Field::VegetableLedDiode) ? "vegetative" : "flowering";
+    }
+    JsonWriter& json = response.json();
+    json.beginObject();
+    json.key("power").boolean(AppState::test(state, AppState::Field::Power));
+    json.key("pump").boolean(AppState::test(state, AppState::Field::PumpLedDiode));
+    json.key("vegetable").boolean(AppState::test(state, AppState::Field::VegetableLedDiode));
+    json.key("flower").boolean(AppState::test(state, AppState::Field::FlowerLedDiode));
+    json.key("strip").string(strip);
+    json.key("state").number(state);
+    json.key("wifi").string(wifiStates[static_cast<uint8_t>(wifiManager.getState())]);
+    json.key("uptimeMs").number(hal::millis());
+    json.key("logTimeMs").number(static_cast<int64_t>(telemetryLog.now()));
+    json.key("restoredUs").number(outputsRestoredUs);
+    json.key("sensors").beginObject();
+    json.key("ph").fixed(sensorReadings[PhSensor], 3);
+    json.key("ec").number(sensorReadings[EcSensor]);
+    json.key("water").fixed(sensorReadings[WaterTemperatureSensor], 1);
+    json.key("level").fixed(sensorReadings[LevelSensor], 1);
+    json.endObject();
+    json.endObject();
+}
+
+/**
+ * @brief Where a streamed history response continues, kept in the stream state.
+ */
+struct HistoryCursor {
+    uint64_t nextMs; // Time of the last record written, or the start of the range
+    uint64_t toMs; // End of the range
+    uint32_t written; // Records at nextMs already written
+    uint8_t channel; // Only this channel, or TelemetryStore::invalidId for all
+    bool started; // The opening bracket was written
+};
+static_assert(sizeof(HistoryCursor) <= HttpServer::streamStateSize, "history cursor must fit the stream state");
+
+/**
+ * @brief A chunk of history being written.
+ */
+struct HistoryChunk {
+    JsonWriter* json;
+    HistoryCursor* cursor;
+    uint32_t skip; // Records at the cursor written in earlier chunks
+};
+
+/**
+ * @brief Writes one record as [timeMs, "channel", value] and moves the cursor past it.
+ */
+void writeHistoryRecord(uint8_t channel, uint64_t timeMs, int32_t value, void* context) {
+    HistoryChunk& chunk = *static_cast<HistoryChunk*>(context);
+    if (chunk.skip > 0) {
+        chunk.skip--;
+        return;
+    }
+    HistoryCursor& cursor = *chunk.cursor;
+    cursor.written = timeMs == cursor.nextMs ? cursor.written + 1 : 1;
+    cursor.nextMs = timeMs;
+    if (cursor.channel == TelemetryStore::invalidId || channel == cursor.channel) {
+        chunk.json->beginArray();
+        chunk.json->number(static_cast<int64_t>(timeMs));
+        chunk.json->string(logChannelNames[channel] != nullptr ? logChannelNames[channel] : "");
+        chunk.json->number(value);
+        chunk.json->endArray();
+    }
+}
+
+/**
+ * @brief Fills a chunk with the next records of the range straight from flash.
+ *
+ * Each chunk is a query for as many records as the chunk can hold, resuming
+ * after the last record of the previous chunk. Records sharing its
+ * timestamp are counted in the cursor and skipped.
+ */
+bool streamHistory(JsonWriter& json, uint8_t* state, void* context) {
+    (void)context;
+    HistoryCursor cursor;
+    memcpy(&cursor, state, sizeof(cursor));
+    if (!cursor.started) {
+        json.beginArray();
+        cursor.started = true;
+    }
+    bool done = false;
+    while (!done && json.remaining() > historyRecordJson) {
+        size_t room = (json.remaining() - 1) / historyRecordJson;
+        HistoryChunk chunk = {&json, &cursor, cursor.written};
+        size_t wanted = cursor.written + room;
+        done = telemetryLog.query(cursor.nextMs, cursor.toMs, writeHistoryRecord, &chunk, wanted) < wanted;
+    }
+    if (done) {
+        json.endArray();
+    }
+    memcpy(state, &cursor, sizeof(cursor));
+    return done;
+}
+
+/**
+ * @brief GET /api/history?from=&to=&channel=: logged records as [[timeMs, "channel", value], ...].
+ *
+ * from and to are milliseconds on the log clock (logTimeMs in /api/state),
+ * inclusive; by default the last hour. channel limits the records to one
+ * channel. The body is streamed, so any range can be asked for.
+ */
+void handleHistoryRequest(const HttpServer::Request& request, HttpServer::Response& response, void* context) {
+    (void)context;
+    uint64_t now = telemetryLog.now();
+    int64_t fromMs = now > historyWindowMs ? static_cast<int64_t>(now - historyWindowMs) : 0;
+    int64_t toMs = static_cast<int64_t>(now);
+    request.intParam("from", fromMs);
+    request.intParam("to", toMs);
+    HistoryCursor cursor = {static_cast<uint64_t>(fromMs < 0 ? 0 : fromMs), static_cast<uint64_t>(toMs < 0 ? 0 : toMs),
+        0, TelemetryStore::invalidId, false};
+    size_t length = 0;
+    const char* channel = request.param("channel", length);
+    if (channel != nullptr) {
+        for (uint8_t i = 0; i < TelemetryStore::maxChannels && cursor.channel == TelemetryStore::invalidId; i++) {
+            if (logChannelNames[i] != nullptr && strlen(logChannelNames[i]) == length &&
+                strncmp(logChannelNames[i], channel, length) == 0) {
+                cursor.channel = i;
+            }
+        }
+        if (cursor.channel == TelemetryStore::invalidId) {
+            response.setStatus(404);
+            response.json().beginObject().key("error").string("unknown channel").endObject();
+            return;
+        }
+    }
+    memcpy(response.streamState(), &cursor, sizeof(cursor));
+    response.stream(streamHistory, nullptr);
+}
+
+/**
+ * @brief POST /api/buttons/{power,pump,vegetable,flower}: clicks a button.
+ *
+ * The click is carried out by the control side like a real one, so the
+ * answer only says it was accepted; /api/state shows the outcome.
+ */
+void handleButtonRequest(const HttpServer::Request& request, HttpServer::Response& response, void* context) {
+    (void)context;
+    for (uint8_t button = Power; button <= Flower; button++) {
+        if (strcmp(request.wildcard, buttonNames[button]) != 0) {
+            continue;
+        }
+        bool sent = controlMessages.send({ControlMessage::ButtonAction, button});
+        response.setStatus(sent ? 202 : 503);
+        response.json().beginObject().key("button").string(buttonNames[button]).key("accepted").boolean(sent).endObject();
+        return;
+    }
+    response.setStatus(404);
+    response.json().beginObject().key("error").string("unknown button").endObject();
+}
+
+/**
+ * @brief GET /api/server: request counters of the HTTP server.
+ */
+void handleServerRequest(const HttpServer::Request& request, HttpServer::Response& response, void* context) {
+    (void)request;
+    (void)context;
+    JsonWriter& json = response.json();
+    json.beginObject();
+    json.key("requests").number(httpServer.getRequestCount());
+    json.key("errors").number(httpServer.getErrorCount());
+    json.key("maxLatencyUs").number(httpServer.getMaxLatencyUs());
+    json.key("connections").number(httpServer.getConnectionCount());
+    json.endObject();
+}
+
+/**
+ * @brief Clicks the button named by a message on the command topic, like POST /api/buttons/ does.
+ */
+void handleMqttMessage(const char* topic, const uint8_t* payload, size_t length, void* context) {
+    (void)context;
+    if (strcmp(topic, mqttCommandTopic) != 0) {
+        return;
+    }
+    for (uint8_t button = Power; button <= Flower; button++) {
+        if (strlen(buttonNames[button]) == length && memcmp(buttonNames[button], payload, length) == 0) {
+            if (!controlMessages.send({ControlMessage::ButtonAction, button})) {
+                LOG_WARN("MQTT command %s dropped.", buttonNames[button]);
+            }
+            return;
+        }
+    }
+    LOG_WARN("Unknown MQTT command.");
+}
+
+/**
+ * @brief One pass of the control side: handlers, state changes, then one output write.
+ */
+void runControlCycle() {
+    PROFILE_SPAN(loopIteration);
+    controlScheduler.runPending();
+    appState.notifyObservers();
+    shiftRegister.flush();
+}
+
+/**
+ * @brief Body of the control task on core 1.
+ */
+void runControlTask(void* context) {
+    (void)context;
+    for (;;) {
+        runControlCycle();
+        controlScheduler.sleep();
+    }
+}
+
+/**
+ * @brief Body of the network task on core 0.
+ */
+void runNetworkTask(void* context) {
+    (void)context;
+    for (;;) {
+        networkScheduler.runOnce();
     }
 }
 
 /**
  * @brief Main loop of the application.
  * 
- * Continuously checks and updates button states, processes button click events, and manages WiFi LED status.
+ * With the control and network tasks running, the Arduino loop task has
+ * nothing left to do and stays asleep. If only the control task could be
+ * started, the network side runs here alone. Without tasks both sides run
+ * here in turn: due handlers run, the state changes they made are applied,
+ * the outputs are written once for everything that changed, and the task
+ * sleeps until either side has work. Only the control work is profiled, not
+ * the sleep.
  */
 void loop() {
-    for (auto& button : allButtons) {
-        button.update();
+    if (networkTaskRunning) {
+        hal::waitForNotification(hal::waitForever);
+        return;
     }
-
-    if (allButtons[Power].isClicked()) handlePowerButtonClick();
-    if (allButtons[Pump].isClicked()) handlePumpButtonClick();
-    if (allButtons[Vegetable].isClicked()) handleVegetableButtonClick();
-    if (allButtons[Flower].isClicked()) handleFlowerButtonClick();
-    if (appState.isPowerOn()) {
-        wifiManager.handleConnectionResult();
-        updateWiFiLedDiodeState();
+    if (controlTaskRunning) {
+        networkScheduler.runOnce();
+        return;
+    }
+    runControlCycle();
+    networkScheduler.runPending();
+    if (!controlScheduler.hasPendingEvents() && !networkScheduler.hasPendingEvents()) {
+        uint32_t controlWait = controlScheduler.millisUntilNextDeadline();
+        uint32_t networkWait = networkScheduler.millisUntilNextDeadline();
+        hal::waitForNotification(controlWait < networkWait ? controlWait : networkWait);
     }
-    delay(10);
 }
-
@@ -0,0 +1,102 @@
+#!/usr/bin/env python3
+"""Compare two benchmark runs and flag regressions.
+
+Reads the "BENCH {...}" lines the benchmark runner prints, from the host
+program's output or from a serial capture of the board, and compares cycles
+per operation benchmark by benchmark. A file may hold several runs, for
+example captures appended to each other; the fastest result of each
+benchmark is used, which takes out most of the noise of a busy host.
+
+Usage:
+    for i in 1 2 3 4 5; do .pio/build/bench_native/program; done > before.txt
+    (change, rebuild)
+    for i in 1 2 3 4 5; do .pio/build/bench_native/program; done > after.txt
+    tools/bench_compare.py before.txt after.txt
+    tools/bench_compare.py before.txt after.txt --threshold 5 --json
+
+On the board, save the serial output of each run and compare the files:
+    pio device monitor -b 115200 | tee esp32-after.txt
+
+Exits with status 1 if any benchmark is slower than the threshold allows,
+so it can gate a build. Results from different platforms are not compared.
+"""
+
+import argparse
+import json
+import sys
+
+PREFIX = "BENCH "
+
+
+def load(path):
+    """Returns {name: record} with the fastest record of each benchmark."""
+    results = {}
+    with open(path, encoding="utf-8", errors="replace") as file:
+        for line in file:
+            start = line.find(PREFIX)
+            if start < 0:
+                continue
+            try:
+                record = json.loads(line[start + len(PREFIX):])
+            except ValueError:
+                continue  # Cut short on a serial line
+            best = results.get(record["name"])
+            if best is None or record["cycles_per_op"] < best["cycles_per_op"]:
+                results[record["name"]] = record
+    return results
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("baseline", help="output of the reference run")
+    parser.add_argument("candidate", help="output of the run to check")
+    parser.add_argument("--threshold", type=float, default=10.0,
+                        help="percent slower than the baseline that counts as a regression (default 10)")
+    parser.add_argument("--json", action="store_true", help="print the comparison as JSON")
+    args = parser.parse_args()
+
+    baseline = load(args.baseline)
+    candidate = load(args.candidate)
+    if not baseline or not candidate:
+        sys.exit("no BENCH lines in %s" % (args.baseline if not baseline else args.candidate))
+
+    rows = []
+    for name in list(baseline) + [name for name in candidate if name not in baseline]:
+        before = baseline.get(name)
+        after = candidate.get(name)
+        row = {"name": name, "before": None, "after": None, "change_percent": None, "status": "only in candidate"}
+        if before is not None:
+            row["before"] = before["cycles_per_op"]
+            row["status"] = "only in baseline"
+        if after is not None:
+            row["after"] = after["cycles_per_op"]
+        if before is not None and after is not None:
+            if before.get("platform") != after.get("platform"):
+                row["status"] = "platform differs"
+            else:
+                change = (after["cycles_per_op"] - before["cycles_per_op"]) / max(before["cycles_per_op"], 1e-9) * 100
+                row["change_percent"] = round(change, 1)
+                row["status"] = ("regression" if change > args.threshold
+                                 else "improvement" if change < -args.threshold else "ok")
+        rows.append(row)
+    regressions = sum(1 for row in rows if row["status"] == "regression")
+
+    if args.json:
+        json.dump({"threshold_percent": args.threshold, "regressions": regressions, "benchmarks": rows},
+                  sys.stdout, indent=2)
+        print()
+    else:
+        print("%-44s %14s %14s %9s  %s" % ("benchmark", "before cyc/op", "after cyc/op", "change", "status"))
+        for row in rows:
+            print("%-44s %14s %14s %9s  %s" % (
+                row["name"],
+                "-" if row["before"] is None else "%.2f" % row["before"],
+                "-" if row["after"] is None else "%.2f" % row["after"],
+                "-" if row["change_percent"] is None else "%+.1f%%" % row["change_percent"],
+                row["status"]))
+        print("%d regression(s) beyond %.1f%%" % (regressions, args.threshold))
+    sys.exit(1 if regressions else 0)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,87 @@
+#!/usr/bin/env python3
+"""Load-test the HTTP API and report throughput and latency.
+
+Each client thread keeps one connection open and sends requests back to back
+for the given time. Run against the board, or against the native program:
+
+Usage:
+    .pio/build/native/program --serve --seconds 60 &
+    tools/http_load.py --host 127.0.0.1 --port 8080 --clients 4 --seconds 10
+    tools/http_load.py --path "/api/history?from=0" --clients 1
+    tools/http_load.py --host 192.168.1.40 --port 80 --post /api/buttons/pump --seconds 5
+
+The server has four connection slots; more clients than that wait in the
+listen backlog and show up as latency.
+"""
+
+import argparse
+import http.client
+import threading
+import time
+
+
+def client(args, deadline, latencies, errors, sizes, lock):
+    connection = http.client.HTTPConnection(args.host, args.port, timeout=5)
+    method, path = ("POST", args.post) if args.post else ("GET", args.path)
+    mine = []
+    failed = 0
+    received = 0
+    while time.perf_counter() < deadline:
+        start = time.perf_counter()
+        try:
+            connection.request(method, path, body=b"" if method == "POST" else None)
+            response = connection.getresponse()
+            body = response.read()
+        except (OSError, http.client.HTTPException):
+            failed += 1
+            connection.close()
+            connection = http.client.HTTPConnection(args.host, args.port, timeout=5)
+            continue
+        mine.append(time.perf_counter() - start)
+        received += len(body)
+        if response.status >= 400:
+            failed += 1
+    connection.close()
+    with lock:
+        latencies.extend(mine)
+        errors.append(failed)
+        sizes.append(received)
+
+
+def percentile(values, fraction):
+    return values[min(len(values) - 1, int(fraction * len(values)))]
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--host", default="127.0.0.1")
+    parser.add_argument("--port", type=int, default=8080)
+    parser.add_argument("--path", default="/api/state", help="GET this path (default /api/state)")
+    parser.add_argument("--post", help="POST to this path instead")
+    parser.add_argument("--clients", type=int, default=4, help="concurrent keep-alive connections")
+    parser.add_argument("--seconds", type=float, default=10)
+    args = parser.parse_args()
+
+    latencies, errors, sizes = [], [], []
+    lock = threading.Lock()
+    deadline = time.perf_counter() + args.seconds
+    threads = [threading.Thread(target=client, args=(args, deadline, latencies, errors, sizes, lock))
+               for _ in range(args.clients)]
+    started = time.perf_counter()
+    for thread in threads:
+        thread.start()
+    for thread in threads:
+        thread.join()
+    elapsed = time.perf_counter() - started
+
+    latencies.sort()
+    print(f"requests:   {len(latencies)} in {elapsed:.2f} s, {len(latencies) / elapsed:.0f} req/s, "
+          f"{sum(errors)} errors")
+    print(f"received:   {sum(sizes) / elapsed / 1024:.1f} KiB/s")
+    if latencies:
+        print("latency:    p50 {:.2f} ms, p90 {:.2f} ms, p99 {:.2f} ms, max {:.2f} ms".format(
+            *(1000 * percentile(latencies, f) for f in (0.5, 0.9, 0.99)), 1000 * latencies[-1]))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,237 @@
+#!/usr/bin/env python3
+"""Decode binary DebugLogger output (firmware built with -D LOG_BINARY).
+
+Format strings are looked up in the firmware ELF by their offset from the
+debugLogFormatAnchor symbol, so the ELF must be the exact build that produced
+the log. Text lines in the stream, such as profiler dumps, are passed through.
+
+Usage:
+    tools/log_decode.py .pio/build/esp32dev/firmware.elf capture.bin
+    tools/log_decode.py .pio/build/esp32dev/firmware.elf --port /dev/ttyUSB0
+    .pio/build/native/program --verbose | tools/log_decode.py .pio/build/native/program -
+
+See lib/DebugLogger/src/BinaryLog.hpp for the frame layout.
+"""
+
+import argparse
+import re
+import struct
+import sys
+
+ANCHOR_SYMBOL = "debugLogFormatAnchor"
+LEVELS = {1: "ERROR", 2: "WARN", 3: "INFO", 4: "DEBUG"}
+TAG_UNSIGNED, TAG_SIGNED, TAG_DOUBLE, TAG_STRING, TAG_TRUNCATED = range(5)
+SHT_SYMTAB, SHT_NOBITS = 2, 8
+
+# printf conversion: flags, width, precision, length modifier, conversion.
+CONVERSION = re.compile(r"%([-+ #0]*)(\*|\d+)?(?:\.(\*|\d+))?(hh|h|ll|l|j|z|t|L)?([diouxXeEfgGcspa%])")
+
+
+class Elf:
+    """The parts of an ELF file needed to read format strings."""
+
+    def __init__(self, path):
+        with open(path, "rb") as f:
+            self.data = f.read()
+        if self.data[:4] != b"\x7fELF":
+            raise ValueError(f"{path} is not an ELF file")
+        if self.data[5] != 1:
+            raise ValueError("only little-endian ELF files are supported")
+        is64 = self.data[4] == 2
+        if is64:
+            shoff, = struct.unpack_from("<Q", self.data, 0x28)
+            shentsize, shnum = struct.unpack_from("<HH", self.data, 0x3A)
+        else:
+            shoff, = struct.unpack_from("<I", self.data, 0x20)
+            shentsize, shnum = struct.unpack_from("<HH", self.data, 0x2E)
+        self.sections = []
+        for i in range(shnum):
+            base = shoff + i * shentsize
+            if is64:
+                _, stype, _, addr, offset, size, link, _, _, entsize = struct.unpack_from("<IIQQQQIIQQ", self.data, base)
+            else:
+                _, stype, _, addr, offset, size, link, _, _, entsize = struct.unpack_from("<IIIIIIIIII", self.data, base)
+            self.sections.append((stype, addr, offset, size, link, entsize))
+        self.anchor = self._find_symbol(ANCHOR_SYMBOL, is64)
+
+    def _find_symbol(self, name, is64):
+        wanted = name.encode()
+        for stype, _, offset, size, link, entsize in self.sections:
+            if stype != SHT_SYMTAB:
+                continue
+            strtab = self.sections[link][2]
+            for base in range(offset, offset + size, entsize):
+                if is64:
+                    st_name, _, _, _, st_value, _ = struct.unpack_from("<IBBHQQ", self.data, base)
+                else:
+                    st_name, st_value, _, _, _, _ = struct.unpack_from("<IIIBBH", self.data, base)
+                start = strtab + st_name
+                if self.data[start:self.data.index(b"\0", start)] == wanted:
+                    return st_value
+        raise ValueError(f"symbol {name} not found; was the firmware built with -D LOG_BINARY and not stripped?")
+
+    def string_at(self, address):
+        for stype, addr, offset, size, _, _ in self.sections:
+            if stype != SHT_NOBITS and addr != 0 and addr <= address < addr + size:
+                start = offset + address - addr
+                return self.data[start:self.data.index(b"\0", start)].decode("utf-8", "replace")
+        return None
+
+
+def cobs_decode(data):
+    out = bytearray()
+    i = 0
+    while i < len(data):
+        code = data[i]
+        if code == 0 or i + code > len(data):
+            return None
+        out += data[i + 1:i + code]
+        i += code
+        if code < 0xFF and i < len(data):
+            out.append(0)
+    return bytes(out)
+
+
+def read_varint(data, pos):
+    value = shift = 0
+    while True:
+        if pos >= len(data):
+            raise ValueError("truncated varint")
+        byte = data[pos]
+        pos += 1
+        value |= (byte & 0x7F) << shift
+        shift += 7
+        if not byte & 0x80:
+            return value, pos
+
+
+def unzigzag(value):
+    return (value >> 1) ^ -(value & 1)
+
+
+def read_arguments(data):
+    arguments = []
+    truncated = False
+    pos = 0
+    while pos < len(data):
+        tag = data[pos]
+        pos += 1
+        if tag == TAG_UNSIGNED:
+            value, pos = read_varint(data, pos)
+        elif tag == TAG_SIGNED:
+            value, pos = read_varint(data, pos)
+            value = unzigzag(value)
+        elif tag == TAG_DOUBLE:
+            value, = struct.unpack_from("<d", data, pos)
+            pos += 8
+        elif tag == TAG_STRING:
+            length = data[pos]
+            value = data[pos + 1:pos + 1 + length].decode("utf-8", "replace")
+            pos += 1 + length
+        elif tag == TAG_TRUNCATED:
+            truncated = True
+            break
+        else:
+            raise ValueError(f"unknown argument tag {tag}")
+        arguments.append(value)
+    return arguments, truncated
+
+
+def render(fmt, arguments, truncated):
+    """Formats like printf, tolerating missing or extra arguments."""
+    remaining = list(arguments)
+
+    def convert(match):
+        flags, width, precision, _, conversion = match.groups()
+        if conversion == "%":
+            return "%"
+        if not remaining:
+            return "<?>"
+        value = remaining.pop(0)
+        if conversion == "c" and isinstance(value, int):
+            value = chr(value & 0xFF)
+        elif conversion == "p":
+            return f"0x{value:x}"
+        spec = "%" + (flags or "") + (width or "") + ("." + precision if precision else "")
+        spec += {"u": "d", "a": "e"}.get(conversion, conversion)
+        try:
+            return spec % value
+        except (TypeError, ValueError):
+            return str(value)
+
+    text = CONVERSION.sub(convert, fmt)
+    if truncated:
+        text += " <truncated>"
+    return text
+
+
+class Decoder:
+    def __init__(self, elf, out):
+        self.elf = elf
+        self.out = out
+        self.time_us = 0
+        self.pending = bytearray()
+
+    def feed(self, chunk):
+        self.pending += chunk
+        while True:
+            end = self.pending.find(b"\0")
+            if end < 0:
+                return
+            block = bytes(self.pending[:end])
+            del self.pending[:end + 1]
+            if block and not self.decode_frame(block):
+                self.out.write(block.decode("utf-8", "replace"))
+
+    def decode_frame(self, block):
+        payload = cobs_decode(block)
+        if payload is None or len(payload) < 4:
+            return False
+        checksum = 0
+        for byte in payload:
+            checksum ^= byte
+        if checksum != 0:
+            return False
+        try:
+            level = payload[0]
+            offset, pos = read_varint(payload, 1)
+            elapsed, pos = read_varint(payload, pos)
+            arguments, truncated = read_arguments(payload[pos:-1])
+        except (ValueError, IndexError, struct.error):
+            return False
+        self.time_us += unzigzag(elapsed)
+        fmt = self.elf.string_at(self.elf.anchor + unzigzag(offset))
+        if fmt is None:
+            fmt = f"<unknown format at offset {unzigzag(offset)}>"
+        text = render(fmt, arguments, truncated)
+        self.out.write(f"[{self.time_us / 1e6:12.6f}] [{LEVELS.get(level, level)}] {text}\n")
+        return True
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("elf", help="firmware ELF of the build that produced the log")
+    parser.add_argument("input", nargs="?", default="-", help="captured log file, or - for stdin")
+    parser.add_argument("--port", help="read from a serial port instead (requires pyserial)")
+    parser.add_argument("--baud", type=int, default=115200)
+    args = parser.parse_args()
+
+    decoder = Decoder(Elf(args.elf), sys.stdout)
+    if args.port:
+        import serial
+        with serial.Serial(args.port, args.baud) as port:
+            while True:
+                decoder.feed(port.read(max(1, port.in_waiting)))
+                sys.stdout.flush()
+    stream = sys.stdin.buffer if args.input == "-" else open(args.input, "rb")
+    with stream:
+        while True:
+            chunk = stream.read(4096)
+            if not chunk:
+                break
+            decoder.feed(chunk)
+    decoder.feed(b"\0")
+
+
+if __name__ == "__main__":
+    main()
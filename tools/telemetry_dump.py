@@ -0,0 +1,168 @@
+#!/usr/bin/env python3
+"""Decode an image of the telemetry log (TelemetryStore) to CSV.
+
+The image is the whole "storage" partition, read from the board or written
+by the native program:
+
+Usage:
+    esptool.py read_flash 0x290000 0x160000 telemetry.bin
+    tools/telemetry_dump.py telemetry.bin > telemetry.csv
+    tools/telemetry_dump.py telemetry.bin --from 86400 --to 172800 --channel ph
+    .pio/build/native/program --grow-days 7 --telemetry-image telemetry.bin
+    tools/telemetry_dump.py telemetry.bin --stats
+
+Times are seconds on the log's clock. See lib/Telemetry/src/TelemetryStore.hpp
+for the layout.
+"""
+
+import argparse
+import struct
+import sys
+
+SEGMENT_SIZE = 4096
+BLOCK_SIZE = 256
+BLOCKS_PER_SEGMENT = SEGMENT_SIZE // BLOCK_SIZE - 1
+COMMIT_SLOTS = 8
+BLOCK_DATA_SIZE = BLOCK_SIZE - 2 * COMMIT_SLOTS
+MAX_CHANNELS = 16
+NAME_LENGTH = 8
+MAGIC = 0x314D4C54
+VERSION = 1
+UNUSED_BLOCK = 0xFFFFFFFF
+ENCODING_XOR = 1
+CHANNEL_MASK, SAME_INTERVAL, SAME_VALUE = 0x0F, 0x10, 0x20
+
+# magic, version, channel count, block size, sequence, reserved, base time
+HEADER = struct.Struct("<IBBHIIQ")
+
+
+class Segment:
+    """Header of one segment: channel table and block index."""
+
+    def __init__(self, image, offset):
+        (self.magic, self.version, self.channel_count, self.block_size, self.sequence, _,
+         self.base_ms) = HEADER.unpack_from(image, offset)
+        pos = offset + HEADER.size
+        self.encodings = image[pos:pos + MAX_CHANNELS]
+        pos += MAX_CHANNELS
+        self.names = [image[pos + i * NAME_LENGTH:pos + (i + 1) * NAME_LENGTH].split(b"\0")[0].decode(errors="replace")
+                      for i in range(MAX_CHANNELS)]
+        pos += MAX_CHANNELS * NAME_LENGTH
+        self.block_times = struct.unpack_from(f"<{BLOCKS_PER_SEGMENT}I", image, pos)
+        self.offset = offset
+
+    def valid(self):
+        return (self.magic == MAGIC and self.version == VERSION and self.block_size == BLOCK_SIZE
+                and self.channel_count <= MAX_CHANNELS)
+
+
+def read_varint(data, pos):
+    value = shift = 0
+    while True:
+        byte = data[pos]
+        pos += 1
+        value |= (byte & 0x7F) << shift
+        if not byte & 0x80:
+            return value, pos
+        shift += 7
+
+
+def unzigzag(value):
+    return (value >> 1) ^ -(value & 1)
+
+
+def to_int32(value):
+    value &= 0xFFFFFFFF
+    return value - (1 << 32) if value & 0x80000000 else value
+
+
+def block_data(image, offset):
+    """Committed bytes of a block: up to the last commit length written."""
+    length = 0
+    for commit in struct.unpack_from(f"<{COMMIT_SLOTS}H", image, offset):
+        if commit == 0xFFFF:
+            break
+        length = commit if commit <= BLOCK_DATA_SIZE else 0
+    start = offset + 2 * COMMIT_SLOTS
+    return image[start:start + length]
+
+
+def decode_block(data, start_ms, segment):
+    """Yields (channel, time_ms, value); stops at a malformed record."""
+    states = [[start_ms, 0, 0] for _ in range(MAX_CHANNELS)]
+    pos = 0
+    try:
+        while pos < len(data):
+            flags = data[pos]
+            pos += 1
+            channel = flags & CHANNEL_MASK
+            if channel >= segment.channel_count:
+                return
+            state = states[channel]
+            if not flags & SAME_INTERVAL:
+                change, pos = read_varint(data, pos)
+                state[1] += unzigzag(change)
+            state[0] += state[1]
+            if not flags & SAME_VALUE:
+                change, pos = read_varint(data, pos)
+                if segment.encodings[channel] == ENCODING_XOR:
+                    state[2] = to_int32(state[2] ^ change)
+                else:
+                    state[2] = to_int32(state[2] + unzigzag(change))
+            yield channel, state[0], state[2]
+    except IndexError:
+        return
+
+
+def segments_in_order(image):
+    segments = [Segment(image, offset) for offset in range(0, len(image) - SEGMENT_SIZE + 1, SEGMENT_SIZE)]
+    return sorted((s for s in segments if s.valid()), key=lambda s: s.sequence)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("image", help="image of the storage partition")
+    parser.add_argument("--from", dest="from_s", type=float, default=0, help="first second to print")
+    parser.add_argument("--to", dest="to_s", type=float, default=float("inf"), help="last second to print")
+    parser.add_argument("--channel", action="append", help="only these channels (repeatable)")
+    parser.add_argument("--stats", action="store_true", help="print record counts and compression instead")
+    args = parser.parse_args()
+
+    with open(args.image, "rb") as f:
+        image = f.read()
+    segments = segments_in_order(image)
+    from_ms, to_ms = args.from_s * 1000, args.to_s * 1000
+    records = encoded = blocks = 0
+    first_ms = last_ms = None
+    if not args.stats:
+        sys.stdout.write("time_s,channel,value\n")
+    for segment in segments:
+        for block, offset_ms in enumerate(segment.block_times):
+            if offset_ms == UNUSED_BLOCK:
+                break
+            data = block_data(image, segment.offset + (block + 1) * BLOCK_SIZE)
+            blocks += 1
+            encoded += len(data)
+            for channel, time_ms, value in decode_block(data, segment.base_ms + offset_ms, segment):
+                records += 1
+                first_ms = time_ms if first_ms is None else first_ms
+                last_ms = time_ms
+                name = segment.names[channel] or str(channel)
+                if args.stats or not from_ms <= time_ms <= to_ms:
+                    continue
+                if args.channel and name not in args.channel:
+                    continue
+                sys.stdout.write(f"{time_ms / 1000:.3f},{name},{value}\n")
+    if args.stats:
+        raw = records * 13  # 8-byte time, 1-byte channel, 4-byte value
+        used = len(segments) * BLOCK_SIZE + blocks * BLOCK_SIZE
+        print(f"segments: {len(segments)} of {len(image) // SEGMENT_SIZE}, blocks: {blocks}")
+        print(f"records:  {records}")
+        if records:
+            print(f"encoded:  {encoded} bytes, {encoded / records:.2f} bytes/record")
+            print(f"flash:    {used} bytes, {used / records:.2f} bytes/record, {raw / used:.1f}:1 against 13-byte records")
+            print(f"span:     {first_ms / 1000:.3f} s to {last_ms / 1000:.3f} s")
+
+
+if __name__ == "__main__":
+    main()